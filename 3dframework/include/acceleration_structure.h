@@ -1,12 +1,10 @@
 #pragma once
 
+#include <matrix.h>
 #include <mesh.h>
 
 DECL_OPAQUE_TYPE(AccelerationStructure)
-
-typedef struct {
-    uint first, count;
-} Range;
+DECL_OPAQUE_TYPE(AccelerationStructureBatch)
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,6 +15,21 @@ AccelerationStructure createMultiAccelerationStructure(const Mesh mesh, const Ra
 void updateAccelerationStructure(AccelerationStructure as, const Mesh mesh, const Range *ranges, const uint nbRanges);
 void deleteAccelerationStructure(AccelerationStructure *as);
 
+// Batched acceleration structures are built in groups fitting the scratch budget, then compacted
+// when the batch ends, they can't be used before nor updated. Positions may use 16-bit float or snorm formats,
+// indices may be 16-bit.
+AccelerationStructureBatch beginAccelerationStructureBatch(const ulong scratchBudget) WARN_UNUSED_RESULT;
+AccelerationStructure batchAccelerationStructure(AccelerationStructureBatch batch, const Mesh mesh, const Range *ranges, const uint nbRanges) WARN_UNUSED_RESULT;
+void endAccelerationStructureBatch(AccelerationStructureBatch *batch);
+
+// Scene acceleration structures only hold a TLAS, instancing the BLAS of other acceleration structures.
+// A deleted acceleration structure stays alive until its instances are removed or their scene deleted.
+AccelerationStructure createSceneAccelerationStructure(const uint maxInstances) WARN_UNUSED_RESULT;
+uint addInstance(AccelerationStructure scene, const AccelerationStructure blas, Mat4 transform, const uchar mask, const uint customIndex);
+void removeInstance(AccelerationStructure scene, const uint instance);
+void setInstanceTransform(AccelerationStructure scene, const uint instance, Mat4 transform);
+void updateSceneAccelerationStructure(AccelerationStructure scene);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <matrix.h>
+
+typedef enum : uchar {
+    SimdLevel_AVX,    // baseline of the build
+    SimdLevel_AVX2,   // with FMA
+    SimdLevel_AVX512,
+} SimdLevel;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Array kernels picking the widest instruction set of the CPU on the first call. Arrays of Float4
+// must be 16 bytes aligned, they are the usual layout of instance and particle buffers.
+SimdLevel getSimdLevel();
+
+// dst[i] = m * src[i], the w of the sources is used so points must have w = 1
+void transformPoints(Float4 *dst, const Float4 *src, const uint n, Mat4 m);
+// Transforms by the inverse transpose of m without renormalizing, the w of the sources must be 0
+void transformNormals(Float4 *dst, const Float4 *src, const uint n, Mat4 m);
+
+// r[i] = a * b[i], same product as multiplytm4
+void multiplyMatrices(Mat4 *r, Mat4 a, const Mat4 *b, const uint n);
+// r[i] = a[i] * b[i]
+void multiplyMatrixPairs(Mat4 *r, const Mat4 *a, const Mat4 *b, const uint n);
+// Like multiplyMatrices with non temporal stores, meant for mapped GPU buffers (see mapBuffer)
+void multiplyStoreMatrices(float *r, Mat4 a, const Mat4 *b, const uint n);
+// Null determinants give null matrices like inversem4
+void inverseMatrices(Mat4 *r, const Mat4 *m, const uint n);
+
+// World bounds of local boxes placed by their own matrix
+void transformAabbs(Float4 *dstMin, Float4 *dstMax, const Float4 *srcMin, const Float4 *srcMax, const Mat4 *matrices, const uint n);
+
+#ifdef __cplusplus
+}
+#endif
@@ -39,13 +39,19 @@ extern "C" {
 
 Buffer createBuffer(const ResourceType type, const uint size) WARN_UNUSED_RESULT;
 Buffer createStagingBuffer(const uint size) WARN_UNUSED_RESULT;
+Buffer createDynamicBuffer(const ResourceType type, const uint bytesPerFrame) WARN_UNUSED_RESULT;
 void deleteBuffer(Buffer *buffer);
 
+// Dynamic buffers only get the slice of the current frame, at most its bytesPerFrame
 void setBufferData(Buffer buffer, const void *data, const uint size);
 void copyBuffer(Buffer dest, Buffer src);
 void* mapBuffer(Buffer buffer);
 void unmapBuffer(Buffer buffer);
 
+// Dynamic buffers are persistently mapped, the returned pointer targets the current frame slice
+void* beginDynamicWrite(Buffer buffer);
+void endDynamicWrite(Buffer buffer, const uint bytesWritten);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <global_defs.h>
+
+DECL_OPAQUE_TYPE(Bundle);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Records the draws and meshlet dispatches until endBundle instead of executing them, for framebuffers
+// with the formats of the current one. Pipelines are compiled while recording, the uniforms set with
+// setUniform are kept as they are, except ProjectionMatrix and ViewMatrix when they hold the camera.
+// Everything else, like buffer writes and compute, still executes right away.
+void beginBundle();
+Bundle endBundle() WARN_UNUSED_RESULT;
+// Replays the draws into the current framebuffer without the pipeline lookups and the uniform binding.
+// The camera matrices are updated to the current camera, several executions in a frame all get the
+// camera of the last one. Dynamic buffers bound while recording are read from the slice of the current
+// frame, they carry the other values changing between the executions.
+void executeBundle(Bundle bundle);
+void deleteBundle(Bundle *bundle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <mesh.h>
+#include <vector.h>
+
+DECL_OPAQUE_TYPE(Bvh)
+
+typedef struct {
+    Float4 origin, direction; // w is ignored
+    float tMin, tMax;
+} Ray;
+
+typedef struct {
+    float t, u, v; // barycentrics of the second and third vertices
+    uint primitive; // ~0u when nothing was hit
+} RayHit;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// CPU BVH over triangle lists, it doesn't need raytracing hardware. Positions are 3 floats read
+// every positionStride bytes, without indices the vertices are taken three by three.
+Bvh createBvh(const void *positions, const uint positionStride, const uint nbVertices, const uint *indices, const uint nbIndices) WARN_UNUSED_RESULT;
+// Reads the mesh back from the GPU and waits for it, meant for loading time
+Bvh createMeshBvh(const Mesh mesh) WARN_UNUSED_RESULT;
+void deleteBvh(Bvh *bvh);
+
+// Closest hit of each ray, rays are spread over all cores
+void traceRays(const Bvh bvh, const Ray *rays, RayHit *hits, const uint nbRays);
+
+// Traces random rays inside the BVH bounds, returns and logs the throughput in Mrays/s
+float benchmarkBvh(const Bvh bvh, const uint nbRays);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <camera.h>
+#include <mesh.h>
+
+// Planes (nx, ny, nz, d) with normalized normals pointing inside, dot(n, p) + d >= 0 for inner points
+typedef struct {
+    Float4 planes[6];
+} Frustum;
+
+// SoA arrays of n floats each
+typedef struct {
+    const float *x, *y, *z, *radius;
+} BoundingSpheres;
+
+typedef struct {
+    const float *x, *y, *z;                   // centers
+    const float *extentX, *extentY, *extentZ; // half sizes
+} BoundingBoxes;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Works with both depth directions, an infinite far plane never culls anything
+Frustum getFrustum(Mat4 viewProjection);
+Frustum getCameraFrustum(Camera *cam);
+
+// Writes the indices of the visible objects in increasing order and returns their number. visible
+// must have room for n indices, large counts are split across all cores. A core tests about one
+// object per nanosecond, a million objects only take under a millisecond when several cores are free.
+uint cullSpheres(const Frustum *frustum, const BoundingSpheres spheres, const uint n, uint *visible);
+uint cullBoxes(const Frustum *frustum, const BoundingBoxes boxes, const uint n, uint *visible);
+
+// Indirect arguments drawing the whole mesh nbInstances times, for drawMeshIndirect after the visible
+// indices were uploaded for the instances
+void setDrawArguments(Buffer indirect, const Mesh mesh, const uint nbInstances);
+
+#ifdef __cplusplus
+}
+#endif
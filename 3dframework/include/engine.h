@@ -1,15 +1,31 @@
 #pragma once
 
+#include <batch_math.h>
+#include <bundle.h>
+#include <bvh.h>
 #include <camera.h>
 #include <config_file.h>
 #include <context.h>
+#include <culling.h>
 #include <file.h>
 #include <framebuffer.h>
+#include <gpu_bvh.h>
+#include <gpu_culling.h>
 #include <graphics_states.h>
 #include <input.h>
+#include <jobs.h>
+#include <memory_budget.h>
 #include <mesh.h>
+#include <mesh_optimizer.h>
+#include <meshlet.h>
+#include <model.h>
+#include <occlusion.h>
+#include <quantization.h>
 #include <random.h>
+#include <readback.h>
+#include <scene_graph.h>
 #include <shader.h>
+#include <simulation.h>
 #include <SDL2/SDL.h>
 
 #define TEXTURE_DIR "../textures/"
@@ -33,6 +49,7 @@ void pauseAnimations(const bool pause);
 bool animationsPaused();
 
 void takeScreenshot(const char *filename);
+void showMemoryOverlay(const bool show);
 
 uint getAppTime();
 uint getAnimTime();
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <mesh.h>
+#include <shader.h>
+
+DECL_OPAQUE_TYPE(GpuBvh)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Linear BVH built in compute, ray traced with shaders/bvh_traversal.glsl on any device. The
+// builder is shaders/lbvh.comp loaded with loadShader, building changes the current shader.
+GpuBvh createGpuBvh(Shader builder, const Mesh mesh) WARN_UNUSED_RESULT;
+// Fast full rebuild for deforming meshes, the triangle count can't change
+void rebuildGpuBvh(GpuBvh bvh, Shader builder, const Mesh mesh);
+void deleteGpuBvh(GpuBvh *bvh);
+
+// Binds the BvhNodes and BvhTriangles buffers of the current shader
+void setUniformGpuBvh(GpuBvh bvh);
+
+#ifdef __cplusplus
+}
+#endif
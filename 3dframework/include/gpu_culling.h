@@ -0,0 +1,38 @@
+#pragma once
+
+#include <mesh.h>
+#include <shader.h>
+#include <texture.h>
+
+DECL_OPAQUE_TYPE(GpuCuller)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Two phase occlusion culling on the GPU with shaders/gpu_culling.comp and the depth pyramid of
+// shaders/hiz.comp, both loaded with loadShader. Instance i is bounded by the world sphere
+// (center, radius) at i in the bounds buffer, a frame is:
+//   cullFirstPhase, then drawMeshIndirect(mesh, getCulledDrawArguments(culler, 0)),
+//   updateDepthPyramid with the depth buffer of these draws,
+//   cullSecondPhase, then drawMeshIndirect(mesh, getCulledDrawArguments(culler, 1)).
+// Nothing is read back, the draws take their instance from CulledInstances[gl_InstanceIndex].
+GpuCuller createGpuCuller(const uint maxInstances, const uint depthWidth, const uint depthHeight) WARN_UNUSED_RESULT;
+void deleteGpuCuller(GpuCuller *culler);
+
+// Frustum and pyramid of the previous frame, the first frame only tests the frustum. Changes the
+// current shader.
+void cullFirstPhase(GpuCuller culler, Shader cullShader, const Mesh mesh, Buffer bounds, const uint nbInstances, Mat4 viewProjection);
+// Builds the pyramid from a single sampled depth buffer, it is resized with the depth buffer
+void updateDepthPyramid(GpuCuller culler, Shader pyramidShader, Texture depth);
+// Instances occluded in the first phase that the new pyramid shows
+void cullSecondPhase(GpuCuller culler, Shader cullShader);
+
+Buffer getCulledDrawArguments(GpuCuller culler, const uint phase);
+Texture getDepthPyramid(GpuCuller culler);
+// Binds the CulledInstances buffer of the current shader
+void setUniformCulledInstances(GpuCuller culler);
+
+#ifdef __cplusplus
+}
+#endif
@@ -150,6 +150,14 @@ typedef struct {
     VariableRateShadingCombiner imageCombiner;
 } VariableRateShadingState;
 
+// What a draw does when its pipeline isn't compiled yet
+typedef enum : uchar {
+    PipelineMiss_Block,    // compiles it right away, stalling the frame
+    PipelineMiss_Skip,     // compiles it on the job workers and drops the draws until it's ready
+    PipelineMiss_Fallback, // same, but draws meanwhile with the designated fallback: the pipeline of the
+                           // shader for the default render state, compiled right away when it's missing too
+} PipelineMissPolicy;
+
 typedef struct {
     BlendState               blendState;
     DepthStencilState        depthStencilState;
@@ -157,6 +165,7 @@ typedef struct {
     ViewportState            viewportState;
     ViewportState            scissorState;
     VariableRateShadingState vrsState;
+    PipelineMissPolicy       pipelineMissPolicy;
 } RenderState;
 
 #ifdef __cplusplus
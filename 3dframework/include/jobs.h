@@ -0,0 +1,39 @@
+#pragma once
+
+#include <global_defs.h>
+
+#define NullJob (Job){0}
+#define JOB_POOL_SIZE 4096
+
+DECL_OPAQUE_TYPE(Job)
+
+typedef void (*JobFunction)(void *data);
+typedef void (*JobRangeFunction)(void *data, const uint begin, const uint end);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Work stealing scheduler with a worker per core besides the main thread, started on first use.
+// Each thread has its own queue, idle threads steal from the others. Jobs come from a ring of
+// JOB_POOL_SIZE per creating thread skipping the ones in flight, a finished job can be reused
+// by the next ones of its thread.
+// A NULL function makes an empty job, only useful as the parent of others.
+Job createJob(JobFunction function, void *data);
+// The parent completes with its last child, children must be created before that happens,
+// usually from the function of the parent or before running it
+Job createChildJob(Job parent, JobFunction function, void *data);
+void runJob(Job job);
+// Runs queued jobs in the meantime, so waiting from a job doesn't block its worker
+void waitJob(Job job);
+bool isJobDone(Job job);
+
+// Calls function on chunks of grain items from all the workers and the calling thread, returns
+// once all of them are done. Can be nested in jobs.
+void runParallelFor(const uint count, const uint grain, JobRangeFunction function, void *data);
+// Threads running jobs, the calling one included
+uint getNbJobWorkers();
+
+#ifdef __cplusplus
+}
+#endif
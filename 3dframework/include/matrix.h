@@ -187,4 +187,49 @@ static inline Float4 transformm4(Mat4 m, Float4 v) {
 }
 #endif
 
+// 8 matrices in SoA layout, column major like Mat4
+typedef Float4x8 Mat4x8[4];
+
+static inline void loadm4x8(Mat4x8 r, Mat4 m[8]) {
+    for (int i = 0; i < 8; i++)
+        for (int c = 0; c < 4; c++) {
+            r[c].x[i] = m[i][c][0];
+            r[c].y[i] = m[i][c][1];
+            r[c].z[i] = m[i][c][2];
+            r[c].w[i] = m[i][c][3];
+        }
+}
+
+static inline void storem4x8(Mat4 m[8], Mat4x8 r) {
+    for (int i = 0; i < 8; i++)
+        for (int c = 0; c < 4; c++)
+            m[i][c] = float4(r[c].x[i], r[c].y[i], r[c].z[i], r[c].w[i]);
+}
+
+static inline void broadcastm4x8(Mat4x8 r, Mat4 m) {
+    for (int c = 0; c < 4; c++) {
+        r[c].x = float1x8(m[c][0]);
+        r[c].y = float1x8(m[c][1]);
+        r[c].z = float1x8(m[c][2]);
+        r[c].w = float1x8(m[c][3]);
+    }
+}
+
+static inline Float4x8 transformtm4x8(Mat4x8 m, Float4x8 v) {
+    Float4x8 r;
+    r.x = m[0].x * v.x + m[1].x * v.y + m[2].x * v.z + m[3].x * v.w;
+    r.y = m[0].y * v.x + m[1].y * v.y + m[2].y * v.z + m[3].y * v.w;
+    r.z = m[0].z * v.x + m[1].z * v.y + m[2].z * v.z + m[3].z * v.w;
+    r.w = m[0].w * v.x + m[1].w * v.y + m[2].w * v.z + m[3].w * v.w;
+    return r;
+}
+
+// r and a must not alias, same product as multiplytm4
+static inline void multiplytm4x8(Mat4x8 r, Mat4x8 a, Mat4x8 b) {
+    r[0] = transformtm4x8(a, b[0]);
+    r[1] = transformtm4x8(a, b[1]);
+    r[2] = transformtm4x8(a, b[2]);
+    r[3] = transformtm4x8(a, b[3]);
+}
+
 #define printm4(m_) ({Mat4 m; copym4(m, m_); print4(m[0]); putchar('\n'); print4(m[1]); putchar('\n'); print4(m[2]); putchar('\n'); print4(m[3]); putchar('\n');})
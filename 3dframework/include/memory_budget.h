@@ -0,0 +1,36 @@
+#pragma once
+
+#include <global_defs.h>
+
+typedef enum : uchar {
+    MemoryCategory_Textures,
+    MemoryCategory_RenderTargets,
+    MemoryCategory_Meshes,
+    MemoryCategory_Buffers,
+    MemoryCategory_AccelerationStructures,
+    MemoryCategory_Staging, // dynamic buffers, readbacks, upload and scratch chunks
+    MemoryCategory_Count,
+} MemoryCategory;
+
+typedef struct {
+    ulong usage, budget; // budget and usage of the whole process, only known with VK_EXT_memory_budget
+    ulong size;
+    bool deviceLocal;
+} MemoryHeap;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ulong getMemoryUsage(const MemoryCategory category);
+ulong getTotalMemoryUsage();
+const char* getMemoryCategoryName(const MemoryCategory category);
+
+uint getNbMemoryHeaps();
+MemoryHeap getMemoryHeap(const uint heap);
+bool memoryBudgetSupported();
+ulong getDeviceLocalBudget();
+
+#ifdef __cplusplus
+}
+#endif
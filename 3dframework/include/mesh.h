@@ -19,6 +19,11 @@ typedef enum : uchar {
     PrimitiveType_Patches,
 } PrimitiveType;
 
+// Submesh of indices, or of vertices for meshes without indices
+typedef struct {
+    uint first, count;
+} Range;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -28,8 +33,15 @@ void deleteMesh(Mesh *mesh);
 
 void setMeshIndices(Mesh mesh, const uint *indices, const uint nbIndices);
 void setMeshIndices16(Mesh mesh, const ushort *indices, const uint nbIndices);
+// 16 bits indices when every vertex fits, half the index memory and bandwidth
+void setMeshIndicesCompact(Mesh mesh, const uint *indices, const uint nbIndices, const uint nbVertices);
 void addMeshAttrib(Mesh mesh, const Format format, const bool instanced, const void *data, const uint nbElems);
 
+// Streamed geometry rewritten every frame, fill it with beginDynamicWrite on getIndexBuffer / getAttribBuffer
+void setMeshDynamicIndices(Mesh mesh, const uint maxIndices);
+void setMeshDynamicIndices16(Mesh mesh, const uint maxIndices);
+void addMeshDynamicAttrib(Mesh mesh, const Format format, const bool instanced, const uint maxElems);
+
 Buffer getIndexBuffer(Mesh mesh);
 Buffer getAttribBuffer(Mesh mesh, const uint i);
 uint getNbIndices(Mesh mesh);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <global_defs.h>
+
+typedef struct {
+    void *data;  // one element per vertex, rewritten in place
+    uint stride; // bytes per vertex
+} VertexStream;
+
+typedef struct {
+    float acmr; // vertex shader invocations per triangle
+    float atvr; // vertex shader invocations per referenced vertex, 1 is optimal
+} VertexCacheStats;
+
+typedef struct {
+    VertexCacheStats before, after;
+    uint nbVerticesBefore, nbVerticesAfter;
+} MeshOptimizationStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Optimizes an indexed triangle list before its upload with setMeshIndicesCompact and addMeshAttrib:
+//   welds the vertices equal in every stream and drops the unreferenced ones,
+//   orders the triangles for the post-transform vertex cache (Tipsify),
+//   sorts clusters of them from the outside in to reduce overdraw,
+//   renumbers the vertices in first use order for fetch locality.
+// The first stream must start with 3 float positions. Streams and indices are rewritten in place,
+// returns the new number of vertices. stats can be null.
+uint optimizeMesh(VertexStream *streams, const uint nbStreams, const uint nbVertices, uint *indices, const uint nbIndices, MeshOptimizationStats *stats);
+
+// Simulates a FIFO post-transform cache of cacheSize vertices
+VertexCacheStats analyzeVertexCache(const uint *indices, const uint nbIndices, const uint nbVertices, const uint cacheSize);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <matrix.h>
+#include <mesh.h>
+#include <shader.h>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+DECL_OPAQUE_TYPE(MeshletMesh)
+
+// Same layout as the Meshlets buffer of shaders/meshlets.glsl
+typedef struct {
+    float center[3], radius;       // bounding sphere
+    float coneAxis[3], coneCutoff; // backfacing from eye when dot(center - eye, axis) >= cutoff * |center - eye| + radius
+    uint vertexOffset, triangleOffset;
+    uint nbVertices, nbTriangles;
+} Meshlet;
+
+typedef struct {
+    Meshlet *meshlets;
+    uint *vertices;  // mesh vertex of each meshlet vertex
+    uint *triangles; // 3 meshlet vertices packed in the low 24 bits
+    uint nbMeshlets, nbVertices, nbTriangles;
+} Meshlets;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Splits a triangle list into meshlets of neighbouring triangles, big meshes are split over all
+// cores. Positions are 3 floats read every positionStride bytes, without indices the vertices
+// are taken three by three.
+Meshlets buildMeshlets(const void *positions, const uint positionStride, const uint nbVertices, const uint *indices, const uint nbIndices);
+void deleteMeshlets(Meshlets *meshlets);
+
+// Builds and uploads the meshlets of a triangle list mesh, it reads the mesh back from the GPU and
+// waits for it, meant for loading time. The mesh positions are used as they are and must outlive
+// the meshlet mesh.
+MeshletMesh createMeshletMesh(const Mesh mesh) WARN_UNUSED_RESULT;
+MeshletMesh uploadMeshlets(const Meshlets *meshlets, const Mesh mesh) WARN_UNUSED_RESULT;
+void deleteMeshletMesh(MeshletMesh *mesh);
+uint getNbMeshlets(const MeshletMesh mesh);
+
+// Draws with the current shader, shaders/meshlets loaded with loadShader or copies of its task and
+// mesh stages with another fragment stage. The task shader drops the meshlets outside the frustum
+// or facing away from eye.
+void drawMeshletMesh(MeshletMesh mesh, Mat4 model, Mat4 viewProjection, const Float4 eye);
+
+#ifdef __cplusplus
+}
+#endif
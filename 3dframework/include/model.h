@@ -0,0 +1,31 @@
+#pragma once
+
+#include <mesh.h>
+#include <vector.h>
+
+DECL_OPAQUE_TYPE(Model)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Loads a Wavefront OBJ or a binary glTF 2.0 (.glb) into a single triangle list mesh of
+// positions (RGB32_FLOAT), normals (RGB32_FLOAT) and uvs (RG32_FLOAT), with a submesh per
+// material. glTF node transforms are applied to the vertices, missing normals are computed.
+// The first load parses the file over all cores and optimizes it with optimizeMesh, then writes a
+// binary cache that later loads map and upload without parsing.
+Model loadModel(const char *filename) WARN_UNUSED_RESULT;
+void deleteModel(Model *model);
+
+Mesh getModelMesh(Model model);
+// Index ranges in the order of the first use of their material
+const Range* getModelSubmeshes(Model model, uint *nbSubmeshes);
+const char* getModelMaterial(Model model, const uint submesh);
+void getModelBounds(Model model, Float4 *min, Float4 *max);
+
+// Directory of the binary caches, "../model_cache/" by default, an empty or null one disables them
+void setModelCacheDir(const char *dir);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1549,6 +1549,8 @@ namespace nvrhi
             [[nodiscard]] virtual const AccelStructDesc& getDesc() const = 0;
             [[nodiscard]] virtual bool isCompacted() const = 0;
             [[nodiscard]] virtual uint64_t getDeviceAddress() const = 0;
+            // Scratch memory of a full build of the geometry of the descriptor, 0 when unknown
+            [[nodiscard]] virtual uint64_t getBuildScratchSize() const = 0;
         };
 
         typedef RefCountPtr<IAccelStruct> AccelStructHandle;
@@ -2119,6 +2121,10 @@ namespace nvrhi
 
         BindingLayoutVector bindingLayouts;
 
+        // With Feature::GraphicsPipelineLibrary, only link the pipeline from the cached libraries of its vertex input,
+        // pre-rasterization, fragment shader and fragment output states. Quick to create but slower to draw with.
+        bool fastLink = false;
+
         GraphicsPipelineDesc& setPrimType(PrimitiveType value) { primType = value; return *this; }
         GraphicsPipelineDesc& setPatchControlPoints(uint32_t value) { patchControlPoints = value; return *this; }
         GraphicsPipelineDesc& setInputLayout(IInputLayout* value) { inputLayout = value; return *this; }
@@ -2133,6 +2139,7 @@ namespace nvrhi
         GraphicsPipelineDesc& setRenderState(const RenderState& value) { renderState = value; return *this; }
         GraphicsPipelineDesc& setVariableRateShadingState(const VariableRateShadingState& value) { shadingRateState = value; return *this; }
         GraphicsPipelineDesc& addBindingLayout(IBindingLayout* layout) { bindingLayouts.push_back(layout); return *this; }
+        GraphicsPipelineDesc& setFastLink(bool value) { fastLink = value; return *this; }
     };
 
     class IGraphicsPipeline : public IResource
@@ -2253,6 +2260,12 @@ namespace nvrhi
         Color blendConstantColor{};
         uint8_t dynamicStencilRefValue = 0;
 
+        // Cull mode, front face, depth bias, depth and stencil tests of the draw when Feature::ExtendedDynamicState
+        // is supported, the pipeline ignores its own then. Those of the pipeline are used when not set.
+        bool useDynamicRenderState = false;
+        RasterState dynamicRasterState;
+        DepthStencilState dynamicDepthStencilState;
+
         BindingSetVector bindings;
 
         static_vector<VertexBufferBinding, c_MaxVertexAttributes> vertexBuffers;
@@ -2266,6 +2279,7 @@ namespace nvrhi
         GraphicsState& setShadingRateState(const VariableRateShadingState& value) { shadingRateState = value; return *this; }
         GraphicsState& setBlendColor(const Color& value) { blendConstantColor = value; return *this; }
         GraphicsState& setDynamicStencilRefValue(uint8_t value) { dynamicStencilRefValue = value; return *this; }
+        GraphicsState& setDynamicRenderState(const RenderState& value) { useDynamicRenderState = true; dynamicRasterState = value.rasterState; dynamicDepthStencilState = value.depthStencilState; return *this; }
         GraphicsState& addBindingSet(IBindingSet* value) { bindings.push_back(value); return *this; }
         GraphicsState& addVertexBuffer(const VertexBufferBinding& value) { vertexBuffers.push_back(value); return *this; }
         GraphicsState& setIndexBuffer(const IndexBufferBinding& value) { indexBuffer = value; return *this; }
@@ -2336,6 +2350,11 @@ namespace nvrhi
         Color blendConstantColor{};
         uint8_t dynamicStencilRefValue = 0;
 
+        // see GraphicsState
+        bool useDynamicRenderState = false;
+        RasterState dynamicRasterState;
+        DepthStencilState dynamicDepthStencilState;
+
         BindingSetVector bindings;
 
         IBuffer* indirectParams = nullptr;
@@ -2347,6 +2366,7 @@ namespace nvrhi
         MeshletState& addBindingSet(IBindingSet* value) { bindings.push_back(value); return *this; }
         MeshletState& setIndirectParams(IBuffer* value) { indirectParams = value; return *this; }
         MeshletState& setDynamicStencilRefValue(uint8_t value) { dynamicStencilRefValue = value; return *this; }
+        MeshletState& setDynamicRenderState(const RenderState& value) { useDynamicRenderState = true; dynamicRasterState = value.rasterState; dynamicDepthStencilState = value.depthStencilState; return *this; }
     };
 
     //////////////////////////////////////////////////////////////////////////
@@ -2472,7 +2492,9 @@ namespace nvrhi
         VirtualResources,
         ComputeQueue,
         CopyQueue,
-        ConstantBufferRanges
+        ConstantBufferRanges,
+        ExtendedDynamicState,
+        GraphicsPipelineLibrary
     };
 
     enum class MessageSeverity : uint8_t
@@ -2556,6 +2578,17 @@ namespace nvrhi
         // Clears the graphics state of the underlying command list object and resets the state cache.
         virtual void clearState() = 0;
 
+        // Opens the command list to record a bundle, which is executed by other command lists with executeBundle
+        // instead of executeCommandLists. A bundle only records graphics and meshlet states and draws, into
+        // framebuffers with the same formats as the given one, and can be executed any number of times until
+        // it's opened again.
+        virtual void openBundle(IFramebuffer* framebuffer) = 0;
+        // Draws the closed bundle into the framebuffer. The graphics, meshlet and compute states must be set again after.
+        virtual void executeBundle(ICommandList* bundle, IFramebuffer* framebuffer) = 0;
+        // Overwrites a range of every version of the volatile buffer written while recording the closed bundle, for the
+        // constants that change between executions. The GPU must be done with the previous execution reading them.
+        virtual void writeBundleVolatileBuffer(IBuffer* buffer, const void* data, size_t dataSize, uint64_t destOffsetBytes) = 0;
+
         virtual void clearTextureFloat(ITexture* t, TextureSubresourceSet subresources, const Color& clearColor) = 0;
         virtual void clearDepthStencilTexture(ITexture* t, TextureSubresourceSet subresources, bool clearDepth, float depth, bool clearStencil, uint8_t stencil) = 0;
         virtual void clearTextureUInt(ITexture* t, TextureSubresourceSet subresources, uint32_t clearColor) = 0;
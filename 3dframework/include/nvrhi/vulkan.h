@@ -45,6 +45,8 @@ namespace nvrhi::vulkan
         virtual uint64_t queueGetCompletedInstance(CommandQueue queue) = 0;
         virtual FramebufferHandle createHandleForNativeFramebuffer(VkRenderPass renderPass, 
             VkFramebuffer framebuffer, const FramebufferDesc& desc, bool transferOwnership) = 0;
+        // Memory held by the upload and scratch chunks of all the live command lists
+        virtual uint64_t getUploadChunkMemory() = 0;
     };
 
     typedef RefCountPtr<IDevice> DeviceHandle;
@@ -77,6 +79,14 @@ namespace nvrhi::vulkan
 
         // Indicates if VkPhysicalDeviceVulkan12Features::bufferDeviceAddress was set to 'true' at device creation time
         bool bufferDeviceAddressSupported = false;
+
+        // Indicates if VkPhysicalDeviceVulkan13Features::dynamicRendering was set to 'true' at device creation time.
+        // Framebuffers then have no render pass objects and pipelines only depend on the attachment formats.
+        bool dynamicRenderingSupported = false;
+
+        // Indicates if the device supports the dynamic states of VK_EXT_extended_dynamic_state and 2, core in Vulkan 1.3.
+        // Pipelines then leave the cull mode, front face, depth bias, depth and stencil tests to the command lists.
+        bool extendedDynamicStateSupported = false;
     };
 
     NVRHI_API DeviceHandle createDevice(const DeviceDesc& desc);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <culling.h>
+
+DECL_OPAQUE_TYPE(OcclusionBuffer)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Low resolution CPU depth buffer in the reversed-Z convention of perspective(), the width is
+// rounded up to 8 pixels and the height to 4 (the tiles of the hierarchy)
+OcclusionBuffer createOcclusionBuffer(const uint width, const uint height) WARN_UNUSED_RESULT;
+void deleteOcclusionBuffer(OcclusionBuffer *buffer);
+
+// Forgets the previous occluders, the view projection is used by the occluders and the tests
+void beginOcclusion(OcclusionBuffer buffer, Mat4 viewProjection);
+// Triangle list of positions (3 floats every positionStride bytes) placed by model, without
+// indices the vertices are taken three by three. Triangles crossing the near plane are dropped.
+void addOccluders(OcclusionBuffer buffer, Mat4 model, const void *positions, const uint positionStride, const uint nbVertices, const uint *indices, const uint nbIndices);
+// Rasterizes the occluders in bands of rows spread across the cores, then builds the tiles depth
+void endOcclusion(OcclusionBuffer buffer);
+
+// Boxes entirely behind the occluders or out of the screen, the ones crossing the near plane never are
+bool isBoxOccluded(OcclusionBuffer buffer, const Float4 center, const Float4 extent);
+// Keeps the indices of the boxes that aren't occluded, in order, and returns their number.
+// Meant to filter the output of cullBoxes.
+uint cullOccludedBoxes(OcclusionBuffer buffer, const BoundingBoxes boxes, uint *indices, const uint n);
+
+#ifdef __cplusplus
+}
+#endif
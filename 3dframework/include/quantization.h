@@ -0,0 +1,36 @@
+#pragma once
+
+#include <mesh.h>
+#include <vector.h>
+
+typedef struct {
+    const float *positions; // 3 floats per vertex
+    const float *normals;   // 3 floats per vertex, or null
+    const float *tangents;  // 4 floats per vertex with the bitangent sign in w, or null
+    const float *uvs;       // 2 floats per vertex, or null
+    uint nbVertices;
+} VertexAttributes;
+
+// position = quantized.xyz * scale + offset, the quantized values being read as normalized floats
+typedef struct {
+    Float4 scale, offset;
+} Dequantization;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Adds the attributes to the mesh in compact formats, in this order and skipping the missing ones:
+//   positions RGBA16_UNORM within the mesh bounds, w is 1 for a negative bitangent sign
+//   normals   octahedral RG8_SNORM, or RG16_SNORM when precise
+//   tangents  octahedral RG8_SNORM, or RG16_SNORM when precise
+//   uvs       RG16_FLOAT
+// That is 16 to 20 bytes per vertex instead of 48. shaders/quantization.glsl decodes them.
+Dequantization addMeshQuantizedAttribs(Mesh mesh, const VertexAttributes *attributes, const bool precise);
+
+// Sets the PositionScale and PositionOffset vec4 uniforms of the current shader
+void setUniformDequantization(const Dequantization dequantization);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <buffer.h>
+#include <texture.h>
+
+#define NullReadback 0
+
+typedef uint ReadbackTicket;
+typedef void (*ReadbackCallback)(const void *data, const uint rowPitch, void *userData);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Copies are recorded in the current command list and land in pooled staging memory, the data
+// is available once the GPU is done with the submission, usually a few frames later
+ReadbackTicket requestBufferReadback(Buffer buffer, const uint offset, const uint size, ReadbackCallback callback, void *userData);
+ReadbackTicket requestTextureReadback(Texture tex, const uint mipmap, const uint layer, ReadbackCallback callback, void *userData);
+
+// Tickets with a callback are released automatically after the callback has run
+const void* pollReadback(ReadbackTicket ticket, uint *rowPitch);
+const void* waitReadback(ReadbackTicket ticket, uint *rowPitch);
+void releaseReadback(ReadbackTicket ticket);
+
+#ifdef __cplusplus
+}
+#endif
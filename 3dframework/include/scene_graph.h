@@ -0,0 +1,48 @@
+#pragma once
+
+#include <buffer.h>
+#include <matrix.h>
+
+#define NullSceneNode ((SceneNode)~0u)
+
+DECL_OPAQUE_TYPE(SceneGraph)
+typedef uint SceneNode;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hierarchy of up to maxNodes transforms kept in one allocation, one array per field. Parents are
+// created before their children so the nodes are always in topological order.
+SceneGraph createSceneGraph(const uint maxNodes) WARN_UNUSED_RESULT;
+void deleteSceneGraph(SceneGraph *graph);
+// Removes all the nodes, the memory is kept
+void clearSceneGraph(SceneGraph graph);
+
+// NullSceneNode as parent makes a root, the local transform starts as the identity
+SceneNode addSceneNode(SceneGraph graph, const SceneNode parent);
+uint getNbSceneNodes(SceneGraph graph);
+SceneNode getNodeParent(SceneGraph graph, const SceneNode node);
+
+// Both mark the subtree of the node for the next update
+void setNodeLocal(SceneGraph graph, const SceneNode node, Mat4 local);
+// Translation, rotation quaternion (x, y, z, w) then scale, applied in reverse order
+void setNodeTRS(SceneGraph graph, const SceneNode node, const Float4 translation, const Float4 rotation, const Float4 scale);
+Float4* getNodeLocal(SceneGraph graph, const SceneNode node);
+
+// Local to world matrices of the changed subtrees only, level by level from the highest changed
+// one, large levels are split across all cores
+void updateSceneGraph(SceneGraph graph);
+// As of the last update
+Float4* getNodeWorld(SceneGraph graph, const SceneNode node);
+// Inverted on the first request after the world matrix changed, not thread safe
+Float4* getNodeWorldInverse(SceneGraph graph, const SceneNode node);
+
+// Writes the world matrices of the nodes, or of the first nbNodes nodes when nodes is NULL, in the
+// current slice of a dynamic buffer as 3 rows of 4 floats. Instances read them as mat3x4 World[]
+// with vec4(position, 1.0) * World[i]. Returns the number of bytes written.
+uint uploadWorldMatrices(SceneGraph graph, Buffer buffer, const SceneNode *nodes, const uint nbNodes);
+
+#ifdef __cplusplus
+}
+#endif
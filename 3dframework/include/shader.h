@@ -62,11 +62,32 @@ Shader createGraphicsShader(
     const void *geomBin, const size_t geomSize,
     const void *fragBin, const size_t fragSize);
 Shader createComputeShader(const void *binary, const size_t size) WARN_UNUSED_RESULT;
+// Loads the stages found as shaderName.vert, .frag, .comp, etc. GLSL sources are compiled at
+// runtime with shaderc_shared when present, precompiled .spv files otherwise
 Shader loadShader(const char *shaderName) WARN_UNUSED_RESULT;
+// defines are space separated NAME or NAME=VALUE, only used by GLSL sources
+Shader loadShaderVariant(const char *shaderName, const char *defines) WARN_UNUSED_RESULT;
 void deleteShader(Shader *shader);
 
 void useShader(Shader shader);
 
+// Compiled SPIR-V and reflection of the stages are kept in dir, keyed by their content, defines and
+// compiler build. NULL disables the cache. Defaults to "../shader_cache/".
+void setShaderCacheDir(const char *dir);
+// Searched by #include after the directory of the including file, defaults to the framework shaders
+void setShaderIncludeDir(const char *dir);
+// Watches the files of the shaders from loadShader and rebuilds the modified ones in the background,
+// they are swapped in between two frames. On errors the old shader keeps running and the errors
+// show in an overlay.
+void setShaderHotReload(const bool enable);
+
+// Graphics and meshlet pipelines compiling on the job workers, see the pipelineMissPolicy of the render state
+uint getNbCompilingPipelines();
+// Graphics and meshlet pipelines created, and the render state permutations that drew with one of them
+// instead of compiling their own thanks to the dynamic cull mode, front face, depth bias, depth and stencil
+uint getNbPipelines();
+uint getNbPipelinesSavedByDynamicStates();
+
 void setUniform1f(const float x, const char *name, ...);
 void setUniform2f(const float x, const float y, const char *name, ...);
 void setUniform3f(const float x, const float y, const float z, const char *name, ...);
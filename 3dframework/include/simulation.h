@@ -0,0 +1,25 @@
+#pragma once
+
+#include <global_defs.h>
+
+// The state starts as a copy of the previous tick, seconds is the fixed tick duration
+typedef void (*UserSimulateFunc)(void *state, const float seconds);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs f tickRate times per second on its own thread while launchApplication runs, so a slow
+// tick doesn't stall the frames and vsync doesn't stall the simulation. Each tick updates a new
+// snapshot of stateSize bytes, starting from initialState. Paused with the animations, a NULL
+// function removes the simulation. Must be set outside of launchApplication.
+void setSimulationFunc(UserSimulateFunc f, const uint tickRate, const uint stateSize, const void *initialState);
+
+// The last two ticks published before the frame started, they stay untouched until the next
+// frame. alpha in [0, 1] is the position of the frame between them, for interpolation.
+void getSimulationStates(const void **previous, const void **current, float *alpha);
+uint getSimulationTicks();
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,6 +12,12 @@
 typedef int   Int4   __attribute__((vector_size(16)));
 typedef uint  UInt4  __attribute__((vector_size(16)));
 typedef float Float4 __attribute__((vector_size(16)));
+typedef int   Int8   __attribute__((vector_size(32)));
+typedef uint  UInt8  __attribute__((vector_size(32)));
+typedef float Float8 __attribute__((vector_size(32)));
+
+// 8 vectors in SoA layout, one lane each
+typedef struct {Float8 x, y, z, w;} Float4x8;
 
 static const Float4 __attribute__((aligned(16)))
     X_AXIS = {1.0f, 0.0f, 0.0f, 0.0f},
@@ -25,6 +31,8 @@ static const Float4 __attribute__((aligned(16)))
 #define float1(x) ({float _x = x; float4(_x, _x, _x, _x);})
 #define int1(x) ({int _x = x; int4(_x, _x, _x, _x);})
 #define uint1(x) ({uint _x = x; uint4(_x, _x, _x, _x);})
+#define float8(...) ({Float8 _v = (Float8){__VA_ARGS__}; _v;})
+#define float1x8(x) ({float _x = x; float8(_x, _x, _x, _x, _x, _x, _x, _x);})
 
 #define V_(v_, ...) ({Float4 v = v_; __VA_ARGS__;})
 #define VV_(a_, b_, ...) ({Float4 a = a_, b = b_; __VA_ARGS__;})
@@ -0,0 +1,104 @@
+// Traversal of the BVH built by lbvh.comp, bind it with setUniformGpuBvh.
+// Leaves store their triangle in Left and BVH_LEAF in Right.
+
+#define BVH_LEAF 0xFFFFFFFFu
+#define BVH_MISS 1e30
+
+// Every internal node of lbvh.comp has a longer common prefix than its parent, of the 30 bits
+// Morton codes then of the 32 bits triangle indices breaking the ties, so the prefixes of 2 to 63
+// bits bound the paths to 62 internal nodes. The stack holds a far child per node of the path.
+#define BVH_MAX_DEPTH 62
+#ifndef BVH_STACK_SIZE
+#define BVH_STACK_SIZE BVH_MAX_DEPTH
+#endif
+#if BVH_STACK_SIZE < BVH_MAX_DEPTH
+#error BVH_STACK_SIZE can't hold the deepest paths of lbvh.comp
+#endif
+
+struct BvhNode {
+    vec3 Min;
+    uint Left;
+    vec3 Max;
+    uint Right;
+};
+
+struct BvhTriangle {
+    vec4 V0, E1, E2;
+};
+
+struct BvhHit {
+    float t;
+    vec2 barycentrics; // weights of the second and third vertices
+    uint primitive;
+};
+
+readonly buffer BvhNodes {BvhNode Nodes[];};
+readonly buffer BvhTriangles {BvhTriangle Triangles[];};
+
+float bvhIntersectBox(BvhNode node, vec3 O, vec3 invD, float tMin, float tMax) {
+    vec3 t0 = (node.Min - O) * invD, t1 = (node.Max - O) * invD;
+    vec3 tNear = min(t0, t1), tFar = max(t0, t1);
+    float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, tMin));
+    float tExit = min(min(tFar.x, tFar.y), min(tFar.z, tMax));
+    return tEnter <= tExit ? tEnter : BVH_MISS;
+}
+
+void bvhIntersectTriangle(uint primitive, vec3 O, vec3 D, float tMin, inout BvhHit hit) {
+    BvhTriangle tri = Triangles[primitive];
+    vec3 P = cross(D, tri.E2.xyz);
+    float invDet = 1.0 / dot(tri.E1.xyz, P);
+    vec3 S = O - tri.V0.xyz;
+    float u = dot(S, P) * invDet;
+    vec3 Q = cross(S, tri.E1.xyz);
+    float v = dot(D, Q) * invDet;
+    float t = dot(tri.E2.xyz, Q) * invDet;
+
+    // Null determinants give NaNs which fail every comparison
+    if (u >= 0.0 && v >= 0.0 && u + v <= 1.0 && t > tMin && t < hit.t) {
+        hit.t = t;
+        hit.barycentrics = vec2(u, v);
+        hit.primitive = primitive;
+    }
+}
+
+// Closest hit between tMin and tMax, false when nothing was hit
+bool traceBvh(vec3 O, vec3 D, float tMin, float tMax, out BvhHit hit) {
+    hit = BvhHit(tMax, vec2(0.0), BVH_LEAF);
+
+    // Null direction components would give inf * 0 = NaN in the slab test
+    vec3 invD = mix(vec3(1.0), vec3(-1.0), lessThan(D, vec3(0.0))) / max(abs(D), vec3(1e-20));
+
+    uint stack[BVH_STACK_SIZE];
+    int top = 0;
+    uint node = 0;
+
+    while (true) {
+        BvhNode n = Nodes[node];
+        uint left = n.Left, right = n.Right;
+
+        if (right == BVH_LEAF)
+            bvhIntersectTriangle(left, O, D, tMin, hit);
+        else {
+            float tLeft = bvhIntersectBox(Nodes[left], O, invD, tMin, hit.t);
+            float tRight = bvhIntersectBox(Nodes[right], O, invD, tMin, hit.t);
+            bool hitLeft = tLeft < BVH_MISS, hitRight = tRight < BVH_MISS;
+
+            if (hitLeft && hitRight) {
+                node = tLeft <= tRight ? left : right;
+                stack[top++] = tLeft <= tRight ? right : left;
+                continue;
+            }
+
+            if (hitLeft || hitRight) {
+                node = hitLeft ? left : right;
+                continue;
+            }
+        }
+
+        if (top == 0)
+            break;
+        node = stack[--top];
+    }
+
+    return hit.primitive != BVH_LEAF;
+}
@@ -0,0 +1,16 @@
+// Faceted shading with a color per meshlet, to see the clusters. Applications shade with their
+// own fragment stage next to copies of meshlets.task and meshlets.mesh.
+
+#extension GL_EXT_mesh_shader : require
+
+in vec3 WorldPosition;
+perprimitiveEXT flat in uint MeshletIndex;
+
+out vec4 FragColor;
+
+void main() {
+    vec3 normal = normalize(cross(dFdx(WorldPosition), dFdy(WorldPosition)));
+    uint hash = MeshletIndex * 2654435761u;
+    vec3 color = vec3(hash & 0xFFu, (hash >> 8) & 0xFFu, (hash >> 16) & 0xFFu) / 255.0;
+    FragColor = vec4(color * (0.3 + 0.7 * abs(normal.z)), 1.0);
+}
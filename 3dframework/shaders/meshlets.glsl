@@ -0,0 +1,36 @@
+// Declarations shared by meshlets.task and meshlets.mesh, bound by drawMeshletMesh. Meshlet
+// bounds are in model space, Model is expected without shear for the cone test.
+
+#extension GL_EXT_mesh_shader : require
+
+#define MESHLET_GROUP_SIZE 32
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+uniform _ {
+    mat4 Model, ViewProjection;
+    vec4 Eye; // world space
+    uint NbMeshlets;
+    uint PositionStride; // in floats
+};
+
+struct Meshlet {
+    vec3 Center;
+    float Radius;
+    vec3 ConeAxis;
+    float ConeCutoff;
+    uint VertexOffset, TriangleOffset;
+    uint NbVertices, NbTriangles;
+};
+
+struct MeshletPayload {
+    uint Meshlets[MESHLET_GROUP_SIZE];
+};
+
+readonly buffer Meshlets {Meshlet Clusters[];};
+readonly buffer MeshletVertices {uint Vertices[];};   // mesh vertex of each meshlet vertex
+readonly buffer MeshletTriangles {uint Triangles[];}; // 3 meshlet vertices in the low 24 bits
+readonly buffer MeshletPositions {float Positions[];};
+
+// Visible meshlets of a task workgroup, one mesh workgroup each
+taskPayloadSharedEXT MeshletPayload Payload;
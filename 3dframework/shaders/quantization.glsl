@@ -0,0 +1,18 @@
+// Decoding of the attributes of addMeshQuantizedAttribs. The including shader declares the
+// PositionScale and PositionOffset vec4 uniforms set by setUniformDequantization.
+
+vec3 dequantizePosition(vec4 position, vec4 scale, vec4 offset) {
+    return position.xyz * scale.xyz + offset.xyz;
+}
+
+float bitangentSign(vec4 position) {
+    return position.w > 0.5 ? -1.0 : 1.0;
+}
+
+// Octahedral encoding, the lower hemisphere is folded over the diagonals
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
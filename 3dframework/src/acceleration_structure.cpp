@@ -1,23 +1,43 @@
 #include <acceleration_structure.h>
+#include <context.h>
 #include "private_impl.h"
 #include "private_log.h"
 
+// Refitting degrades the BVH quality as the mesh deforms, a full build restores it periodically
+#define REFITS_BEFORE_REBUILD 16
+
+static bool isBlasVertexFormat(const nvrhi::Format format) {
+    switch (format) {
+        case nvrhi::Format::RG32_FLOAT   :
+        case nvrhi::Format::RGB32_FLOAT  :
+        case nvrhi::Format::RGBA32_FLOAT :
+        case nvrhi::Format::RG16_FLOAT   :
+        case nvrhi::Format::RGBA16_FLOAT :
+        case nvrhi::Format::RG16_SNORM   :
+        case nvrhi::Format::RGBA16_SNORM : return true;
+        default                          : return false;
+    }
+}
+
 static nvrhi::rt::AccelStructDesc getBlasDesc(MeshImpl *meshimpl, const Range *ranges, const uint nbRanges, const nvrhi::rt::AccelStructBuildFlags flags) {
+    const uint vertexStride = getFormatInfo((Format)meshimpl->attributes[0].format).size;
+    const uint vertexOffset = getBufferOffset(meshimpl->buffers[0]);
     nvrhi::rt::GeometryTriangles trianglesBase = nvrhi::rt::GeometryTriangles()
         .setVertexBuffer(getNvBuffer(meshimpl->buffers[0]))
-        .setVertexFormat(meshimpl->attributes[0].format).setVertexStride(getFormatInfo((Format)meshimpl->attributes[0].format).size)
-        .setVertexOffset(0).setVertexCount(meshimpl->nbVertices);
+        .setVertexFormat(meshimpl->attributes[0].format).setVertexStride(vertexStride)
+        .setVertexOffset(vertexOffset).setVertexCount(meshimpl->nbVertices);
 
+    const uint indexSize = meshimpl->indicesFormat == nvrhi::Format::R16_UINT ? 2 : 4;
     if (meshimpl->indices.impl)
-        trianglesBase.setIndexBuffer(getNvBuffer(meshimpl->indices)).setIndexFormat(nvrhi::Format::R32_UINT);
+        trianglesBase.setIndexBuffer(getNvBuffer(meshimpl->indices)).setIndexFormat(meshimpl->indicesFormat);
 
     nvrhi::rt::AccelStructDesc blasDesc = nvrhi::rt::AccelStructDesc().setIsTopLevel(false).setBuildFlags(flags);
     for (uint i = 0; i < nbRanges; i++) {
         nvrhi::rt::GeometryTriangles triangles = trianglesBase;
         if (meshimpl->indices.impl)
-            triangles.setIndexOffset(ranges[i].first * 4).setIndexCount(ranges[i].count);
+            triangles.setIndexOffset(getBufferOffset(meshimpl->indices) + ranges[i].first * indexSize).setIndexCount(ranges[i].count);
         else
-            triangles.setVertexOffset(ranges[i].first * trianglesBase.vertexStride).setVertexCount(ranges[i].count);
+            triangles.setVertexOffset(vertexOffset + ranges[i].first * vertexStride).setVertexCount(ranges[i].count);
 
         blasDesc.addBottomLevelGeometry(nvrhi::rt::GeometryDesc().setTriangles(triangles).setFlags(nvrhi::rt::GeometryFlags::Opaque));
     }
@@ -25,6 +45,64 @@ static nvrhi::rt::AccelStructDesc getBlasDesc(MeshImpl *meshimpl, const Range *r
     return blasDesc;
 }
 
+// The TLAS of a single instance is created and built with the same flags, the BLAS ones only apply to bottom level builds
+static nvrhi::rt::AccelStructBuildFlags getOwnTlasFlags(const bool updatable) {
+    return updatable ? nvrhi::rt::AccelStructBuildFlags::PreferFastBuild | nvrhi::rt::AccelStructBuildFlags::AllowUpdate :
+        nvrhi::rt::AccelStructBuildFlags::PreferFastTrace;
+}
+
+static AccelerationStructureImpl* createBlas(const Mesh mesh, const Range *ranges, const uint nbRanges, const nvrhi::rt::AccelStructBuildFlags flags,
+    const bool updatable, nvrhi::rt::AccelStructDesc &blasDesc) {
+    if (!raytracingEnabled()) {
+        logError("Creation of an acceleration structure while raytracing is disabled.");
+        return nullptr;
+    }
+
+    MeshImpl *meshimpl = getMesh(mesh);
+    if (!meshimpl || meshimpl->attributes.empty()) {
+        logError("Creation of an acceleration structure from an invalid mesh");
+        return nullptr;
+    }
+
+    if (!isBlasVertexFormat(meshimpl->attributes[0].format)) {
+        logError("Unsupported vertex format for an acceleration structure: %s", nvrhi::getFormatInfo(meshimpl->attributes[0].format).name);
+        return nullptr;
+    }
+
+    AccelerationStructureImpl *as = new AccelerationStructureImpl();
+    as->ranges.assign(ranges, ranges + nbRanges);
+    as->updatable = updatable;
+    blasDesc = getBlasDesc(meshimpl, ranges, nbRanges, flags);
+    as->blas = getDevice()->createAccelStruct(blasDesc);
+    as->tlas = getDevice()->createAccelStruct(nvrhi::rt::AccelStructDesc().setIsTopLevel(true).setTopLevelMaxInstances(1).setBuildFlags(getOwnTlasFlags(updatable)));
+    return as;
+}
+
+static void buildOwnTlas(AccelerationStructureImpl *as, const bool update) {
+    const nvrhi::rt::AccelStructBuildFlags flags = getOwnTlasFlags(as->updatable);
+    nvrhi::rt::InstanceDesc instanceDesc = nvrhi::rt::InstanceDesc().setBLAS(as->blas).setInstanceMask(0xFF)
+        .setFlags(nvrhi::rt::InstanceFlags::ForceOpaque | nvrhi::rt::InstanceFlags::TriangleCullDisable);
+
+    getCommandList()->buildTopLevelAccelStruct(as->tlas, &instanceDesc, 1, update ? flags | nvrhi::rt::AccelStructBuildFlags::PerformUpdate : flags);
+}
+
+static void destroyAccelerationStructure(AccelerationStructureImpl *impl) {
+    trackMemory(MemoryCategory_AccelerationStructures, -(long long)impl->memorySize);
+    impl->tlas.Reset();
+    impl->blas.Reset();
+    delete impl;
+}
+
+static void releaseBlasInstance(const AccelerationStructure blas) {
+    AccelerationStructureImpl *impl = getAccelerationStructure(blas);
+    if (--impl->nbInstances == 0 && impl->deleted)
+        destroyAccelerationStructure(impl);
+}
+
+static ulong getAccelerationStructureMemory(AccelerationStructureImpl *as) {
+    return getDevice()->getAccelStructMemoryRequirements(as->blas).size + getDevice()->getAccelStructMemoryRequirements(as->tlas).size;
+}
+
 extern "C" {
 
 AccelerationStructure createAccelerationStructure(const Mesh mesh, const bool updatable) {
@@ -33,53 +111,255 @@ AccelerationStructure createAccelerationStructure(const Mesh mesh, const bool up
 }
 
 AccelerationStructure createMultiAccelerationStructure(const Mesh mesh, const Range *ranges, const uint nbRanges, const bool updatable) {
-    if (!raytracingEnabled()) {
-        logError("Creation of an acceleration structure while raytracing is disabled.");
-        return AccelerationStructure{nullptr};
-    }
-
-    AccelerationStructureImpl *as = new AccelerationStructureImpl();
     nvrhi::rt::AccelStructBuildFlags flags = nvrhi::rt::AccelStructBuildFlags::AllowDataAccess | (updatable ?
         (nvrhi::rt::AccelStructBuildFlags::PreferFastBuild | nvrhi::rt::AccelStructBuildFlags::AllowUpdate) :
         (nvrhi::rt::AccelStructBuildFlags::PreferFastTrace));
 
-    nvrhi::rt::AccelStructDesc blasDesc = getBlasDesc(getMesh(mesh), ranges, nbRanges, flags);
-    as->blas = getDevice()->createAccelStruct(blasDesc);
+    nvrhi::rt::AccelStructDesc blasDesc;
+    AccelerationStructureImpl *as = createBlas(mesh, ranges, nbRanges, flags, updatable, blasDesc);
+    if (!as)
+        return AccelerationStructure{nullptr};
+
     getCommandList()->buildBottomLevelAccelStruct(as->blas, blasDesc.bottomLevelGeometries.data(), blasDesc.bottomLevelGeometries.size(), flags);
+    buildOwnTlas(as, false);
 
-    nvrhi::rt::AccelStructDesc tlasDesc = nvrhi::rt::AccelStructDesc().setIsTopLevel(true).setTopLevelMaxInstances(1).setBuildFlags(flags);
-    as->tlas = getDevice()->createAccelStruct(tlasDesc);
+    as->memorySize = getAccelerationStructureMemory(as);
+    trackMemory(MemoryCategory_AccelerationStructures, as->memorySize);
+    return AccelerationStructure{as};
+}
 
-    nvrhi::rt::InstanceDesc instanceDesc = nvrhi::rt::InstanceDesc().setBLAS(as->blas).setInstanceMask(0xFF)
-        .setFlags(nvrhi::rt::InstanceFlags::ForceOpaque | nvrhi::rt::InstanceFlags::TriangleCullDisable);
+AccelerationStructureBatch beginAccelerationStructureBatch(const ulong scratchBudget) {
+    AccelerationStructureBatchImpl *batch = new AccelerationStructureBatchImpl();
+    batch->scratchBudget = scratchBudget;
+    return AccelerationStructureBatch{batch};
+}
+
+AccelerationStructure batchAccelerationStructure(AccelerationStructureBatch batch, const Mesh mesh, const Range *ranges, const uint nbRanges) {
+    AccelerationStructureBatchImpl *impl = getAccelerationStructureBatch(batch);
+    if (!impl) {
+        logError("Adding an acceleration structure to an invalid batch");
+        return AccelerationStructure{nullptr};
+    }
+
+    const nvrhi::rt::AccelStructBuildFlags flags = nvrhi::rt::AccelStructBuildFlags::PreferFastTrace |
+        nvrhi::rt::AccelStructBuildFlags::AllowCompaction | nvrhi::rt::AccelStructBuildFlags::AllowDataAccess;
 
-    getCommandList()->buildTopLevelAccelStruct(as->tlas, &instanceDesc, 1, flags);
+    nvrhi::rt::AccelStructDesc blasDesc;
+    AccelerationStructureImpl *as = createBlas(mesh, ranges, nbRanges, flags, false, blasDesc);
+    if (!as)
+        return AccelerationStructure{nullptr};
 
+    // The scratch chunks of a group can only be reused once the GPU is done with it
+    const ulong scratchSize = as->blas->getBuildScratchSize();
+    if (impl->groupScratch > 0 && impl->groupScratch + scratchSize > impl->scratchBudget) {
+        flush();
+        waitGPUIdle();
+        impl->groupScratch = 0;
+    }
+    impl->groupScratch += scratchSize;
+
+    getCommandList()->buildBottomLevelAccelStruct(as->blas, blasDesc.bottomLevelGeometries.data(), blasDesc.bottomLevelGeometries.size(), flags);
+    impl->built.push_back(as);
     return AccelerationStructure{as};
 }
 
+void endAccelerationStructureBatch(AccelerationStructureBatch *batch) {
+    if (!batch || !batch->impl)
+        return;
+
+    AccelerationStructureBatchImpl *impl = getAccelerationStructureBatch(*batch);
+    ulong uncompactedSize = 0;
+    for (AccelerationStructureImpl *as : impl->built)
+        uncompactedSize += getDevice()->getAccelStructMemoryRequirements(as->blas).size;
+
+    // The compacted sizes are queried by the builds, they must have completed before compacting
+    flush();
+    waitGPUIdle();
+    getCommandList()->compactBottomLevelAccelStructs();
+
+    ulong compactedSize = 0;
+    for (AccelerationStructureImpl *as : impl->built) {
+        buildOwnTlas(as, false);
+        as->memorySize = getAccelerationStructureMemory(as);
+        trackMemory(MemoryCategory_AccelerationStructures, as->memorySize);
+        compactedSize += getDevice()->getAccelStructMemoryRequirements(as->blas).size;
+    }
+
+    if (!impl->built.empty())
+        logInfo("Compacted %u acceleration structures from %.1f MB to %.1f MB", (uint)impl->built.size(),
+            uncompactedSize / (1024.0 * 1024.0), compactedSize / (1024.0 * 1024.0));
+
+    delete impl;
+    batch->impl = nullptr;
+}
+
 void updateAccelerationStructure(AccelerationStructure as, const Mesh mesh, const Range *ranges, const uint nbRanges) {
-    nvrhi::rt::AccelStructBuildFlags flags = nvrhi::rt::AccelStructBuildFlags::AllowDataAccess | nvrhi::rt::AccelStructBuildFlags::PreferFastBuild | nvrhi::rt::AccelStructBuildFlags::AllowUpdate;
-    nvrhi::rt::AccelStructDesc blasDesc = getBlasDesc(getMesh(mesh), ranges, nbRanges, flags);
-    getCommandList()->buildBottomLevelAccelStruct(getAccelerationStructure(as)->blas, blasDesc.bottomLevelGeometries.data(), blasDesc.bottomLevelGeometries.size(), flags);
+    AccelerationStructureImpl *impl = getAccelerationStructure(as);
+    if (!impl || !impl->blas) {
+        logError("Updating an invalid acceleration structure");
+        return;
+    }
 
-    nvrhi::rt::InstanceDesc instanceDesc = nvrhi::rt::InstanceDesc().setBLAS(getAccelerationStructure(as)->blas).setInstanceMask(0xFF)
-        .setFlags(nvrhi::rt::InstanceFlags::ForceOpaque | nvrhi::rt::InstanceFlags::TriangleCullDisable);
+    // A full build needs the uncompacted storage size
+    if (impl->blas->isCompacted()) {
+        logError("Updating a compacted acceleration structure, batched ones can't be updated");
+        return;
+    }
+
+    if (!impl->updatable) logPerfWarning("Updating an acceleration structure created as non updatable, it is fully rebuilt");
 
-    getCommandList()->buildTopLevelAccelStruct(getAccelerationStructure(as)->tlas, &instanceDesc, 1, flags | nvrhi::rt::AccelStructBuildFlags::PerformUpdate);
+    // A refit requires the same geometries and primitive counts as the last full build
+    const bool sameRanges = nbRanges == impl->ranges.size() && !memcmp(ranges, impl->ranges.data(), nbRanges * sizeof(Range));
+    const bool refit = impl->updatable && sameRanges && impl->nbRefits < REFITS_BEFORE_REBUILD;
+    impl->nbRefits = refit ? impl->nbRefits + 1 : 0;
+    impl->ranges.assign(ranges, ranges + nbRanges);
+    impl->version++;
+
+    nvrhi::rt::AccelStructBuildFlags flags = nvrhi::rt::AccelStructBuildFlags::AllowDataAccess | (impl->updatable ?
+        (nvrhi::rt::AccelStructBuildFlags::PreferFastBuild | nvrhi::rt::AccelStructBuildFlags::AllowUpdate) :
+        (nvrhi::rt::AccelStructBuildFlags::PreferFastTrace));
+    nvrhi::rt::AccelStructDesc blasDesc = getBlasDesc(getMesh(mesh), ranges, nbRanges, flags);
+    getCommandList()->buildBottomLevelAccelStruct(impl->blas, blasDesc.bottomLevelGeometries.data(), blasDesc.bottomLevelGeometries.size(),
+        refit ? flags | nvrhi::rt::AccelStructBuildFlags::PerformUpdate : flags);
+    buildOwnTlas(impl, impl->updatable);
 }
 
 void deleteAccelerationStructure(AccelerationStructure *as) {
-    if (!as || as->impl)
+    if (!as || !as->impl)
         return;
 
     AccelerationStructureImpl *impl = getAccelerationStructure(*as);
-    impl->tlas.Reset();
-    impl->blas.Reset();
-    delete impl;
+    for (const SceneInstance &instance : impl->instances)
+        releaseBlasInstance(instance.blas);
+
+    // Scenes still instancing the BLAS dereference it, it's destroyed with its last instance
     as->impl = nullptr;
+    if (impl->nbInstances > 0) {
+        impl->deleted = true;
+        return;
+    }
+    destroyAccelerationStructure(impl);
+}
+
+AccelerationStructure createSceneAccelerationStructure(const uint maxInstances) {
+    if (!raytracingEnabled()) {
+        logError("Creation of an acceleration structure while raytracing is disabled.");
+        return AccelerationStructure{nullptr};
+    }
+
+    AccelerationStructureImpl *scene = new AccelerationStructureImpl();
+    nvrhi::rt::AccelStructDesc tlasDesc = nvrhi::rt::AccelStructDesc().setIsTopLevel(true).setTopLevelMaxInstances(maxInstances)
+        .setBuildFlags(nvrhi::rt::AccelStructBuildFlags::PreferFastTrace | nvrhi::rt::AccelStructBuildFlags::AllowUpdate);
+    scene->tlas = getDevice()->createAccelStruct(tlasDesc);
+    scene->maxInstances = maxInstances;
+    scene->instancesChanged = true;
+    scene->instanceDescs.reserve(maxInstances);
+    scene->instances.reserve(maxInstances);
+
+    scene->memorySize = getDevice()->getAccelStructMemoryRequirements(scene->tlas).size;
+    trackMemory(MemoryCategory_AccelerationStructures, scene->memorySize);
+    return AccelerationStructure{scene};
+}
+
+uint addInstance(AccelerationStructure scene, const AccelerationStructure blas, Mat4 transform, const uchar mask, const uint customIndex) {
+    AccelerationStructureImpl *impl = getAccelerationStructure(scene);
+    if (!impl || !impl->tlas || impl->blas) {
+        logError("Adding an instance to an invalid scene acceleration structure");
+        return ~0u;
+    }
+
+    if (!blas.impl || !getAccelerationStructure(blas)->blas || getAccelerationStructure(blas)->deleted) {
+        logWarning("Adding an instance of an invalid acceleration structure");
+        return ~0u;
+    }
+
+    if (impl->instances.size() >= impl->maxInstances) {
+        logError("Scene acceleration structure full (%u instances)", impl->maxInstances);
+        return ~0u;
+    }
+
+    uint id = impl->instanceIndices.size();
+    if (!impl->freeIds.empty()) {
+        id = impl->freeIds.back();
+        impl->freeIds.pop_back();
+    } else
+        impl->instanceIndices.push_back(0);
+
+    impl->instanceIndices[id] = impl->instances.size();
+    getAccelerationStructure(blas)->nbInstances++;
+    impl->instances.push_back(SceneInstance{blas, id, getAccelerationStructure(blas)->version});
+    impl->instanceDescs.push_back(nvrhi::rt::InstanceDesc()
+        .setBLAS(getAccelerationStructure(blas)->blas)
+        .setInstanceMask(mask).setInstanceID(customIndex)
+        .setFlags(nvrhi::rt::InstanceFlags::ForceOpaque | nvrhi::rt::InstanceFlags::TriangleCullDisable));
+    impl->instancesChanged = true;
+
+    setInstanceTransform(scene, id, transform);
+    return id;
+}
+
+void removeInstance(AccelerationStructure scene, const uint instance) {
+    AccelerationStructureImpl *impl = getAccelerationStructure(scene);
+    if (!impl || instance >= impl->instanceIndices.size() || impl->instanceIndices[instance] == ~0u) {
+        logWarning("Removing an invalid instance");
+        return;
+    }
+
+    // Swap with the last instance to keep the instance array packed
+    const uint index = impl->instanceIndices[instance];
+    releaseBlasInstance(impl->instances[index].blas);
+    impl->instances[index] = impl->instances.back();
+    impl->instanceDescs[index] = impl->instanceDescs.back();
+    impl->instanceIndices[impl->instances[index].id] = index;
+    impl->instances.pop_back();
+    impl->instanceDescs.pop_back();
+
+    impl->instanceIndices[instance] = ~0u;
+    impl->freeIds.push_back(instance);
+    impl->instancesChanged = true;
+}
+
+void setInstanceTransform(AccelerationStructure scene, const uint instance, Mat4 transform) {
+    AccelerationStructureImpl *impl = getAccelerationStructure(scene);
+    if (!impl || instance >= impl->instanceIndices.size() || impl->instanceIndices[instance] == ~0u) {
+        logWarning("Setting the transform of an invalid instance");
+        return;
+    }
+
+    // Column major Mat4 to row major 3x4
+    nvrhi::rt::InstanceDesc &desc = impl->instanceDescs[impl->instanceIndices[instance]];
+    for (uint row = 0; row < 3; row++)
+        for (uint column = 0; column < 4; column++)
+            desc.transform[row * 4 + column] = transform[column][row];
+    impl->transformsChanged = true;
+}
+
+void updateSceneAccelerationStructure(AccelerationStructure scene) {
+    AccelerationStructureImpl *impl = getAccelerationStructure(scene);
+    if (!impl || !impl->tlas || impl->blas) {
+        logError("Updating an invalid scene acceleration structure");
+        return;
+    }
+
+    // Refitted or rebuilt BLAS change the instance bounds
+    for (SceneInstance &instance : impl->instances) {
+        const uint version = getAccelerationStructure(instance.blas)->version;
+        if (instance.blasVersion != version) {
+            instance.blasVersion = version;
+            impl->transformsChanged = true;
+        }
+    }
+
+    if (!impl->instancesChanged && !impl->transformsChanged)
+        return;
+
+    nvrhi::rt::AccelStructBuildFlags flags = nvrhi::rt::AccelStructBuildFlags::PreferFastTrace | nvrhi::rt::AccelStructBuildFlags::AllowUpdate;
+    if (!impl->instancesChanged) flags = flags | nvrhi::rt::AccelStructBuildFlags::PerformUpdate;
+    getCommandList()->buildTopLevelAccelStruct(impl->tlas, impl->instanceDescs.data(), impl->instanceDescs.size(), flags);
+    impl->instancesChanged = impl->transformsChanged = false;
 }
 
 }
 
 AccelerationStructureImpl* getAccelerationStructure(AccelerationStructure as) {return (AccelerationStructureImpl*)as.impl;}
+AccelerationStructureBatchImpl* getAccelerationStructureBatch(AccelerationStructureBatch batch) {return (AccelerationStructureBatchImpl*)batch.impl;}
@@ -0,0 +1,112 @@
+#include <batch_math.h>
+#include <stdint.h>
+#include "private_log.h"
+
+// Baseline of the build, AVX with -march=ivybridge
+#ifdef __AVX__
+    #define LANES 8
+    #define STREAM(p, v) _mm256_stream_ps((float*)(p), v)
+#else
+    #define LANES 4
+    #define STREAM(p, v) _mm_stream_ps((float*)(p), v)
+#endif
+#define KERNEL(name) name##Base
+#include "private_batch_math.h"
+#undef LANES
+#undef STREAM
+#undef KERNEL
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define LANES 8
+#define STREAM(p, v) _mm256_stream_ps((float*)(p), v)
+#define KERNEL(name) name##Avx2
+#include "private_batch_math.h"
+#undef LANES
+#undef STREAM
+#undef KERNEL
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define LANES 16
+#define STREAM(p, v) _mm512_stream_ps((float*)(p), v)
+#define KERNEL(name) name##Avx512
+#include "private_batch_math.h"
+#undef LANES
+#undef STREAM
+#undef KERNEL
+#pragma GCC pop_options
+
+typedef struct {
+    SimdLevel level;
+    const char *name;
+    void (*transform)(Float4 *dst, const Float4 *src, const uint n, Mat4 m, const bool stream);
+    void (*multiplyPairs)(Mat4 *r, const Mat4 *a, const Mat4 *b, const uint n);
+    void (*inverse)(Mat4 *r, const Mat4 *m, const uint n);
+    void (*transformAabbs)(Float4 *dstMin, Float4 *dstMax, const Float4 *srcMin, const Float4 *srcMax, const Mat4 *matrices, const uint n);
+} Kernels;
+
+#define KERNELS(level, name, suffix) {level, name, transform##suffix, multiplyPairs##suffix, inverse##suffix, transformAabbs##suffix}
+
+static const Kernels kernels[] = {
+    KERNELS(SimdLevel_AVX   , "AVX"    , Base  ),
+    KERNELS(SimdLevel_AVX2  , "AVX2"   , Avx2  ),
+    KERNELS(SimdLevel_AVX512, "AVX-512", Avx512),
+};
+
+static const Kernels* getKernels() {
+    static const Kernels *selected = NULL;
+    if (selected)
+        return selected;
+
+    // Every thread picks the same kernels, racing here is harmless
+    __builtin_cpu_init();
+    const Kernels *best = &kernels[SimdLevel_AVX];
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        best = &kernels[SimdLevel_AVX2];
+    if (__builtin_cpu_supports("avx512f"))
+        best = &kernels[SimdLevel_AVX512];
+
+    logInfo("Batch math kernels: %s", best->name);
+    selected = best;
+    return selected;
+}
+
+SimdLevel getSimdLevel() {
+    return getKernels()->level;
+}
+
+void transformPoints(Float4 *dst, const Float4 *src, const uint n, Mat4 m) {
+    getKernels()->transform(dst, src, n, m, false);
+}
+
+void transformNormals(Float4 *dst, const Float4 *src, const uint n, Mat4 m) {
+    Mat4 inv, normalMatrix;
+    inversem4(inv, m);
+    transposem4(normalMatrix, inv);
+    normalMatrix[0][3] = normalMatrix[1][3] = normalMatrix[2][3] = 0.0f;
+    normalMatrix[3] = float1(0.0f);
+    getKernels()->transform(dst, src, n, normalMatrix, false);
+}
+
+void multiplyMatrices(Mat4 *r, Mat4 a, const Mat4 *b, const uint n) {
+    getKernels()->transform((Float4*)r, (const Float4*)b, 4 * n, a, false);
+}
+
+void multiplyMatrixPairs(Mat4 *r, const Mat4 *a, const Mat4 *b, const uint n) {
+    getKernels()->multiplyPairs(r, a, b, n);
+}
+
+void multiplyStoreMatrices(float *r, Mat4 a, const Mat4 *b, const uint n) {
+    getKernels()->transform((Float4*)r, (const Float4*)b, 4 * n, a, true);
+    _mm_sfence();
+}
+
+void inverseMatrices(Mat4 *r, const Mat4 *m, const uint n) {
+    getKernels()->inverse(r, m, n);
+}
+
+void transformAabbs(Float4 *dstMin, Float4 *dstMax, const Float4 *srcMin, const Float4 *srcMax, const Mat4 *matrices, const uint n) {
+    getKernels()->transformAabbs(dstMin, dstMax, srcMin, srcMax, matrices, n);
+}
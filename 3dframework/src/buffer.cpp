@@ -1,26 +1,70 @@
 #include <buffer.h>
 #include <nvrhi/nvrhi.h>
+#include <vulkan/vulkan.h>
 #include "private_log.h"
 #include "private_impl.h"
 
-extern "C" {
+// Slices are bound as constant buffers and flushed as non coherent memory, both alignments are
+// powers of two so the largest one satisfies the two
+static uint getDynamicBufferAlignment() {
+    static uint alignment = 0;
+    if (!alignment) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties((VkPhysicalDevice)getDevice()->getNativeObject(nvrhi::ObjectTypes::VK_PhysicalDevice).pointer, &properties);
+        alignment = MAX((uint)nvrhi::c_ConstantBufferOffsetSizeAlignment, (uint)properties.limits.nonCoherentAtomSize);
+    }
+    return alignment;
+}
 
-Buffer createBuffer(const ResourceType type, const uint size) {
+static uint padDynamicBufferSize(const uint size) {
+    const uint alignment = getDynamicBufferAlignment();
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+static Buffer createTrackedBuffer(const nvrhi::BufferDesc &desc, const MemoryCategory category) {
     BufferImpl *buffer = new BufferImpl();
-    buffer->buffer = getDevice()->createBuffer(getBufferDesc(type, size));
-	buffer->mapped = false;
+    buffer->buffer = getDevice()->createBuffer(desc);
+    if (!buffer->buffer) {
+        logError("Can't create a %s buffer of %llu bytes (%llu MB already used)", getMemoryCategoryName(category), (ulong)desc.byteSize, getTotalMemoryUsage() >> 20);
+        delete buffer;
+        return NullBuffer;
+    }
+
+    buffer->mapped = false;
+    buffer->memoryCategory = category;
+    buffer->memorySize = getDevice()->getBufferMemoryRequirements(buffer->buffer).size;
+    trackMemory(category, buffer->memorySize);
     return Buffer{buffer};
 }
 
+extern "C" {
+
+Buffer createBuffer(const ResourceType type, const uint size) {
+    const bool mesh = type == ResourceType_VertexBuffer || type == ResourceType_IndexBuffer;
+    return createTrackedBuffer(getBufferDesc(type, size), mesh ? MemoryCategory_Meshes : MemoryCategory_Buffers);
+}
+
 Buffer createStagingBuffer(const uint size) {
-    BufferImpl *buffer = new BufferImpl();
     nvrhi::BufferDesc desc = nvrhi::BufferDesc()
         .setByteSize(size)
         .setCpuAccess(nvrhi::CpuAccessMode::Read)
         .setKeepInitialState(true);
-    buffer->buffer = getDevice()->createBuffer(desc);
-	buffer->mapped = false;
-    return Buffer{buffer};
+    return createTrackedBuffer(desc, MemoryCategory_Staging);
+}
+
+Buffer createDynamicBuffer(const ResourceType type, const uint bytesPerFrame) {
+    const uint frameSize = padDynamicBufferSize(bytesPerFrame);
+    nvrhi::BufferDesc desc = getBufferDesc(type, frameSize * FRAME_BUFFERING).setCpuAccess(nvrhi::CpuAccessMode::Write);
+
+    Buffer result = createTrackedBuffer(desc, MemoryCategory_Staging);
+    if (!result.impl)
+        return NullBuffer;
+
+    BufferImpl *buffer = (BufferImpl*)result.impl;
+    buffer->mappedData = getDevice()->mapBuffer(buffer->buffer, nvrhi::CpuAccessMode::Write);
+    buffer->mapped = true;
+    buffer->frameSize = frameSize;
+    return result;
 }
 
 void deleteBuffer(Buffer *buffer) {
@@ -28,27 +72,72 @@ void deleteBuffer(Buffer *buffer) {
         return;
 
     BufferImpl *impl = (BufferImpl*)buffer->impl;
-	if (impl->mapped) unmapBuffer(*buffer);
+	if (impl->mapped) getDevice()->unmapBuffer(impl->buffer);
+    trackMemory(impl->memoryCategory, -(long long)impl->memorySize);
     impl->buffer.Reset();
     delete impl;
     buffer->impl = nullptr;
 }
 
 void setBufferData(Buffer buffer, const void *data, const uint size) {
-    nvrhi::IBuffer *buf = getNvBuffer(buffer);
-    getCommandList()->writeBuffer(buf, data, size);
+    BufferImpl *impl = (BufferImpl*)buffer.impl;
+    if (impl->frameSize) {
+        if (size > impl->frameSize)
+            logError("setBufferData of %u bytes truncated to the %u bytes of a dynamic buffer slice", size, impl->frameSize);
+        memcpy(beginDynamicWrite(buffer), data, MIN(size, impl->frameSize));
+        endDynamicWrite(buffer, MIN(size, impl->frameSize));
+        return;
+    }
+
+    getCommandList()->writeBuffer(impl->buffer, data, size);
 }
 
 void copyBuffer(Buffer dest, Buffer src) {
-    getCommandList()->copyBuffer(getNvBuffer(dest), 0, getNvBuffer(src), 0, getNvBuffer(dest)->getDesc().byteSize);
+    getCommandList()->copyBuffer(getNvBuffer(dest), getBufferOffset(dest), getNvBuffer(src), getBufferOffset(src), MIN(getBufferSize(dest), getBufferSize(src)));
 }
 
 void* mapBuffer(Buffer buffer) {
-    return getDevice()->mapBuffer(getNvBuffer(buffer), nvrhi::CpuAccessMode::Read);
+    BufferImpl *impl = (BufferImpl*)buffer.impl;
+    if (impl->frameSize)
+        return beginDynamicWrite(buffer);
+
+    const nvrhi::CpuAccessMode access = impl->buffer->getDesc().cpuAccess;
+    return getDevice()->mapBuffer(impl->buffer, access == nvrhi::CpuAccessMode::None ? nvrhi::CpuAccessMode::Read : access);
 }
 
 void unmapBuffer(Buffer buffer) {
-    return getDevice()->unmapBuffer(getNvBuffer(buffer));
+    BufferImpl *impl = (BufferImpl*)buffer.impl;
+    if (impl->frameSize) {
+        endDynamicWrite(buffer, impl->frameSize);
+        return;
+    }
+
+    return getDevice()->unmapBuffer(impl->buffer);
+}
+
+void* beginDynamicWrite(Buffer buffer) {
+    BufferImpl *impl = (BufferImpl*)buffer.impl;
+    if (!impl || !impl->frameSize) {
+        logError("Dynamic write to a non dynamic buffer");
+        return nullptr;
+    }
+
+    return (char*)impl->mappedData + getBufferOffset(buffer);
+}
+
+void endDynamicWrite(Buffer buffer, const uint bytesWritten) {
+    BufferImpl *impl = (BufferImpl*)buffer.impl;
+    if (!impl || !impl->frameSize || bytesWritten == 0)
+        return;
+
+    // Host visible memory isn't necessarily coherent, slices are aligned on nonCoherentAtomSize
+    const VkMappedMemoryRange range = {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = (VkDeviceMemory)impl->buffer->getNativeObject(nvrhi::ObjectTypes::VK_DeviceMemory).integer,
+        .offset = getBufferOffset(buffer),
+        .size = MIN(padDynamicBufferSize(bytesWritten), impl->frameSize),
+    };
+    vkFlushMappedMemoryRanges((VkDevice)getDevice()->getNativeObject(nvrhi::ObjectTypes::VK_Device).integer, 1, &range);
 }
 
 }
@@ -74,3 +163,18 @@ nvrhi::IBuffer* getNvBuffer(Buffer &buffer) {
     BufferImpl *impl = (BufferImpl*)buffer.impl;
     return impl ? impl->buffer : nullptr;
 }
+
+uint getBufferOffset(Buffer &buffer) {
+    return getBufferOffset(buffer, getFrameIndex());
+}
+
+uint getBufferOffset(Buffer &buffer, const uint frame) {
+    BufferImpl *impl = (BufferImpl*)buffer.impl;
+    return impl ? impl->frameSize * frame : 0;
+}
+
+uint getBufferSize(Buffer &buffer) {
+    BufferImpl *impl = (BufferImpl*)buffer.impl;
+    if (!impl) return 0;
+    return impl->frameSize ? impl->frameSize : impl->buffer->getDesc().byteSize;
+}
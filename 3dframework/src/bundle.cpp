@@ -0,0 +1,101 @@
+#include <bundle.h>
+#include <camera.h>
+#include "private_impl.h"
+#include "private_log.h"
+
+typedef struct {
+    nvrhi::BufferHandle buffer;
+    uint offset;
+    bool view;
+} BundleCameraUniform;
+
+typedef struct {
+    nvrhi::CommandListHandle commandLists[FRAME_BUFFERING]; // one per slice of the dynamic buffers
+    nvrhi::FramebufferInfo framebufferInfo;
+    std::vector<BundleCameraUniform> cameraUniforms;
+} BundleImpl;
+
+static BundleImpl *recording = nullptr;
+
+extern "C" {
+
+void beginBundle() {
+    if (recording) {
+        logError("Bundles can't be nested");
+        return;
+    }
+
+    nvrhi::IFramebuffer *framebuffer = getCurrentFramebuffer();
+    if (!framebuffer) {
+        logError("Recording a bundle without framebuffer");
+        return;
+    }
+
+    recording = new BundleImpl();
+    recording->framebufferInfo = framebuffer->getFramebufferInfo();
+    for (uint i = 0; i < FRAME_BUFFERING; i++) {
+        recording->commandLists[i] = getDevice()->createCommandList(nvrhi::CommandListParameters().setEnableImmediateExecution(false));
+        recording->commandLists[i]->openBundle(framebuffer);
+    }
+}
+
+Bundle endBundle() {
+    if (!recording) {
+        logError("Ending a bundle that was never begun");
+        return Bundle{nullptr};
+    }
+
+    for (uint i = 0; i < FRAME_BUFFERING; i++)
+        recording->commandLists[i]->close();
+
+    BundleImpl *bundle = recording;
+    recording = nullptr;
+    return Bundle{bundle};
+}
+
+void executeBundle(Bundle bundle) {
+    BundleImpl *impl = (BundleImpl*)bundle.impl;
+    if (!impl)
+        return;
+
+    if (recording) {
+        logError("Bundles can't execute other bundles");
+        return;
+    }
+
+    nvrhi::IFramebuffer *framebuffer = getCurrentFramebuffer();
+    if (!framebuffer || framebuffer->getFramebufferInfo() != impl->framebufferInfo) {
+        logError("Executing a bundle into a framebuffer with other formats than the recording one");
+        return;
+    }
+
+    // The frame that used the slice before is done, its uniform versions can be rewritten
+    nvrhi::ICommandList *commandList = impl->commandLists[getFrameIndex()];
+    for (const BundleCameraUniform &uniform : impl->cameraUniforms)
+        commandList->writeBundleVolatileBuffer(uniform.buffer, uniform.view ? getCamera()->view.mat : getCamera()->projection.mat, sizeof(Mat4), uniform.offset);
+
+    getCommandList()->executeBundle(commandList, framebuffer);
+}
+
+// The command lists executing the bundle keep what they need alive until the GPU is done with it
+void deleteBundle(Bundle *bundle) {
+    if (!bundle || !bundle->impl)
+        return;
+
+    delete (BundleImpl*)bundle->impl;
+    bundle->impl = nullptr;
+}
+
+}
+
+nvrhi::ICommandList* getBundleCommandList(const uint frame) {
+    return recording ? recording->commandLists[frame].Get() : nullptr;
+}
+
+void addBundleCameraUniform(nvrhi::IBuffer *buffer, const uint offset, const bool view) {
+    for (const BundleCameraUniform &uniform : recording->cameraUniforms)
+        if (uniform.buffer == buffer && uniform.offset == offset)
+            return;
+
+    recording->cameraUniforms.push_back(BundleCameraUniform{buffer, offset, view});
+}
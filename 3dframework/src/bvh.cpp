@@ -0,0 +1,499 @@
+#include <bvh.h>
+#include <context.h>
+#include <random.h>
+#include <readback.h>
+#include <chrono>
+#include "private_impl.h"
+#include "private_log.h"
+#include "private_parallel.h"
+
+#define BVH_BINS 16
+#define BVH_MAX_LEAF_SIZE 8
+#define BVH_PARALLEL_SIZE 4096 // subtrees of more triangles are built by their own job
+#define BVH_STACK_SIZE 256 // entries on the call stack, deeper trees traverse with a heap stack
+
+// 8-wide node, children are tested at once with AVX
+typedef struct alignas(32) {
+    float bounds[6][8]; // min xyz then max xyz of each child, empty slots are inverted so they're never hit
+    int children[8];    // inner node index, or ~first triangle block of a leaf
+    uchar nbBlocks[8];
+} BvhNode;
+
+// 4 triangles in structure of arrays layout for the SSE intersection
+typedef struct {
+    Float4 v0[3], e1[3], e2[3];
+    uint primitives[4]; // ~0u for the padding of partial blocks
+} TriangleBlock;
+
+typedef struct {
+    std::vector<BvhNode> nodes;
+    std::vector<TriangleBlock> blocks;
+    Float4 min, max;
+    uint nbTriangles;
+    uint stackSize; // traversal stack bound, 7 entries per level below the root
+} BvhImpl;
+
+struct BuildNode {
+    Float4 min, max;
+    BuildNode *children[2];
+    uint first, count;
+};
+
+struct BuildContext {
+    std::vector<Float4> vertices, triMin, triMax, centroids; // 3 vertices per triangle
+    std::vector<uint> refs;
+};
+
+struct BuildTask {
+    BuildContext *ctx;
+    BuildNode **node;
+    uint first, count;
+};
+
+static BvhImpl* getBvh(Bvh bvh) {return (BvhImpl*)bvh.impl;}
+
+static float halfArea(const Float4 min, const Float4 max) {
+    const Float4 d = max4(max - min, float1(0.0f));
+    return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+static uint getBin(const float centroid, const float min, const float scale) {
+    return MIN((uint)MAX((centroid - min) * scale, 0.0f), BVH_BINS - 1u);
+}
+
+// Binned SAH on the 3 axes, large splits are recursed in parallel
+static BuildNode* buildNode(BuildContext &ctx, const uint first, const uint count) {
+    BuildNode *node = new BuildNode();
+    node->first = first;
+    node->count = count;
+
+    Float4 cmin = float1(INFINITY), cmax = float1(-INFINITY);
+    node->min = cmin;
+    node->max = cmax;
+    for (uint i = first; i < first + count; i++) {
+        const uint ref = ctx.refs[i];
+        node->min = min4(node->min, ctx.triMin[ref]);
+        node->max = max4(node->max, ctx.triMax[ref]);
+        cmin = min4(cmin, ctx.centroids[ref]);
+        cmax = max4(cmax, ctx.centroids[ref]);
+    }
+
+    if (count <= 2)
+        return node;
+
+    const Float4 extent = cmax - cmin;
+    float bestCost = INFINITY, bestScale = 0.0f;
+    int bestAxis = -1;
+    uint bestSplit = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (extent[axis] <= 0.0f)
+            continue;
+
+        struct {Float4 min, max; uint count;} bins[BVH_BINS];
+        for (uint bin = 0; bin < BVH_BINS; bin++)
+            bins[bin] = {float1(INFINITY), float1(-INFINITY), 0};
+
+        const float scale = BVH_BINS / extent[axis];
+        for (uint i = first; i < first + count; i++) {
+            const uint ref = ctx.refs[i];
+            const uint bin = getBin(ctx.centroids[ref][axis], cmin[axis], scale);
+            bins[bin].min = min4(bins[bin].min, ctx.triMin[ref]);
+            bins[bin].max = max4(bins[bin].max, ctx.triMax[ref]);
+            bins[bin].count++;
+        }
+
+        float rightArea[BVH_BINS - 1];
+        uint rightCount[BVH_BINS - 1];
+        Float4 bmin = float1(INFINITY), bmax = float1(-INFINITY);
+        uint n = 0;
+        for (uint bin = BVH_BINS - 1; bin > 0; bin--) {
+            bmin = min4(bmin, bins[bin].min);
+            bmax = max4(bmax, bins[bin].max);
+            n += bins[bin].count;
+            rightArea[bin - 1] = halfArea(bmin, bmax);
+            rightCount[bin - 1] = n;
+        }
+
+        bmin = float1(INFINITY);
+        bmax = float1(-INFINITY);
+        n = 0;
+        for (uint bin = 0; bin < BVH_BINS - 1; bin++) {
+            bmin = min4(bmin, bins[bin].min);
+            bmax = max4(bmax, bins[bin].max);
+            n += bins[bin].count;
+            const float cost = halfArea(bmin, bmax) * n + rightArea[bin] * rightCount[bin];
+            if (n > 0 && rightCount[bin] > 0 && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = bin;
+                bestScale = scale;
+            }
+        }
+    }
+
+    // Traversal and intersection costs are equal, so a leaf costs its triangle count
+    if (count <= BVH_MAX_LEAF_SIZE && (bestAxis < 0 || count <= 1.0f + bestCost / halfArea(node->min, node->max)))
+        return node;
+
+    uint middle = first + count / 2;
+    if (bestAxis >= 0)
+        middle = std::partition(ctx.refs.begin() + first, ctx.refs.begin() + first + count, [&](const uint ref) {
+            return getBin(ctx.centroids[ref][bestAxis], cmin[bestAxis], bestScale) <= bestSplit;
+        }) - ctx.refs.begin();
+
+    // Identical centroids can't be binned, any split is as good
+    if (middle == first || middle == first + count)
+        middle = first + count / 2;
+
+    if (count > BVH_PARALLEL_SIZE) {
+        BuildTask task = {&ctx, &node->children[0], first, middle - first};
+        Job job = createJob([](void *data) {
+            BuildTask *task = (BuildTask*)data;
+            *task->node = buildNode(*task->ctx, task->first, task->count);
+        }, &task);
+        runJob(job);
+        node->children[1] = buildNode(ctx, middle, first + count - middle);
+        waitJob(job);
+    } else {
+        node->children[0] = buildNode(ctx, first, middle - first);
+        node->children[1] = buildNode(ctx, middle, first + count - middle);
+    }
+
+    return node;
+}
+
+static void deleteBuildNode(BuildNode *node) {
+    if (node->children[0]) {
+        deleteBuildNode(node->children[0]);
+        deleteBuildNode(node->children[1]);
+    }
+    delete node;
+}
+
+static uint emitLeaf(BvhImpl *bvh, const BuildContext &ctx, const BuildNode *node) {
+    const uint firstBlock = bvh->blocks.size();
+    for (uint i = 0; i < node->count; i += 4) {
+        TriangleBlock block = {};
+        for (uint j = 0; j < 4; j++) {
+            block.primitives[j] = ~0u;
+            if (i + j >= node->count)
+                continue;
+
+            const uint ref = ctx.refs[node->first + i + j];
+            const Float4 *v = &ctx.vertices[ref * 3];
+            for (uint axis = 0; axis < 3; axis++) {
+                block.v0[axis][j] = v[0][axis];
+                block.e1[axis][j] = v[1][axis] - v[0][axis];
+                block.e2[axis][j] = v[2][axis] - v[0][axis];
+            }
+            block.primitives[j] = ref;
+        }
+        bvh->blocks.push_back(block);
+    }
+    return firstBlock;
+}
+
+// Collapses the binary tree by opening the largest children until 8 of them are gathered
+static uint collapseNode(BvhImpl *bvh, const BuildContext &ctx, const BuildNode *node, const uint depth) {
+    bvh->stackSize = MAX(bvh->stackSize, 7 * depth + 1);
+    const BuildNode *children[8] = {node};
+    uint nbChildren = 1;
+    if (node->children[0]) {
+        children[0] = node->children[0];
+        children[1] = node->children[1];
+        nbChildren = 2;
+    }
+
+    while (nbChildren < 8) {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (uint i = 0; i < nbChildren; i++) {
+            const float area = halfArea(children[i]->min, children[i]->max);
+            if (children[i]->children[0] && area > largestArea) {
+                largest = i;
+                largestArea = area;
+            }
+        }
+        if (largest < 0)
+            break;
+
+        const BuildNode *opened = children[largest];
+        children[largest] = opened->children[0];
+        children[nbChildren++] = opened->children[1];
+    }
+
+    const uint index = bvh->nodes.size();
+    BvhNode wide = {};
+    for (uint i = 0; i < 8; i++)
+        for (uint axis = 0; axis < 3; axis++) {
+            wide.bounds[axis][i] = INFINITY;
+            wide.bounds[axis + 3][i] = -INFINITY;
+        }
+    bvh->nodes.push_back(wide);
+
+    for (uint i = 0; i < nbChildren; i++) {
+        const BuildNode *child = children[i];
+        int reference;
+        uchar nbBlocks = 0;
+        if (child->children[0])
+            reference = collapseNode(bvh, ctx, child, depth + 1);
+        else {
+            reference = ~(int)emitLeaf(bvh, ctx, child);
+            nbBlocks = (child->count + 3) / 4;
+        }
+
+        BvhNode &n = bvh->nodes[index];
+        for (uint axis = 0; axis < 3; axis++) {
+            n.bounds[axis][i] = child->min[axis];
+            n.bounds[axis + 3][i] = child->max[axis];
+        }
+        n.children[i] = reference;
+        n.nbBlocks[i] = nbBlocks;
+    }
+
+    return index;
+}
+
+// Möller-Trumbore on 4 triangles at once
+static void intersectBlocks(const BvhImpl *bvh, const uint first, const uint nbBlocks, const Float4 o[3], const Float4 d[3], const float tMin, RayHit &hit) {
+    for (uint i = first; i < first + nbBlocks; i++) {
+        const TriangleBlock &b = bvh->blocks[i];
+        const Float4 px = d[1] * b.e2[2] - d[2] * b.e2[1];
+        const Float4 py = d[2] * b.e2[0] - d[0] * b.e2[2];
+        const Float4 pz = d[0] * b.e2[1] - d[1] * b.e2[0];
+        const Float4 det = b.e1[0] * px + b.e1[1] * py + b.e1[2] * pz;
+        const Float4 invDet = float1(1.0f) / det;
+
+        const Float4 sx = o[0] - b.v0[0], sy = o[1] - b.v0[1], sz = o[2] - b.v0[2];
+        const Float4 u = (sx * px + sy * py + sz * pz) * invDet;
+        const Float4 qx = sy * b.e1[2] - sz * b.e1[1];
+        const Float4 qy = sz * b.e1[0] - sx * b.e1[2];
+        const Float4 qz = sx * b.e1[1] - sy * b.e1[0];
+        const Float4 v = (d[0] * qx + d[1] * qy + d[2] * qz) * invDet;
+        const Float4 t = (b.e2[0] * qx + b.e2[1] * qy + b.e2[2] * qz) * invDet;
+
+        // Padding and null determinants are masked explicitly, -Ofast doesn't preserve NaN comparisons
+        const Int4 filled = (Int4)_mm_loadu_si128((const __m128i*)b.primitives) != int1(-1);
+        const Int4 valid = filled & (det != 0.0f) & (u >= 0.0f) & (v >= 0.0f) & (u + v <= 1.0f) & (t > tMin) & (t < hit.t);
+        uint mask = _mm_movemask_ps((Float4)valid);
+        while (mask) {
+            const uint j = __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (t[j] < hit.t)
+                hit = {t[j], u[j], v[j], b.primitives[j]};
+        }
+    }
+}
+
+static void traceRay(const BvhImpl *bvh, const Ray &ray, RayHit &hit) {
+    hit = {ray.tMax, 0.0f, 0.0f, ~0u};
+
+    // Null direction components would give inf * 0 = NaN in the slab test
+    Float4 inv;
+    for (uint axis = 0; axis < 3; axis++)
+        inv[axis] = 1.0f / (fabsf(ray.direction[axis]) > 1e-20f ? ray.direction[axis] : copysignf(1e-20f, ray.direction[axis]));
+
+    // With the near plane picked by the direction sign, inverted empty slots never hit
+    const uint nearX = inv[0] < 0.0f ? 3 : 0, nearY = inv[1] < 0.0f ? 4 : 1, nearZ = inv[2] < 0.0f ? 5 : 2;
+    const uint farX = (nearX + 3) % 6, farY = (nearY + 3) % 6, farZ = (nearZ + 3) % 6;
+    const __m256 invX = _mm256_set1_ps(inv[0]), invY = _mm256_set1_ps(inv[1]), invZ = _mm256_set1_ps(inv[2]);
+    const __m256 oiX = _mm256_set1_ps(ray.origin[0] * inv[0]), oiY = _mm256_set1_ps(ray.origin[1] * inv[1]), oiZ = _mm256_set1_ps(ray.origin[2] * inv[2]);
+    const __m256 tMin = _mm256_set1_ps(ray.tMin);
+    const Float4 o[3] = {float1(ray.origin[0]), float1(ray.origin[1]), float1(ray.origin[2])};
+    const Float4 d[3] = {float1(ray.direction[0]), float1(ray.direction[1]), float1(ray.direction[2])};
+
+    struct StackEntry {int node; float t;};
+    StackEntry localStack[BVH_STACK_SIZE], *stack = localStack;
+    std::vector<StackEntry> heapStack;
+    if (bvh->stackSize > BVH_STACK_SIZE) {
+        heapStack.resize(bvh->stackSize);
+        stack = heapStack.data();
+    }
+    uint top = 0;
+    stack[top++] = {0, ray.tMin};
+
+    while (top > 0) {
+        const auto entry = stack[--top];
+        if (entry.t > hit.t)
+            continue;
+
+        const BvhNode &node = bvh->nodes[entry.node];
+        const __m256 tNear = _mm256_max_ps(_mm256_max_ps(
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(node.bounds[nearX]), invX), oiX),
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(node.bounds[nearY]), invY), oiY)), _mm256_max_ps(
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(node.bounds[nearZ]), invZ), oiZ), tMin));
+        const __m256 tFar = _mm256_min_ps(_mm256_min_ps(
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(node.bounds[farX]), invX), oiX),
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(node.bounds[farY]), invY), oiY)), _mm256_min_ps(
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_load_ps(node.bounds[farZ]), invZ), oiZ), _mm256_set1_ps(hit.t)));
+
+        uint mask = _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+        float __attribute__((aligned(32))) distances[8];
+        _mm256_store_ps(distances, tNear);
+
+        // Leaves are intersected right away, inner children are pushed farthest first
+        const uint firstPushed = top;
+        while (mask) {
+            const uint i = __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (node.children[i] < 0) {
+                intersectBlocks(bvh, ~node.children[i], node.nbBlocks[i], o, d, ray.tMin, hit);
+                continue;
+            }
+
+            uint j = top++;
+            while (j > firstPushed && stack[j - 1].t < distances[i]) {
+                stack[j] = stack[j - 1];
+                j--;
+            }
+            stack[j] = {node.children[i], distances[i]};
+        }
+    }
+}
+
+extern "C" {
+
+Bvh createBvh(const void *positions, const uint positionStride, const uint nbVertices, const uint *indices, const uint nbIndices) {
+    const uint nbTriangles = (indices ? nbIndices : nbVertices) / 3;
+    if (!positions || nbTriangles == 0) {
+        logError("Creation of a BVH without triangles");
+        return Bvh{nullptr};
+    }
+
+    BuildContext ctx;
+    ctx.vertices.resize(nbTriangles * 3);
+    ctx.triMin.resize(nbTriangles);
+    ctx.triMax.resize(nbTriangles);
+    ctx.centroids.resize(nbTriangles);
+    ctx.refs.resize(nbTriangles);
+
+    std::atomic<bool> outOfRange(false);
+    parallelFor(nbTriangles, 4096, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++) {
+            for (uint j = 0; j < 3; j++) {
+                uint vertex = indices ? indices[i * 3 + j] : i * 3 + j;
+                if (vertex >= nbVertices) {
+                    outOfRange = true;
+                    vertex = 0;
+                }
+                const float *p = (const float*)((const uchar*)positions + (ulong)vertex * positionStride);
+                ctx.vertices[i * 3 + j] = float4(p[0], p[1], p[2], 0.0f);
+            }
+
+            const Float4 *v = &ctx.vertices[i * 3];
+            ctx.triMin[i] = min4(min4(v[0], v[1]), v[2]);
+            ctx.triMax[i] = max4(max4(v[0], v[1]), v[2]);
+            ctx.centroids[i] = (ctx.triMin[i] + ctx.triMax[i]) * 0.5f;
+            ctx.refs[i] = i;
+        }
+    });
+
+    if (outOfRange)
+        logWarning("BVH indices out of range, replaced by the first vertex");
+
+    BvhImpl *bvh = new BvhImpl();
+    bvh->nbTriangles = nbTriangles;
+    bvh->nodes.reserve(nbTriangles / 4 + 1);
+    bvh->blocks.reserve(nbTriangles / 2 + 1);
+
+    BuildNode *root = buildNode(ctx, 0, nbTriangles);
+    bvh->min = root->min;
+    bvh->max = root->max;
+    collapseNode(bvh, ctx, root, 0);
+    deleteBuildNode(root);
+
+    return Bvh{bvh};
+}
+
+Bvh createMeshBvh(const Mesh mesh) {
+    MeshImpl *meshimpl = getMesh(mesh);
+    if (!meshimpl || meshimpl->attributes.empty() || meshimpl->primitiveType != PrimitiveType_Triangles) {
+        logError("Creation of a BVH from an invalid or non triangle list mesh");
+        return Bvh{nullptr};
+    }
+
+    const nvrhi::Format format = meshimpl->attributes[0].format;
+    if (format != nvrhi::Format::RG32_FLOAT && format != nvrhi::Format::RGB32_FLOAT && format != nvrhi::Format::RGBA32_FLOAT) {
+        logError("Unsupported vertex format for a BVH: %s", nvrhi::getFormatInfo(format).name);
+        return Bvh{nullptr};
+    }
+
+    const uint stride = getFormatInfo((Format)format).size;
+    const uint indexSize = meshimpl->indicesFormat == nvrhi::Format::R16_UINT ? 2 : 4;
+    const ReadbackTicket vertexTicket = requestBufferReadback(meshimpl->buffers[0], 0, meshimpl->nbVertices * stride, nullptr, nullptr);
+    const ReadbackTicket indexTicket = meshimpl->indices.impl ?
+        requestBufferReadback(meshimpl->indices, 0, meshimpl->nbIndices * indexSize, nullptr, nullptr) : NullReadback;
+    flush();
+
+    // 2D positions get a null z
+    const uchar *vertexData = (const uchar*)waitReadback(vertexTicket, nullptr);
+    std::vector<float> positions(meshimpl->nbVertices * 3, 0.0f);
+    for (uint i = 0; vertexData && i < meshimpl->nbVertices; i++)
+        memcpy(&positions[i * 3], vertexData + i * stride, format == nvrhi::Format::RG32_FLOAT ? 8 : 12);
+    releaseReadback(vertexTicket);
+
+    std::vector<uint> indices;
+    if (indexTicket != NullReadback) {
+        const void *indexData = waitReadback(indexTicket, nullptr);
+        indices.resize(meshimpl->nbIndices);
+        for (uint i = 0; indexData && i < meshimpl->nbIndices; i++)
+            indices[i] = indexSize == 2 ? ((const ushort*)indexData)[i] : ((const uint*)indexData)[i];
+        releaseReadback(indexTicket);
+    }
+
+    return createBvh(positions.data(), 3 * sizeof(float), meshimpl->nbVertices,
+        indices.empty() ? nullptr : indices.data(), indices.size());
+}
+
+void deleteBvh(Bvh *bvh) {
+    if (!bvh || !bvh->impl)
+        return;
+
+    delete getBvh(*bvh);
+    bvh->impl = nullptr;
+}
+
+void traceRays(const Bvh bvh, const Ray *rays, RayHit *hits, const uint nbRays) {
+    const BvhImpl *impl = getBvh(bvh);
+    if (!impl) {
+        logError("Tracing rays in an invalid BVH");
+        return;
+    }
+
+    parallelFor(nbRays, 256, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++)
+            traceRay(impl, rays[i], hits[i]);
+    });
+}
+
+float benchmarkBvh(const Bvh bvh, const uint nbRays) {
+    const BvhImpl *impl = getBvh(bvh);
+    if (!impl || nbRays == 0) {
+        logError("Benchmarking an invalid BVH");
+        return 0.0f;
+    }
+
+    std::vector<Ray> rays(nbRays);
+    std::vector<RayHit> hits(nbRays);
+    for (Ray &ray : rays) {
+        ray.origin = impl->min + (impl->max - impl->min) * float4(randf(), randf(), randf(), 0.0f);
+        ray.direction = normalize3(float4(randNormal(), randNormal(), randNormal(), 0.0f));
+        ray.tMin = 0.0f;
+        ray.tMax = INFINITY;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    traceRays(bvh, rays.data(), hits.data(), nbRays);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint nbHits = 0;
+    for (const RayHit &hit : hits)
+        nbHits += hit.primitive != ~0u;
+
+    const float mrays = nbRays / seconds * 1e-6;
+    logInfo("BVH of %u triangles: %.1f Mrays/s (%u rays, %u hits)", impl->nbTriangles, (double)mrays, nbRays, nbHits);
+    return mrays;
+}
+
+}
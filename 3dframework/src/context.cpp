@@ -12,8 +12,6 @@
 #include "private_impl.h"
 #include "sdlwindow.h"
 
-#define FRAME_BUFFERING 3
-
 static struct {
     SDL_Window *window;
     vkb::Instance instance;
@@ -35,7 +33,7 @@ static struct {
     uint currentFrame, imageIndex, width, height;
     ColorSpace colorSpace;
     nvrhi::TimerQueryHandle timerQuery;
-    bool raytracing;
+    bool raytracing, memoryBudget, graphicsPipelineLibrary;
 } context = {};
 
 #ifndef NDEBUG
@@ -115,7 +113,18 @@ static vkb::PhysicalDevice selectPhysicalDevice(const vkb::Instance &vkb_instanc
     return vkb_physical_device;
 }
 
-static vkb::Device createDevice(const vkb::PhysicalDevice &vkb_physical_device, const bool gcn, const bool rdna, const bool maxwell, const bool nvPascal, const bool raytracing, const bool turing) {
+// Both extensions present and the feature supported, drivers may expose the extension without it
+static bool supportsGraphicsPipelineLibrary(const vkb::PhysicalDevice &physicalDevice) {
+    if (!physicalDevice.is_extension_present("VK_KHR_pipeline_library") || !physicalDevice.is_extension_present("VK_EXT_graphics_pipeline_library"))
+        return false;
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT featuresGPL = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT};
+    VkPhysicalDeviceFeatures2 features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &featuresGPL};
+    vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &features);
+    return featuresGPL.graphicsPipelineLibrary;
+}
+
+static vkb::Device createDevice(const vkb::PhysicalDevice &vkb_physical_device, const bool gcn, const bool rdna, const bool maxwell, const bool nvPascal, const bool raytracing, const bool turing, const bool graphicsPipelineLibrary) {
     std::vector<vkb::CustomQueueDescription> queue_descriptions;
     std::vector<VkQueueFamilyProperties> queue_families = vkb_physical_device.get_queue_families();
     for (size_t i = 0; i < queue_families.size(); i++) {
@@ -220,6 +229,7 @@ static vkb::Device createDevice(const vkb::PhysicalDevice &vkb_physical_device,
 #if 1
     VkPhysicalDeviceVulkan13Features vulkan13Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
     device_builder.add_pNext(&vulkan13Features);
+    vulkan13Features.dynamicRendering = true;
     vulkan13Features.maintenance4 = true;
     vulkan13Features.shaderIntegerDotProduct = true;
     vulkan13Features.synchronization2 = true;
@@ -233,6 +243,12 @@ static vkb::Device createDevice(const vkb::PhysicalDevice &vkb_physical_device,
     VkPhysicalDeviceFragmentShadingRateFeaturesKHR featuresVRS = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR};
     VkPhysicalDeviceShaderSMBuiltinsFeaturesNV featuresSMBuiltins = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_SM_BUILTINS_FEATURES_NV};
     VkPhysicalDeviceComputeShaderDerivativesFeaturesNV featuresComputeDerivatives = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_COMPUTE_SHADER_DERIVATIVES_FEATURES_NV};
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT featuresGPL = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT};
+
+    if (graphicsPipelineLibrary) {
+        device_builder.add_pNext(&featuresGPL);
+        featuresGPL.graphicsPipelineLibrary = true;
+    }
 
     if (gcn) {
         device_builder.add_pNext(&featuresShaderAtomicFloat);
@@ -361,7 +377,7 @@ extern "C" {
 
 void initContext(const char *title, const uint width, const uint height, const ulong flags) {
     uint nbDeviceExtensions = 0;
-    const char *deviceExtensions[16];
+    const char *deviceExtensions[24];
     deviceExtensions[nbDeviceExtensions++] = "VK_KHR_swapchain";
 
     const bool nvTuring = (flags & NV_TURING_FLAG) != 0, nvPascal = nvTuring || (flags & NV_PASCAL_FLAG) != 0, nvMaxwell = nvPascal || (flags & NV_MAXWELL_FLAG) != 0;
@@ -411,11 +427,21 @@ void initContext(const char *title, const uint width, const uint height, const u
 
     context.instance = createInstance(instanceExtensions, nbInstanceExtensions);
     context.physicalDevice = selectPhysicalDevice(context.instance, context.window, deviceExtensions, nbDeviceExtensions);
+    context.memoryBudget = context.physicalDevice.enable_extension_if_present("VK_EXT_memory_budget");
+    // Optional, pipelines are then fast linked from cached parts while the optimized ones compile
+    context.graphicsPipelineLibrary = supportsGraphicsPipelineLibrary(context.physicalDevice)
+                                   && context.physicalDevice.enable_extension_if_present("VK_KHR_pipeline_library")
+                                   && context.physicalDevice.enable_extension_if_present("VK_EXT_graphics_pipeline_library");
     logInfo("Running on a %s", context.physicalDevice.name.c_str());
-    context.device = createDevice(context.physicalDevice, gcn, rdna, nvMaxwell, nvPascal, context.raytracing, nvTuring);
+    context.device = createDevice(context.physicalDevice, gcn, rdna, nvMaxwell, nvPascal, context.raytracing, nvTuring, context.graphicsPipelineLibrary);
     context.vkDevice = context.device.device;
     context.vkGraphicsQueue = context.device.get_queue(vkb::QueueType::graphics).value();
 
+    if (context.graphicsPipelineLibrary) {
+        deviceExtensions[nbDeviceExtensions++] = "VK_KHR_pipeline_library";
+        deviceExtensions[nbDeviceExtensions++] = "VK_EXT_graphics_pipeline_library";
+    }
+
     // NVRHI device
     nvrhi::vulkan::DeviceDesc deviceDesc = {};
 #ifndef NDEBUG
@@ -431,6 +457,8 @@ void initContext(const char *title, const uint width, const uint height, const u
     deviceDesc.deviceExtensions = deviceExtensions;
     deviceDesc.numDeviceExtensions = nbDeviceExtensions;
     deviceDesc.bufferDeviceAddressSupported = true;
+    deviceDesc.dynamicRenderingSupported = true;
+    deviceDesc.extendedDynamicStateSupported = true;
     context.nvrhiVkDevice = nvrhi::vulkan::createDevice(deviceDesc);
     context.nvrhiDevice = context.nvrhiVkDevice;
 #ifndef NDEBUG
@@ -481,6 +509,7 @@ void initContext(const char *title, const uint width, const uint height, const u
 
 void deleteContext() {
     context.nvrhiDevice->waitForIdle();
+    deleteReadbacks();
     context.timerQuery.Reset();
     for (size_t i = 0; i < FRAME_BUFFERING; i++) {
         context.throttleCommands[i].Reset();
@@ -507,11 +536,13 @@ void beginFrame() {
     context.nvrhiVkDevice->queueWaitForSemaphore(nvrhi::CommandQueue::Graphics, context.acquireSemaphores[context.currentFrame], 0);
     context.nvrhiVkDevice->queueSignalSemaphore(nvrhi::CommandQueue::Graphics, context.presentSemaphores[context.currentFrame], 0);
     context.commandList->open();
+    processReadbacks();
 }
 
 void endFrame() {
     context.commandList->close();
     context.nvrhiDevice->executeCommandList(context.commandList);
+    submitReadbacks();
     vk::PresentInfoKHR presentInfo = vk::PresentInfoKHR({1}, {&context.presentSemaphores[context.currentFrame]}, {1}, {&context.vkSwapchain}, {&context.imageIndex});
     VERIFY(context.vkGraphicsQueue.presentKHR(&presentInfo) == vk::Result::eSuccess);
     context.nvrhiDevice->waitEventQuery(context.throttleCommands[context.currentFrame]);
@@ -523,11 +554,13 @@ void waitGPUIdle() {context.nvrhiDevice->waitForIdle();}
 void flush() {
     context.commandList->close();
     context.nvrhiDevice->executeCommandList(context.commandList);
+    submitReadbacks();
     context.commandList->open();
 }
 void flushAndGarbageCollect() {
     context.commandList->close();
     context.nvrhiDevice->executeCommandList(context.commandList);
+    submitReadbacks();
     context.commandList = context.nvrhiDevice->createCommandList();
     context.commandList->open();
 }
@@ -542,6 +575,7 @@ uint        getHeight              () {return context.height;}
 struct SDL_Window* getWindow       () {return context.window;}
 const char* getDeviceName          () {return context.device.physical_device.name.c_str();}
 bool        raytracingEnabled      () {return context.raytracing;}
+bool        memoryBudgetSupported  () {return context.memoryBudget;}
 
 void beginTimerQuery() {
     context.commandList->beginTimerQuery(context.timerQuery);
@@ -562,5 +596,7 @@ SDL_Window* getSDLWindow() {return context.window;}
 
 }
 
-nvrhi::IDevice*      getDevice     () {return context.nvrhiDevice;}
-nvrhi::ICommandList* getCommandList() {return context.commandList;}
+nvrhi::IDevice*         getDevice      () {return context.nvrhiDevice;}
+nvrhi::vulkan::IDevice* getVulkanDevice() {return context.nvrhiVkDevice;}
+nvrhi::ICommandList*    getCommandList () {return context.commandList;}
+uint                    getFrameIndex  () {return context.currentFrame;}
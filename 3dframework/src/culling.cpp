@@ -0,0 +1,130 @@
+#include <culling.h>
+#include <string.h>
+#include "private_parallel.h"
+
+#define CULLING_GRAIN 16384
+
+// Lanes past end are zeroed and masked out of the result
+static inline Float8 load8(const float *p, const uint i, const uint end) {
+    if (i + 8 <= end)
+        return (Float8)_mm256_loadu_ps(p + i);
+
+    const Int8 lanes = {0, 1, 2, 3, 4, 5, 6, 7};
+    return (Float8)_mm256_maskload_ps(p + i, (__m256i)(lanes < (int)(end - i)));
+}
+
+static inline uint validMask(const uint i, const uint end) {
+    return end - i >= 8 ? 0xFF : (1u << (end - i)) - 1;
+}
+
+static inline uint sphereMask(const Frustum *frustum, const BoundingSpheres &spheres, const uint i, const uint end) {
+    const Float8
+        x = load8(spheres.x, i, end),
+        y = load8(spheres.y, i, end),
+        z = load8(spheres.z, i, end),
+        r = -load8(spheres.radius, i, end);
+
+    Int8 inside = ~Int8{};
+    #pragma GCC unroll 6
+    for (int p = 0; p < 6; p++) {
+        const Float4 plane = frustum->planes[p];
+        inside &= x * plane[0] + y * plane[1] + z * plane[2] + plane[3] >= r;
+    }
+
+    return _mm256_movemask_ps((__m256)inside) & validMask(i, end);
+}
+
+static inline uint boxMask(const Frustum *frustum, const BoundingBoxes &boxes, const uint i, const uint end) {
+    const Float8
+        x = load8(boxes.x, i, end),
+        y = load8(boxes.y, i, end),
+        z = load8(boxes.z, i, end),
+        ex = load8(boxes.extentX, i, end),
+        ey = load8(boxes.extentY, i, end),
+        ez = load8(boxes.extentZ, i, end);
+
+    // Projected radius of the box on each plane normal
+    Int8 inside = ~Int8{};
+    #pragma GCC unroll 6
+    for (int p = 0; p < 6; p++) {
+        const Float4 plane = frustum->planes[p], absPlane = abs4(plane);
+        inside &= x * plane[0] + y * plane[1] + z * plane[2] + plane[3] >= -(ex * absPlane[0] + ey * absPlane[1] + ez * absPlane[2]);
+    }
+
+    return _mm256_movemask_ps((__m256)inside) & validMask(i, end);
+}
+
+// Each chunk writes its indices at its own start in visible, then the chunks are packed in order
+template<typename MaskFunction>
+static uint cull(const uint n, uint *visible, MaskFunction &&mask) {
+    const uint nbChunks = (n + CULLING_GRAIN - 1) / CULLING_GRAIN;
+    std::vector<uint> counts(nbChunks);
+
+    parallelFor(n, CULLING_GRAIN, [&](const uint begin, const uint end) {
+        uint count = begin;
+        for (uint i = begin; i < end; i += 8)
+            for (uint bits = mask(i, end); bits; bits &= bits - 1)
+                visible[count++] = i + __builtin_ctz(bits);
+        counts[begin / CULLING_GRAIN] = count - begin;
+    });
+
+    uint total = 0;
+    for (uint chunk = 0; chunk < nbChunks; chunk++) {
+        if (total != chunk * CULLING_GRAIN)
+            memmove(visible + total, visible + chunk * CULLING_GRAIN, counts[chunk] * sizeof(uint));
+        total += counts[chunk];
+    }
+
+    return total;
+}
+
+extern "C" {
+
+Frustum getFrustum(Mat4 viewProjection) {
+    Mat4 rows;
+    transposem4(rows, viewProjection);
+
+    // Clip space bounds -w <= x, y <= w and 0 <= z <= w
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+
+    for (int p = 0; p < 6; p++) {
+        const float length = length3(frustum.planes[p]);
+        frustum.planes[p] = length > 0.0f ? frustum.planes[p] / length : float1(0.0f);
+    }
+
+    return frustum;
+}
+
+Frustum getCameraFrustum(Camera *cam) {
+    Mat4 viewProjection;
+    multiplytm4(viewProjection, cam->projection.mat, cam->view.mat);
+    return getFrustum(viewProjection);
+}
+
+uint cullSpheres(const Frustum *frustum, const BoundingSpheres spheres, const uint n, uint *visible) {
+    return cull(n, visible, [&](const uint i, const uint end) {return sphereMask(frustum, spheres, i, end);});
+}
+
+uint cullBoxes(const Frustum *frustum, const BoundingBoxes boxes, const uint n, uint *visible) {
+    return cull(n, visible, [&](const uint i, const uint end) {return boxMask(frustum, boxes, i, end);});
+}
+
+void setDrawArguments(Buffer indirect, const Mesh mesh, const uint nbInstances) {
+    if (getIndexBuffer(mesh).impl) {
+        // indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
+        const uint arguments[5] = {getNbIndices(mesh), nbInstances, 0, 0, 0};
+        setBufferData(indirect, arguments, sizeof(arguments));
+    } else {
+        // vertexCount, instanceCount, firstVertex, firstInstance
+        const uint arguments[4] = {getNbVertices(mesh), nbInstances, 0, 0};
+        setBufferData(indirect, arguments, sizeof(arguments));
+    }
+}
+
+}
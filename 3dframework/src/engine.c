@@ -1,9 +1,12 @@
 #include <engine.h>
 #include "private_log.h"
+#include "private_shader.h"
+#include "private_simulation.h"
 #define CIMGUI_DEFINE_ENUMS_AND_STRUCTS
 #include <cimgui/cimgui.h>
 #include <SDL2/SDL_image.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 //#include <SDL2/SDL_syswm.h>
 //#include <windows.h>
@@ -15,7 +18,7 @@ static UserDrawGuiFunc userDrawGui = NULL;
 static char appName[64], customTitle[128] = "";
 static uint t0, t, animt = 0, nbFrames = 0;
 static float dt = 0.0f, fps = 1000.0f;
-static bool paused = false, screenshotRequested = false;
+static bool paused = false, screenshotRequested = false, memoryOverlay = false;
 static char requestedScreenshotName[256];
 
 static Texture imguiFont;
@@ -85,10 +88,10 @@ static void initImgui() {
     }
 
     imguiMesh = createMesh(PrimitiveType_Triangles);
-    setMeshIndices16(imguiMesh, NULL, 1 << 16);
-    addMeshAttrib(imguiMesh, RG32_FLOAT , false, NULL, 1 << 16);
-    addMeshAttrib(imguiMesh, RG32_FLOAT , false, NULL, 1 << 16);
-    addMeshAttrib(imguiMesh, RGBA8_UNORM, false, NULL, 1 << 16);
+    setMeshDynamicIndices16(imguiMesh, 1 << 16);
+    addMeshDynamicAttrib(imguiMesh, RG32_FLOAT , false, 1 << 16);
+    addMeshDynamicAttrib(imguiMesh, RG32_FLOAT , false, 1 << 16);
+    addMeshDynamicAttrib(imguiMesh, RGBA8_UNORM, false, 1 << 16);
 
     static const uint vertSrc[] = {
         #include "imgui.vert.spv"
@@ -129,6 +132,8 @@ Application initApplication(const char *title, const int width, const int height
 
 void deleteApplication(Application *app) {
     UNUSED(app);
+    setSimulationFunc(NULL, 0, 0, NULL);
+    setShaderHotReload(false);
     closeImgui();
     deleteContext();
 }
@@ -146,11 +151,70 @@ static bool processEvents() {
     return finished;
 }
 
+static void drawMemoryOverlay() {
+    igSetNextWindowPos((ImVec2){10.0f, 10.0f}, ImGuiCond_FirstUseEver, (ImVec2){0.0f, 0.0f});
+    igBegin("GPU memory", &memoryOverlay, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing);
+    for (uint i = 0; i < MemoryCategory_Count; i++)
+        igText("%-24s %6llu MB", getMemoryCategoryName(i), getMemoryUsage(i) >> 20);
+    igSeparator();
+    igText("%-24s %6llu MB", "Total", getTotalMemoryUsage() >> 20);
+
+    if (memoryBudgetSupported()) {
+        for (uint i = 0; i < getNbMemoryHeaps(); i++) {
+            const MemoryHeap heap = getMemoryHeap(i);
+            const float ratio = heap.budget ? (float)heap.usage / (float)heap.budget : 0.0f;
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%llu / %llu MB", heap.usage >> 20, heap.budget >> 20);
+            ratio > 0.9f ?
+                igTextColored((ImVec4){1.0f, 0.3f, 0.3f, 1.0f}, "Heap %u (%s), near budget", i, heap.deviceLocal ? "device" : "host") :
+                igText("Heap %u (%s)", i, heap.deviceLocal ? "device" : "host");
+            igProgressBar(ratio, (ImVec2){-1.0f, 0.0f}, overlay);
+        }
+    } else
+        igText("%-24s %6llu MB", "Device local", getDeviceLocalBudget() >> 20);
+
+    igSeparator();
+    igText("%-24s %6u", "Pipelines", getNbPipelines());
+    igText("%-24s %6u", "Saved by dynamic states", getNbPipelinesSavedByDynamicStates());
+    igEnd();
+}
+
+static void drawShaderErrorOverlay() {
+    const ImGuiIO *io = igGetIO();
+    igSetNextWindowPos((ImVec2){io->DisplaySize.x * 0.5f, io->DisplaySize.y - 10.0f}, ImGuiCond_Always, (ImVec2){0.5f, 1.0f});
+    igBegin("Shader errors", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoSavedSettings);
+    igTextColored((ImVec4){1.0f, 0.3f, 0.3f, 1.0f}, "%s", getShaderReloadError());
+    igEnd();
+}
+
+static void checkMemoryBudget() {
+    static bool nearBudget = false;
+    static uint frame = 0;
+    if (!memoryBudgetSupported() || frame++ % 64 != 0)
+        return;
+
+    ulong usage = 0, budget = 0;
+    for (uint i = 0; i < getNbMemoryHeaps(); i++) {
+        const MemoryHeap heap = getMemoryHeap(i);
+        if (heap.deviceLocal) {
+            usage += heap.usage;
+            budget += heap.budget;
+        }
+    }
+
+    // Hysteresis so that an application hovering around the limit doesn't flood the log
+    if (!nearBudget && usage > budget / 10 * 9)
+        logWarning("GPU memory usage near budget: %llu / %llu MB", usage >> 20, budget >> 20);
+    nearBudget = nearBudget ? usage > budget / 10 * 8 : usage > budget / 10 * 9;
+}
+
 static void drawGui() {
     igGetIO()->DisplaySize.x = getWidth();
     igGetIO()->DisplaySize.y = getHeight();
     igNewFrame();
-    userDrawGui();
+    if (userDrawGui) userDrawGui();
+    if (memoryOverlay) drawMemoryOverlay();
+    if (getShaderReloadError()) drawShaderErrorOverlay();
     igEndFrame();
     igRender();
 
@@ -161,9 +225,10 @@ static void drawGui() {
                 return;
 
             int vtxOffset = 0, idxOffset = 0;
-            ImDrawIdx gpuIndices[1 << 16];
-            ImVec2 gpuVertices[1 << 16], gpuTexCoords[1 << 16];
-            ImU32 gpuColors[1 << 16];
+            ImDrawIdx *gpuIndices   = beginDynamicWrite(getIndexBuffer (imguiMesh   ));
+            ImVec2    *gpuVertices  = beginDynamicWrite(getAttribBuffer(imguiMesh, 0));
+            ImVec2    *gpuTexCoords = beginDynamicWrite(getAttribBuffer(imguiMesh, 1));
+            ImU32     *gpuColors    = beginDynamicWrite(getAttribBuffer(imguiMesh, 2));
             for (int i = 0; i < drawData->CmdListsCount; i++) {
                 const ImDrawList *cmdList = drawData->CmdLists[i];
                 memcpy(&gpuIndices[idxOffset], cmdList->IdxBuffer.Data, cmdList->IdxBuffer.Size * sizeof(ImDrawIdx));
@@ -179,10 +244,10 @@ static void drawGui() {
                 vtxOffset += cmdList->VtxBuffer.Size;
             }
 
-            setBufferData(getIndexBuffer (imguiMesh   ), gpuIndices  , idxOffset * sizeof(ImDrawIdx));
-            setBufferData(getAttribBuffer(imguiMesh, 0), gpuVertices , vtxOffset * sizeof(ImVec2   ));
-            setBufferData(getAttribBuffer(imguiMesh, 1), gpuTexCoords, vtxOffset * sizeof(ImVec2   ));
-            setBufferData(getAttribBuffer(imguiMesh, 2), gpuColors   , vtxOffset * sizeof(ImU32    ));
+            endDynamicWrite(getIndexBuffer (imguiMesh   ), idxOffset * sizeof(ImDrawIdx));
+            endDynamicWrite(getAttribBuffer(imguiMesh, 0), vtxOffset * sizeof(ImVec2   ));
+            endDynamicWrite(getAttribBuffer(imguiMesh, 1), vtxOffset * sizeof(ImVec2   ));
+            endDynamicWrite(getAttribBuffer(imguiMesh, 2), vtxOffset * sizeof(ImU32    ));
         }
         {   // Draw UI
             resetRenderState();
@@ -238,20 +303,31 @@ static void updateCounters() {
     }
 }
 
+typedef struct {
+    uint width, height;
+    char filename[256];
+} Screenshot;
+
+static void writeScreenshot(const void *pixels, const uint rowPitch, void *userData) {
+    Screenshot *screenshot = (Screenshot*)userData;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom((void*)pixels, screenshot->width, screenshot->height, 32, rowPitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    IMG_SavePNG(surface, screenshot->filename);
+    SDL_FreeSurface(surface);
+    free(screenshot);
+}
+
 static void saveScreen(const char *filename) {
     if (swapchainFormat() != BGRA8_UNORM && swapchainFormat() != SBGRA8_UNORM) {
         logError("Can't save screen. Swapchain format unsupported.");
         return;
     }
 
-    SCOPED(Texture) tex = createTexture2D(getWidth(), getHeight(), swapchainFormat(), 0);
-    copyTexture(tex, getSwapchainTexture()); // TODO: it shouldn't work for sRGB swapchain
-    void *pixels = mapTexture(tex);
-    flush(); waitGPUIdle();
-    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(pixels, getWidth(), getHeight(), 32, 4 * getWidth(), 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
-    IMG_SavePNG(surface, filename);
-    SDL_FreeSurface(surface);
-    unmapTexture(tex);
+    Screenshot *screenshot = malloc(sizeof(Screenshot));
+    screenshot->width = getWidth();
+    screenshot->height = getHeight();
+    strncpy(screenshot->filename, filename, sizeof(screenshot->filename) - 1);
+    screenshot->filename[sizeof(screenshot->filename) - 1] = '\0';
+    requestTextureReadback(getSwapchainTexture(), 0, 0, writeScreenshot, screenshot); // TODO: it shouldn't work for sRGB swapchain
 }
 
 void launchApplication(UserDrawFunc drawFunc, UserEventsFunc eventsFunc, UserDrawGuiFunc drawGuiFunc) {
@@ -263,10 +339,12 @@ void launchApplication(UserDrawFunc drawFunc, UserEventsFunc eventsFunc, UserDra
     flushEvents();
     flushAndGarbageCollect();
 
+    startSimulation();
     bool finished = false;
     while (!finished) {
         endFrame();
         beginFrame();
+        applyShaderReloads();
 
         finished = processEvents();
         updateCounters();
@@ -274,6 +352,7 @@ void launchApplication(UserDrawFunc drawFunc, UserEventsFunc eventsFunc, UserDra
         setLogActive(firstFrame);
         if (userDrawFrame) {
             resetRenderState();
+            acquireSimulationStates();
             userDrawFrame();
         }
 
@@ -283,11 +362,13 @@ void launchApplication(UserDrawFunc drawFunc, UserEventsFunc eventsFunc, UserDra
         }
         setLogActive(true);
 
-        if (userDrawGui) drawGui();
+        checkMemoryBudget();
+        if (userDrawGui || memoryOverlay || getShaderReloadError()) drawGui();
 
         firstFrame = false;
     }
 
+    stopSimulation();
     endFrame();
     waitGPUIdle();
 }
@@ -305,6 +386,8 @@ void takeScreenshot(const char *filename) {
     strncpy(requestedScreenshotName, filename, 255);
 }
 
+void showMemoryOverlay(const bool show) {memoryOverlay = show;}
+
 uint getAppTime()   {return t;                   }
 uint getAnimTime()  {return animt;               }
 uint getFrameTime() {return dt;                  }
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/stat.h>
+#include "private_file_watcher.h"
+#include "private_log.h"
+#ifdef __linux__
+    #include <poll.h>
+    #include <stdlib.h>
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+struct FileWatcher {
+    std::unordered_set<std::string> files;
+#ifdef __linux__
+    int inotify;
+    std::unordered_map<std::string, int> directories; // canonical paths, spellings of a directory share its watch
+    std::unordered_map<int, std::string> watches;
+    std::unordered_map<std::string, std::vector<std::string>> spellings; // canonical path -> watched files
+#else
+    std::unordered_map<std::string, time_t> modificationTimes;
+#endif
+};
+
+#ifdef __linux__
+// Ends with a slash, empty when the directory doesn't exist
+static std::string getCanonicalDirectory(const std::string &filename) {
+    const size_t slash = filename.find_last_of("/\\");
+    char *path = realpath(slash == std::string::npos ? "." : filename.substr(0, slash + 1).c_str(), nullptr);
+    if (!path)
+        return std::string();
+
+    std::string directory = path;
+    free(path);
+    if (directory.back() != '/')
+        directory += '/';
+    return directory;
+}
+#else
+static time_t getModificationTime(const std::string &filename) {
+    struct stat info;
+    return stat(filename.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+#endif
+
+FileWatcher* createFileWatcher() {
+    FileWatcher *watcher = new FileWatcher();
+#ifdef __linux__
+    if ((watcher->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+        logError("Can't watch files, inotify unavailable");
+        delete watcher;
+        return nullptr;
+    }
+#endif
+    return watcher;
+}
+
+void deleteFileWatcher(FileWatcher *watcher) {
+    if (!watcher)
+        return;
+
+#ifdef __linux__
+    close(watcher->inotify);
+#endif
+    delete watcher;
+}
+
+void watchFile(FileWatcher *watcher, const std::string &filename) {
+    if (!watcher || !watcher->files.insert(filename).second)
+        return;
+
+#ifdef __linux__
+    // Editors often replace the file instead of writing it, so its directory is watched
+    const std::string directory = getCanonicalDirectory(filename);
+    if (directory.empty()) {
+        logWarning("Can't watch the directory of \"%s\"", filename.c_str());
+        return;
+    }
+
+    const size_t slash = filename.find_last_of("/\\");
+    watcher->spellings[directory + filename.substr(slash == std::string::npos ? 0 : slash + 1)].push_back(filename);
+    if (watcher->directories.count(directory))
+        return;
+
+    const int watch = inotify_add_watch(watcher->inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watch < 0) {
+        logWarning("Can't watch the directory of \"%s\"", filename.c_str());
+        return;
+    }
+
+    watcher->directories[directory] = watch;
+    watcher->watches[watch] = directory;
+#else
+    watcher->modificationTimes[filename] = getModificationTime(filename);
+#endif
+}
+
+std::vector<std::string> waitFileChanges(FileWatcher *watcher, const uint timeoutMs) {
+    std::vector<std::string> changes;
+    if (!watcher)
+        return changes;
+
+#ifdef __linux__
+    pollfd descriptor = {watcher->inotify, POLLIN, 0};
+    if (poll(&descriptor, 1, timeoutMs) <= 0)
+        return changes;
+
+    alignas(inotify_event) char buffer[4096];
+    ssize_t size;
+    while ((size = read(watcher->inotify, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + size; p += sizeof(inotify_event) + ((inotify_event*)p)->len) {
+            const inotify_event *event = (inotify_event*)p;
+            auto directory = watcher->watches.find(event->wd);
+            if (directory == watcher->watches.end() || event->len == 0)
+                continue;
+
+            auto files = watcher->spellings.find(directory->second + event->name);
+            if (files == watcher->spellings.end())
+                continue;
+
+            for (const std::string &filename : files->second)
+                if (std::find(changes.begin(), changes.end(), filename) == changes.end())
+                    changes.push_back(filename);
+        }
+    }
+#else
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    do {
+        for (auto &file : watcher->modificationTimes) {
+            const time_t time = getModificationTime(file.first);
+            if (time != file.second) {
+                file.second = time;
+                changes.push_back(file.first);
+            }
+        }
+        if (changes.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(MIN(timeoutMs, 100u)));
+    } while (changes.empty() && std::chrono::steady_clock::now() < deadline);
+#endif
+
+    return changes;
+}
@@ -13,12 +13,14 @@ Framebuffer createFramebuffer(Texture *colors, const uint nbColors, Texture dept
 Framebuffer createFramebufferMip(Texture *colors, const uint nbColors, Texture depth, const uint mip) {
     nvrhi::FramebufferDesc framebufferDesc = nvrhi::FramebufferDesc();
     for (uint i = 0; i < nbColors; i++) {
+        if (mip == 0) setTextureMemoryCategory(colors[i], MemoryCategory_RenderTargets);
         nvrhi::FramebufferAttachment attachment = nvrhi::FramebufferAttachment()
             .setTexture(getNvTexture(colors[i]))
             .setMipLevel(mip).setArraySliceRange(0, getNvTexture(colors[i])->getDesc().arraySize);
         framebufferDesc.addColorAttachment(attachment);
     }
     if (getNvTexture(depth)) {
+        if (mip == 0) setTextureMemoryCategory(depth, MemoryCategory_RenderTargets);
         nvrhi::FramebufferAttachment attachment = nvrhi::FramebufferAttachment()
             .setTexture(getNvTexture(depth))
             .setMipLevel(mip).setArraySliceRange(0, getNvTexture(depth)->getDesc().arraySize);
@@ -64,6 +66,10 @@ void useFramebuffer(Framebuffer fb) {
 
 }
 
+Framebuffer getUsedFramebuffer() {
+    return Framebuffer{current};
+}
+
 nvrhi::IFramebuffer* getCurrentFramebuffer() {
     if (!current)
         return nullptr;
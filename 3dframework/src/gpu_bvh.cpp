@@ -0,0 +1,161 @@
+#include <gpu_bvh.h>
+#include "private_impl.h"
+#include "private_log.h"
+
+// Must match shaders/lbvh.comp
+#define LBVH_GROUP_SIZE 256
+#define LBVH_RADIX_BITS 4
+enum {
+    LbvhPass_Triangles,
+    LbvhPass_Morton,
+    LbvhPass_Histogram,
+    LbvhPass_Scan,
+    LbvhPass_Scatter,
+    LbvhPass_Hierarchy,
+    LbvhPass_Bounds,
+};
+
+typedef struct {
+    Buffer nodes, triangles;
+    Buffer keys, values, histogram, parents, state; // kept for the rebuilds
+    uint nbTriangles, nbGroups;
+} GpuBvhImpl;
+
+static GpuBvhImpl* getGpuBvh(GpuBvh bvh) {return (GpuBvhImpl*)bvh.impl;}
+
+static uint getNbTriangles(MeshImpl *meshimpl) {
+    return (meshimpl->indices.impl ? meshimpl->nbIndices : meshimpl->nbVertices) / 3;
+}
+
+static bool checkMesh(MeshImpl *meshimpl) {
+    if (!meshimpl || meshimpl->attributes.empty() || meshimpl->primitiveType != PrimitiveType_Triangles || getNbTriangles(meshimpl) == 0) {
+        logError("Building a GPU BVH from an invalid or non triangle list mesh");
+        return false;
+    }
+
+    const nvrhi::Format format = meshimpl->attributes[0].format;
+    if (format != nvrhi::Format::RG32_FLOAT && format != nvrhi::Format::RGB32_FLOAT && format != nvrhi::Format::RGBA32_FLOAT) {
+        logError("Unsupported vertex format for a GPU BVH: %s", nvrhi::getFormatInfo(format).name);
+        return false;
+    }
+
+    return true;
+}
+
+static void dispatchPass(const uint pass, const uint nbThreads) {
+    setUniform1i(pass, "Pass");
+    dispatch1D(nbThreads);
+}
+
+static void buildGpuBvh(GpuBvhImpl *impl, Shader builder, MeshImpl *meshimpl) {
+    // Centroid bounds start empty in the order preserving encoding of the shader
+    const uint initialBounds[6] = {~0u, ~0u, ~0u, 0, 0, 0};
+    setBufferData(impl->state, initialBounds, sizeof(initialBounds));
+
+    const nvrhi::Format vertexFormat = meshimpl->attributes[0].format;
+    useShader(builder);
+    setUniformBuffer(meshimpl->buffers[0], "LbvhVertices");
+    setUniformBuffer(meshimpl->indices.impl ? meshimpl->indices : meshimpl->buffers[0], "LbvhIndices");
+    setUniformBuffer(impl->nodes, "BvhNodes");
+    setUniformBuffer(impl->triangles, "BvhTriangles");
+    setUniformBuffer(impl->keys, "LbvhKeys");
+    setUniformBuffer(impl->values, "LbvhValues");
+    setUniformBuffer(impl->histogram, "LbvhHistogram");
+    setUniformBuffer(impl->parents, "LbvhParents");
+    setUniformBuffer(impl->state, "LbvhState");
+    setUniform1i(impl->nbTriangles, "NbTriangles");
+    setUniform1i(impl->nbGroups, "NbGroups");
+    setUniform1i(getFormatInfo((Format)vertexFormat).size / sizeof(float), "VertexStride");
+    setUniform1i(vertexFormat == nvrhi::Format::RG32_FLOAT ? 2 : 3, "VertexComponents");
+    setUniform1i(!meshimpl->indices.impl ? 0 : meshimpl->indicesFormat == nvrhi::Format::R16_UINT ? 2 : 4, "IndexSize");
+    setGroupSize1D(LBVH_GROUP_SIZE);
+
+    dispatchPass(LbvhPass_Triangles, impl->nbTriangles);
+    dispatchPass(LbvhPass_Morton, impl->nbTriangles);
+
+    // LSD radix sort of the 30 bits Morton codes, ping-ponging between the two halves of the keys
+    for (uint shift = 0; shift < 32; shift += LBVH_RADIX_BITS) {
+        setUniform1i(shift, "Shift");
+        setUniform1i((shift / LBVH_RADIX_BITS) & 1, "SortSource");
+        dispatchPass(LbvhPass_Histogram, impl->nbTriangles);
+        dispatchPass(LbvhPass_Scan, LBVH_GROUP_SIZE);
+        dispatchPass(LbvhPass_Scatter, impl->nbTriangles);
+    }
+
+    dispatchPass(LbvhPass_Hierarchy, impl->nbTriangles);
+    dispatchPass(LbvhPass_Bounds, impl->nbTriangles);
+}
+
+extern "C" {
+
+GpuBvh createGpuBvh(Shader builder, const Mesh mesh) {
+    MeshImpl *meshimpl = getMesh(mesh);
+    if (!builder.impl || !checkMesh(meshimpl))
+        return GpuBvh{nullptr};
+
+    GpuBvhImpl *impl = new GpuBvhImpl();
+    impl->nbTriangles = getNbTriangles(meshimpl);
+    impl->nbGroups = (impl->nbTriangles + LBVH_GROUP_SIZE - 1) / LBVH_GROUP_SIZE;
+
+    const uint n = impl->nbTriangles;
+    impl->nodes     = createBuffer(ResourceType_UnorderedAccess, (2 * n - 1) * 8 * sizeof(float));
+    impl->triangles = createBuffer(ResourceType_UnorderedAccess, n * 12 * sizeof(float));
+    impl->keys      = createBuffer(ResourceType_UnorderedAccess, 2 * n * sizeof(uint));
+    impl->values    = createBuffer(ResourceType_UnorderedAccess, 2 * n * sizeof(uint));
+    impl->histogram = createBuffer(ResourceType_UnorderedAccess, (1 << LBVH_RADIX_BITS) * impl->nbGroups * sizeof(uint));
+    impl->parents   = createBuffer(ResourceType_UnorderedAccess, (2 * n - 1) * sizeof(uint));
+    impl->state     = createBuffer(ResourceType_UnorderedAccess, (6 + n) * sizeof(uint));
+
+    GpuBvh bvh = {impl};
+    if (!impl->nodes.impl || !impl->triangles.impl || !impl->keys.impl || !impl->values.impl ||
+        !impl->histogram.impl || !impl->parents.impl || !impl->state.impl) {
+        deleteGpuBvh(&bvh);
+        return GpuBvh{nullptr};
+    }
+
+    buildGpuBvh(impl, builder, meshimpl);
+    return bvh;
+}
+
+void rebuildGpuBvh(GpuBvh bvh, Shader builder, const Mesh mesh) {
+    GpuBvhImpl *impl = getGpuBvh(bvh);
+    MeshImpl *meshimpl = getMesh(mesh);
+    if (!impl || !builder.impl || !checkMesh(meshimpl))
+        return;
+
+    if (getNbTriangles(meshimpl) != impl->nbTriangles) {
+        logError("Rebuilding a GPU BVH of %u triangles with a mesh of %u triangles", impl->nbTriangles, getNbTriangles(meshimpl));
+        return;
+    }
+
+    buildGpuBvh(impl, builder, meshimpl);
+}
+
+void deleteGpuBvh(GpuBvh *bvh) {
+    if (!bvh || !bvh->impl)
+        return;
+
+    GpuBvhImpl *impl = getGpuBvh(*bvh);
+    deleteBuffer(&impl->nodes);
+    deleteBuffer(&impl->triangles);
+    deleteBuffer(&impl->keys);
+    deleteBuffer(&impl->values);
+    deleteBuffer(&impl->histogram);
+    deleteBuffer(&impl->parents);
+    deleteBuffer(&impl->state);
+    delete impl;
+    bvh->impl = nullptr;
+}
+
+void setUniformGpuBvh(GpuBvh bvh) {
+    GpuBvhImpl *impl = getGpuBvh(bvh);
+    if (!impl) {
+        logWarning("Setting an invalid GPU BVH");
+        return;
+    }
+
+    setUniformBuffer(impl->nodes, "BvhNodes");
+    setUniformBuffer(impl->triangles, "BvhTriangles");
+}
+
+}
@@ -0,0 +1,215 @@
+#include <gpu_culling.h>
+#include "private_impl.h"
+#include "private_log.h"
+
+// Must match shaders/gpu_culling.comp and shaders/hiz.comp
+#define CULLING_GROUP_SIZE 64
+#define HIZ_GROUP_SIZE 8
+enum {
+    CullingPhase_First,
+    CullingPhase_Second,
+};
+
+typedef struct {
+    Buffer arguments[2], instances, flags;
+    Buffer bounds;
+    Texture pyramid;
+    uint pyramidWidth, pyramidHeight, pyramidLevels;
+    uint depthWidth, depthHeight;
+    uint maxInstances, nbInstances;
+    Mat4 viewProjection, pyramidViewProjection;
+    bool hasPyramid;
+} GpuCullerImpl;
+
+static GpuCullerImpl* getGpuCuller(GpuCuller culler) {return (GpuCullerImpl*)culler.impl;}
+
+static uint previousPowerOf2(const uint x) {
+    return x ? 1u << (31 - __builtin_clz(x)) : 1;
+}
+
+static bool createPyramid(GpuCullerImpl *impl, const uint depthWidth, const uint depthHeight) {
+    deleteTexture(&impl->pyramid);
+    impl->depthWidth = depthWidth;
+    impl->depthHeight = depthHeight;
+    impl->pyramidWidth = previousPowerOf2(depthWidth);
+    impl->pyramidHeight = previousPowerOf2(depthHeight);
+    impl->pyramidLevels = 32 - __builtin_clz(MAX(impl->pyramidWidth, impl->pyramidHeight));
+    impl->hasPyramid = false;
+
+    impl->pyramid = createTexture2D(impl->pyramidWidth, impl->pyramidHeight, R32_FLOAT, MIPMAPS_FLAG);
+    if (!impl->pyramid.impl)
+        return false;
+
+    // Bilinear footprints of the downsampling return the farthest of their 4 texels
+    SamplerState *sampler = getSampler(impl->pyramid);
+    sampler->minFilter = sampler->magFilter = true;
+    sampler->mipFilter = false;
+    sampler->wrapU = sampler->wrapV = WrapMode_Clamp;
+    sampler->filterFunc = FilterFunc_Minimum;
+    return true;
+}
+
+static void resetDrawArguments(GpuCullerImpl *impl, MeshImpl *meshimpl) {
+    // The second phase writes its instances after the room of the first one
+    for (uint phase = 0; phase < 2; phase++) {
+        const uint firstInstance = phase * impl->maxInstances;
+        if (meshimpl->indices.impl) {
+            // indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
+            const uint arguments[5] = {meshimpl->nbIndices, 0, 0, 0, firstInstance};
+            setBufferData(impl->arguments[phase], arguments, sizeof(arguments));
+        } else {
+            // vertexCount, instanceCount, firstVertex, firstInstance
+            const uint arguments[4] = {meshimpl->nbVertices, 0, 0, firstInstance};
+            setBufferData(impl->arguments[phase], arguments, sizeof(arguments));
+        }
+    }
+}
+
+static void dispatchCulling(GpuCullerImpl *impl, Shader cullShader, const uint phase) {
+    useShader(cullShader);
+    setUniformBuffer(impl->bounds, "CullBounds");
+    setUniformBuffer(impl->flags, "CullFlags");
+    setUniformBuffer(impl->arguments[phase], "CullArgs");
+    setUniformBuffer(impl->instances, "CulledInstances");
+    setUniformTexture(impl->pyramid, "DepthPyramid");
+    setUniformMat4(impl->viewProjection, "ViewProjection");
+    setUniformMat4(impl->pyramidViewProjection, "PyramidViewProjection");
+    setUniform2f(impl->pyramidWidth, impl->pyramidHeight, "PyramidSize");
+    setUniform1i(impl->pyramidLevels, "PyramidLevels");
+    setUniform1i(phase, "Phase");
+    setUniform1i(impl->nbInstances, "NbInstances");
+    setUniform1i(phase * impl->maxInstances, "InstanceOffset");
+    setUniform1i(impl->hasPyramid, "HasPyramid");
+    setGroupSize1D(CULLING_GROUP_SIZE);
+    dispatch1D(impl->nbInstances);
+}
+
+extern "C" {
+
+GpuCuller createGpuCuller(const uint maxInstances, const uint depthWidth, const uint depthHeight) {
+    if (maxInstances == 0 || depthWidth == 0 || depthHeight == 0) {
+        logError("Creating a GPU culler of %u instances for a %ux%u depth buffer", maxInstances, depthWidth, depthHeight);
+        return GpuCuller{nullptr};
+    }
+
+    GpuCullerImpl *impl = new GpuCullerImpl();
+    impl->maxInstances = maxInstances;
+    impl->arguments[0] = createBuffer(ResourceType_IndirectArgument, 5 * sizeof(uint));
+    impl->arguments[1] = createBuffer(ResourceType_IndirectArgument, 5 * sizeof(uint));
+    impl->instances    = createBuffer(ResourceType_UnorderedAccess, 2 * maxInstances * sizeof(uint));
+    impl->flags        = createBuffer(ResourceType_UnorderedAccess, maxInstances * sizeof(uint));
+
+    GpuCuller culler = {impl};
+    if (!impl->arguments[0].impl || !impl->arguments[1].impl || !impl->instances.impl || !impl->flags.impl ||
+        !createPyramid(impl, depthWidth, depthHeight)) {
+        deleteGpuCuller(&culler);
+        return GpuCuller{nullptr};
+    }
+
+    return culler;
+}
+
+void deleteGpuCuller(GpuCuller *culler) {
+    if (!culler || !culler->impl)
+        return;
+
+    GpuCullerImpl *impl = getGpuCuller(*culler);
+    deleteBuffer(&impl->arguments[0]);
+    deleteBuffer(&impl->arguments[1]);
+    deleteBuffer(&impl->instances);
+    deleteBuffer(&impl->flags);
+    deleteTexture(&impl->pyramid);
+    delete impl;
+    culler->impl = nullptr;
+}
+
+void cullFirstPhase(GpuCuller culler, Shader cullShader, const Mesh mesh, Buffer bounds, const uint nbInstances, Mat4 viewProjection) {
+    GpuCullerImpl *impl = getGpuCuller(culler);
+    MeshImpl *meshimpl = getMesh(mesh);
+    if (!impl || !cullShader.impl || !meshimpl || !bounds.impl)
+        return;
+
+    if (nbInstances > impl->maxInstances) {
+        logError("Culling %u instances with a GPU culler of %u instances", nbInstances, impl->maxInstances);
+        return;
+    }
+
+    impl->bounds = bounds;
+    impl->nbInstances = nbInstances;
+    copym4(impl->viewProjection, viewProjection);
+    resetDrawArguments(impl, meshimpl);
+    if (nbInstances)
+        dispatchCulling(impl, cullShader, CullingPhase_First);
+}
+
+void updateDepthPyramid(GpuCuller culler, Shader pyramidShader, Texture depth) {
+    GpuCullerImpl *impl = getGpuCuller(culler);
+    TextureImpl *depthimpl = (TextureImpl*)depth.impl;
+    if (!impl || !pyramidShader.impl || !depthimpl)
+        return;
+
+    if (depthimpl->desc.dimension != nvrhi::TextureDimension::Texture2D) {
+        logError("The depth pyramid needs a single sampled 2D depth buffer");
+        return;
+    }
+
+    if ((depthimpl->desc.width != impl->depthWidth || depthimpl->desc.height != impl->depthHeight) &&
+        !createPyramid(impl, depthimpl->desc.width, depthimpl->desc.height))
+        return;
+
+    useShader(pyramidShader);
+    setGroupSize2D(HIZ_GROUP_SIZE, HIZ_GROUP_SIZE);
+    for (uint level = 0; level < impl->pyramidLevels; level++) {
+        const uint width = MAX(impl->pyramidWidth >> level, 1u), height = MAX(impl->pyramidHeight >> level, 1u);
+        if (level == 0)
+            setUniformTexture(depth, "HizSource");
+        else
+            setUniformTextureMip(impl->pyramid, level - 1, "HizSource");
+        setUniformTextureMip(impl->pyramid, level, "HizLevel");
+        setUniform1i(level, "Level");
+        setUniform2i(width, height, "LevelSize");
+        dispatch2D(width, height);
+    }
+
+    // The next first phase reprojects the instances with the camera of this depth
+    copym4(impl->pyramidViewProjection, impl->viewProjection);
+    impl->hasPyramid = true;
+}
+
+void cullSecondPhase(GpuCuller culler, Shader cullShader) {
+    GpuCullerImpl *impl = getGpuCuller(culler);
+    if (!impl || !cullShader.impl || !impl->bounds.impl || !impl->nbInstances)
+        return;
+
+    if (!impl->hasPyramid) {
+        logWarning("Second culling phase without depth pyramid");
+        return;
+    }
+
+    dispatchCulling(impl, cullShader, CullingPhase_Second);
+}
+
+Buffer getCulledDrawArguments(GpuCuller culler, const uint phase) {
+    GpuCullerImpl *impl = getGpuCuller(culler);
+    if (!impl || phase > CullingPhase_Second)
+        return NullBuffer;
+
+    return impl->arguments[phase];
+}
+
+Texture getDepthPyramid(GpuCuller culler) {
+    GpuCullerImpl *impl = getGpuCuller(culler);
+    return impl ? impl->pyramid : NullTexture;
+}
+
+void setUniformCulledInstances(GpuCuller culler) {
+    GpuCullerImpl *impl = getGpuCuller(culler);
+    if (!impl) {
+        logWarning("Setting an invalid GPU culler");
+        return;
+    }
+
+    setUniformBuffer(impl->instances, "CulledInstances");
+}
+
+}
@@ -48,6 +48,7 @@ void setDefaultRenderState() {
     memset(&states.back().viewportState, 0, sizeof(ViewportState));
     memset(&states.back().scissorState, 0, sizeof(ViewportState));
     memcpy(&states.back().vrsState, &defaultVRS, sizeof(nvrhi::VariableRateShadingState));
+    states.back().pipelineMissPolicy = PipelineMiss_Block;
     states.back().viewportState.maxX = states.back().scissorState.maxX = getWidth();
     states.back().viewportState.maxY = states.back().scissorState.maxY = getHeight();
     states.back().viewportState.maxZ = 1.0f;
@@ -0,0 +1,291 @@
+#include <jobs.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "private_log.h"
+#include "private_parallel.h"
+
+#define JOB_QUEUE_SIZE 4096  // power of 2
+#define MAX_JOB_THREADS 256  // workers and other threads creating jobs
+#define IDLE_SPINS 64
+
+struct alignas(64) JobImpl {
+    JobFunction function;
+    void *data;
+    JobImpl *parent;
+    std::atomic<int> unfinished; // the job itself and its children
+};
+
+// Chase-Lev deque: the owner pushes and pops at the bottom, thieves take from the top
+typedef struct {
+    alignas(64) std::atomic<long long> top;
+    alignas(64) std::atomic<long long> bottom;
+    std::atomic<JobImpl*> jobs[JOB_QUEUE_SIZE];
+} JobQueue;
+
+typedef struct {
+    JobQueue queue;
+    JobImpl pool[JOB_POOL_SIZE];
+    uint nextJob, random;
+} JobThread;
+
+static std::atomic<JobThread*> jobThreads[MAX_JOB_THREADS];
+static std::atomic<uint> nbJobThreads(0);
+static std::mutex threadsMutex;
+static std::vector<uint> freeSlots; // of exited threads
+
+// Sleeping workers wake up when jobs are queued
+static std::mutex sleepMutex;
+static std::condition_variable sleepCondition;
+static std::atomic<int> nbQueued(0), nbSleeping(0);
+static std::atomic<bool> quitWorkers(false);
+
+static std::once_flag workersStarted;
+static struct Workers {
+    std::vector<std::thread> threads;
+    ~Workers() {
+        quitWorkers = true;
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCondition.notify_all();
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+} workers;
+
+static bool pushJob(JobQueue *queue, JobImpl *job) {
+    const long long bottom = queue->bottom.load(std::memory_order_relaxed), top = queue->top.load(std::memory_order_acquire);
+    if (bottom - top >= JOB_QUEUE_SIZE)
+        return false;
+
+    queue->jobs[bottom & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    queue->bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static JobImpl* popJob(JobQueue *queue) {
+    const long long bottom = queue->bottom.load(std::memory_order_relaxed) - 1;
+    queue->bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long top = queue->top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+        queue->bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    JobImpl *job = queue->jobs[bottom & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last job, the thieves may be taking it too
+        if (!queue->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        queue->bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+static JobImpl* stealJob(JobQueue *queue) {
+    long long top = queue->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const long long bottom = queue->bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+        return nullptr;
+
+    JobImpl *job = queue->jobs[top & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+    return queue->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed) ? job : nullptr;
+}
+
+// Threads get a queue on their first job, which goes back to the next ones when they exit
+static thread_local struct ThreadSlot {
+    JobThread *thread = nullptr;
+    uint index;
+    ~ThreadSlot() {
+        if (!thread) return;
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        freeSlots.push_back(index);
+    }
+} threadSlot;
+
+static void workerLoop();
+
+static void startWorkers() {
+    const uint nbWorkers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    for (uint i = 0; i < nbWorkers; i++)
+        workers.threads.emplace_back(workerLoop);
+}
+
+static JobThread* getJobThread() {
+    if (threadSlot.thread)
+        return threadSlot.thread;
+
+    std::call_once(workersStarted, startWorkers);
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    if (!freeSlots.empty()) {
+        threadSlot.index = freeSlots.back();
+        freeSlots.pop_back();
+        threadSlot.thread = jobThreads[threadSlot.index];
+        return threadSlot.thread;
+    }
+
+    const uint index = nbJobThreads;
+    if (index == MAX_JOB_THREADS) {
+        logError("More than %u threads creating jobs", MAX_JOB_THREADS);
+        abort();
+    }
+
+    JobThread *thread = new JobThread();
+    thread->random = index * 0x9E3779B9u + 1;
+    jobThreads[index] = thread;
+    nbJobThreads = index + 1;
+    threadSlot.index = index;
+    threadSlot.thread = thread;
+    return thread;
+}
+
+// Own queue first, then the others from a random one
+static JobImpl* findJob(JobThread *self) {
+    JobImpl *job = popJob(&self->queue);
+    if (!job) {
+        const uint n = nbJobThreads;
+        self->random ^= self->random << 13;
+        self->random ^= self->random >> 17;
+        self->random ^= self->random << 5;
+        for (uint i = 0, first = self->random % n; i < n && !job; i++) {
+            JobThread *victim = jobThreads[(first + i) % n];
+            if (victim && victim != self)
+                job = stealJob(&victim->queue);
+        }
+    }
+
+    if (job)
+        nbQueued--;
+    return job;
+}
+
+static void finishJob(JobImpl *job) {
+    JobImpl *parent = job->parent;
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent)
+        finishJob(parent);
+}
+
+static void executeJob(JobImpl *job) {
+    if (job->function)
+        job->function(job->data);
+    finishJob(job);
+}
+
+static void waitJobImpl(JobImpl *job) {
+    JobThread *self = getJobThread();
+    while (job->unfinished.load(std::memory_order_acquire) > 0) {
+        if (JobImpl *other = findJob(self))
+            executeJob(other);
+        else
+            std::this_thread::yield();
+    }
+}
+
+static void workerLoop() {
+    JobThread *self = getJobThread();
+    uint idle = 0;
+    while (!quitWorkers) {
+        if (JobImpl *job = findJob(self)) {
+            executeJob(job);
+            idle = 0;
+        } else if (++idle < IDLE_SPINS) {
+            std::this_thread::yield();
+        } else {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            nbSleeping++;
+            sleepCondition.wait(lock, []() {return nbQueued > 0 || quitWorkers;});
+            nbSleeping--;
+            idle = 0;
+        }
+    }
+}
+
+static JobImpl* allocateJob(JobFunction function, void *data, JobImpl *parent) {
+    JobThread *self = getJobThread();
+    JobImpl *job = &self->pool[self->nextJob++ & (JOB_POOL_SIZE - 1)];
+
+    // The ring skips the jobs still in flight, like the parents waiting for deep recursions
+    for (uint tries = 1; job->unfinished.load(std::memory_order_acquire) > 0; tries++) {
+        if (tries % JOB_POOL_SIZE == 0) {
+            if (tries == JOB_POOL_SIZE)
+                logPerfWarning("More than %u jobs in flight on a thread", JOB_POOL_SIZE);
+            if (JobImpl *other = findJob(self))
+                executeJob(other);
+            else
+                std::this_thread::yield();
+        }
+        job = &self->pool[self->nextJob++ & (JOB_POOL_SIZE - 1)];
+    }
+
+    job->function = function;
+    job->data = data;
+    job->parent = parent;
+    job->unfinished.store(1, std::memory_order_relaxed);
+    if (parent)
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+extern "C" {
+
+Job createJob(JobFunction function, void *data) {
+    return Job{allocateJob(function, data, nullptr)};
+}
+
+Job createChildJob(Job parent, JobFunction function, void *data) {
+    if (!parent.impl) {
+        logWarning("Creating the child of an invalid job");
+        return NullJob;
+    }
+
+    return Job{allocateJob(function, data, (JobImpl*)parent.impl)};
+}
+
+void runJob(Job job) {
+    JobImpl *impl = (JobImpl*)job.impl;
+    if (!impl)
+        return;
+
+    // Empty jobs only wait their children, a full queue runs the job right away
+    if (!impl->function) {
+        finishJob(impl);
+        return;
+    }
+
+    if (!pushJob(&getJobThread()->queue, impl)) {
+        executeJob(impl);
+        return;
+    }
+
+    nbQueued++;
+    if (nbSleeping > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCondition.notify_one();
+    }
+}
+
+void waitJob(Job job) {
+    if (job.impl)
+        waitJobImpl((JobImpl*)job.impl);
+}
+
+bool isJobDone(Job job) {
+    JobImpl *impl = (JobImpl*)job.impl;
+    return !impl || impl->unfinished.load(std::memory_order_acquire) == 0;
+}
+
+void runParallelFor(const uint count, const uint grain, JobRangeFunction function, void *data) {
+    parallelFor(count, grain, [&](const uint begin, const uint end) {function(data, begin, end);});
+}
+
+uint getNbJobWorkers() {
+    std::call_once(workersStarted, startWorkers);
+    return workers.threads.size() + 1;
+}
+
+}
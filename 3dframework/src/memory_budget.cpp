@@ -0,0 +1,76 @@
+#include <memory_budget.h>
+#include <nvrhi/vulkan.h>
+#include <vulkan/vulkan.h>
+#include "private_impl.h"
+
+static long long memoryUsage[MemoryCategory_Count] = {};
+
+extern "C" {
+
+ulong getMemoryUsage(const MemoryCategory category) {
+    if (category >= MemoryCategory_Count)
+        return 0;
+
+    const ulong usage = MAX(memoryUsage[category], 0ll);
+    return category == MemoryCategory_Staging ? usage + getVulkanDevice()->getUploadChunkMemory() : usage;
+}
+
+ulong getTotalMemoryUsage() {
+    ulong total = 0;
+    for (uint i = 0; i < MemoryCategory_Count; i++)
+        total += getMemoryUsage((MemoryCategory)i);
+    return total;
+}
+
+const char* getMemoryCategoryName(const MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory_Textures              : return "Textures";
+        case MemoryCategory_RenderTargets         : return "Render targets";
+        case MemoryCategory_Meshes                : return "Meshes";
+        case MemoryCategory_Buffers               : return "Buffers";
+        case MemoryCategory_AccelerationStructures: return "Acceleration structures";
+        case MemoryCategory_Staging               : return "Staging";
+        default                                   : return "Unknown";
+    }
+}
+
+uint getNbMemoryHeaps() {
+    VkPhysicalDeviceMemoryProperties properties;
+    vkGetPhysicalDeviceMemoryProperties((VkPhysicalDevice)getDevice()->getNativeObject(nvrhi::ObjectTypes::VK_PhysicalDevice).pointer, &properties);
+    return properties.memoryHeapCount;
+}
+
+MemoryHeap getMemoryHeap(const uint heap) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+    VkPhysicalDeviceMemoryProperties2 properties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+    if (memoryBudgetSupported()) properties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2((VkPhysicalDevice)getDevice()->getNativeObject(nvrhi::ObjectTypes::VK_PhysicalDevice).pointer, &properties);
+
+    if (heap >= properties.memoryProperties.memoryHeapCount)
+        return MemoryHeap{};
+
+    MemoryHeap result = {};
+    result.size = properties.memoryProperties.memoryHeaps[heap].size;
+    result.deviceLocal = (properties.memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    if (memoryBudgetSupported()) {
+        result.usage = budget.heapUsage[heap];
+        result.budget = budget.heapBudget[heap];
+    }
+    return result;
+}
+
+ulong getDeviceLocalBudget() {
+    ulong budget = 0;
+    for (uint i = 0; i < getNbMemoryHeaps(); i++) {
+        const MemoryHeap heap = getMemoryHeap(i);
+        if (heap.deviceLocal)
+            budget += heap.budget ? heap.budget : heap.size;
+    }
+    return budget;
+}
+
+}
+
+void trackMemory(const MemoryCategory category, const long long bytes) {
+    memoryUsage[category] += bytes;
+}
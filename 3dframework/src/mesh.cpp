@@ -40,26 +40,63 @@ void setMeshIndices16(Mesh mesh, const ushort *indices, const uint nbIndices) {
     impl->nbIndices = nbIndices;
     impl->indicesFormat = nvrhi::Format::R16_UINT;
 
+    // Rounded to whole 32-bit words for the shaders reading the indices two by two as storage buffers
     deleteBuffer(&impl->indices);
     if (nbIndices > 0) {
-        impl->indices = createBuffer(ResourceType_IndexBuffer, nbIndices * sizeof(ushort));
+        impl->indices = createBuffer(ResourceType_IndexBuffer, (nbIndices + 1) / 2 * sizeof(uint));
         if (indices) setBufferData(impl->indices, indices, nbIndices * sizeof(ushort));
     }
 }
 
-void addMeshAttrib(Mesh mesh, const Format format, const bool instanced, const void *data, const uint nbElems) {
-    MeshImpl *impl = getMesh(mesh);
-    impl->nbVertices = nbElems;
-    const uint elemSize = getFormatInfo(format).size;
+void setMeshIndicesCompact(Mesh mesh, const uint *indices, const uint nbIndices, const uint nbVertices) {
+    if (nbVertices > 65536 || !indices) {
+        setMeshIndices(mesh, indices, nbIndices);
+        return;
+    }
+
+    std::vector<ushort> indices16(indices, indices + nbIndices);
+    setMeshIndices16(mesh, indices16.data(), nbIndices);
+}
 
+static void addMeshAttribBuffer(MeshImpl *impl, const Format format, const bool instanced, const Buffer buffer, const uint nbElems) {
+    impl->nbVertices = nbElems;
     impl->attributes.push_back(nvrhi::VertexAttributeDesc()
-        .setFormat((nvrhi::Format)format).setElementStride(elemSize)
+        .setFormat((nvrhi::Format)format).setElementStride(getFormatInfo(format).size)
         .setIsInstanced(instanced)
         .setBufferIndex(impl->attributes.size()));
+    impl->buffers.push_back(buffer);
+}
 
+void addMeshAttrib(Mesh mesh, const Format format, const bool instanced, const void *data, const uint nbElems) {
+    const uint elemSize = getFormatInfo(format).size;
     Buffer buffer = createBuffer(ResourceType_VertexBuffer, nbElems * elemSize);
     if (data) setBufferData(buffer, data, nbElems * elemSize);
-    impl->buffers.push_back(buffer);
+    addMeshAttribBuffer(getMesh(mesh), format, instanced, buffer, nbElems);
+}
+
+void setMeshDynamicIndices(Mesh mesh, const uint maxIndices) {
+    MeshImpl *impl = getMesh(mesh);
+    impl->nbIndices = maxIndices;
+    impl->indicesFormat = nvrhi::Format::R32_UINT;
+
+    deleteBuffer(&impl->indices);
+    if (maxIndices > 0)
+        impl->indices = createDynamicBuffer(ResourceType_IndexBuffer, maxIndices * sizeof(uint));
+}
+
+void setMeshDynamicIndices16(Mesh mesh, const uint maxIndices) {
+    MeshImpl *impl = getMesh(mesh);
+    impl->nbIndices = maxIndices;
+    impl->indicesFormat = nvrhi::Format::R16_UINT;
+
+    deleteBuffer(&impl->indices);
+    if (maxIndices > 0)
+        impl->indices = createDynamicBuffer(ResourceType_IndexBuffer, (maxIndices + 1) / 2 * sizeof(uint));
+}
+
+void addMeshDynamicAttrib(Mesh mesh, const Format format, const bool instanced, const uint maxElems) {
+    Buffer buffer = createDynamicBuffer(ResourceType_VertexBuffer, maxElems * getFormatInfo(format).size);
+    addMeshAttribBuffer(getMesh(mesh), format, instanced, buffer, maxElems);
 }
 
 Buffer getIndexBuffer(Mesh mesh) {return getMesh(mesh)->indices;}
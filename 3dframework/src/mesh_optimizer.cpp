@@ -0,0 +1,323 @@
+#include <mesh_optimizer.h>
+#include <vector.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "private_log.h"
+
+#define VERTEX_CACHE_SIZE 16
+// Soft cluster boundaries are cut where the cache efficiency is back within 5% of the hard cluster
+#define OVERDRAW_THRESHOLD 1.05f
+
+typedef struct {
+    uint begin, end; // triangles
+    float order;
+} TriangleCluster;
+
+// FIFO cache with timestamps, a vertex is evicted after cacheSize later misses
+struct CacheSimulator {
+    std::vector<uint> timestamps;
+    uint time, cacheSize;
+
+    CacheSimulator(const uint nbVertices, const uint cacheSize) : timestamps(nbVertices, 0), time(cacheSize + 1), cacheSize(cacheSize) {}
+
+    bool isCached(const uint vertex) const {return time - timestamps[vertex] <= cacheSize;}
+    uint access(const uint vertex) {
+        if (isCached(vertex))
+            return 0;
+        timestamps[vertex] = time++;
+        return 1;
+    }
+    void reset() {time += cacheSize + 1;}
+};
+
+static Float4 loadPosition(const VertexStream &stream, const uint vertex) {
+    const float *p = (const float*)((const uchar*)stream.data + (ulong)vertex * stream.stride);
+    return float4(p[0], p[1], p[2], 0.0f);
+}
+
+static uint hashVertex(const VertexStream *streams, const uint nbStreams, const uint vertex) {
+    uint hash = 2166136261u;
+    for (uint i = 0; i < nbStreams; i++) {
+        const uchar *data = (const uchar*)streams[i].data + (ulong)vertex * streams[i].stride;
+        for (uint j = 0; j < streams[i].stride; j++)
+            hash = (hash ^ data[j]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool equalVertices(const VertexStream *streams, const uint nbStreams, const uint a, const uint b) {
+    for (uint i = 0; i < nbStreams; i++) {
+        const uchar *data = (const uchar*)streams[i].data;
+        if (memcmp(data + (ulong)a * streams[i].stride, data + (ulong)b * streams[i].stride, streams[i].stride))
+            return false;
+    }
+    return true;
+}
+
+// Indices of duplicated vertices are replaced by the first of them, in an open addressing table
+static void weldVertices(const VertexStream *streams, const uint nbStreams, const uint nbVertices, uint *indices, const uint nbIndices) {
+    std::vector<bool> referenced(nbVertices, false);
+    for (uint i = 0; i < nbIndices; i++)
+        referenced[indices[i]] = true;
+
+    uint tableSize = 1;
+    while (tableSize < nbVertices * 2)
+        tableSize *= 2;
+    std::vector<uint> table(tableSize, ~0u), canonical(nbVertices);
+    for (uint vertex = 0; vertex < nbVertices; vertex++) {
+        if (!referenced[vertex])
+            continue;
+
+        uint slot = hashVertex(streams, nbStreams, vertex) & (tableSize - 1);
+        while (table[slot] != ~0u && !equalVertices(streams, nbStreams, table[slot], vertex))
+            slot = (slot + 1) & (tableSize - 1);
+        if (table[slot] == ~0u)
+            table[slot] = vertex;
+        canonical[vertex] = table[slot];
+    }
+
+    for (uint i = 0; i < nbIndices; i++)
+        indices[i] = canonical[indices[i]];
+}
+
+// Tipsify (Sander et al. 2007): fans around the vertices that stay in the cache, hard cluster
+// boundaries are the dead ends where the next vertex isn't a neighbour of the previous fan
+static void tipsify(std::vector<uint> &output, std::vector<uint> &boundaries, const uint *indices, const uint nbIndices, const uint nbVertices) {
+    const uint nbTriangles = nbIndices / 3;
+    std::vector<uint> offsets(nbVertices + 1, 0), adjacency(nbIndices);
+    for (uint i = 0; i < nbIndices; i++)
+        offsets[indices[i] + 1]++;
+    for (uint i = 1; i <= nbVertices; i++)
+        offsets[i] += offsets[i - 1];
+    std::vector<uint> live(nbVertices), fill(offsets.begin(), offsets.end() - 1);
+    for (uint i = 0; i < nbVertices; i++)
+        live[i] = offsets[i + 1] - offsets[i];
+    for (uint i = 0; i < nbIndices; i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    std::vector<bool> emitted(nbTriangles, false);
+    std::vector<uint> timestamps(nbVertices, 0), deadEnds, candidates;
+    uint time = VERTEX_CACHE_SIZE + 1, cursor = 0;
+    output.clear();
+    output.reserve(nbIndices);
+
+    auto skipDeadEnd = [&]() {
+        while (!deadEnds.empty()) {
+            const uint vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[vertex] > 0)
+                return vertex;
+        }
+        while (cursor < nbVertices) {
+            if (live[cursor] > 0)
+                return cursor;
+            cursor++;
+        }
+        return ~0u;
+    };
+
+    uint fan = skipDeadEnd();
+    while (fan != ~0u) {
+        if (boundaries.empty() || boundaries.back() != output.size() / 3)
+            boundaries.push_back(output.size() / 3);
+
+        while (fan != ~0u) {
+            candidates.clear();
+            for (uint i = offsets[fan]; i < offsets[fan + 1]; i++) {
+                const uint triangle = adjacency[i];
+                if (emitted[triangle])
+                    continue;
+
+                emitted[triangle] = true;
+                for (uint j = 0; j < 3; j++) {
+                    const uint vertex = indices[triangle * 3 + j];
+                    output.push_back(vertex);
+                    deadEnds.push_back(vertex);
+                    candidates.push_back(vertex);
+                    live[vertex]--;
+                    if (time - timestamps[vertex] > VERTEX_CACHE_SIZE)
+                        timestamps[vertex] = time++;
+                }
+            }
+
+            // Most recent candidate that is still cached once its remaining triangles are emitted
+            uint next = ~0u;
+            int bestPriority = -1;
+            for (uint vertex : candidates) {
+                if (live[vertex] == 0)
+                    continue;
+
+                int priority = 0;
+                if (time - timestamps[vertex] + 2 * live[vertex] <= VERTEX_CACHE_SIZE)
+                    priority = time - timestamps[vertex];
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    next = vertex;
+                }
+            }
+            fan = next;
+        }
+
+        fan = skipDeadEnd();
+    }
+    boundaries.push_back(nbTriangles);
+}
+
+// Cuts the hard clusters where their cache efficiency is already reached, so there are more of
+// them to sort for a small cost in vertex shader invocations
+static void splitClusters(std::vector<TriangleCluster> &clusters, const std::vector<uint> &indices, const std::vector<uint> &boundaries, const uint nbVertices) {
+    CacheSimulator cache(nbVertices, VERTEX_CACHE_SIZE);
+    for (uint c = 0; c + 1 < boundaries.size(); c++) {
+        const uint begin = boundaries[c], end = boundaries[c + 1];
+        uint misses = 0;
+        cache.reset();
+        for (uint i = begin * 3; i < end * 3; i++)
+            misses += cache.access(indices[i]);
+        const float threshold = OVERDRAW_THRESHOLD * misses / (end - begin);
+
+        uint start = begin;
+        misses = 0;
+        cache.reset();
+        for (uint t = begin; t < end; t++) {
+            for (uint j = 0; j < 3; j++)
+                misses += cache.access(indices[t * 3 + j]);
+            if (t + 1 < end && misses <= threshold * (t + 1 - start)) {
+                clusters.push_back({start, t + 1, 0.0f});
+                start = t + 1;
+                misses = 0;
+                cache.reset();
+            }
+        }
+        clusters.push_back({start, end, 0.0f});
+    }
+}
+
+// Clusters facing away from the mesh center are drawn first, they are more likely to occlude the
+// others (Sander et al. 2007)
+static void sortClusters(std::vector<TriangleCluster> &clusters, const std::vector<uint> &indices, const VertexStream &positions) {
+    std::vector<Float4> centroids(clusters.size()), normals(clusters.size());
+    Float4 meshCentroid = float1(0.0f);
+    float meshArea = 0.0f;
+    for (uint c = 0; c < clusters.size(); c++) {
+        Float4 centroid = float1(0.0f), normal = float1(0.0f);
+        float area = 0.0f;
+        for (uint t = clusters[c].begin; t < clusters[c].end; t++) {
+            const Float4 p0 = loadPosition(positions, indices[t * 3]);
+            const Float4 p1 = loadPosition(positions, indices[t * 3 + 1]);
+            const Float4 p2 = loadPosition(positions, indices[t * 3 + 2]);
+            const Float4 n = cross3(p1 - p0, p2 - p0);
+            const float triangleArea = length3(n);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        normals[c] = sqlength3(normal) > 0.0f ? normalize3(normal) : normal;
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+    for (uint c = 0; c < clusters.size(); c++)
+        clusters[c].order = dot3(centroids[c] - meshCentroid, normals[c])[0];
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster &a, const TriangleCluster &b) {return a.order > b.order;});
+}
+
+// Vertices are renumbered in first use order, the unreferenced and welded ones disappear
+static uint remapVertices(VertexStream *streams, const uint nbStreams, const uint nbVertices, uint *indices, const uint nbIndices) {
+    std::vector<uint> remap(nbVertices, ~0u), order;
+    order.reserve(nbVertices);
+    for (uint i = 0; i < nbIndices; i++) {
+        uint &vertex = remap[indices[i]];
+        if (vertex == ~0u) {
+            vertex = order.size();
+            order.push_back(indices[i]);
+        }
+        indices[i] = vertex;
+    }
+
+    std::vector<uchar> copy;
+    for (uint i = 0; i < nbStreams; i++) {
+        const uint stride = streams[i].stride;
+        uchar *data = (uchar*)streams[i].data;
+        copy.resize((ulong)order.size() * stride);
+        for (uint j = 0; j < order.size(); j++)
+            memcpy(&copy[(ulong)j * stride], data + (ulong)order[j] * stride, stride);
+        memcpy(data, copy.data(), copy.size());
+    }
+
+    return order.size();
+}
+
+extern "C" {
+
+uint optimizeMesh(VertexStream *streams, const uint nbStreams, const uint nbVertices, uint *indices, const uint nbIndices, MeshOptimizationStats *stats) {
+    if (!streams || nbStreams == 0 || !indices || nbIndices < 3 || nbIndices % 3) {
+        logError("Optimizing a mesh without vertex streams or triangles");
+        return nbVertices;
+    }
+
+    for (uint i = 0; i < nbIndices; i++) {
+        if (indices[i] >= nbVertices) {
+            logError("Optimizing a mesh with the index %u out of its %u vertices", indices[i], nbVertices);
+            return nbVertices;
+        }
+    }
+
+    if (stats) {
+        stats->before = analyzeVertexCache(indices, nbIndices, nbVertices, VERTEX_CACHE_SIZE);
+        stats->nbVerticesBefore = nbVertices;
+    }
+
+    weldVertices(streams, nbStreams, nbVertices, indices, nbIndices);
+
+    std::vector<uint> ordered, boundaries;
+    tipsify(ordered, boundaries, indices, nbIndices, nbVertices);
+
+    std::vector<TriangleCluster> clusters;
+    splitClusters(clusters, ordered, boundaries, nbVertices);
+    sortClusters(clusters, ordered, streams[0]);
+    uint *output = indices;
+    for (const TriangleCluster &cluster : clusters) {
+        memcpy(output, &ordered[cluster.begin * 3], (cluster.end - cluster.begin) * 3 * sizeof(uint));
+        output += (cluster.end - cluster.begin) * 3;
+    }
+
+    const uint nbVerticesAfter = remapVertices(streams, nbStreams, nbVertices, indices, nbIndices);
+    if (stats) {
+        stats->after = analyzeVertexCache(indices, nbIndices, nbVerticesAfter, VERTEX_CACHE_SIZE);
+        stats->nbVerticesAfter = nbVerticesAfter;
+    }
+
+    return nbVerticesAfter;
+}
+
+VertexCacheStats analyzeVertexCache(const uint *indices, const uint nbIndices, const uint nbVertices, const uint cacheSize) {
+    VertexCacheStats stats = {};
+    if (!indices || nbIndices < 3)
+        return stats;
+
+    CacheSimulator cache(nbVertices, cacheSize);
+    std::vector<bool> referenced(nbVertices, false);
+    uint misses = 0, nbReferenced = 0;
+    for (uint i = 0; i < nbIndices; i++) {
+        if (indices[i] >= nbVertices)
+            continue;
+
+        misses += cache.access(indices[i]);
+        if (!referenced[indices[i]]) {
+            referenced[indices[i]] = true;
+            nbReferenced++;
+        }
+    }
+
+    stats.acmr = (float)misses / (nbIndices / 3);
+    stats.atvr = nbReferenced ? (float)misses / nbReferenced : 0.0f;
+    return stats;
+}
+
+}
@@ -0,0 +1,374 @@
+#include <meshlet.h>
+#include <context.h>
+#include <readback.h>
+#include <unordered_map>
+#include "private_impl.h"
+#include "private_log.h"
+#include "private_parallel.h"
+
+// Must match shaders/meshlets.task
+#define MESHLET_GROUP_SIZE 32
+// Triangles of the index order split by each job, meshlets never straddle two chunks
+#define MESHLET_CHUNK_SIZE 16384
+#define MESHLET_NO_SLOT 0xFF
+
+typedef struct {
+    Buffer meshlets, vertices, triangles;
+    Mesh mesh;
+    uint nbMeshlets;
+} MeshletMeshImpl;
+
+struct MeshletChunk {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint> vertices, triangles;
+    uint nbDropped;
+};
+
+static MeshletMeshImpl* getMeshletMesh(MeshletMesh mesh) {return (MeshletMeshImpl*)mesh.impl;}
+
+static Float4 loadPosition(const void *positions, const uint positionStride, const uint vertex) {
+    const float *p = (const float*)((const uchar*)positions + (ulong)vertex * positionStride);
+    return float4(p[0], p[1], p[2], 0.0f);
+}
+
+// Greedy growth in the spirit of meshoptimizer: the next triangle is the neighbour of the meshlet
+// adding the fewest vertices, and when none is left the next unused one of the index order. The
+// chunk vertices are renumbered so the adjacency and the meshlet slots are plain arrays.
+static void buildChunk(MeshletChunk &chunk, const uint *indices, const uint nbVertices, const uint first, const uint count) {
+    std::unordered_map<uint, uint> compact;
+    compact.reserve(count * 2);
+    std::vector<uint> globals, corners(count * 3);
+    std::vector<bool> used(count, false);
+    chunk.nbDropped = 0;
+    for (uint i = 0; i < count; i++) {
+        for (uint j = 0; j < 3; j++) {
+            const uint vertex = indices ? indices[(first + i) * 3 + j] : (first + i) * 3 + j;
+            auto it = compact.emplace(vertex, (uint)globals.size());
+            if (it.second)
+                globals.push_back(vertex);
+            corners[i * 3 + j] = it.first->second;
+        }
+
+        // Degenerate triangles draw nothing
+        const uint *c = &corners[i * 3];
+        if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0] ||
+            globals[c[0]] >= nbVertices || globals[c[1]] >= nbVertices || globals[c[2]] >= nbVertices) {
+            used[i] = true;
+            chunk.nbDropped++;
+        }
+    }
+
+    std::vector<uint> offsets(globals.size() + 1, 0), adjacency(count * 3);
+    for (uint i = 0; i < count * 3; i++)
+        offsets[corners[i] + 1]++;
+    for (uint i = 1; i < offsets.size(); i++)
+        offsets[i] += offsets[i - 1];
+    std::vector<uint> fill(offsets.begin(), offsets.end() - 1);
+    for (uint i = 0; i < count * 3; i++)
+        adjacency[fill[corners[i]]++] = i / 3;
+
+    std::vector<uchar> slots(globals.size(), MESHLET_NO_SLOT);
+    std::vector<uint> current, candidates;
+    Meshlet meshlet = {};
+
+    auto newVertices = [&](const uint triangle) {
+        const uint *c = &corners[triangle * 3];
+        return (uint)(slots[c[0]] == MESHLET_NO_SLOT) + (slots[c[1]] == MESHLET_NO_SLOT) + (slots[c[2]] == MESHLET_NO_SLOT);
+    };
+
+    auto closeMeshlet = [&]() {
+        if (meshlet.nbTriangles) {
+            for (uint vertex : current) {
+                slots[vertex] = MESHLET_NO_SLOT;
+                chunk.vertices.push_back(globals[vertex]);
+            }
+            meshlet.nbVertices = current.size();
+            chunk.meshlets.push_back(meshlet);
+        }
+
+        current.clear();
+        candidates.clear();
+        meshlet = Meshlet{};
+        meshlet.vertexOffset = chunk.vertices.size();
+        meshlet.triangleOffset = chunk.triangles.size();
+    };
+
+    auto add = [&](const uint triangle) {
+        used[triangle] = true;
+        uint packed = 0;
+        for (uint j = 0; j < 3; j++) {
+            const uint vertex = corners[triangle * 3 + j];
+            if (slots[vertex] == MESHLET_NO_SLOT) {
+                slots[vertex] = current.size();
+                current.push_back(vertex);
+                for (uint k = offsets[vertex]; k < offsets[vertex + 1]; k++)
+                    if (!used[adjacency[k]])
+                        candidates.push_back(adjacency[k]);
+            }
+            packed |= (uint)slots[vertex] << (j * 8);
+        }
+        chunk.triangles.push_back(packed);
+        meshlet.nbTriangles++;
+    };
+
+    closeMeshlet();
+    uint seed = 0;
+    for (;;) {
+        // Used candidates are removed as they're met, a triangle closing the meshlet ends the search
+        uint best = ~0u, bestCost = 4;
+        for (uint i = 0; i < candidates.size() && bestCost > 0;) {
+            const uint triangle = candidates[i];
+            if (used[triangle]) {
+                candidates[i] = candidates.back();
+                candidates.pop_back();
+                continue;
+            }
+
+            const uint cost = newVertices(triangle);
+            if (cost < bestCost) {
+                best = triangle;
+                bestCost = cost;
+            }
+            i++;
+        }
+
+        if (best == ~0u) {
+            while (seed < count && used[seed])
+                seed++;
+            if (seed == count)
+                break;
+            best = seed;
+            bestCost = newVertices(seed);
+        }
+
+        if (current.size() + bestCost > MESHLET_MAX_VERTICES || meshlet.nbTriangles == MESHLET_MAX_TRIANGLES) {
+            closeMeshlet();
+            continue;
+        }
+        add(best);
+    }
+    closeMeshlet();
+}
+
+// Sphere around the bounding box, and cone of the triangle normals. Cones wider than a half
+// space, or of less than ~6 degrees margin, get a cutoff of 1 that never culls.
+static void computeBounds(Meshlet &meshlet, const void *positions, const uint positionStride, const uint *vertices, const uint *triangles) {
+    Float4 points[MESHLET_MAX_VERTICES];
+    Float4 min = float1(INFINITY), max = float1(-INFINITY);
+    for (uint i = 0; i < meshlet.nbVertices; i++) {
+        points[i] = loadPosition(positions, positionStride, vertices[meshlet.vertexOffset + i]);
+        min = min4(min, points[i]);
+        max = max4(max, points[i]);
+    }
+
+    const Float4 center = (min + max) * 0.5f;
+    float radius = 0.0f;
+    for (uint i = 0; i < meshlet.nbVertices; i++)
+        radius = MAX(radius, distance3(points[i], center));
+
+    Float4 normals[MESHLET_MAX_TRIANGLES];
+    Float4 sum = float1(0.0f);
+    uint nbNormals = 0;
+    for (uint i = 0; i < meshlet.nbTriangles; i++) {
+        const uint packed = triangles[meshlet.triangleOffset + i];
+        const Float4 p0 = points[packed & 0xFF], p1 = points[(packed >> 8) & 0xFF], p2 = points[(packed >> 16) & 0xFF];
+        const Float4 normal = cross3(p1 - p0, p2 - p0);
+        const float area = length3(normal);
+        if (area <= 0.0f)
+            continue;
+
+        normals[nbNormals] = normal / area;
+        sum += normals[nbNormals++];
+    }
+
+    Float4 axis = float4(0.0f, 0.0f, 1.0f, 0.0f);
+    float cutoff = 1.0f;
+    if (nbNormals && sqlength3(sum) > 0.0f) {
+        axis = normalize3(sum);
+        float minDot = 1.0f;
+        for (uint i = 0; i < nbNormals; i++)
+            minDot = MIN(minDot, dot3(normals[i], axis)[0]);
+        if (minDot > 0.1f)
+            cutoff = sqrtf(1.0f - minDot * minDot);
+    }
+
+    for (uint i = 0; i < 3; i++) {
+        meshlet.center[i] = center[i];
+        meshlet.coneAxis[i] = axis[i];
+    }
+    meshlet.radius = radius;
+    meshlet.coneCutoff = cutoff;
+}
+
+extern "C" {
+
+Meshlets buildMeshlets(const void *positions, const uint positionStride, const uint nbVertices, const uint *indices, const uint nbIndices) {
+    Meshlets result = {};
+    const uint nbTriangles = (indices ? nbIndices : nbVertices) / 3;
+    if (!positions || nbTriangles == 0) {
+        logError("Building meshlets without triangles");
+        return result;
+    }
+
+    const uint nbChunks = (nbTriangles + MESHLET_CHUNK_SIZE - 1) / MESHLET_CHUNK_SIZE;
+    std::vector<MeshletChunk> chunks(nbChunks);
+    parallelFor(nbChunks, 1, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++)
+            buildChunk(chunks[i], indices, nbVertices, i * MESHLET_CHUNK_SIZE, MIN(MESHLET_CHUNK_SIZE, nbTriangles - i * MESHLET_CHUNK_SIZE));
+    });
+
+    uint nbDropped = 0;
+    for (const MeshletChunk &chunk : chunks) {
+        result.nbMeshlets += chunk.meshlets.size();
+        result.nbVertices += chunk.vertices.size();
+        result.nbTriangles += chunk.triangles.size();
+        nbDropped += chunk.nbDropped;
+    }
+    if (nbDropped)
+        logWarning("%u degenerate or out of range triangles left out of the meshlets", nbDropped);
+    if (result.nbMeshlets == 0)
+        return result;
+
+    result.meshlets = (Meshlet*)malloc(result.nbMeshlets * sizeof(Meshlet));
+    result.vertices = (uint*)malloc(result.nbVertices * sizeof(uint));
+    result.triangles = (uint*)malloc(result.nbTriangles * sizeof(uint));
+
+    uint meshletOffset = 0, vertexOffset = 0, triangleOffset = 0;
+    for (const MeshletChunk &chunk : chunks) {
+        for (uint i = 0; i < chunk.meshlets.size(); i++) {
+            Meshlet &meshlet = result.meshlets[meshletOffset + i] = chunk.meshlets[i];
+            meshlet.vertexOffset += vertexOffset;
+            meshlet.triangleOffset += triangleOffset;
+        }
+        memcpy(result.vertices + vertexOffset, chunk.vertices.data(), chunk.vertices.size() * sizeof(uint));
+        memcpy(result.triangles + triangleOffset, chunk.triangles.data(), chunk.triangles.size() * sizeof(uint));
+        meshletOffset += chunk.meshlets.size();
+        vertexOffset += chunk.vertices.size();
+        triangleOffset += chunk.triangles.size();
+    }
+
+    parallelFor(result.nbMeshlets, 256, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++)
+            computeBounds(result.meshlets[i], positions, positionStride, result.vertices, result.triangles);
+    });
+
+    return result;
+}
+
+void deleteMeshlets(Meshlets *meshlets) {
+    if (!meshlets)
+        return;
+
+    free(meshlets->meshlets);
+    free(meshlets->vertices);
+    free(meshlets->triangles);
+    *meshlets = Meshlets{};
+}
+
+MeshletMesh createMeshletMesh(const Mesh mesh) {
+    MeshImpl *meshimpl = getMesh(mesh);
+    if (!meshimpl || meshimpl->attributes.empty() || meshimpl->primitiveType != PrimitiveType_Triangles) {
+        logError("Creation of meshlets from an invalid or non triangle list mesh");
+        return MeshletMesh{nullptr};
+    }
+
+    const nvrhi::Format format = meshimpl->attributes[0].format;
+    if (format != nvrhi::Format::RGB32_FLOAT && format != nvrhi::Format::RGBA32_FLOAT) {
+        logError("Unsupported vertex format for meshlets: %s", nvrhi::getFormatInfo(format).name);
+        return MeshletMesh{nullptr};
+    }
+
+    const uint stride = getFormatInfo((Format)format).size;
+    const uint indexSize = meshimpl->indicesFormat == nvrhi::Format::R16_UINT ? 2 : 4;
+    const ReadbackTicket vertexTicket = requestBufferReadback(meshimpl->buffers[0], 0, meshimpl->nbVertices * stride, nullptr, nullptr);
+    const ReadbackTicket indexTicket = meshimpl->indices.impl ?
+        requestBufferReadback(meshimpl->indices, 0, meshimpl->nbIndices * indexSize, nullptr, nullptr) : NullReadback;
+    flush();
+
+    const void *positions = waitReadback(vertexTicket, nullptr);
+    std::vector<uint> indices;
+    if (indexTicket != NullReadback) {
+        const void *indexData = waitReadback(indexTicket, nullptr);
+        indices.resize(meshimpl->nbIndices);
+        for (uint i = 0; indexData && i < meshimpl->nbIndices; i++)
+            indices[i] = indexSize == 2 ? ((const ushort*)indexData)[i] : ((const uint*)indexData)[i];
+        releaseReadback(indexTicket);
+    }
+
+    MeshletMesh result = {nullptr};
+    if (positions) {
+        Meshlets meshlets = buildMeshlets(positions, stride, meshimpl->nbVertices,
+            indices.empty() ? nullptr : indices.data(), indices.size());
+        result = uploadMeshlets(&meshlets, mesh);
+        deleteMeshlets(&meshlets);
+    }
+    releaseReadback(vertexTicket);
+
+    return result;
+}
+
+MeshletMesh uploadMeshlets(const Meshlets *meshlets, const Mesh mesh) {
+    MeshImpl *meshimpl = getMesh(mesh);
+    if (!meshlets || !meshlets->nbMeshlets || !meshimpl || meshimpl->attributes.empty()) {
+        logError("Uploading empty meshlets or meshlets of an invalid mesh");
+        return MeshletMesh{nullptr};
+    }
+
+    MeshletMeshImpl *impl = new MeshletMeshImpl();
+    impl->mesh = mesh;
+    impl->nbMeshlets = meshlets->nbMeshlets;
+    impl->meshlets  = createBuffer(ResourceType_UnorderedAccess, meshlets->nbMeshlets * sizeof(Meshlet));
+    impl->vertices  = createBuffer(ResourceType_UnorderedAccess, meshlets->nbVertices * sizeof(uint));
+    impl->triangles = createBuffer(ResourceType_UnorderedAccess, meshlets->nbTriangles * sizeof(uint));
+
+    MeshletMesh result = {impl};
+    if (!impl->meshlets.impl || !impl->vertices.impl || !impl->triangles.impl) {
+        deleteMeshletMesh(&result);
+        return MeshletMesh{nullptr};
+    }
+
+    setBufferData(impl->meshlets, meshlets->meshlets, meshlets->nbMeshlets * sizeof(Meshlet));
+    setBufferData(impl->vertices, meshlets->vertices, meshlets->nbVertices * sizeof(uint));
+    setBufferData(impl->triangles, meshlets->triangles, meshlets->nbTriangles * sizeof(uint));
+    return result;
+}
+
+void deleteMeshletMesh(MeshletMesh *mesh) {
+    if (!mesh || !mesh->impl)
+        return;
+
+    MeshletMeshImpl *impl = getMeshletMesh(*mesh);
+    deleteBuffer(&impl->meshlets);
+    deleteBuffer(&impl->vertices);
+    deleteBuffer(&impl->triangles);
+    delete impl;
+    mesh->impl = nullptr;
+}
+
+uint getNbMeshlets(const MeshletMesh mesh) {
+    MeshletMeshImpl *impl = getMeshletMesh(mesh);
+    return impl ? impl->nbMeshlets : 0;
+}
+
+void drawMeshletMesh(MeshletMesh mesh, Mat4 model, Mat4 viewProjection, const Float4 eye) {
+    MeshletMeshImpl *impl = getMeshletMesh(mesh);
+    MeshImpl *meshimpl = impl ? getMesh(impl->mesh) : nullptr;
+    if (!meshimpl) {
+        logWarning("Drawing an invalid meshlet mesh");
+        return;
+    }
+
+    setUniformBuffer(impl->meshlets, "Meshlets");
+    setUniformBuffer(impl->vertices, "MeshletVertices");
+    setUniformBuffer(impl->triangles, "MeshletTriangles");
+    setUniformBuffer(meshimpl->buffers[0], "MeshletPositions");
+    setUniformMat4(model, "Model");
+    setUniformMat4(viewProjection, "ViewProjection");
+    setUniform4f(eye[0], eye[1], eye[2], 1.0f, "Eye");
+    setUniform1i(impl->nbMeshlets, "NbMeshlets");
+    setUniform1i(meshimpl->attributes[0].elementStride / sizeof(float), "PositionStride");
+    setGroupSize1D(MESHLET_GROUP_SIZE);
+    dispatch1D(impl->nbMeshlets);
+}
+
+}
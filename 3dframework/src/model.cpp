@@ -0,0 +1,1181 @@
+#include <model.h>
+#include <mesh_optimizer.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+#include "private_log.h"
+#include "private_parallel.h"
+#ifdef _WIN32
+    #define NOMINMAX
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <direct.h>
+    #define makeDirectory(dir) _mkdir(dir)
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #define makeDirectory(dir) mkdir(dir, 0755)
+#endif
+
+#define CACHE_MAGIC 0x4C444F4Du // "MODL"
+#define CACHE_VERSION 1u        // bump when the layout or the processing of the models change
+#define CACHE_ALIGNMENT 16
+#define MATERIAL_NAME_SIZE 64
+
+#define OBJ_CHUNK_SIZE (1 << 20)
+#define OBJ_MISSING INT32_MIN
+#define OBJ_RELATIVE (1 << 30) // negative indices are stored relative to their chunk until its offsets are known
+
+#define GLB_MAGIC 0x46546C67u // "glTF"
+#define GLB_JSON  0x4E4F534Au
+#define GLB_BIN   0x004E4942u
+
+static std::string cacheDir = "../model_cache/";
+
+typedef struct {
+    Mesh mesh;
+    std::vector<Range> submeshes;
+    std::vector<std::string> materials;
+    Float4 min, max;
+} ModelImpl;
+
+// Geometry of a material before the optimization and the merge of the submeshes
+struct SubmeshData {
+    std::string material;
+    std::vector<float> positions, normals, uvs; // 3, 3 and 2 floats per vertex
+    std::vector<uint> indices;
+};
+
+// Merged model, in the layout of the cache and of the mesh
+struct ModelData {
+    std::vector<float> positions, normals, uvs;
+    std::vector<uint> indices;
+    std::vector<Range> submeshes;
+    std::vector<std::string> materials;
+    Float4 min, max;
+};
+
+typedef struct {
+    uint magic, version;
+    uint64_t key;
+    uint nbVertices, nbIndices, nbSubmeshes, indexSize;
+    float min[4], max[4];
+} CacheHeader;
+
+typedef struct {
+    Range range;
+    char material[MATERIAL_NAME_SIZE];
+} CacheSubmesh;
+
+static ModelImpl* getModel(Model model) {return (ModelImpl*)model.impl;}
+
+static size_t alignCache(const size_t size) {
+    return (size + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+}
+
+static std::string joinPath(const std::string &dir, const char *name) {
+    if (dir.empty() || dir.back() == '/' || dir.back() == '\\')
+        return dir + name;
+    return dir + '/' + name;
+}
+
+static uint64_t hashData(const void *data, const size_t size, uint64_t hash) {
+    // FNV-1a
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ ((const uchar*)data)[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Read only file mappings
+
+struct MappedFile {
+    const uchar *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+};
+
+static bool mapFile(const char *filename, MappedFile &mapped) {
+    mapped = MappedFile{};
+#ifdef _WIN32
+    mapped.file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (mapped.file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(mapped.file, &size) && size.QuadPart > 0) {
+        mapped.size = size.QuadPart;
+        mapped.mapping = CreateFileMappingA(mapped.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapped.mapping)
+            mapped.data = (const uchar*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!mapped.data) {
+        if (mapped.mapping) CloseHandle(mapped.mapping);
+        CloseHandle(mapped.file);
+        mapped = MappedFile{};
+        return false;
+    }
+#else
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            mapped.data = (const uchar*)data;
+            mapped.size = info.st_size;
+        }
+    }
+    close(fd);
+    if (!mapped.data)
+        return false;
+#endif
+    return true;
+}
+
+static void unmapFile(MappedFile &mapped) {
+    if (!mapped.data)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped.data);
+    CloseHandle(mapped.mapping);
+    CloseHandle(mapped.file);
+#else
+    munmap((void*)mapped.data, mapped.size);
+#endif
+    mapped = MappedFile{};
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Shared processing
+
+// Area weighted vertex normals, the three by three vertices of OBJ files get their face normal
+static void computeNormals(SubmeshData &submesh, const uint firstVertex, const uint firstIndex) {
+    const uint nbVertices = submesh.positions.size() / 3;
+    std::fill(submesh.normals.begin() + firstVertex * 3, submesh.normals.begin() + nbVertices * 3, 0.0f);
+    for (uint i = firstIndex; i + 2 < submesh.indices.size(); i += 3) {
+        const uint *triangle = &submesh.indices[i];
+        const float *p0 = &submesh.positions[triangle[0] * 3], *p1 = &submesh.positions[triangle[1] * 3], *p2 = &submesh.positions[triangle[2] * 3];
+        const Float4 normal = cross3(float4(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2], 0.0f), float4(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2], 0.0f));
+        for (uint j = 0; j < 3; j++)
+            for (uint k = 0; k < 3; k++)
+                submesh.normals[triangle[j] * 3 + k] += normal[k];
+    }
+
+    for (uint i = firstVertex; i < nbVertices; i++) {
+        float *n = &submesh.normals[i * 3];
+        const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f) {
+            n[0] /= length; n[1] /= length; n[2] /= length;
+        } else {
+            n[0] = 0.0f; n[1] = 0.0f; n[2] = 1.0f;
+        }
+    }
+}
+
+// Submeshes are optimized in parallel then concatenated, indices are global so any submesh can
+// be drawn with drawSubMesh
+static void mergeSubmeshes(std::vector<SubmeshData> &submeshes, ModelData &model) {
+    parallelFor(submeshes.size(), 1, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++) {
+            SubmeshData &submesh = submeshes[i];
+            const uint nbVertices = submesh.positions.size() / 3;
+            if (submesh.indices.empty())
+                continue;
+
+            VertexStream streams[3] = {
+                {submesh.positions.data(), 3 * sizeof(float)},
+                {submesh.normals.data(), 3 * sizeof(float)},
+                {submesh.uvs.data(), 2 * sizeof(float)},
+            };
+            const uint nbOptimized = optimizeMesh(streams, 3, nbVertices, submesh.indices.data(), submesh.indices.size(), nullptr);
+            submesh.positions.resize(nbOptimized * 3);
+            submesh.normals.resize(nbOptimized * 3);
+            submesh.uvs.resize(nbOptimized * 2);
+        }
+    });
+
+    model.min = float1(INFINITY);
+    model.max = float1(-INFINITY);
+    for (SubmeshData &submesh : submeshes) {
+        if (submesh.indices.empty())
+            continue;
+
+        const uint firstVertex = model.positions.size() / 3;
+        model.submeshes.push_back({(uint)model.indices.size(), (uint)submesh.indices.size()});
+        model.materials.push_back(submesh.material);
+        model.positions.insert(model.positions.end(), submesh.positions.begin(), submesh.positions.end());
+        model.normals.insert(model.normals.end(), submesh.normals.begin(), submesh.normals.end());
+        model.uvs.insert(model.uvs.end(), submesh.uvs.begin(), submesh.uvs.end());
+        for (uint index : submesh.indices)
+            model.indices.push_back(firstVertex + index);
+
+        for (uint i = 0; i < submesh.positions.size(); i += 3) {
+            const Float4 p = float4(submesh.positions[i], submesh.positions[i + 1], submesh.positions[i + 2], 0.0f);
+            model.min = min4(model.min, p);
+            model.max = max4(model.max, p);
+        }
+        submesh = SubmeshData{};
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Wavefront OBJ
+
+struct ObjCorner {
+    int v, vt, vn;
+};
+
+struct ObjChunk {
+    std::vector<float> positions, uvs, normals;
+    std::vector<ObjCorner> corners; // 3 per triangle, polygons are fanned
+    std::vector<std::pair<uint, std::string>> materials; // first triangle of each usemtl
+    std::vector<std::pair<uint, uint>> runs; // first triangle and submesh, resolved after the parsing
+};
+
+static const char* skipSpaces(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+static const char* parseInt(const char *p, const char *end, int &value) {
+    const bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+
+    int x = 0;
+    for (; p < end && (uint)(*p - '0') < 10; p++)
+        x = x * 10 + (*p - '0');
+    value = negative ? -x : x;
+    return p;
+}
+
+// Decimal and scientific notations, much faster than strtod on the millions of OBJ numbers. Integers
+// stay exact up to 2^53, the glTF offsets and counts go through it.
+static const char* parseDouble(const char *p, const char *end, double &value) {
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+
+    p = skipSpaces(p, end);
+    const bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    for (; p < end && (uint)(*p - '0') < 10; p++)
+        mantissa = mantissa * 10.0 + (*p - '0');
+    if (p < end && *p == '.') {
+        for (p++; p < end && (uint)(*p - '0') < 10; p++, exponent--)
+            mantissa = mantissa * 10.0 + (*p - '0');
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int e;
+        p = parseInt(p + 1, end, e);
+        exponent += e;
+    }
+
+    const uint magnitude = abs(exponent);
+    const double scale = magnitude < ARRAY_SIZE(powers) ? powers[magnitude] : pow(10.0, magnitude);
+    value = (negative ? -mantissa : mantissa) * (exponent < 0 ? 1.0 / scale : scale);
+    return p;
+}
+
+static const char* parseFloat(const char *p, const char *end, float &value) {
+    double x;
+    p = parseDouble(p, end, x);
+    value = (float)x;
+    return p;
+}
+
+static int resolveObjIndex(const int index, const uint localCount) {
+    if (index > 0) return index - 1;
+    if (index < 0) return (int)localCount + index - OBJ_RELATIVE;
+    return OBJ_MISSING;
+}
+
+static int offsetObjIndex(const int index, const uint base) {
+    if (index == OBJ_MISSING || index >= 0) return index;
+    return index + OBJ_RELATIVE + (int)base;
+}
+
+static void parseObjChunk(ObjChunk &chunk, const char *p, const char *end) {
+    std::vector<ObjCorner> polygon;
+    while (p < end) {
+        p = skipSpaces(p, end);
+        const char *eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+
+        if (eol - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            float x, y, z;
+            p = parseFloat(parseFloat(parseFloat(p + 2, eol, x), eol, y), eol, z);
+            chunk.positions.insert(chunk.positions.end(), {x, y, z});
+        } else if (eol - p >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            float u, v = 0.0f;
+            p = parseFloat(p + 3, eol, u);
+            p = skipSpaces(p, eol);
+            if (p < eol && *p != '\r')
+                p = parseFloat(p, eol, v);
+            chunk.uvs.insert(chunk.uvs.end(), {u, v});
+        } else if (eol - p >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            float x, y, z;
+            p = parseFloat(parseFloat(parseFloat(p + 3, eol, x), eol, y), eol, z);
+            chunk.normals.insert(chunk.normals.end(), {x, y, z});
+        } else if (eol - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            polygon.clear();
+            for (p = skipSpaces(p + 2, eol); p < eol && ((uint)(*p - '0') < 10 || *p == '-');) {
+                int v, vt = 0, vn = 0;
+                p = parseInt(p, eol, v);
+                if (p < eol && *p == '/') {
+                    if (p + 1 < eol && p[1] != '/')
+                        p = parseInt(p + 1, eol, vt);
+                    else
+                        p++;
+                    if (p < eol && *p == '/')
+                        p = parseInt(p + 1, eol, vn);
+                }
+                polygon.push_back({resolveObjIndex(v, chunk.positions.size() / 3), resolveObjIndex(vt, chunk.uvs.size() / 2),
+                    resolveObjIndex(vn, chunk.normals.size() / 3)});
+                p = skipSpaces(p, eol);
+            }
+
+            for (uint i = 2; i < polygon.size(); i++)
+                chunk.corners.insert(chunk.corners.end(), {polygon[0], polygon[i - 1], polygon[i]});
+        } else if (eol - p >= 7 && !strncmp(p, "usemtl", 6) && (p[6] == ' ' || p[6] == '\t')) {
+            const char *name = skipSpaces(p + 7, eol), *nameEnd = eol;
+            while (nameEnd > name && (nameEnd[-1] == '\r' || nameEnd[-1] == ' ' || nameEnd[-1] == '\t'))
+                nameEnd--;
+            chunk.materials.push_back({(uint)chunk.corners.size() / 3, std::string(name, nameEnd)});
+        }
+
+        p = eol + 1;
+    }
+}
+
+static bool parseObj(const char *data, const size_t size, ModelData &model) {
+    // Chunks end on line ends so every line is parsed by a single job
+    std::vector<const char*> bounds = {data};
+    for (size_t offset = OBJ_CHUNK_SIZE; offset < size; offset += OBJ_CHUNK_SIZE) {
+        if (bounds.back() >= data + offset)
+            continue;
+        const char *eol = (const char*)memchr(data + offset, '\n', size - offset);
+        if (!eol)
+            break;
+        bounds.push_back(eol + 1);
+    }
+    bounds.push_back(data + size);
+
+    const uint nbChunks = bounds.size() - 1;
+    std::vector<ObjChunk> chunks(nbChunks);
+    parallelFor(nbChunks, 1, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++)
+            parseObjChunk(chunks[i], bounds[i], bounds[i + 1]);
+    });
+
+    // Offsets of the chunk elements and submesh runs, in file order
+    std::vector<uint> positionBases(nbChunks + 1, 0), uvBases(nbChunks + 1, 0), normalBases(nbChunks + 1, 0);
+    std::unordered_map<std::string, uint> materialIds;
+    std::vector<SubmeshData> submeshes;
+    std::vector<std::vector<uint>> counts(nbChunks); // triangles of each submesh in each chunk
+    uint current = ~0u;
+    for (uint c = 0; c < nbChunks; c++) {
+        ObjChunk &chunk = chunks[c];
+        positionBases[c + 1] = positionBases[c] + chunk.positions.size() / 3;
+        uvBases[c + 1] = uvBases[c] + chunk.uvs.size() / 2;
+        normalBases[c + 1] = normalBases[c] + chunk.normals.size() / 3;
+
+        auto useMaterial = [&](const std::string &name, const uint firstTriangle) {
+            auto it = materialIds.emplace(name, submeshes.size());
+            if (it.second) {
+                submeshes.emplace_back();
+                submeshes.back().material = name;
+            }
+            current = it.first->second;
+            chunk.runs.push_back({firstTriangle, current});
+        };
+
+        if (current == ~0u)
+            useMaterial("", 0);
+        else
+            chunk.runs.push_back({0, current});
+        for (const auto &material : chunk.materials)
+            useMaterial(material.second, material.first);
+    }
+
+    std::vector<uint> totals(submeshes.size(), 0);
+    for (uint c = 0; c < nbChunks; c++) {
+        const ObjChunk &chunk = chunks[c];
+        counts[c].assign(submeshes.size(), 0);
+        for (uint r = 0; r < chunk.runs.size(); r++) {
+            const uint end = r + 1 < chunk.runs.size() ? chunk.runs[r + 1].first : chunk.corners.size() / 3;
+            counts[c][chunk.runs[r].second] += end - chunk.runs[r].first;
+        }
+        // Chunk counts become the first triangle of the chunk in each submesh
+        for (uint s = 0; s < submeshes.size(); s++) {
+            const uint count = counts[c][s];
+            counts[c][s] = totals[s];
+            totals[s] += count;
+        }
+    }
+
+    const uint nbPositions = positionBases[nbChunks], nbUvs = uvBases[nbChunks], nbNormals = normalBases[nbChunks];
+    std::vector<float> positions(nbPositions * 3), uvs(nbUvs * 2), normals(nbNormals * 3);
+    parallelFor(nbChunks, 1, [&](const uint begin, const uint end) {
+        for (uint c = begin; c < end; c++) {
+            std::copy(chunks[c].positions.begin(), chunks[c].positions.end(), positions.begin() + positionBases[c] * 3);
+            std::copy(chunks[c].uvs.begin(), chunks[c].uvs.end(), uvs.begin() + uvBases[c] * 2);
+            std::copy(chunks[c].normals.begin(), chunks[c].normals.end(), normals.begin() + normalBases[c] * 3);
+            std::vector<float>().swap(chunks[c].positions);
+            std::vector<float>().swap(chunks[c].uvs);
+            std::vector<float>().swap(chunks[c].normals);
+        }
+    });
+
+    for (uint s = 0; s < submeshes.size(); s++) {
+        submeshes[s].positions.resize(totals[s] * 9);
+        submeshes[s].normals.resize(totals[s] * 9);
+        submeshes[s].uvs.resize(totals[s] * 6);
+        submeshes[s].indices.resize(totals[s] * 3);
+    }
+
+    // Corners are expanded three by three, optimizeMesh welds them back
+    std::atomic<uint> nbInvalid(0);
+    parallelFor(nbChunks, 1, [&](const uint begin, const uint end) {
+        for (uint c = begin; c < end; c++) {
+            const ObjChunk &chunk = chunks[c];
+            for (uint r = 0; r < chunk.runs.size(); r++) {
+                SubmeshData &submesh = submeshes[chunk.runs[r].second];
+                const uint runEnd = r + 1 < chunk.runs.size() ? chunk.runs[r + 1].first : chunk.corners.size() / 3;
+                for (uint t = chunk.runs[r].first; t < runEnd; t++) {
+                    const uint vertex = counts[c][chunk.runs[r].second]++ * 3;
+                    bool hasNormals = true;
+                    for (uint j = 0; j < 3; j++) {
+                        const ObjCorner &corner = chunk.corners[t * 3 + j];
+                        const int v = offsetObjIndex(corner.v, positionBases[c]);
+                        const int vt = offsetObjIndex(corner.vt, uvBases[c]);
+                        const int vn = offsetObjIndex(corner.vn, normalBases[c]);
+                        float *position = &submesh.positions[(vertex + j) * 3], *normal = &submesh.normals[(vertex + j) * 3], *uv = &submesh.uvs[(vertex + j) * 2];
+
+                        if (v >= 0 && v < (int)nbPositions) {
+                            memcpy(position, &positions[v * 3], 3 * sizeof(float));
+                        } else {
+                            memset(position, 0, 3 * sizeof(float));
+                            nbInvalid++;
+                        }
+                        if (vt >= 0 && vt < (int)nbUvs)
+                            memcpy(uv, &uvs[vt * 2], 2 * sizeof(float));
+                        else
+                            memset(uv, 0, 2 * sizeof(float));
+                        if (vn >= 0 && vn < (int)nbNormals)
+                            memcpy(normal, &normals[vn * 3], 3 * sizeof(float));
+                        else
+                            hasNormals = false;
+                        submesh.indices[vertex + j] = vertex + j;
+                    }
+
+                    // Faces without normals are flat
+                    if (!hasNormals) {
+                        const float *p0 = &submesh.positions[vertex * 3], *p1 = p0 + 3, *p2 = p0 + 6;
+                        Float4 n = cross3(float4(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2], 0.0f), float4(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2], 0.0f));
+                        n = sqlength3(n) > 0.0f ? normalize3(n) : float4(0.0f, 0.0f, 1.0f, 0.0f);
+                        for (uint j = 0; j < 3; j++)
+                            memcpy(&submesh.normals[(vertex + j) * 3], &n, 3 * sizeof(float));
+                    }
+                }
+            }
+        }
+    });
+
+    if (nbInvalid)
+        logWarning("%u OBJ face corners reference missing positions", (uint)nbInvalid);
+
+    chunks.clear();
+    mergeSubmeshes(submeshes, model);
+    return !model.indices.empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Binary glTF 2.0, with a minimal JSON reader for its scene description
+
+struct JsonValue {
+    enum Type : uchar {Null, Bool, Number, String, Array, Object} type = Null;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> elements; // of arrays, and values of objects
+    std::vector<std::string> keys;   // of objects
+
+    const JsonValue& operator[](const char *key) const;
+    const JsonValue& operator[](const int i) const;
+    size_t size() const {return elements.size();}
+    bool valid() const {return type != Null;}
+    int toInt(const int fallback) const {return type == Number ? (int)number : fallback;}
+    uint64_t toUInt64(const uint64_t fallback) const {return type == Number && number >= 0.0 ? (uint64_t)number : fallback;}
+    float toFloat(const float fallback) const {return type == Number ? (float)number : fallback;}
+};
+
+static const JsonValue nullJson;
+
+const JsonValue& JsonValue::operator[](const char *key) const {
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i] == key)
+            return elements[i];
+    return nullJson;
+}
+
+const JsonValue& JsonValue::operator[](const int i) const {
+    return type == Array && i >= 0 && (size_t)i < elements.size() ? elements[i] : nullJson;
+}
+
+struct JsonReader {
+    const char *p, *end;
+
+    void skip() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    bool parseString(std::string &s) {
+        if (p >= end || *p != '"')
+            return false;
+        for (p++; p < end && *p != '"'; p++) {
+            if (*p != '\\') {
+                s += *p;
+                continue;
+            }
+            if (++p >= end)
+                return false;
+            switch (*p) {
+                case 'b': s += '\b'; break;
+                case 'f': s += '\f'; break;
+                case 'n': s += '\n'; break;
+                case 'r': s += '\r'; break;
+                case 't': s += '\t'; break;
+                case 'u': {
+                    // UTF-8 of the code unit, surrogate pairs aren't combined
+                    if (end - p < 5)
+                        return false;
+                    const uint c = strtoul(std::string(p + 1, 4).c_str(), nullptr, 16);
+                    if (c < 0x80) s += (char)c;
+                    else if (c < 0x800) s += {(char)(0xC0 | c >> 6), (char)(0x80 | (c & 0x3F))};
+                    else s += {(char)(0xE0 | c >> 12), (char)(0x80 | ((c >> 6) & 0x3F)), (char)(0x80 | (c & 0x3F))};
+                    p += 4;
+                    break;
+                }
+                default: s += *p;
+            }
+        }
+        return p++ < end;
+    }
+
+    bool parse(JsonValue &value, const uint depth) {
+        skip();
+        if (p >= end || depth > 64)
+            return false;
+
+        if (*p == '{' || *p == '[') {
+            const bool object = *p++ == '{';
+            value.type = object ? JsonValue::Object : JsonValue::Array;
+            skip();
+            if (p < end && *p == (object ? '}' : ']'))
+                return p++, true;
+
+            for (;;) {
+                if (object) {
+                    skip();
+                    value.keys.emplace_back();
+                    if (!parseString(value.keys.back()))
+                        return false;
+                    skip();
+                    if (p >= end || *p++ != ':')
+                        return false;
+                }
+                value.elements.emplace_back();
+                if (!parse(value.elements.back(), depth + 1))
+                    return false;
+                skip();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                return p < end && *p++ == (object ? '}' : ']');
+            }
+        }
+
+        if (*p == '"') {
+            value.type = JsonValue::String;
+            return parseString(value.string);
+        }
+        if (end - p >= 4 && !strncmp(p, "true", 4)) {
+            value.type = JsonValue::Bool;
+            value.number = 1.0;
+            return p += 4, true;
+        }
+        if (end - p >= 5 && !strncmp(p, "false", 5)) {
+            value.type = JsonValue::Bool;
+            return p += 5, true;
+        }
+        if (end - p >= 4 && !strncmp(p, "null", 4))
+            return p += 4, true;
+
+        const char *start = p;
+        p = parseDouble(p, end, value.number);
+        value.type = JsonValue::Number;
+        return p > start;
+    }
+};
+
+// Column major like glTF
+struct GltfMatrix {
+    float m[16];
+
+    static GltfMatrix identity() {
+        GltfMatrix r = {};
+        r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+        return r;
+    }
+
+    GltfMatrix operator*(const GltfMatrix &b) const {
+        GltfMatrix r;
+        for (uint c = 0; c < 4; c++)
+            for (uint l = 0; l < 4; l++)
+                r.m[c * 4 + l] = m[l] * b.m[c * 4] + m[4 + l] * b.m[c * 4 + 1] + m[8 + l] * b.m[c * 4 + 2] + m[12 + l] * b.m[c * 4 + 3];
+        return r;
+    }
+};
+
+struct GltfAccessor {
+    const uchar *data;
+    uint count, components, stride, componentType;
+    bool normalized;
+};
+
+// A primitive drawn by a node
+struct GltfDraw {
+    const JsonValue *primitive;
+    GltfMatrix matrix;
+    uint submesh, firstVertex, firstIndex, nbVertices, nbIndices; // vertices and indices in the submesh
+};
+
+static uint getComponentSize(const uint componentType) {
+    switch (componentType) {
+        case 5120: case 5121: return 1; // byte, unsigned byte
+        case 5122: case 5123: return 2; // short, unsigned short
+        case 5125: case 5126: return 4; // unsigned int, float
+        default: return 0;
+    }
+}
+
+static bool getAccessor(const JsonValue &gltf, const uchar *bin, const size_t binSize, const int index, const uint components, GltfAccessor &accessor) {
+    static const char *types[] = {"", "SCALAR", "VEC2", "VEC3", "VEC4"};
+    const JsonValue &desc = gltf["accessors"][index];
+    const JsonValue &view = gltf["bufferViews"][desc["bufferView"].toInt(-1)];
+    const JsonValue &buffer = gltf["buffers"][view["buffer"].toInt(-1)];
+    if (!desc.valid() || !view.valid() || view["buffer"].toInt(-1) != 0 || buffer["uri"].valid() || desc["sparse"].valid() ||
+        desc["type"].string != types[components]) {
+        logError("Unsupported glTF accessor %d, only dense accessors of the GLB buffer are supported", index);
+        return false;
+    }
+
+    accessor.componentType = desc["componentType"].toInt(0);
+    accessor.components = components;
+    accessor.normalized = desc["normalized"].number != 0.0;
+    const uint elementSize = getComponentSize(accessor.componentType) * components;
+    const uint64_t count = desc["count"].toUInt64(0), stride = view["byteStride"].toUInt64(elementSize);
+    const uint64_t offset = view["byteOffset"].toUInt64(0) + desc["byteOffset"].toUInt64(0);
+    const uint64_t viewEnd = view["byteOffset"].toUInt64(0) + view["byteLength"].toUInt64(0);
+    if (!elementSize || count > UINT32_MAX || stride > UINT32_MAX || (count && offset + stride * (count - 1) + elementSize > MIN(viewEnd, (uint64_t)binSize))) {
+        logError("Invalid glTF accessor %d", index);
+        return false;
+    }
+    accessor.count = count;
+    accessor.stride = stride;
+
+    accessor.data = bin + offset;
+    return true;
+}
+
+static float readComponent(const GltfAccessor &accessor, const uint element, const uint component) {
+    const uchar *p = accessor.data + (size_t)element * accessor.stride + component * getComponentSize(accessor.componentType);
+    switch (accessor.componentType) {
+        case 5120: return accessor.normalized ? MAX(*(const signed char*)p / 127.0f, -1.0f) : *(const signed char*)p;
+        case 5121: return accessor.normalized ? *p / 255.0f : *p;
+        case 5122: {short x; memcpy(&x, p, 2); return accessor.normalized ? MAX(x / 32767.0f, -1.0f) : x;}
+        case 5123: {ushort x; memcpy(&x, p, 2); return accessor.normalized ? x / 65535.0f : x;}
+        case 5125: {uint x; memcpy(&x, p, 4); return x;}
+        default: {float x; memcpy(&x, p, 4); return x;}
+    }
+}
+
+static uint readIndex(const GltfAccessor &accessor, const uint element) {
+    const uchar *p = accessor.data + (size_t)element * accessor.stride;
+    switch (accessor.componentType) {
+        case 5121: return *p;
+        case 5123: {ushort x; memcpy(&x, p, 2); return x;}
+        default: {uint x; memcpy(&x, p, 4); return x;}
+    }
+}
+
+static GltfMatrix getNodeMatrix(const JsonValue &node) {
+    GltfMatrix matrix = GltfMatrix::identity();
+    const JsonValue &m = node["matrix"];
+    if (m.size() == 16) {
+        for (uint i = 0; i < 16; i++)
+            matrix.m[i] = m[i].toFloat(0.0f);
+        return matrix;
+    }
+
+    const JsonValue &t = node["translation"], &r = node["rotation"], &s = node["scale"];
+    const float x = r[0].toFloat(0.0f), y = r[1].toFloat(0.0f), z = r[2].toFloat(0.0f), w = r[3].toFloat(1.0f);
+    const float sx = s[0].toFloat(1.0f), sy = s[1].toFloat(1.0f), sz = s[2].toFloat(1.0f);
+    const float rotation[9] = {
+        1 - 2 * (y * y + z * z), 2 * (x * y + z * w),     2 * (x * z - y * w),
+        2 * (x * y - z * w),     1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+        2 * (x * z + y * w),     2 * (y * z - x * w),     1 - 2 * (x * x + y * y),
+    };
+    const float scale[3] = {sx, sy, sz};
+    for (uint c = 0; c < 3; c++)
+        for (uint l = 0; l < 3; l++)
+            matrix.m[c * 4 + l] = rotation[c * 3 + l] * scale[c];
+    for (uint l = 0; l < 3; l++)
+        matrix.m[12 + l] = t[l].toFloat(0.0f);
+    return matrix;
+}
+
+static void collectGltfDraws(const JsonValue &gltf, const int nodeIndex, const GltfMatrix &parent, std::vector<GltfDraw> &draws,
+    std::unordered_map<int, uint> &submeshIds, std::vector<SubmeshData> &submeshes, const uint depth) {
+    const JsonValue &node = gltf["nodes"][nodeIndex];
+    if (!node.valid() || depth > 64)
+        return;
+
+    const GltfMatrix matrix = parent * getNodeMatrix(node);
+    const JsonValue &primitives = gltf["meshes"][node["mesh"].toInt(-1)]["primitives"];
+    for (size_t i = 0; i < primitives.size(); i++) {
+        const JsonValue &primitive = primitives[i];
+        if (primitive["mode"].toInt(4) != 4) {
+            logWarning("glTF primitive of mode %d skipped, only triangle lists are supported", primitive["mode"].toInt(4));
+            continue;
+        }
+
+        const int material = primitive["material"].toInt(-1);
+        auto it = submeshIds.emplace(material, submeshes.size());
+        if (it.second) {
+            submeshes.emplace_back();
+            const JsonValue &name = gltf["materials"][material]["name"];
+            submeshes.back().material = name.type == JsonValue::String ? name.string : material < 0 ? "" : "material" + std::to_string(material);
+        }
+        draws.push_back({&primitive, matrix, it.first->second, 0, 0});
+    }
+
+    const JsonValue &children = node["children"];
+    for (size_t i = 0; i < children.size(); i++)
+        collectGltfDraws(gltf, children[i].toInt(-1), matrix, draws, submeshIds, submeshes, depth + 1);
+}
+
+static bool decodeGltfDraw(const JsonValue &gltf, const uchar *bin, const size_t binSize, const GltfDraw &draw, SubmeshData &submesh) {
+    const JsonValue &attributes = (*draw.primitive)["attributes"];
+    GltfAccessor positions, normals, uvs, indices;
+    const bool hasNormals = attributes["NORMAL"].valid(), hasUvs = attributes["TEXCOORD_0"].valid(), indexed = (*draw.primitive)["indices"].valid();
+    if (!getAccessor(gltf, bin, binSize, attributes["POSITION"].toInt(-1), 3, positions) ||
+        (hasNormals && !getAccessor(gltf, bin, binSize, attributes["NORMAL"].toInt(-1), 3, normals)) ||
+        (hasUvs && !getAccessor(gltf, bin, binSize, attributes["TEXCOORD_0"].toInt(-1), 2, uvs)) ||
+        (indexed && !getAccessor(gltf, bin, binSize, (*draw.primitive)["indices"].toInt(-1), 1, indices)))
+        return false;
+
+    // Normals go through the cofactor matrix, mirroring transforms flip the winding
+    const float *m = draw.matrix.m;
+    const float cofactor[9] = {
+        m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+        m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+        m[1] * m[6] - m[2] * m[5],  m[2] * m[4] - m[0] * m[6],  m[0] * m[5] - m[1] * m[4],
+    };
+    const bool mirrored = m[0] * cofactor[0] + m[1] * cofactor[1] + m[2] * cofactor[2] < 0.0f;
+
+    const uint nbVertices = positions.count;
+    for (uint i = 0; i < nbVertices; i++) {
+        const float x = readComponent(positions, i, 0), y = readComponent(positions, i, 1), z = readComponent(positions, i, 2);
+        float *position = &submesh.positions[(draw.firstVertex + i) * 3];
+        for (uint l = 0; l < 3; l++)
+            position[l] = m[l] * x + m[4 + l] * y + m[8 + l] * z + m[12 + l];
+
+        float *uv = &submesh.uvs[(draw.firstVertex + i) * 2];
+        uv[0] = hasUvs && i < uvs.count ? readComponent(uvs, i, 0) : 0.0f;
+        uv[1] = hasUvs && i < uvs.count ? readComponent(uvs, i, 1) : 0.0f;
+
+        if (hasNormals && i < normals.count) {
+            const float nx = readComponent(normals, i, 0), ny = readComponent(normals, i, 1), nz = readComponent(normals, i, 2);
+            Float4 n = float4(
+                cofactor[0] * nx + cofactor[3] * ny + cofactor[6] * nz,
+                cofactor[1] * nx + cofactor[4] * ny + cofactor[7] * nz,
+                cofactor[2] * nx + cofactor[5] * ny + cofactor[8] * nz, 0.0f);
+            n = sqlength3(n) > 0.0f ? normalize3(n) : float4(0.0f, 0.0f, 1.0f, 0.0f);
+            memcpy(&submesh.normals[(draw.firstVertex + i) * 3], &n, 3 * sizeof(float));
+        }
+    }
+
+    const uint nbIndices = indexed ? indices.count : nbVertices;
+    for (uint i = 0; i + 2 < nbIndices; i += 3) {
+        for (uint j = 0; j < 3; j++) {
+            uint index = indexed ? readIndex(indices, i + (mirrored && j ? 3 - j : j)) : i + (mirrored && j ? 3 - j : j);
+            if (index >= nbVertices)
+                index = 0;
+            submesh.indices[draw.firstIndex + i + j] = draw.firstVertex + index;
+        }
+    }
+
+    return true;
+}
+
+static bool parseGlb(const uchar *data, const size_t size, ModelData &model) {
+    uint header[5];
+    if (size < sizeof(header) || (memcpy(header, data, sizeof(header)), header[0] != GLB_MAGIC) || header[1] != 2 || header[4] != GLB_JSON ||
+        header[3] > size - sizeof(header)) {
+        logError("Invalid binary glTF 2.0 file");
+        return false;
+    }
+
+    const char *json = (const char*)data + sizeof(header);
+    const size_t jsonSize = header[3];
+    const uchar *bin = nullptr;
+    size_t binSize = 0;
+    const size_t binHeader = sizeof(header) + jsonSize;
+    uint chunk[2];
+    if (binHeader + sizeof(chunk) <= size && (memcpy(chunk, data + binHeader, sizeof(chunk)), chunk[1] == GLB_BIN)) {
+        bin = data + binHeader + sizeof(chunk);
+        binSize = MIN((size_t)chunk[0], size - binHeader - sizeof(chunk));
+    }
+
+    JsonValue gltf;
+    JsonReader reader = {json, json + jsonSize};
+    if (!reader.parse(gltf, 0) || gltf.type != JsonValue::Object) {
+        logError("Invalid glTF JSON chunk");
+        return false;
+    }
+
+    // Roots of the default scene, or every node that isn't a child without scenes
+    std::vector<int> roots;
+    const JsonValue &scene = gltf["scenes"][gltf["scene"].toInt(0)];
+    if (scene.valid()) {
+        for (size_t i = 0; i < scene["nodes"].size(); i++)
+            roots.push_back(scene["nodes"][i].toInt(-1));
+    } else {
+        std::vector<bool> isChild(gltf["nodes"].size(), false);
+        for (size_t i = 0; i < gltf["nodes"].size(); i++)
+            for (size_t j = 0; j < gltf["nodes"][i]["children"].size(); j++)
+                if (gltf["nodes"][i]["children"][j].toInt(-1) >= 0 && (size_t)gltf["nodes"][i]["children"][j].toInt(-1) < isChild.size())
+                    isChild[gltf["nodes"][i]["children"][j].toInt(-1)] = true;
+        for (size_t i = 0; i < isChild.size(); i++)
+            if (!isChild[i])
+                roots.push_back(i);
+    }
+
+    std::vector<GltfDraw> draws;
+    std::unordered_map<int, uint> submeshIds;
+    std::vector<SubmeshData> submeshes;
+    for (int root : roots)
+        collectGltfDraws(gltf, root, GltfMatrix::identity(), draws, submeshIds, submeshes, 0);
+
+    // Room of every draw in its submesh, then the draws are decoded in parallel
+    std::vector<uint64_t> nbVertices(submeshes.size(), 0), nbIndices(submeshes.size(), 0);
+    std::vector<bool> computeNormalsOf(draws.size(), false);
+    for (uint i = 0; i < draws.size(); i++) {
+        const JsonValue &primitive = *draws[i].primitive;
+        const uint64_t vertices = gltf["accessors"][primitive["attributes"]["POSITION"].toInt(-1)]["count"].toUInt64(0);
+        const uint64_t indices = primitive["indices"].valid() ? gltf["accessors"][primitive["indices"].toInt(-1)]["count"].toUInt64(0) : vertices;
+        if (nbVertices[draws[i].submesh] + vertices > UINT32_MAX || nbIndices[draws[i].submesh] + indices > UINT32_MAX) {
+            logError("glTF material with more than 2^32 vertices or indices");
+            return false;
+        }
+        draws[i].firstVertex = nbVertices[draws[i].submesh];
+        draws[i].firstIndex = nbIndices[draws[i].submesh];
+        draws[i].nbVertices = vertices;
+        draws[i].nbIndices = indices / 3 * 3;
+        nbVertices[draws[i].submesh] += draws[i].nbVertices;
+        nbIndices[draws[i].submesh] += draws[i].nbIndices;
+        computeNormalsOf[i] = !primitive["attributes"]["NORMAL"].valid();
+    }
+    for (uint s = 0; s < submeshes.size(); s++) {
+        submeshes[s].positions.resize(nbVertices[s] * 3);
+        submeshes[s].normals.resize(nbVertices[s] * 3);
+        submeshes[s].uvs.resize(nbVertices[s] * 2);
+        submeshes[s].indices.resize(nbIndices[s]);
+    }
+
+    std::atomic<bool> success(true);
+    parallelFor(draws.size(), 1, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++)
+            if (!decodeGltfDraw(gltf, bin, binSize, draws[i], submeshes[draws[i].submesh]))
+                success = false;
+    });
+    if (!success)
+        return false;
+
+    // Primitives without normals are smoothed over their own triangles only
+    for (uint i = 0; i < draws.size(); i++) {
+        if (!computeNormalsOf[i])
+            continue;
+
+        SubmeshData &submesh = submeshes[draws[i].submesh];
+        const GltfDraw &range = draws[i];
+        SubmeshData draw;
+        draw.positions.assign(submesh.positions.begin() + (size_t)range.firstVertex * 3, submesh.positions.begin() + (size_t)(range.firstVertex + range.nbVertices) * 3);
+        draw.normals.resize(draw.positions.size());
+        for (uint j = range.firstIndex; j < range.firstIndex + range.nbIndices; j++)
+            draw.indices.push_back(submesh.indices[j] - range.firstVertex);
+        computeNormals(draw, 0, 0);
+        std::copy(draw.normals.begin(), draw.normals.end(), submesh.normals.begin() + draws[i].firstVertex * 3);
+    }
+
+    mergeSubmeshes(submeshes, model);
+    return !model.indices.empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Binary cache, the arrays are aligned so the mapping is uploaded as is
+
+static uint64_t getCacheKey(const char *filename) {
+    struct stat info;
+    if (stat(filename, &info) != 0)
+        return 0;
+
+    const uint64_t size = info.st_size, time = info.st_mtime, version = CACHE_VERSION;
+    uint64_t key = hashData(filename, strlen(filename), 0xCBF29CE484222325ull);
+    key = hashData(&size, sizeof(size), key);
+    key = hashData(&time, sizeof(time), key);
+    return hashData(&version, sizeof(version), key);
+}
+
+static std::string getCacheFilename(const uint64_t key) {
+    char name[32];
+    sprintf(name, "%08x%08x.model", (uint)(key >> 32), (uint)key);
+    return joinPath(cacheDir, name);
+}
+
+static void writeCache(const uint64_t key, const ModelData &model) {
+    if (cacheDir.empty() || !key)
+        return;
+
+    // Written aside then renamed, so a crash or a concurrent load never maps a partial cache
+    static std::atomic<uint> nbWrites(0);
+    const std::string filename = getCacheFilename(key);
+    const std::string temporary = filename + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "." + std::to_string(nbWrites++) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        makeDirectory(cacheDir.c_str());
+        file = fopen(temporary.c_str(), "wb");
+    }
+    if (!file) {
+        logWarning("Can't write the model cache \"%s\"", filename.c_str());
+        return;
+    }
+
+    const uint nbVertices = model.positions.size() / 3;
+    CacheHeader header = {CACHE_MAGIC, CACHE_VERSION, key, nbVertices, (uint)model.indices.size(), (uint)model.submeshes.size(),
+        nbVertices <= 65536 ? 2u : 4u, {model.min[0], model.min[1], model.min[2], 0.0f}, {model.max[0], model.max[1], model.max[2], 0.0f}};
+    std::vector<CacheSubmesh> submeshes(model.submeshes.size());
+    for (uint i = 0; i < submeshes.size(); i++) {
+        submeshes[i].range = model.submeshes[i];
+        strncpy(submeshes[i].material, model.materials[i].c_str(), MATERIAL_NAME_SIZE - 1);
+    }
+
+    std::vector<ushort> indices16;
+    if (header.indexSize == 2)
+        indices16.assign(model.indices.begin(), model.indices.end());
+
+    const uchar padding[CACHE_ALIGNMENT] = {};
+    size_t offset = 0;
+    auto write = [&](const void *data, const size_t size) {
+        fwrite(data, 1, size, file);
+        fwrite(padding, 1, alignCache(offset + size) - offset - size, file);
+        offset = alignCache(offset + size);
+    };
+    write(&header, sizeof(header));
+    write(submeshes.data(), submeshes.size() * sizeof(CacheSubmesh));
+    write(model.positions.data(), model.positions.size() * sizeof(float));
+    write(model.normals.data(), model.normals.size() * sizeof(float));
+    write(model.uvs.data(), model.uvs.size() * sizeof(float));
+    if (header.indexSize == 2)
+        write(indices16.data(), indices16.size() * sizeof(ushort));
+    else
+        write(model.indices.data(), model.indices.size() * sizeof(uint));
+
+    bool success = !ferror(file);
+    success &= fclose(file) == 0;
+#ifdef _WIN32
+    success = success && MoveFileExA(temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    success = success && rename(temporary.c_str(), filename.c_str()) == 0;
+#endif
+    if (!success) {
+        logWarning("Can't write the model cache \"%s\"", filename.c_str());
+        remove(temporary.c_str());
+    }
+}
+
+static ModelImpl* loadCache(const uint64_t key) {
+    MappedFile mapped;
+    if (cacheDir.empty() || !key || !mapFile(getCacheFilename(key).c_str(), mapped))
+        return nullptr;
+
+    CacheHeader header;
+    if (mapped.size < sizeof(header) || (memcpy(&header, mapped.data, sizeof(header)), header.magic != CACHE_MAGIC) ||
+        header.version != CACHE_VERSION || header.key != key || (header.indexSize != 2 && header.indexSize != 4)) {
+        unmapFile(mapped);
+        return nullptr;
+    }
+
+    const size_t submeshOffset = alignCache(sizeof(header));
+    const size_t positionOffset = submeshOffset + alignCache((size_t)header.nbSubmeshes * sizeof(CacheSubmesh));
+    const size_t normalOffset = positionOffset + alignCache((size_t)header.nbVertices * 3 * sizeof(float));
+    const size_t uvOffset = normalOffset + alignCache((size_t)header.nbVertices * 3 * sizeof(float));
+    const size_t indexOffset = uvOffset + alignCache((size_t)header.nbVertices * 2 * sizeof(float));
+    if (mapped.size != indexOffset + alignCache((size_t)header.nbIndices * header.indexSize)) {
+        unmapFile(mapped);
+        return nullptr;
+    }
+
+    // A corrupt cache is a miss rather than draws out of the buffers
+    const CacheSubmesh *submeshes = (const CacheSubmesh*)(mapped.data + submeshOffset);
+    bool valid = header.nbIndices % 3 == 0;
+    for (uint i = 0; valid && i < header.nbSubmeshes; i++)
+        valid = submeshes[i].range.first <= header.nbIndices && submeshes[i].range.count <= header.nbIndices - submeshes[i].range.first;
+    for (uint i = 0; valid && i < header.nbIndices; i++)
+        valid = (header.indexSize == 2 ? ((const ushort*)(mapped.data + indexOffset))[i] : ((const uint*)(mapped.data + indexOffset))[i]) < header.nbVertices;
+    if (!valid) {
+        logWarning("Invalid model cache \"%s\"", getCacheFilename(key).c_str());
+        unmapFile(mapped);
+        return nullptr;
+    }
+
+    ModelImpl *model = new ModelImpl();
+    model->min = float4(header.min[0], header.min[1], header.min[2], 0.0f);
+    model->max = float4(header.max[0], header.max[1], header.max[2], 0.0f);
+    for (uint i = 0; i < header.nbSubmeshes; i++) {
+        model->submeshes.push_back(submeshes[i].range);
+        model->materials.push_back(std::string(submeshes[i].material, strnlen(submeshes[i].material, MATERIAL_NAME_SIZE)));
+    }
+
+    model->mesh = createMesh(PrimitiveType_Triangles);
+    addMeshAttrib(model->mesh, RGB32_FLOAT, false, mapped.data + positionOffset, header.nbVertices);
+    addMeshAttrib(model->mesh, RGB32_FLOAT, false, mapped.data + normalOffset, header.nbVertices);
+    addMeshAttrib(model->mesh, RG32_FLOAT, false, mapped.data + uvOffset, header.nbVertices);
+    if (header.indexSize == 2)
+        setMeshIndices16(model->mesh, (const ushort*)(mapped.data + indexOffset), header.nbIndices);
+    else
+        setMeshIndices(model->mesh, (const uint*)(mapped.data + indexOffset), header.nbIndices);
+
+    unmapFile(mapped);
+    return model;
+}
+
+static ModelImpl* uploadModel(const ModelData &data) {
+    ModelImpl *model = new ModelImpl();
+    model->submeshes = data.submeshes;
+    model->materials = data.materials;
+    model->min = data.min;
+    model->max = data.max;
+
+    const uint nbVertices = data.positions.size() / 3;
+    model->mesh = createMesh(PrimitiveType_Triangles);
+    addMeshAttrib(model->mesh, RGB32_FLOAT, false, data.positions.data(), nbVertices);
+    addMeshAttrib(model->mesh, RGB32_FLOAT, false, data.normals.data(), nbVertices);
+    addMeshAttrib(model->mesh, RG32_FLOAT, false, data.uvs.data(), nbVertices);
+    setMeshIndicesCompact(model->mesh, data.indices.data(), data.indices.size(), nbVertices);
+    return model;
+}
+
+// Case insensitive, strcasecmp isn't declared by every C runtime
+static bool isExtension(const char *extension, const char *lowercase) {
+    for (; *extension && tolower((uchar)*extension) == *lowercase; extension++, lowercase++);
+    return !*extension && !*lowercase;
+}
+
+extern "C" {
+
+Model loadModel(const char *filename) {
+    const auto start = std::chrono::steady_clock::now();
+    const char *extension = filename ? strrchr(filename, '.') : nullptr;
+    const bool obj = extension && isExtension(extension, ".obj"), glb = extension && isExtension(extension, ".glb");
+    if (!obj && !glb) {
+        logError("Unsupported model \"%s\", only .obj and .glb files can be loaded", filename ? filename : "");
+        return Model{nullptr};
+    }
+
+    const uint64_t key = getCacheKey(filename);
+    ModelImpl *model = loadCache(key);
+    const bool cached = model != nullptr;
+    if (!model) {
+        MappedFile mapped;
+        if (!mapFile(filename, mapped)) {
+            logError("Can't read the model \"%s\"", filename);
+            return Model{nullptr};
+        }
+
+        ModelData data;
+        const bool success = obj ? parseObj((const char*)mapped.data, mapped.size, data) : parseGlb(mapped.data, mapped.size, data);
+        unmapFile(mapped);
+        if (!success) {
+            logError("No triangles loaded from \"%s\"", filename);
+            return Model{nullptr};
+        }
+
+        writeCache(key, data);
+        model = uploadModel(data);
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    logInfo("Model \"%s\" %s in %.0f ms: %u triangles, %u vertices, %u submeshes", filename, cached ? "mapped from its cache" : "parsed",
+        ms, getNbIndices(model->mesh) / 3, getNbVertices(model->mesh), (uint)model->submeshes.size());
+    return Model{model};
+}
+
+void deleteModel(Model *model) {
+    if (!model || !model->impl)
+        return;
+
+    ModelImpl *impl = getModel(*model);
+    deleteMesh(&impl->mesh);
+    delete impl;
+    model->impl = nullptr;
+}
+
+Mesh getModelMesh(Model model) {
+    ModelImpl *impl = getModel(model);
+    return impl ? impl->mesh : NullMesh;
+}
+
+const Range* getModelSubmeshes(Model model, uint *nbSubmeshes) {
+    ModelImpl *impl = getModel(model);
+    if (nbSubmeshes)
+        *nbSubmeshes = impl ? impl->submeshes.size() : 0;
+    return impl ? impl->submeshes.data() : nullptr;
+}
+
+const char* getModelMaterial(Model model, const uint submesh) {
+    ModelImpl *impl = getModel(model);
+    return impl && submesh < impl->materials.size() ? impl->materials[submesh].c_str() : nullptr;
+}
+
+void getModelBounds(Model model, Float4 *min, Float4 *max) {
+    ModelImpl *impl = getModel(model);
+    if (min) *min = impl ? impl->min : float1(0.0f);
+    if (max) *max = impl ? impl->max : float1(0.0f);
+}
+
+void setModelCacheDir(const char *dir) {
+    cacheDir = dir ? dir : "";
+}
+
+}
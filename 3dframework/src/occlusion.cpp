@@ -0,0 +1,301 @@
+#include <occlusion.h>
+#include <string.h>
+#include "private_log.h"
+#include "private_parallel.h"
+
+// Tiles of the hierarchy, a tile row is one Float8
+#define TILE_WIDTH  8
+#define TILE_HEIGHT 4
+#define BAND_HEIGHT 16
+#define OCCLUDEE_GRAIN 1024
+
+// Screen space setup, the edge functions are positive inside and the depth is affine in x and y
+typedef struct {
+    float edgeX[3], edgeY[3], edgeC[3];
+    float depthX, depthY, depthC;
+    int minX, maxX, minY, maxY; // inclusive pixel bounds
+} OccluderTriangle;
+
+typedef struct {
+    uint width, height;
+    float *depth;     // row major, 32 bytes aligned
+    float *tileDepth; // farthest depth of each tile
+    Mat4 viewProjection;
+    std::vector<OccluderTriangle> triangles;
+} OcclusionBufferImpl;
+
+static OcclusionBufferImpl* getOcclusionBuffer(OcclusionBuffer buffer) {return (OcclusionBufferImpl*)buffer.impl;}
+
+static const Float8 laneOffsets = {0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f};
+static const Float8 cornerSigns[3] = {
+    {-1.0f,  1.0f, -1.0f,  1.0f, -1.0f,  1.0f, -1.0f,  1.0f},
+    {-1.0f, -1.0f,  1.0f,  1.0f, -1.0f, -1.0f,  1.0f,  1.0f},
+    {-1.0f, -1.0f, -1.0f, -1.0f,  1.0f,  1.0f,  1.0f,  1.0f},
+};
+
+static inline float reduceMin(const Float8 v) {
+    Float4 m = _mm_min_ps(_mm256_castps256_ps128((__m256)v), _mm256_extractf128_ps((__m256)v, 1));
+    m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+    return _mm_min_ss(m, _mm_shuffle_ps(m, m, 0x01))[0];
+}
+
+static inline float reduceMax(const Float8 v) {
+    Float4 m = _mm_max_ps(_mm256_castps256_ps128((__m256)v), _mm256_extractf128_ps((__m256)v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    return _mm_max_ss(m, _mm_shuffle_ps(m, m, 0x01))[0];
+}
+
+// Pixel coordinates with y going up like the NDC, occluders and tests only have to agree
+static inline Float4 toScreen(const OcclusionBufferImpl *impl, const Float4 clip) {
+    const Float4 ndc = clip / clip[3];
+    return float4((ndc[0] * 0.5f + 0.5f) * impl->width, (ndc[1] * 0.5f + 0.5f) * impl->height, ndc[2], 1.0f);
+}
+
+static void setupTriangle(OcclusionBufferImpl *impl, Float4 v0, Float4 v1, Float4 v2) {
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+    if (!(fabsf(area) > 0.0f))
+        return;
+
+    // Both windings are occluders
+    if (area < 0.0f) {
+        const Float4 v = v1; v1 = v2; v2 = v;
+        area = -area;
+    }
+
+    OccluderTriangle t;
+    t.minX = MAX((int)floorf(MIN(MIN(v0[0], v1[0]), v2[0])), 0);
+    t.maxX = MIN((int)ceilf (MAX(MAX(v0[0], v1[0]), v2[0])), (int)impl->width - 1);
+    t.minY = MAX((int)floorf(MIN(MIN(v0[1], v1[1]), v2[1])), 0);
+    t.maxY = MIN((int)ceilf (MAX(MAX(v0[1], v1[1]), v2[1])), (int)impl->height - 1);
+    if (t.minX > t.maxX || t.minY > t.maxY)
+        return;
+
+    const Float4 v[3] = {v0, v1, v2};
+    for (int e = 0; e < 3; e++) {
+        const Float4 p = v[e], q = v[(e + 1) % 3];
+        t.edgeX[e] = p[1] - q[1];
+        t.edgeY[e] = q[0] - p[0];
+        t.edgeC[e] = -(t.edgeX[e] * p[0] + t.edgeY[e] * p[1]);
+    }
+
+    const float dz1 = v1[2] - v0[2], dz2 = v2[2] - v0[2];
+    t.depthX = (dz1 * (v2[1] - v0[1]) - dz2 * (v1[1] - v0[1])) / area;
+    t.depthY = (dz2 * (v1[0] - v0[0]) - dz1 * (v2[0] - v0[0])) / area;
+    t.depthC = v0[2] - t.depthX * v0[0] - t.depthY * v0[1];
+
+    impl->triangles.push_back(t);
+}
+
+// Keeps the nearest depth, the largest one with reversed-Z
+static void rasterizeBand(OcclusionBufferImpl *impl, const int bandMin, const int bandMax) {
+    for (const OccluderTriangle &t : impl->triangles) {
+        const int minY = MAX(t.minY, bandMin), maxY = MIN(t.maxY, bandMax - 1);
+        if (minY > maxY)
+            continue;
+
+        for (int y = minY; y <= maxY; y++) {
+            const float py = y + 0.5f;
+            const float
+                row0 = t.edgeY[0] * py + t.edgeC[0],
+                row1 = t.edgeY[1] * py + t.edgeC[1],
+                row2 = t.edgeY[2] * py + t.edgeC[2],
+                rowDepth = t.depthY * py + t.depthC;
+
+            float *line = impl->depth + y * impl->width;
+            for (int x = t.minX & ~(TILE_WIDTH - 1); x <= t.maxX; x += TILE_WIDTH) {
+                const Float8 px = laneOffsets + (float)x;
+                const Int8 inside =
+                    (px * t.edgeX[0] + row0 >= 0.0f) &
+                    (px * t.edgeX[1] + row1 >= 0.0f) &
+                    (px * t.edgeX[2] + row2 >= 0.0f);
+                if (_mm256_testz_ps((__m256)inside, (__m256)inside))
+                    continue;
+
+                const Float8 depth = *(Float8*)(line + x);
+                const Float8 z = px * t.depthX + rowDepth;
+                *(Float8*)(line + x) = inside & (z > depth) ? z : depth;
+            }
+        }
+    }
+
+    // Tiles of the band
+    const uint tilesPerRow = impl->width / TILE_WIDTH;
+    for (int y = bandMin; y < bandMax; y += TILE_HEIGHT)
+        for (uint x = 0; x < impl->width; x += TILE_WIDTH) {
+            Float8 farthest = *(Float8*)(impl->depth + y * impl->width + x);
+            for (int row = 1; row < TILE_HEIGHT; row++)
+                farthest = (Float8)_mm256_min_ps((__m256)farthest, *(__m256*)(impl->depth + (y + row) * impl->width + x));
+
+            float tileDepth = farthest[0];
+            for (int lane = 1; lane < 8; lane++)
+                tileDepth = MIN(tileDepth, farthest[lane]);
+            impl->tileDepth[y / TILE_HEIGHT * tilesPerRow + x / TILE_WIDTH] = tileDepth;
+        }
+}
+
+extern "C" {
+
+OcclusionBuffer createOcclusionBuffer(const uint width, const uint height) {
+    if (width == 0 || height == 0) {
+        logError("Creating an empty occlusion buffer");
+        return OcclusionBuffer{nullptr};
+    }
+
+    OcclusionBufferImpl *impl = new OcclusionBufferImpl();
+    impl->width = (width + TILE_WIDTH - 1) & ~(TILE_WIDTH - 1);
+    impl->height = (height + TILE_HEIGHT - 1) & ~(TILE_HEIGHT - 1);
+    impl->depth = (float*)aligned_malloc(impl->width * impl->height * sizeof(float));
+    impl->tileDepth = (float*)aligned_malloc(impl->width / TILE_WIDTH * impl->height / TILE_HEIGHT * sizeof(float));
+    mat1(impl->viewProjection, 1.0f);
+
+    // Nothing occludes until the first endOcclusion
+    memset(impl->depth, 0, impl->width * impl->height * sizeof(float));
+    memset(impl->tileDepth, 0, impl->width / TILE_WIDTH * impl->height / TILE_HEIGHT * sizeof(float));
+    return OcclusionBuffer{impl};
+}
+
+void deleteOcclusionBuffer(OcclusionBuffer *buffer) {
+    if (!buffer || !buffer->impl)
+        return;
+
+    OcclusionBufferImpl *impl = getOcclusionBuffer(*buffer);
+    aligned_free(impl->depth);
+    aligned_free(impl->tileDepth);
+    delete impl;
+    buffer->impl = nullptr;
+}
+
+void beginOcclusion(OcclusionBuffer buffer, Mat4 viewProjection) {
+    OcclusionBufferImpl *impl = getOcclusionBuffer(buffer);
+    if (!impl)
+        return;
+
+    copym4(impl->viewProjection, viewProjection);
+    impl->triangles.clear();
+}
+
+void addOccluders(OcclusionBuffer buffer, Mat4 model, const void *positions, const uint positionStride, const uint nbVertices, const uint *indices, const uint nbIndices) {
+    OcclusionBufferImpl *impl = getOcclusionBuffer(buffer);
+    if (!impl || !positions)
+        return;
+
+    Mat4 modelViewProjection;
+    multiplytm4(modelViewProjection, impl->viewProjection, model);
+
+    const uint count = indices ? nbIndices : nbVertices;
+    for (uint i = 0; i + 2 < count; i += 3) {
+        Float4 v[3];
+        bool nearClipped = false;
+        for (int k = 0; k < 3; k++) {
+            const uint index = indices ? indices[i + k] : i + k;
+            if (index >= nbVertices) {
+                logError("Occluder index %u out of %u vertices", index, nbVertices);
+                return;
+            }
+
+            const float *p = (const float*)((const char*)positions + (ulong)index * positionStride);
+            const Float4 clip = transformtm4(modelViewProjection, float4(p[0], p[1], p[2], 1.0f));
+            // Reversed Z puts the near plane at z = w, points before it or behind the eye have z > w
+            nearClipped |= clip[2] > clip[3];
+            v[k] = toScreen(impl, clip);
+        }
+
+        if (!nearClipped)
+            setupTriangle(impl, v[0], v[1], v[2]);
+    }
+}
+
+void endOcclusion(OcclusionBuffer buffer) {
+    OcclusionBufferImpl *impl = getOcclusionBuffer(buffer);
+    if (!impl)
+        return;
+
+    memset(impl->depth, 0, impl->width * impl->height * sizeof(float));
+    const uint nbBands = (impl->height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    parallelFor(nbBands, 1, [&](const uint begin, const uint end) {
+        for (uint band = begin; band < end; band++)
+            rasterizeBand(impl, band * BAND_HEIGHT, MIN((band + 1) * BAND_HEIGHT, impl->height));
+    });
+}
+
+bool isBoxOccluded(OcclusionBuffer buffer, const Float4 center, const Float4 extent) {
+    OcclusionBufferImpl *impl = getOcclusionBuffer(buffer);
+    if (!impl)
+        return false;
+
+    // Clip coordinates of the 8 corners, one per lane
+    Mat4 axes;
+    const Float4 clipCenter = transformtm4(impl->viewProjection, float4(center[0], center[1], center[2], 1.0f));
+    axes[0] = impl->viewProjection[0] * extent[0];
+    axes[1] = impl->viewProjection[1] * extent[1];
+    axes[2] = impl->viewProjection[2] * extent[2];
+
+    Float8 clip[4];
+    for (int k = 0; k < 4; k++)
+        clip[k] = clipCenter[k] + cornerSigns[0] * axes[0][k] + cornerSigns[1] * axes[1][k] + cornerSigns[2] * axes[2][k];
+
+    const Int8 nearClipped = clip[2] > clip[3];
+    if (!_mm256_testz_ps((__m256)nearClipped, (__m256)nearClipped))
+        return false;
+
+    const Float8 invW = 1.0f / clip[3];
+    const Float8
+        x = (clip[0] * invW * 0.5f + 0.5f) * (float)impl->width,
+        y = (clip[1] * invW * 0.5f + 0.5f) * (float)impl->height;
+    const float left = reduceMin(x), right = reduceMax(x), bottom = reduceMin(y), top = reduceMax(y);
+    if (right < 0.0f || top < 0.0f || left >= impl->width || bottom >= impl->height)
+        return true;
+
+    const int
+        minX = MAX((int)left  , 0), maxX = MIN((int)right, (int)impl->width  - 1),
+        minY = MAX((int)bottom, 0), maxY = MIN((int)top  , (int)impl->height - 1);
+    const float nearest = reduceMax(clip[2] * invW);
+    const uint tilesPerRow = impl->width / TILE_WIDTH;
+
+    for (int ty = minY / TILE_HEIGHT; ty <= maxY / TILE_HEIGHT; ty++)
+        for (int tx = minX / TILE_WIDTH; tx <= maxX / TILE_WIDTH; tx++) {
+            if (impl->tileDepth[ty * tilesPerRow + tx] > nearest)
+                continue;
+
+            // Partially covered tile, down to the pixels of the rectangle
+            const Float8 px = laneOffsets + (float)(tx * TILE_WIDTH);
+            const Int8 columns = (px > (float)minX) & (px < (float)(maxX + 1));
+            for (int y = MAX(ty * TILE_HEIGHT, minY); y <= MIN(ty * TILE_HEIGHT + TILE_HEIGHT - 1, maxY); y++) {
+                const Float8 depth = *(Float8*)(impl->depth + y * impl->width + tx * TILE_WIDTH);
+                const Int8 visible = columns & (depth <= nearest);
+                if (!_mm256_testz_ps((__m256)visible, (__m256)visible))
+                    return false;
+            }
+        }
+
+    return true;
+}
+
+uint cullOccludedBoxes(OcclusionBuffer buffer, const BoundingBoxes boxes, uint *indices, const uint n) {
+    // Chunks are filtered in place in parallel, then packed in order
+    const uint nbChunks = (n + OCCLUDEE_GRAIN - 1) / OCCLUDEE_GRAIN;
+    std::vector<uint> counts(nbChunks);
+
+    parallelFor(n, OCCLUDEE_GRAIN, [&](const uint begin, const uint end) {
+        uint count = begin;
+        for (uint i = begin; i < end; i++) {
+            const uint index = indices[i];
+            const Float4 center = float4(boxes.x[index], boxes.y[index], boxes.z[index], 0.0f);
+            const Float4 extent = float4(boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index], 0.0f);
+            if (!isBoxOccluded(buffer, center, extent))
+                indices[count++] = index;
+        }
+        counts[begin / OCCLUDEE_GRAIN] = count - begin;
+    });
+
+    uint total = 0;
+    for (uint chunk = 0; chunk < nbChunks; chunk++) {
+        if (total != chunk * OCCLUDEE_GRAIN)
+            memmove(indices + total, indices + chunk * OCCLUDEE_GRAIN, counts[chunk] * sizeof(uint));
+        total += counts[chunk];
+    }
+
+    return total;
+}
+
+}
@@ -0,0 +1,202 @@
+// Kernels of batch_math.c, included once per instruction set under its target pragma with
+// LANES floats per register, KERNEL(name) suffixing the symbols and STREAM storing a register.
+
+#define Vec  KERNEL(Vec)
+#define VecU KERNEL(VecU)
+#define IVec KERNEL(IVec)
+#define PER_VEC (LANES / 4) // Float4 per register
+
+typedef float Vec  __attribute__((vector_size(LANES * 4)));
+typedef float VecU __attribute__((vector_size(LANES * 4), aligned(16), may_alias));
+typedef int   IVec __attribute__((vector_size(LANES * 4)));
+
+#if LANES == 4
+    #define GROUP_MASK(a, b, c, d) {a, b, c, d}
+    #define COMBINE(p0, p1, p2, p3) (p0)
+#elif LANES == 8
+    #define GROUP_MASK(a, b, c, d) {a, b, c, d, a + 4, b + 4, c + 4, d + 4}
+    #define COMBINE(p0, p1, p2, p3) __builtin_shufflevector(p0, p1, 0, 1, 2, 3, 4, 5, 6, 7)
+#elif LANES == 16
+    #define GROUP_MASK(a, b, c, d) {a, b, c, d, a + 4, b + 4, c + 4, d + 4, a + 8, b + 8, c + 8, d + 8, a + 12, b + 12, c + 12, d + 12}
+    #define COMBINE(p0, p1, p2, p3) __builtin_shufflevector( \
+        __builtin_shufflevector(p0, p1, 0, 1, 2, 3, 4, 5, 6, 7), \
+        __builtin_shufflevector(p2, p3, 0, 1, 2, 3, 4, 5, 6, 7), \
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+#endif
+
+// Same shuffle in every group of 4 lanes, the second operand starts at LANES
+#define shuffleGroups(u, v, a, b, c, d) __builtin_shuffle(u, v, (IVec)GROUP_MASK(a, b, c, d))
+// Component c of each Float4 of the register
+#define splat(v, c) __builtin_shuffle(v, (IVec)GROUP_MASK(c, c, c, c))
+#define absv(v) ((Vec)((IVec)(v) & 0x7FFFFFFF))
+#define repeat(v) COMBINE(v, v, v, v)
+// Column c of PER_VEC consecutive matrices
+#define gatherColumn(m, c) COMBINE((m)[0][c], (m)[1][c], (m)[2][c], (m)[3][c])
+
+// _MM_TRANSPOSE4_PS in each group of 4 lanes
+static inline void KERNEL(transposeGroups)(Vec q[4]) {
+    const Vec
+        t0 = shuffleGroups(q[0], q[1], 0, LANES    , 1, LANES + 1),
+        t1 = shuffleGroups(q[0], q[1], 2, LANES + 2, 3, LANES + 3),
+        t2 = shuffleGroups(q[2], q[3], 0, LANES    , 1, LANES + 1),
+        t3 = shuffleGroups(q[2], q[3], 2, LANES + 2, 3, LANES + 3);
+    q[0] = shuffleGroups(t0, t2, 0, 1, LANES    , LANES + 1);
+    q[1] = shuffleGroups(t0, t2, 2, 3, LANES + 2, LANES + 3);
+    q[2] = shuffleGroups(t1, t3, 0, 1, LANES    , LANES + 1);
+    q[3] = shuffleGroups(t1, t3, 2, 3, LANES + 2, LANES + 3);
+}
+
+static void KERNEL(transform)(Float4 *dst, const Float4 *src, const uint n, Mat4 m, const bool stream) {
+    const Vec
+        c0 = repeat(m[0]),
+        c1 = repeat(m[1]),
+        c2 = repeat(m[2]),
+        c3 = repeat(m[3]);
+
+    uint i = 0;
+    if (stream)
+        for (; i < n && ((uintptr_t)(dst + i) & (sizeof(Vec) - 1)); i++)
+            streamstore((float*)(dst + i), transformtm4(m, src[i]));
+
+    for (; i + PER_VEC <= n; i += PER_VEC) {
+        const Vec v = *(const VecU*)(src + i);
+        const Vec r = c0 * splat(v, 0) + c1 * splat(v, 1) + c2 * splat(v, 2) + c3 * splat(v, 3);
+        if (stream)
+            STREAM(dst + i, r);
+        else
+            *(VecU*)(dst + i) = r;
+    }
+
+    for (; i < n; i++)
+        if (stream)
+            streamstore((float*)(dst + i), transformtm4(m, src[i]));
+        else
+            dst[i] = transformtm4(m, src[i]);
+}
+
+static void KERNEL(multiplyPairs)(Mat4 *r, const Mat4 *a, const Mat4 *b, const uint n) {
+    for (uint i = 0; i < n; i++) {
+        const Vec
+            c0 = repeat(a[i][0]),
+            c1 = repeat(a[i][1]),
+            c2 = repeat(a[i][2]),
+            c3 = repeat(a[i][3]);
+
+        for (int j = 0; j < 4; j += PER_VEC) {
+            const Vec v = *(const VecU*)&b[i][j];
+            *(VecU*)&r[i][j] = c0 * splat(v, 0) + c1 * splat(v, 1) + c2 * splat(v, 2) + c3 * splat(v, 3);
+        }
+    }
+}
+
+// Cofactors from the 2x2 minors of LANES matrices, one per lane
+static inline void KERNEL(inverseBatch)(Mat4 *r, const Mat4 *m) {
+    Vec e[16];
+    for (int c = 0; c < 4; c++) {
+        for (int l = 0; l < 4; l++)
+            e[c * 4 + l] = COMBINE(m[l][c], m[l + 4][c], m[l + 8][c], m[l + 12][c]);
+        KERNEL(transposeGroups)(e + c * 4);
+    }
+
+    const Vec
+        s0 = e[ 0] * e[ 5] - e[ 4] * e[ 1],
+        s1 = e[ 0] * e[ 6] - e[ 4] * e[ 2],
+        s2 = e[ 0] * e[ 7] - e[ 4] * e[ 3],
+        s3 = e[ 1] * e[ 6] - e[ 5] * e[ 2],
+        s4 = e[ 1] * e[ 7] - e[ 5] * e[ 3],
+        s5 = e[ 2] * e[ 7] - e[ 6] * e[ 3],
+        t0 = e[ 8] * e[13] - e[12] * e[ 9],
+        t1 = e[ 8] * e[14] - e[12] * e[10],
+        t2 = e[ 8] * e[15] - e[12] * e[11],
+        t3 = e[ 9] * e[14] - e[13] * e[10],
+        t4 = e[ 9] * e[15] - e[13] * e[11],
+        t5 = e[10] * e[15] - e[14] * e[11];
+
+    const Vec det = s0 * t5 - s1 * t4 + s2 * t3 + s3 * t2 - s4 * t1 + s5 * t0;
+    const Vec rd = (Vec)((IVec)(1.0f / det) & (det != 0.0f));
+
+    Vec o[16];
+    o[ 0] =  e[ 5] * t5 - e[ 6] * t4 + e[ 7] * t3;
+    o[ 1] = -e[ 1] * t5 + e[ 2] * t4 - e[ 3] * t3;
+    o[ 2] =  e[13] * s5 - e[14] * s4 + e[15] * s3;
+    o[ 3] = -e[ 9] * s5 + e[10] * s4 - e[11] * s3;
+    o[ 4] = -e[ 4] * t5 + e[ 6] * t2 - e[ 7] * t1;
+    o[ 5] =  e[ 0] * t5 - e[ 2] * t2 + e[ 3] * t1;
+    o[ 6] = -e[12] * s5 + e[14] * s2 - e[15] * s1;
+    o[ 7] =  e[ 8] * s5 - e[10] * s2 + e[11] * s1;
+    o[ 8] =  e[ 4] * t4 - e[ 5] * t2 + e[ 7] * t0;
+    o[ 9] = -e[ 0] * t4 + e[ 1] * t2 - e[ 3] * t0;
+    o[10] =  e[12] * s4 - e[13] * s2 + e[15] * s0;
+    o[11] = -e[ 8] * s4 + e[ 9] * s2 - e[11] * s0;
+    o[12] = -e[ 4] * t3 + e[ 5] * t1 - e[ 6] * t0;
+    o[13] =  e[ 0] * t3 - e[ 1] * t1 + e[ 2] * t0;
+    o[14] = -e[12] * s3 + e[13] * s1 - e[14] * s0;
+    o[15] =  e[ 8] * s3 - e[ 9] * s1 + e[10] * s0;
+
+    for (int c = 0; c < 4; c++) {
+        union {Vec vec[4]; Float4 parts[4][PER_VEC];} u;
+        for (int l = 0; l < 4; l++)
+            u.vec[l] = o[c * 4 + l] * rd;
+        KERNEL(transposeGroups)(u.vec);
+
+        // Group g of row l is the column of matrix 4 * g + l
+        for (int g = 0; g < PER_VEC; g++)
+            for (int l = 0; l < 4; l++)
+                r[4 * g + l][c] = u.parts[l][g];
+    }
+}
+
+static void KERNEL(inverse)(Mat4 *r, const Mat4 *m, const uint n) {
+    uint i = 0;
+    for (; i + LANES <= n; i += LANES)
+        KERNEL(inverseBatch)(r + i, m + i);
+
+    // The last partial batch is padded with its last matrix
+    if (i < n) {
+        Mat4 src[LANES], dst[LANES];
+        for (uint l = 0; l < LANES; l++)
+            copym4(src[l], (Float4*)m[MIN(i + l, n - 1)]);
+        KERNEL(inverseBatch)(dst, (const Mat4*)src);
+        for (uint l = 0; i + l < n; l++)
+            copym4(r[i + l], dst[l]);
+    }
+}
+
+// Center and extents (Arvo), the extents go through the absolute values of the matrix
+static void KERNEL(transformAabbs)(Float4 *dstMin, Float4 *dstMax, const Float4 *srcMin, const Float4 *srcMax, const Mat4 *matrices, const uint n) {
+    uint i = 0;
+    for (; i + PER_VEC <= n; i += PER_VEC) {
+        const Vec
+            c0 = gatherColumn(matrices + i, 0),
+            c1 = gatherColumn(matrices + i, 1),
+            c2 = gatherColumn(matrices + i, 2),
+            c3 = gatherColumn(matrices + i, 3);
+
+        const Vec lo = *(const VecU*)(srcMin + i), hi = *(const VecU*)(srcMax + i);
+        const Vec center = (lo + hi) * 0.5f, extent = (hi - lo) * 0.5f;
+        const Vec c = c0 * splat(center, 0) + c1 * splat(center, 1) + c2 * splat(center, 2) + c3;
+        const Vec e = absv(c0) * splat(extent, 0) + absv(c1) * splat(extent, 1) + absv(c2) * splat(extent, 2);
+        *(VecU*)(dstMin + i) = c - e;
+        *(VecU*)(dstMax + i) = c + e;
+    }
+
+    for (; i < n; i++) {
+        const Float4 center = (srcMin[i] + srcMax[i]) * 0.5f, extent = (srcMax[i] - srcMin[i]) * 0.5f;
+        const Float4 c = matrices[i][0] * center[0] + matrices[i][1] * center[1] + matrices[i][2] * center[2] + matrices[i][3];
+        const Float4 e = abs4(matrices[i][0]) * extent[0] + abs4(matrices[i][1]) * extent[1] + abs4(matrices[i][2]) * extent[2];
+        dstMin[i] = c - e;
+        dstMax[i] = c + e;
+    }
+}
+
+#undef Vec
+#undef VecU
+#undef IVec
+#undef PER_VEC
+#undef GROUP_MASK
+#undef shuffleGroups
+#undef splat
+#undef absv
+#undef repeat
+#undef gatherColumn
+#undef COMBINE
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <global_defs.h>
+#include <string>
+#include <vector>
+
+typedef struct FileWatcher FileWatcher;
+
+// Watches the directories of the files with inotify on Linux, polls their modification times elsewhere
+FileWatcher* createFileWatcher();
+void deleteFileWatcher(FileWatcher *watcher);
+void watchFile(FileWatcher *watcher, const std::string &filename);
+// Waits up to timeout for changes, returns the watched files written since the last call
+std::vector<std::string> waitFileChanges(FileWatcher *watcher, const uint timeoutMs);
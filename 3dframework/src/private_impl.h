@@ -2,23 +2,41 @@
 
 #include <acceleration_structure.h>
 #include <buffer.h>
+#include <memory_budget.h>
 #include <mesh.h>
 #include <nvrhi/nvrhi.h>
 #include <texture.h>
 #include <unordered_map>
 
+#define FRAME_BUFFERING 3
+
+namespace nvrhi::vulkan {class IDevice;}
+
 nvrhi::IDevice* getDevice();
+nvrhi::vulkan::IDevice* getVulkanDevice();
 nvrhi::ICommandList* getCommandList();
+uint getFrameIndex();
+void submitReadbacks();
+void processReadbacks();
+void deleteReadbacks();
+void trackMemory(const MemoryCategory category, const long long bytes);
 extern "C" bool raytracingEnabled();
 
 typedef struct {
     nvrhi::BufferHandle buffer;
 	bool mapped;
+    void *mappedData;
+    uint frameSize; // non zero for dynamic buffers, which hold one slice per frame in flight
+    ulong memorySize;
+    MemoryCategory memoryCategory;
 } BufferImpl;
 
 Buffer createBuffer(const nvrhi::BufferDesc &desc);
 nvrhi::BufferDesc getBufferDesc(ResourceType type, const uint size);
 nvrhi::IBuffer* getNvBuffer(Buffer &buffer);
+uint getBufferOffset(Buffer &buffer);
+uint getBufferOffset(Buffer &buffer, const uint frame); // of the slice of the frame for dynamic buffers
+uint getBufferSize(Buffer &buffer);
 
 typedef struct {
     PrimitiveType primitiveType;
@@ -31,12 +49,36 @@ typedef struct {
 
 MeshImpl* getMesh(Mesh mesh);
 
+typedef struct {
+    AccelerationStructure blas;
+    uint id, blasVersion;
+} SceneInstance;
+
 typedef struct {
     nvrhi::rt::AccelStructHandle blas, tlas;
+    ulong memorySize;
+    std::vector<Range> ranges;
+    uint version, nbRefits; // version counts BLAS builds, nbRefits the refits since the last full build
+    uint nbInstances;       // instances of the BLAS in scenes, it outlives its deletion until they're removed
+    bool updatable, deleted;
+
+    // Scene only
+    std::vector<nvrhi::rt::InstanceDesc> instanceDescs;
+    std::vector<SceneInstance> instances;
+    std::vector<uint> instanceIndices, freeIds; // instance id -> index in instances
+    uint maxInstances;
+    bool instancesChanged, transformsChanged;
 } AccelerationStructureImpl;
 
 AccelerationStructureImpl* getAccelerationStructure(AccelerationStructure as);
 
+typedef struct {
+    ulong scratchBudget, groupScratch; // groupScratch sums the build scratch used by the builds since the last GPU sync
+    std::vector<AccelerationStructureImpl*> built;
+} AccelerationStructureBatchImpl;
+
+AccelerationStructureBatchImpl* getAccelerationStructureBatch(AccelerationStructureBatch batch);
+
 struct SamplerDescHash {
     size_t operator()(const nvrhi::SamplerDesc &s) const {
         size_t seed = 205;
@@ -72,9 +114,12 @@ typedef struct {
     std::unordered_map<nvrhi::SamplerDesc, nvrhi::SamplerHandle, SamplerDescHash, SamplerDescEqual> samplerCache;
     nvrhi::TextureDesc desc;
     nvrhi::StagingTextureHandle staging;
+    ulong memorySize;
+    MemoryCategory memoryCategory;
 } TextureImpl;
 
 nvrhi::ITexture* getNvTexture(Texture &tex);
+void setTextureMemoryCategory(Texture &tex, const MemoryCategory category);
 nvrhi::ISampler* getNvSampler(Texture &tex);
 
 typedef struct {
@@ -82,3 +127,9 @@ typedef struct {
 } FramebufferImpl;
 
 nvrhi::IFramebuffer* getCurrentFramebuffer();
+// Framebuffer set by the last useFramebuffer, a null handle if none or deleted since
+Framebuffer getUsedFramebuffer();
+// Bundle recorded between beginBundle and endBundle, one command list per frame slice, nullptr otherwise
+nvrhi::ICommandList* getBundleCommandList(const uint frame);
+// Uniform of the bundle being recorded that gets the camera view or projection at each execution
+void addBundleCameraUniform(nvrhi::IBuffer *buffer, const uint offset, const bool view);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+#include <jobs.h>
+
+template<typename Function>
+struct ParallelForContext {
+    std::atomic<uint> next;
+    uint count, grain;
+    typename std::remove_reference<Function>::type *function;
+};
+
+// Calls function(begin, end) on chunks of grain items taken by the job workers, the calling
+// thread included, chunks are fetched dynamically so uneven work stays balanced
+template<typename Function>
+void parallelFor(const uint count, const uint grain, Function &&function) {
+    const uint nbChunks = (count + grain - 1) / grain;
+    const uint nbJobs = std::min(getNbJobWorkers(), nbChunks);
+    if (nbJobs <= 1) {
+        if (count > 0) function(0u, count);
+        return;
+    }
+
+    ParallelForContext<Function> context = {{0}, count, grain, &function};
+    auto work = [](void *data) {
+        ParallelForContext<Function> *context = (ParallelForContext<Function>*)data;
+        for (uint begin = context->next.fetch_add(context->grain); begin < context->count; begin = context->next.fetch_add(context->grain))
+            (*context->function)(begin, std::min(begin + context->grain, context->count));
+    };
+
+    Job group = createJob(nullptr, nullptr);
+    for (uint i = 1; i < nbJobs; i++)
+        runJob(createChildJob(group, work, &context));
+    work(&context);
+    runJob(group);
+    waitJob(group);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called by launchApplication between two frames, swaps in the shaders rebuilt by the hot reload
+void applyShaderReloads();
+// Compilation errors of the last reloads, NULL when they all succeeded
+const char* getShaderReloadError();
+
+#ifdef __cplusplus
+}
+#endif
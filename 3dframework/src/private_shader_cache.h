@@ -0,0 +1,40 @@
+#pragma once
+
+#include <global_defs.h>
+#include <nvrhi/nvrhi.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct ReflectedUniform {
+    std::string name;
+    uint offset, size; // offset inside its block
+};
+
+// What the binding layout and the uniform lookups need from spirv-cross, in binding order
+struct ReflectedResource {
+    nvrhi::ResourceType type;
+    uint binding;
+    uint arraySize; // of texture arrays, 0 otherwise
+    uint size;      // declared size of uniform blocks
+    std::string name;
+    std::vector<ReflectedUniform> uniforms;
+};
+
+typedef std::vector<ReflectedResource> StageReflection;
+
+struct ShaderCacheEntry {
+    std::vector<uint32_t> spirv; // compiled from GLSL, empty for SPIR-V inputs
+    StageReflection reflection;
+    std::vector<std::pair<std::string, uint64_t>> includes; // files the source depends on and their hashes
+};
+
+uint64_t hashShaderData(const void *data, const size_t size, const uint64_t seed);
+// Content address of a stage, GLSL sources also depend on the defines and the compiler version
+uint64_t getShaderCacheKey(const nvrhi::ShaderType stage, const void *data, const size_t size, const bool glsl, const char *defines);
+
+bool readShaderCache(const uint64_t key, ShaderCacheEntry &entry);
+void writeShaderCache(const uint64_t key, const ShaderCacheEntry &entry);
+
+// Fills the SPIR-V and the includes of the entry or the error message, thread safe
+bool compileGlsl(const char *filename, const char *source, const nvrhi::ShaderType stage, const char *defines, ShaderCacheEntry &entry, std::string &error);
@@ -0,0 +1,14 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called by launchApplication around its loop and before each user draw
+void startSimulation();
+void acquireSimulationStates();
+void stopSimulation();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,110 @@
+#include <quantization.h>
+#include <shader.h>
+#include <cmath>
+#include <immintrin.h>
+#include "private_log.h"
+#include "private_parallel.h"
+
+#define QUANTIZATION_GRAIN 4096
+
+static int quantizeSnorm(const float x, const int max) {
+    return (int)lrintf(CLAMP(x, -1.0f, 1.0f) * max);
+}
+
+// Projection on the octahedron |x| + |y| + |z| = 1, the lower half folded over the diagonals
+static void encodeOctahedral(const float *n, const int max, int *e) {
+    const float sum = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = sum > 0.0f ? n[0] / sum : 0.0f, y = sum > 0.0f ? n[1] / sum : 0.0f;
+    if (n[2] < 0.0f) {
+        const float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+    }
+    e[0] = quantizeSnorm(x, max);
+    e[1] = quantizeSnorm(y, max);
+}
+
+static void addOctahedralAttrib(Mesh mesh, const float *vectors, const uint stride, const uint nbVertices, const bool precise) {
+    if (precise) {
+        std::vector<short> encoded(nbVertices * 2);
+        parallelFor(nbVertices, QUANTIZATION_GRAIN, [&](const uint begin, const uint end) {
+            for (uint i = begin; i < end; i++) {
+                int e[2];
+                encodeOctahedral(&vectors[i * stride], 32767, e);
+                encoded[i * 2] = e[0];
+                encoded[i * 2 + 1] = e[1];
+            }
+        });
+        addMeshAttrib(mesh, RG16_SNORM, false, encoded.data(), nbVertices);
+    } else {
+        std::vector<char> encoded(nbVertices * 2);
+        parallelFor(nbVertices, QUANTIZATION_GRAIN, [&](const uint begin, const uint end) {
+            for (uint i = begin; i < end; i++) {
+                int e[2];
+                encodeOctahedral(&vectors[i * stride], 127, e);
+                encoded[i * 2] = e[0];
+                encoded[i * 2 + 1] = e[1];
+            }
+        });
+        addMeshAttrib(mesh, RG8_SNORM, false, encoded.data(), nbVertices);
+    }
+}
+
+extern "C" {
+
+Dequantization addMeshQuantizedAttribs(Mesh mesh, const VertexAttributes *attributes, const bool precise) {
+    Dequantization dequantization = {float1(1.0f), float1(0.0f)};
+    if (!attributes || !attributes->positions || attributes->nbVertices == 0) {
+        logError("Quantization of a mesh without positions");
+        return dequantization;
+    }
+
+    const uint nbVertices = attributes->nbVertices;
+    const float *positions = attributes->positions;
+    Float4 min = float1(INFINITY), max = float1(-INFINITY);
+    for (uint i = 0; i < nbVertices; i++) {
+        const Float4 p = float4(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], 0.0f);
+        min = min4(min, p);
+        max = max4(max, p);
+    }
+
+    // Flat axes keep a unit scale so every quantized value lands on the plane
+    Float4 extent = max - min;
+    for (uint i = 0; i < 3; i++)
+        if (extent[i] <= 0.0f) extent[i] = 1.0f;
+    dequantization.scale = float4(extent[0], extent[1], extent[2], 1.0f);
+    dequantization.offset = float4(min[0], min[1], min[2], 0.0f);
+
+    std::vector<ushort> quantized(nbVertices * 4);
+    parallelFor(nbVertices, QUANTIZATION_GRAIN, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++) {
+            for (uint j = 0; j < 3; j++)
+                quantized[i * 4 + j] = lrintf(CLAMP((positions[i * 3 + j] - min[j]) / extent[j], 0.0f, 1.0f) * 65535.0f);
+            quantized[i * 4 + 3] = attributes->tangents && attributes->tangents[i * 4 + 3] < 0.0f ? 65535 : 0;
+        }
+    });
+    addMeshAttrib(mesh, RGBA16_UNORM, false, quantized.data(), nbVertices);
+
+    if (attributes->normals)
+        addOctahedralAttrib(mesh, attributes->normals, 3, nbVertices, precise);
+    if (attributes->tangents)
+        addOctahedralAttrib(mesh, attributes->tangents, 4, nbVertices, precise);
+
+    if (attributes->uvs) {
+        std::vector<ushort> halfs(nbVertices * 2);
+        parallelFor(nbVertices * 2, QUANTIZATION_GRAIN, [&](const uint begin, const uint end) {
+            for (uint i = begin; i < end; i++)
+                halfs[i] = _cvtss_sh(attributes->uvs[i], _MM_FROUND_TO_NEAREST_INT);
+        });
+        addMeshAttrib(mesh, RG16_FLOAT, false, halfs.data(), nbVertices);
+    }
+
+    return dequantization;
+}
+
+void setUniformDequantization(const Dequantization dequantization) {
+    setUniform4f(dequantization.scale[0], dequantization.scale[1], dequantization.scale[2], dequantization.scale[3], "PositionScale");
+    setUniform4f(dequantization.offset[0], dequantization.offset[1], dequantization.offset[2], dequantization.offset[3], "PositionOffset");
+}
+
+}
@@ -0,0 +1,264 @@
+#include <readback.h>
+#include <context.h>
+#include <algorithm>
+#include <nvrhi/nvrhi.h>
+#include "private_impl.h"
+#include "private_log.h"
+
+#define MAX_FREE_STAGING 8 // per kind, the oldest staging resources beyond it are released
+
+struct Readback {
+    nvrhi::BufferHandle buffer;
+    nvrhi::StagingTextureHandle texture;
+    nvrhi::EventQueryHandle query;
+    ReadbackCallback callback;
+    void *userData;
+    const void *data;
+    size_t rowPitch;
+    bool submitted, released;
+};
+
+static struct {
+    std::unordered_map<ReadbackTicket, Readback> readbacks;
+    std::vector<ReadbackTicket> pending;
+    std::vector<nvrhi::BufferHandle> freeBuffers;
+    std::vector<nvrhi::StagingTextureHandle> freeTextures;
+    std::vector<nvrhi::EventQueryHandle> freeQueries;
+    ReadbackTicket nextTicket = 1;
+    ulong memorySize;
+} readback;
+
+static nvrhi::EventQueryHandle acquireQuery() {
+    if (readback.freeQueries.empty())
+        return getDevice()->createEventQuery();
+
+    nvrhi::EventQueryHandle query = readback.freeQueries.back();
+    readback.freeQueries.pop_back();
+    getDevice()->resetEventQuery(query);
+    return query;
+}
+
+static nvrhi::BufferHandle acquireBuffer(const uint size) {
+    auto best = readback.freeBuffers.end();
+    for (auto it = readback.freeBuffers.begin(); it != readback.freeBuffers.end(); it++)
+        if ((*it)->getDesc().byteSize >= size && (best == readback.freeBuffers.end() || (*it)->getDesc().byteSize < (*best)->getDesc().byteSize))
+            best = it;
+
+    if (best == readback.freeBuffers.end()) {
+        nvrhi::BufferHandle buffer = getDevice()->createBuffer(nvrhi::BufferDesc()
+            .setByteSize(size)
+            .setCpuAccess(nvrhi::CpuAccessMode::Read)
+            .setInitialState(nvrhi::ResourceStates::CopyDest)
+            .setKeepInitialState(true)
+            .setDebugName("Readback"));
+        const ulong memorySize = getDevice()->getBufferMemoryRequirements(buffer).size;
+        trackMemory(MemoryCategory_Staging, memorySize);
+        readback.memorySize += memorySize;
+        return buffer;
+    }
+
+    nvrhi::BufferHandle buffer = *best;
+    readback.freeBuffers.erase(best);
+    return buffer;
+}
+
+static ulong getTextureMemorySize(const nvrhi::TextureDesc &desc) {
+    return (ulong)desc.width * desc.height * nvrhi::getFormatInfo(desc.format).bytesPerBlock;
+}
+
+static nvrhi::StagingTextureHandle acquireTexture(const nvrhi::TextureDesc &desc) {
+    for (auto it = readback.freeTextures.begin(); it != readback.freeTextures.end(); it++) {
+        const nvrhi::TextureDesc &d = (*it)->getDesc();
+        if (d.width == desc.width && d.height == desc.height && d.format == desc.format) {
+            nvrhi::StagingTextureHandle texture = *it;
+            readback.freeTextures.erase(it);
+            return texture;
+        }
+    }
+
+    const ulong memorySize = getTextureMemorySize(desc);
+    trackMemory(MemoryCategory_Staging, memorySize);
+    readback.memorySize += memorySize;
+    return getDevice()->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
+}
+
+static ReadbackTicket addReadback(const Readback &r) {
+    const ReadbackTicket ticket = readback.nextTicket++;
+    readback.readbacks[ticket] = r;
+    readback.pending.push_back(ticket);
+    return ticket;
+}
+
+static bool mapReadback(Readback &r) {
+    if (!r.submitted || !getDevice()->pollEventQuery(r.query))
+        return false;
+
+    if (!r.data)
+        r.data = r.buffer ?
+            getDevice()->mapBuffer(r.buffer, nvrhi::CpuAccessMode::Read) :
+            getDevice()->mapStagingTexture(r.texture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &r.rowPitch);
+
+    return true;
+}
+
+static void recycleReadback(Readback &r) {
+    if (r.data) r.buffer ?
+        getDevice()->unmapBuffer(r.buffer) :
+        getDevice()->unmapStagingTexture(r.texture);
+
+    if (r.buffer ) readback.freeBuffers .push_back(r.buffer );
+    if (r.texture) readback.freeTextures.push_back(r.texture);
+    readback.freeQueries.push_back(r.query);
+
+    // Bursts of readbacks of various sizes would otherwise keep their staging memory forever
+    if (readback.freeBuffers.size() > MAX_FREE_STAGING) {
+        const ulong memorySize = getDevice()->getBufferMemoryRequirements(readback.freeBuffers.front()).size;
+        trackMemory(MemoryCategory_Staging, -(long long)memorySize);
+        readback.memorySize -= memorySize;
+        readback.freeBuffers.erase(readback.freeBuffers.begin());
+    }
+    if (readback.freeTextures.size() > MAX_FREE_STAGING) {
+        const ulong memorySize = getTextureMemorySize(readback.freeTextures.front()->getDesc());
+        trackMemory(MemoryCategory_Staging, -(long long)memorySize);
+        readback.memorySize -= memorySize;
+        readback.freeTextures.erase(readback.freeTextures.begin());
+    }
+    if (readback.freeQueries.size() > MAX_FREE_STAGING)
+        readback.freeQueries.erase(readback.freeQueries.begin());
+}
+
+extern "C" {
+
+ReadbackTicket requestBufferReadback(Buffer buffer, const uint offset, const uint size, ReadbackCallback callback, void *userData) {
+    if (!buffer.impl || size == 0) {
+        logWarning("Readback of an invalid buffer");
+        return NullReadback;
+    }
+
+    Readback r = {};
+    r.buffer = acquireBuffer(size);
+    r.query = acquireQuery();
+    r.callback = callback;
+    r.userData = userData;
+    r.rowPitch = size;
+    getCommandList()->copyBuffer(r.buffer, 0, getNvBuffer(buffer), getBufferOffset(buffer) + offset, size);
+    return addReadback(r);
+}
+
+ReadbackTicket requestTextureReadback(Texture tex, const uint mipmap, const uint layer, ReadbackCallback callback, void *userData) {
+    if (!tex.impl) {
+        logWarning("Readback of an invalid texture");
+        return NullReadback;
+    }
+
+    const nvrhi::TextureDesc &desc = getNvTexture(tex)->getDesc();
+    if (mipmap >= desc.mipLevels || layer >= desc.arraySize) {
+        logWarning("Readback of texture \"%s\" out of range (mipmap %u, layer %u)", desc.debugName.c_str(), mipmap, layer);
+        return NullReadback;
+    }
+
+    const nvrhi::TextureDesc stagingDesc = nvrhi::TextureDesc()
+        .setWidth(std::max(desc.width >> mipmap, 1u))
+        .setHeight(std::max(desc.height >> mipmap, 1u))
+        .setFormat(desc.format)
+        .setDebugName("Readback");
+
+    Readback r = {};
+    r.texture = acquireTexture(stagingDesc);
+    r.query = acquireQuery();
+    r.callback = callback;
+    r.userData = userData;
+    getCommandList()->copyTexture(r.texture, nvrhi::TextureSlice(), getNvTexture(tex), nvrhi::TextureSlice().setMipLevel(mipmap).setArraySlice(layer));
+    return addReadback(r);
+}
+
+const void* pollReadback(ReadbackTicket ticket, uint *rowPitch) {
+    auto it = readback.readbacks.find(ticket);
+    if (it == readback.readbacks.end()) {
+        logWarning("Polling an invalid readback ticket");
+        return nullptr;
+    }
+
+    if (!mapReadback(it->second))
+        return nullptr;
+
+    if (rowPitch) *rowPitch = it->second.rowPitch;
+    return it->second.data;
+}
+
+const void* waitReadback(ReadbackTicket ticket, uint *rowPitch) {
+    auto it = readback.readbacks.find(ticket);
+    if (it == readback.readbacks.end()) {
+        logWarning("Waiting for an invalid readback ticket");
+        return nullptr;
+    }
+
+    if (!it->second.submitted) {
+        logPerfWarning("Waiting for a readback that hasn't been submitted yet, flushing");
+        flush();
+    }
+
+    getDevice()->waitEventQuery(it->second.query);
+    return pollReadback(ticket, rowPitch);
+}
+
+void releaseReadback(ReadbackTicket ticket) {
+    auto it = readback.readbacks.find(ticket);
+    if (it == readback.readbacks.end())
+        return;
+
+    // The staging memory may still be written by the GPU, recycle it once the copy is done
+    if (!mapReadback(it->second)) {
+        it->second.released = true;
+        it->second.callback = nullptr;
+        return;
+    }
+
+    recycleReadback(it->second);
+    readback.readbacks.erase(it);
+}
+
+}
+
+void submitReadbacks() {
+    for (ReadbackTicket ticket : readback.pending) {
+        Readback &r = readback.readbacks[ticket];
+        getDevice()->setEventQuery(r.query, nvrhi::CommandQueue::Graphics);
+        r.submitted = true;
+    }
+    readback.pending.clear();
+}
+
+void processReadbacks() {
+    std::vector<ReadbackTicket> completed;
+    for (auto &it : readback.readbacks)
+        if ((it.second.callback || it.second.released) && mapReadback(it.second))
+            completed.push_back(it.first);
+
+    // Callbacks may request new readbacks, so they run outside of the map iteration, in the order
+    // of the requests since tickets are increasing
+    std::sort(completed.begin(), completed.end());
+    for (ReadbackTicket ticket : completed) {
+        Readback &r = readback.readbacks[ticket];
+        if (r.callback)
+            r.callback(r.data, r.rowPitch, r.userData);
+        releaseReadback(ticket);
+    }
+}
+
+void deleteReadbacks() {
+    // The device is idle at this point, pending callbacks such as screenshots still get their data
+    processReadbacks();
+    for (auto &it : readback.readbacks)
+        if (it.second.data) it.second.buffer ?
+            getDevice()->unmapBuffer(it.second.buffer) :
+            getDevice()->unmapStagingTexture(it.second.texture);
+
+    readback.readbacks.clear();
+    readback.pending.clear();
+    readback.freeBuffers.clear();
+    readback.freeTextures.clear();
+    readback.freeQueries.clear();
+    trackMemory(MemoryCategory_Staging, -(long long)readback.memorySize);
+    readback.memorySize = 0;
+}
@@ -0,0 +1,266 @@
+#include <scene_graph.h>
+#include "private_impl.h"
+#include "private_log.h"
+#include "private_parallel.h"
+
+#define SCENE_GRAIN 1024
+#define CLEAN_LEVEL (~0u)
+
+typedef struct {
+    void *arena;
+    Mat4 *local, *world, *worldInverse;
+    uint *parents, *levels;
+    uint *updates, *inverseUpdates; // updates that last changed the world matrix and the inverse
+    uchar *dirty;
+    uint *order, *levelStarts;      // nodes sorted by level, rebuilt after additions
+    uint maxNodes, nbNodes, nbLevels;
+    uint update, firstDirtyLevel;
+    bool orderChanged;
+} SceneGraphImpl;
+
+static SceneGraphImpl* getSceneGraph(SceneGraph graph) {return (SceneGraphImpl*)graph.impl;}
+
+template<typename T>
+static T* carve(uintptr_t &cursor, const uint count) {
+    T *p = (T*)cursor;
+    cursor += (count * sizeof(T) + 31) & ~(uintptr_t)31;
+    return p;
+}
+
+// Places the arrays from base and returns the size they take
+static size_t layoutArena(SceneGraphImpl *impl, const uintptr_t base) {
+    const uint n = impl->maxNodes;
+    uintptr_t cursor = base;
+    impl->local          = carve<Mat4>(cursor, n);
+    impl->world          = carve<Mat4>(cursor, n);
+    impl->worldInverse   = carve<Mat4>(cursor, n);
+    impl->parents        = carve<uint>(cursor, n);
+    impl->levels         = carve<uint>(cursor, n);
+    impl->updates        = carve<uint>(cursor, n);
+    impl->inverseUpdates = carve<uint>(cursor, n);
+    impl->dirty          = carve<uchar>(cursor, n);
+    impl->order          = carve<uint>(cursor, n);
+    impl->levelStarts    = carve<uint>(cursor, n + 1);
+    return cursor - base;
+}
+
+static bool checkNode(SceneGraphImpl *impl, const SceneNode node) {
+    if (!impl || node >= impl->nbNodes) {
+        logError("Invalid scene node %u", node);
+        return false;
+    }
+
+    return true;
+}
+
+static void markDirty(SceneGraphImpl *impl, const SceneNode node) {
+    impl->dirty[node] = true;
+    impl->firstDirtyLevel = MIN(impl->firstDirtyLevel, impl->levels[node]);
+}
+
+// Counting sort of the nodes by level, the order inside a level doesn't matter
+static void sortByLevel(SceneGraphImpl *impl) {
+    memset(impl->levelStarts, 0, (impl->nbLevels + 1) * sizeof(uint));
+    for (uint i = 0; i < impl->nbNodes; i++)
+        impl->levelStarts[impl->levels[i] + 1]++;
+    for (uint level = 0; level < impl->nbLevels; level++)
+        impl->levelStarts[level + 1] += impl->levelStarts[level];
+
+    for (uint i = 0; i < impl->nbNodes; i++)
+        impl->order[impl->levelStarts[impl->levels[i]]++] = i;
+
+    // The scatter moved each start to the next one
+    for (uint level = impl->nbLevels; level > 0; level--)
+        impl->levelStarts[level] = impl->levelStarts[level - 1];
+    impl->levelStarts[0] = 0;
+    impl->orderChanged = false;
+}
+
+static inline void updateNode(SceneGraphImpl *impl, const SceneNode node) {
+    const SceneNode parent = impl->parents[node];
+    const bool parentChanged = parent != NullSceneNode && impl->updates[parent] == impl->update;
+    if (!impl->dirty[node] && !parentChanged)
+        return;
+
+    if (parent == NullSceneNode)
+        copym4(impl->world[node], impl->local[node]);
+    else
+        multiplytm4(impl->world[node], impl->world[parent], impl->local[node]);
+    impl->dirty[node] = false;
+    impl->updates[node] = impl->update;
+}
+
+extern "C" {
+
+SceneGraph createSceneGraph(const uint maxNodes) {
+    if (maxNodes == 0 || maxNodes >= NullSceneNode) {
+        logError("Creating a scene graph of %u nodes", maxNodes);
+        return SceneGraph{nullptr};
+    }
+
+    SceneGraphImpl *impl = new SceneGraphImpl();
+    impl->maxNodes = maxNodes;
+    impl->arena = aligned_malloc(layoutArena(impl, 0));
+    if (!impl->arena) {
+        logError("Can't allocate a scene graph of %u nodes", maxNodes);
+        delete impl;
+        return SceneGraph{nullptr};
+    }
+
+    layoutArena(impl, (uintptr_t)impl->arena);
+    impl->firstDirtyLevel = CLEAN_LEVEL;
+    return SceneGraph{impl};
+}
+
+void deleteSceneGraph(SceneGraph *graph) {
+    if (!graph || !graph->impl)
+        return;
+
+    SceneGraphImpl *impl = getSceneGraph(*graph);
+    aligned_free(impl->arena);
+    delete impl;
+    graph->impl = nullptr;
+}
+
+void clearSceneGraph(SceneGraph graph) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    if (!impl)
+        return;
+
+    impl->nbNodes = impl->nbLevels = 0;
+    impl->firstDirtyLevel = CLEAN_LEVEL;
+    impl->orderChanged = true;
+}
+
+SceneNode addSceneNode(SceneGraph graph, const SceneNode parent) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    if (!impl || (parent != NullSceneNode && !checkNode(impl, parent)))
+        return NullSceneNode;
+
+    if (impl->nbNodes == impl->maxNodes) {
+        logError("Scene graph full (%u nodes)", impl->maxNodes);
+        return NullSceneNode;
+    }
+
+    const SceneNode node = impl->nbNodes++;
+    impl->parents[node] = parent;
+    impl->levels[node] = parent == NullSceneNode ? 0 : impl->levels[parent] + 1;
+    impl->nbLevels = MAX(impl->nbLevels, impl->levels[node] + 1);
+    impl->updates[node] = 0;
+    impl->inverseUpdates[node] = ~0u;
+    mat1(impl->local[node], 1.0f);
+    mat1(impl->world[node], 1.0f);
+    impl->orderChanged = true;
+    markDirty(impl, node);
+    return node;
+}
+
+uint getNbSceneNodes(SceneGraph graph) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    return impl ? impl->nbNodes : 0;
+}
+
+SceneNode getNodeParent(SceneGraph graph, const SceneNode node) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    return checkNode(impl, node) ? impl->parents[node] : NullSceneNode;
+}
+
+void setNodeLocal(SceneGraph graph, const SceneNode node, Mat4 local) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    if (!checkNode(impl, node))
+        return;
+
+    copym4(impl->local[node], local);
+    markDirty(impl, node);
+}
+
+void setNodeTRS(SceneGraph graph, const SceneNode node, const Float4 translation, const Float4 rotation, const Float4 scale) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    if (!checkNode(impl, node))
+        return;
+
+    const float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+    Float4 *m = impl->local[node];
+    m[0] = float4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * scale[0];
+    m[1] = float4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * scale[1];
+    m[2] = float4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * scale[2];
+    m[3] = float4(translation[0], translation[1], translation[2], 1.0f);
+    markDirty(impl, node);
+}
+
+Float4* getNodeLocal(SceneGraph graph, const SceneNode node) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    return checkNode(impl, node) ? impl->local[node] : nullptr;
+}
+
+void updateSceneGraph(SceneGraph graph) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    if (!impl || impl->firstDirtyLevel == CLEAN_LEVEL)
+        return;
+
+    if (impl->orderChanged)
+        sortByLevel(impl);
+
+    // Parents are a level above, so they are final when their level is done
+    impl->update++;
+    for (uint level = impl->firstDirtyLevel; level < impl->nbLevels; level++) {
+        const uint *nodes = impl->order + impl->levelStarts[level];
+        parallelFor(impl->levelStarts[level + 1] - impl->levelStarts[level], SCENE_GRAIN, [&](const uint begin, const uint end) {
+            for (uint i = begin; i < end; i++)
+                updateNode(impl, nodes[i]);
+        });
+    }
+
+    impl->firstDirtyLevel = CLEAN_LEVEL;
+}
+
+Float4* getNodeWorld(SceneGraph graph, const SceneNode node) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    return checkNode(impl, node) ? impl->world[node] : nullptr;
+}
+
+Float4* getNodeWorldInverse(SceneGraph graph, const SceneNode node) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    if (!checkNode(impl, node))
+        return nullptr;
+
+    if (impl->inverseUpdates[node] != impl->updates[node]) {
+        inversem4(impl->worldInverse[node], impl->world[node]);
+        impl->inverseUpdates[node] = impl->updates[node];
+    }
+
+    return impl->worldInverse[node];
+}
+
+uint uploadWorldMatrices(SceneGraph graph, Buffer buffer, const SceneNode *nodes, const uint nbNodes) {
+    SceneGraphImpl *impl = getSceneGraph(graph);
+    if (!impl || (!nodes && nbNodes > impl->nbNodes))
+        return 0;
+
+    const uint size = nbNodes * 3 * sizeof(Float4);
+    if (size > getBufferSize(buffer)) {
+        logError("Uploading %u world matrices to a %u bytes buffer", nbNodes, getBufferSize(buffer));
+        return 0;
+    }
+
+    float *dst = (float*)beginDynamicWrite(buffer);
+    if (!dst)
+        return 0;
+
+    // Write combined memory, the rows are streamed and each thread fences its own stores
+    parallelFor(nbNodes, SCENE_GRAIN, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++) {
+            Mat4 rows;
+            transposem4(rows, impl->world[nodes ? nodes[i] : i]);
+            streamstore(dst + 12 * i    , rows[0]);
+            streamstore(dst + 12 * i + 4, rows[1]);
+            streamstore(dst + 12 * i + 8, rows[2]);
+        }
+        _mm_sfence();
+    });
+
+    endDynamicWrite(buffer, size);
+    return size;
+}
+
+}
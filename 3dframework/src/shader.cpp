@@ -1,18 +1,28 @@
 #include <shader.h>
+#include <algorithm>
 #include <camera.h>
+#include <dirent.h>
 #include <file.h>
 #include <framebuffer.h>
 #include <functional>
 #include <graphics_states.h>
+#include <jobs.h>
 #include <mesh.h>
+#include <mutex>
 #include <nvrhi/utils.h>
 #include <spirv_cross/spirv_cross_c.h>
 #include <stdarg.h>
+#include <thread>
+#include <unordered_set>
+#include "private_file_watcher.h"
 #include "private_impl.h"
 #include "private_log.h"
+#include "private_parallel.h"
+#include "private_shader.h"
+#include "private_shader_cache.h"
 
-static const char SPIRV_EXTENSIONS[][11] = {
-    ".task.spv", ".mesh.spv", ".vert.spv", ".tesc.spv", ".tese.spv", ".geom.spv", ".frag.spv", ".comp.spv"
+static const char STAGE_EXTENSIONS[][6] = {
+    ".task", ".mesh", ".vert", ".tesc", ".tese", ".geom", ".frag", ".comp"
 };
 
 static const nvrhi::ShaderType SHADER_STAGES[] = {
@@ -40,6 +50,7 @@ struct UniformTexture {
 struct UniformBuffer {
     uint binding;
     Buffer buffer;
+    uint offset; // frame slice of a dynamic buffer the binding set was created with
 };
 
 struct UniformAccelerationStructure {
@@ -64,8 +75,8 @@ struct UInt4Equal {
     }
 };
 
-static void renderStateHash(size_t &seed, const nvrhi::RenderState &d) {
-    nvrhi::hash_combine(seed, d.blendState);
+// The states set by the command buffers with extended dynamic states
+static void dynamicStateHash(size_t &seed, const nvrhi::RenderState &d) {
     nvrhi::hash_combine(seed, d.depthStencilState.backFaceStencil.depthFailOp);
     nvrhi::hash_combine(seed, d.depthStencilState.backFaceStencil.failOp);
     nvrhi::hash_combine(seed, d.depthStencilState.backFaceStencil.passOp);
@@ -79,18 +90,24 @@ static void renderStateHash(size_t &seed, const nvrhi::RenderState &d) {
     nvrhi::hash_combine(seed, d.depthStencilState.frontFaceStencil.stencilFunc);
     nvrhi::hash_combine(seed, d.depthStencilState.stencilEnable);
     nvrhi::hash_combine(seed, d.depthStencilState.stencilReadMask);
-    nvrhi::hash_combine(seed, d.depthStencilState.stencilRefValue);
     nvrhi::hash_combine(seed, d.depthStencilState.stencilWriteMask);
-    nvrhi::hash_combine(seed, d.depthStencilState.dynamicStencilRef);
-    nvrhi::hash_combine(seed, d.rasterState.antialiasedLineEnable);
-    nvrhi::hash_combine(seed, d.rasterState.conservativeRasterEnable);
     nvrhi::hash_combine(seed, d.rasterState.cullMode);
     nvrhi::hash_combine(seed, d.rasterState.depthBias);
     nvrhi::hash_combine(seed, d.rasterState.depthBiasClamp);
+    nvrhi::hash_combine(seed, d.rasterState.frontCounterClockwise);
+    nvrhi::hash_combine(seed, d.rasterState.slopeScaledDepthBias);
+}
+
+static void renderStateHash(size_t &seed, const nvrhi::RenderState &d) {
+    nvrhi::hash_combine(seed, d.blendState);
+    dynamicStateHash(seed, d);
+    nvrhi::hash_combine(seed, d.depthStencilState.stencilRefValue);
+    nvrhi::hash_combine(seed, d.depthStencilState.dynamicStencilRef);
+    nvrhi::hash_combine(seed, d.rasterState.antialiasedLineEnable);
+    nvrhi::hash_combine(seed, d.rasterState.conservativeRasterEnable);
     nvrhi::hash_combine(seed, d.rasterState.depthClipEnable);
     nvrhi::hash_combine(seed, d.rasterState.fillMode);
     nvrhi::hash_combine(seed, d.rasterState.forcedSampleCount);
-    nvrhi::hash_combine(seed, d.rasterState.frontCounterClockwise);
     nvrhi::hash_combine(seed, d.rasterState.rasterizerDiscard);
     nvrhi::hash_combine(seed, d.rasterState.sampleShadingEnable);
     nvrhi::hash_combine(seed, d.rasterState.programmableSamplePositionsEnable);
@@ -100,21 +117,31 @@ static void renderStateHash(size_t &seed, const nvrhi::RenderState &d) {
         nvrhi::hash_combine(seed, d.rasterState.samplePositionsY[i]);
     }
     nvrhi::hash_combine(seed, d.rasterState.scissorEnable);
-    nvrhi::hash_combine(seed, d.rasterState.slopeScaledDepthBias);
 }
 
-static void framebufferInfoEx(size_t &seed, const nvrhi::FramebufferInfoEx &d) {
+// Only the formats, with dynamic rendering the pipelines don't depend on the framebuffer size
+static void framebufferInfo(size_t &seed, const nvrhi::FramebufferInfo &d) {
     for (uint i = 0; i < d.colorFormats.size(); i++) nvrhi::hash_combine(seed, d.colorFormats[i]);
     nvrhi::hash_combine(seed, d.depthFormat);
     nvrhi::hash_combine(seed, d.sampleCount);
     nvrhi::hash_combine(seed, d.sampleQuality);
-    nvrhi::hash_combine(seed, d.width);
-    nvrhi::hash_combine(seed, d.height);
+}
+
+// Resets the dynamic states in the pipeline keys, so that their permutations share a pipeline
+static void clearDynamicStates(nvrhi::RenderState &d) {
+    d.depthStencilState.frontFaceStencil = d.depthStencilState.backFaceStencil = nvrhi::DepthStencilState::StencilOpDesc();
+    d.depthStencilState.depthFunc = nvrhi::ComparisonFunc::Always;
+    d.depthStencilState.depthTestEnable = d.depthStencilState.depthWriteEnable = d.depthStencilState.stencilEnable = false;
+    d.depthStencilState.stencilReadMask = d.depthStencilState.stencilWriteMask = 0;
+    d.rasterState.cullMode = nvrhi::RasterCullMode::None;
+    d.rasterState.frontCounterClockwise = false;
+    d.rasterState.depthBias = 0;
+    d.rasterState.depthBiasClamp = d.rasterState.slopeScaledDepthBias = 0.0f;
 }
 
 struct GraphicsPipeKey {
     nvrhi::GraphicsPipelineDesc pipeDesc;
-    nvrhi::FramebufferInfoEx fbDesc;
+    nvrhi::FramebufferInfo fbDesc;
 };
 
 struct GraphicsDescHash {
@@ -136,7 +163,7 @@ struct GraphicsDescHash {
         nvrhi::hash_combine(seed, d.pipeDesc.shadingRateState.imageCombiner);
         nvrhi::hash_combine(seed, d.pipeDesc.shadingRateState.pipelinePrimitiveCombiner);
         nvrhi::hash_combine(seed, d.pipeDesc.shadingRateState.shadingRate);
-        framebufferInfoEx(seed, d.fbDesc);
+        framebufferInfo(seed, d.fbDesc);
         return seed;
     }
 };
@@ -155,7 +182,7 @@ struct GraphicsDescEqual {
 struct MeshletPipeKey {
     UInt4 groupSize;
     nvrhi::MeshletPipelineDesc pipeDesc;
-    nvrhi::FramebufferInfoEx fbDesc;
+    nvrhi::FramebufferInfo fbDesc;
 };
 
 struct MeshletDescHash {
@@ -164,7 +191,7 @@ struct MeshletDescHash {
         nvrhi::hash_combine(seed, UInt4Hash()(d.groupSize));
         nvrhi::hash_combine(seed, d.pipeDesc.primType);
         renderStateHash(seed, d.pipeDesc.renderState);
-        framebufferInfoEx(seed, d.fbDesc);
+        framebufferInfo(seed, d.fbDesc);
         return seed;
     }
 };
@@ -179,6 +206,25 @@ struct MeshletDescEqual {
     }
 };
 
+// Pipelines compiled on the job workers, the draws poll them and finish them on the main thread
+template<typename Handle>
+struct PipelineCompile {
+    Job job;
+    std::function<Handle()> create;
+    Handle result;
+    std::chrono::steady_clock::time_point start;
+};
+
+template<typename Handle>
+struct PipelineEntry {
+    Handle pipeline;
+    PipelineCompile<Handle> *compile;
+    std::vector<size_t> dynamicStates; // hashes of the dynamic states drawn with the pipeline
+};
+
+typedef PipelineEntry<nvrhi::GraphicsPipelineHandle> GraphicsPipelineEntry;
+typedef PipelineEntry<nvrhi::MeshletPipelineHandle> MeshletPipelineEntry;
+
 enum PipelineType {
     PipelineType_Graphics,
     PipelineType_Compute,
@@ -203,14 +249,133 @@ struct ShaderImpl {
     nvrhi::BufferHandle uniformBuffer;
     bool uniformsDirty;
     PipelineType pipeType;
-    std::unordered_map<GraphicsPipeKey, nvrhi::GraphicsPipelineHandle, GraphicsDescHash, GraphicsDescEqual> graphicsPipeCache;
+    std::string defines;
+    std::vector<std::string> files; // stage sources and their includes, for the hot reload
+    std::unordered_map<GraphicsPipeKey, GraphicsPipelineEntry, GraphicsDescHash, GraphicsDescEqual> graphicsPipeCache;
     std::unordered_map<UInt4, nvrhi::ComputePipelineHandle, UInt4Hash, UInt4Equal> computePipeCache;
-    std::unordered_map<MeshletPipeKey, nvrhi::MeshletPipelineHandle, MeshletDescHash, MeshletDescEqual> meshletPipeCache;
+    std::unordered_map<MeshletPipeKey, MeshletPipelineEntry, MeshletDescHash, MeshletDescEqual> meshletPipeCache;
 };
 
 static const nvrhi::VulkanBindingOffsets bindingOffsets = {0, 0, 0, 0};
 
 static ShaderImpl *current = nullptr;
+static std::atomic<uint> nbCompilingPipelines(0);
+static uint nbPipelines = 0, nbPipelinesSavedByDynamicStates = 0;
+
+static bool extendedDynamicState() {
+    static const bool supported = getDevice()->queryFeatureSupport(nvrhi::Feature::ExtendedDynamicState);
+    return supported;
+}
+
+static bool graphicsPipelineLibrary() {
+    static const bool supported = getDevice()->queryFeatureSupport(nvrhi::Feature::GraphicsPipelineLibrary);
+    return supported;
+}
+
+static double millisecondsSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename Handle>
+static void compilePipeline(void *data) {
+    PipelineCompile<Handle> *compile = (PipelineCompile<Handle>*)data;
+    compile->result = compile->create();
+    nbCompilingPipelines--;
+}
+
+template<typename Handle>
+static void finishPipelineCompile(PipelineEntry<Handle> &entry, const char *shaderName) {
+    waitJob(entry.compile->job);
+    if (entry.compile->result) // keeps the fast linked pipeline if the optimized one failed
+        entry.pipeline = entry.compile->result;
+    logInfo("Pipeline of '%s' compiled in the background in %.1f ms", shaderName, millisecondsSince(entry.compile->start));
+    delete entry.compile;
+    entry.compile = nullptr;
+}
+
+// The pipeline of the entry when it's ready, following the miss policy of the render state otherwise.
+// A fast linked pipeline, when given, is drawn with right away while the optimized one compiles in the background.
+// Bundles keep the pipelines they're recorded with, so they always wait for the optimized one.
+template<typename Handle>
+static Handle getPipeline(PipelineEntry<Handle> &entry, std::function<Handle()> &&create, const char *shaderName, std::function<Handle()> &&fastLink = nullptr) {
+    const bool bundle = getBundleCommandList(0);
+    const PipelineMissPolicy policy = bundle ? PipelineMiss_Block : getRenderState()->pipelineMissPolicy;
+    if (!entry.pipeline && !entry.compile) {
+        nbPipelines++;
+        if (fastLink && !bundle)
+            entry.pipeline = fastLink();
+        if (policy == PipelineMiss_Block && !entry.pipeline) {
+            entry.pipeline = create();
+            return entry.pipeline;
+        }
+
+        nbCompilingPipelines++;
+        entry.compile = new PipelineCompile<Handle>{NullJob, std::move(create), nullptr, std::chrono::steady_clock::now()};
+        entry.compile->job = createJob(compilePipeline<Handle>, entry.compile);
+        runJob(entry.compile->job);
+    }
+
+    if (entry.compile) {
+        if (policy == PipelineMiss_Block && (!entry.pipeline || bundle) && !isJobDone(entry.compile->job)) {
+            const auto start = std::chrono::steady_clock::now();
+            waitJob(entry.compile->job);
+            logPerfWarning("Draw blocked %.1f ms on a pipeline compiling for '%s'", millisecondsSince(start), shaderName);
+        }
+        if (isJobDone(entry.compile->job))
+            finishPipelineCompile(entry, shaderName);
+    }
+
+    return entry.pipeline;
+}
+
+// Draws go to the frame command list, or to every frame slice of the bundle being recorded
+template<typename Record>
+static void recordDraw(Record record) {
+    if (!getBundleCommandList(0)) {
+        record(getCommandList(), getFrameIndex());
+        return;
+    }
+
+    for (uint frame = 0; frame < FRAME_BUFFERING; frame++)
+        record(getBundleCommandList(frame), frame);
+}
+
+// Every new permutation of the dynamic states drawn with a pipeline would have compiled its own without them
+template<typename Handle>
+static void countDynamicStates(PipelineEntry<Handle> &entry, const nvrhi::RenderState &state) {
+    size_t seed = 0;
+    dynamicStateHash(seed, state);
+    if (std::find(entry.dynamicStates.begin(), entry.dynamicStates.end(), seed) != entry.dynamicStates.end())
+        return;
+
+    if (!entry.dynamicStates.empty())
+        nbPipelinesSavedByDynamicStates++;
+    entry.dynamicStates.push_back(seed);
+}
+
+template<typename Key, typename Handle, typename Hash, typename Equal>
+static void waitPipelineCompiles(std::unordered_map<Key, PipelineEntry<Handle>, Hash, Equal> &cache) {
+    for (auto &it : cache)
+        if (it.second.compile) {
+            waitJob(it.second.compile->job);
+            delete it.second.compile;
+            it.second.compile = nullptr;
+        }
+}
+
+// The designated fallback of a draw missing its pipeline is the same draw with the default render
+// state, compiled right away the first time so its blend and depth states are always the same
+static nvrhi::RenderState getFallbackRenderState() {
+    pushRenderState();
+    setDefaultRenderState();
+    if (!getCurrentFramebuffer()->getDesc().depthAttachment.valid())
+        getRenderState()->depthStencilState.depthTestEnable = false;
+
+    nvrhi::RenderState state = nvrhi::RenderState();
+    memcpy((void*)&state, getRenderState(), sizeof(BlendState) + sizeof(DepthStencilState) + sizeof(RasterState));
+    popRenderState();
+    return state;
+}
 
 static uint padUniformBufferSize(const uint size) {
     return (size + nvrhi::c_ConstantBufferOffsetSizeAlignment - 1) / nvrhi::c_ConstantBufferOffsetSizeAlignment * nvrhi::c_ConstantBufferOffsetSizeAlignment;
@@ -221,122 +386,85 @@ static void merge(nvrhi::BindingLayoutDesc &dest, const nvrhi::BindingLayoutDesc
         dest.bindings.push_back(item);
 }
 
-static nvrhi::BindingLayoutDesc reflectShader(ShaderImpl *shader, const nvrhi::ShaderType stage, const void *binary, const size_t size) {
-    nvrhi::BindingLayoutDesc bindingLayoutDesc = nvrhi::BindingLayoutDesc();
-
-    if (!binary || size == 0)
-        return bindingLayoutDesc;
-
-    nvrhi::ShaderHandle handle = getDevice()->createShader(nvrhi::ShaderDesc(stage), binary, size);
-    switch (stage) {
-        case nvrhi::ShaderType::Compute      : shader->computeDesc .setComputeShader      (handle); break;
-        case nvrhi::ShaderType::Amplification: shader->meshletDesc .setAmplificationShader(handle); break;
-        case nvrhi::ShaderType::Mesh         : shader->meshletDesc .setMeshShader         (handle); break;
-        case nvrhi::ShaderType::Vertex       : shader->graphicsDesc.setVertexShader       (handle); break;
-        case nvrhi::ShaderType::Hull         : shader->graphicsDesc.setHullShader         (handle); break;
-        case nvrhi::ShaderType::Domain       : shader->graphicsDesc.setDomainShader       (handle); break;
-        case nvrhi::ShaderType::Geometry     : shader->graphicsDesc.setGeometryShader     (handle); break;
-        case nvrhi::ShaderType::Pixel        :
-            shader->graphicsDesc.setFragmentShader(handle);
-            shader->meshletDesc .setFragmentShader(handle);
-            break;
-        default:;
-    }
-
+typedef struct {
+    nvrhi::ShaderType stage;
+    const void *binary;
+    size_t size;
+    const char *filename; // loaded by the parsing when there's no binary
+    bool glsl;
+    const char *defines;
+    File file;
+    nvrhi::ShaderHandle handle;
+    ShaderCacheEntry cache;
+    std::string error;
+} ParsedStage;
+
+static StageReflection extractReflection(const void *binary, const size_t size) {
+    StageReflection reflection;
     spvc_context context;
-    spvc_parsed_ir parsed;
+    spvc_parsed_ir ir;
     spvc_compiler compiler;
     spvc_resources resources;
     VERIFY(SPVC_SUCCESS == spvc_context_create(&context));
-    VERIFY(SPVC_SUCCESS == spvc_context_parse_spirv(context, (SpvId*)binary, size / 4, &parsed));
-    VERIFY(SPVC_SUCCESS == spvc_context_create_compiler(context, SPVC_BACKEND_GLSL, parsed, SPVC_CAPTURE_MODE_TAKE_OWNERSHIP, &compiler));
+    VERIFY(SPVC_SUCCESS == spvc_context_parse_spirv(context, (SpvId*)binary, size / 4, &ir));
+    VERIFY(SPVC_SUCCESS == spvc_context_create_compiler(context, SPVC_BACKEND_GLSL, ir, SPVC_CAPTURE_MODE_TAKE_OWNERSHIP, &compiler));
     VERIFY(SPVC_SUCCESS == spvc_compiler_create_shader_resources(compiler, &resources));
 
-    auto parse = [&](const spvc_resource_type resType, std::function<void (const spvc_reflected_resource, const uint)> const &parseFunc) {
+    auto parse = [&](const spvc_resource_type resType, std::function<void (const spvc_reflected_resource, ReflectedResource&)> const &parseFunc) {
         const spvc_reflected_resource *list;
         size_t nbResources;
         spvc_resources_get_resource_list_for_type(resources, resType, &list, &nbResources);
 
         for (uint j = 0; j < nbResources; j++) {
-            const uint binding = spvc_compiler_get_decoration(compiler, list[j].id, SpvDecorationBinding);
-            Binding bindingInfo = {binding, shader->bindings.empty() ? 0 : shader->bindings.back().size};
-            shader->bindings.push_back(bindingInfo);
-            parseFunc(list[j], binding);
+            ReflectedResource resource = {};
+            resource.binding = spvc_compiler_get_decoration(compiler, list[j].id, SpvDecorationBinding);
+            resource.name = list[j].name;
+            parseFunc(list[j], resource);
+            reflection.push_back(resource);
         }
     };
 
-    auto uniformBufferParsing = [&](const spvc_reflected_resource resource, const uint binding) {
-        shader->bindings.back().type = nvrhi::ResourceType::VolatileConstantBuffer;
-        bindingLayoutDesc.addItem(nvrhi::BindingLayoutItem::VolatileConstantBuffer(binding));
+    auto uniformBufferParsing = [&](const spvc_reflected_resource resource, ReflectedResource &reflected) {
+        reflected.type = nvrhi::ResourceType::VolatileConstantBuffer;
         spvc_type resourceType = spvc_compiler_get_type_handle(compiler, resource.base_type_id);
         const uint nbMembers = spvc_type_get_num_member_types(resourceType);
         for (uint k = 0; k < nbMembers; k++) {
             spvc_type memberType = spvc_compiler_get_type_handle(compiler, spvc_type_get_member_type(resourceType, k));
+            const char *memberName = spvc_compiler_get_member_name(compiler, resource.base_type_id, k);
+            uint offset;
+            spvc_compiler_type_struct_member_offset(compiler, resourceType, k, &offset);
             if (spvc_type_get_num_array_dimensions(memberType) > 0) {
                 const uint arraySize = spvc_type_get_array_dimension(memberType, 0);
                 uint stride;
                 spvc_compiler_type_struct_member_array_stride(compiler, resourceType, k, &stride);
 
                 for (uint l = 0; l < arraySize; l++) {
-                    Uniform uniform = {};
-                    spvc_compiler_type_struct_member_offset(compiler, resourceType, k, &uniform.offset);
-                    uniform.offset += shader->bindings.back().size + l * stride;
-                    uniform.size = stride;
                     char name[64];
-                    sprintf(name, "%s[%u]", spvc_compiler_get_member_name(compiler, resource.base_type_id, k), l);
-                    shader->uniforms.insert(std::make_pair(name, uniform));
+                    sprintf(name, "%s[%u]", memberName, l);
+                    reflected.uniforms.push_back(ReflectedUniform{name, offset + l * stride, stride});
                 }
             } else {
-                Uniform uniform = {};
-                spvc_compiler_type_struct_member_offset(compiler, resourceType, k, &uniform.offset);
-                uniform.offset += shader->bindings.back().size;
-                spvc_compiler_get_declared_struct_member_size(compiler, resourceType, k, &uniform.size);
-                shader->uniforms.insert(std::make_pair(spvc_compiler_get_member_name(compiler, resource.base_type_id, k), uniform));
+                size_t size;
+                spvc_compiler_get_declared_struct_member_size(compiler, resourceType, k, &size);
+                reflected.uniforms.push_back(ReflectedUniform{memberName, offset, (uint)size});
             }
         }
 
         size_t paddedSize;
         spvc_compiler_get_declared_struct_size(compiler, resourceType, &paddedSize);
-        shader->bindings.back().size += padUniformBufferSize(paddedSize);
-    };
-
-    auto storageBufferParsing = [&](const spvc_reflected_resource resource, const uint binding) {
-        shader->bindings.back().type = nvrhi::ResourceType::RawBuffer_UAV;
-        bindingLayoutDesc.addItem(nvrhi::BindingLayoutItem::RawBuffer_UAV(binding));
-        shader->buffers.insert(std::make_pair(resource.name, UniformBuffer{binding}));
+        reflected.size = paddedSize;
     };
 
-    auto textureParsing = [&](const spvc_reflected_resource resource, const nvrhi::ResourceType type, const uint binding) {
-        shader->bindings.back().type = type;
+    auto textureParsing = [&](const spvc_reflected_resource resource, ReflectedResource &reflected) {
         spvc_type resourceType = spvc_compiler_get_type_handle(compiler, resource.type_id);
-        if (spvc_type_get_num_array_dimensions(resourceType) == 0) {
-            bindingLayoutDesc.addItem(type == nvrhi::ResourceType::Texture_UAV ?
-                nvrhi::BindingLayoutItem::Texture_UAV(binding) :
-                nvrhi::BindingLayoutItem::Texture_SRV(binding));
-            shader->textures.insert(std::make_pair(resource.name, UniformTexture{binding, 0, ~0u, 0, ~0u, type}));
-        } else {
-            const uint arraySize = spvc_type_get_array_dimension(resourceType, 0);
-            for (uint k = 0; k < arraySize; k++) {
-                char name[64];
-                sprintf(name, "%s[%u]", resource.name, k);
-                bindingLayoutDesc.addItem(type == nvrhi::ResourceType::Texture_UAV ?
-                    nvrhi::BindingLayoutItem::Texture_UAV(binding) :
-                    nvrhi::BindingLayoutItem::Texture_SRV(binding));
-                shader->textures.insert(std::make_pair(name, UniformTexture{binding, 0, ~0u, 0, ~0u, type}));
-            }
-        }
+        if (spvc_type_get_num_array_dimensions(resourceType) > 0)
+            reflected.arraySize = spvc_type_get_array_dimension(resourceType, 0);
     };
 
-    auto combinedImageSamplerParsing = [&](const spvc_reflected_resource resource, const uint binding) {textureParsing(resource, nvrhi::ResourceType::Texture_SRV, binding);};
-    auto storageImageParsing         = [&](const spvc_reflected_resource resource, const uint binding) {textureParsing(resource, nvrhi::ResourceType::Texture_UAV, binding);};
-
-    auto accelerationStructureParsing = [&](const spvc_reflected_resource resource, const uint binding) {
-        UNUSED(resource);
-        shader->bindings.back().type = nvrhi::ResourceType::RayTracingAccelStruct;
-        bindingLayoutDesc.addItem(nvrhi::BindingLayoutItem::RayTracingAccelStruct(binding));
-        shader->accelerationStructure.binding = binding;
-        shader->accelerationStructure.as.impl = nullptr;
-    };
+    auto storageBufferParsing         = [&](const spvc_reflected_resource resource, ReflectedResource &reflected) {UNUSED(resource); reflected.type = nvrhi::ResourceType::RawBuffer_UAV;};
+    auto combinedImageSamplerParsing  = [&](const spvc_reflected_resource resource, ReflectedResource &reflected) {reflected.type = nvrhi::ResourceType::Texture_SRV; textureParsing(resource, reflected);};
+    auto storageImageParsing          = [&](const spvc_reflected_resource resource, ReflectedResource &reflected) {reflected.type = nvrhi::ResourceType::Texture_UAV; textureParsing(resource, reflected);};
+    auto accelerationStructureParsing = [&](const spvc_reflected_resource resource, ReflectedResource &reflected) {UNUSED(resource); reflected.type = nvrhi::ResourceType::RayTracingAccelStruct;};
 
     parse(SPVC_RESOURCE_TYPE_UNIFORM_BUFFER        , uniformBufferParsing        );
     parse(SPVC_RESOURCE_TYPE_STORAGE_BUFFER        , storageBufferParsing        );
@@ -345,9 +473,122 @@ static nvrhi::BindingLayoutDesc reflectShader(ShaderImpl *shader, const nvrhi::S
     parse(SPVC_RESOURCE_TYPE_ACCELERATION_STRUCTURE, accelerationStructureParsing);
 
     spvc_context_destroy(context);
+    return reflection;
+}
+
+// Compilation, module creation and reflection of a stage, independent of the shader so stages run
+// in parallel. The SPIR-V and the reflection come from the cache when the inputs didn't change.
+static void parseStage(ParsedStage &parsed) {
+    if (parsed.filename) {
+        parsed.file = loadFile(parsed.filename);
+        parsed.binary = parsed.file.data;
+        parsed.size = parsed.glsl ? (parsed.file.data ? strlen(parsed.file.data) : 0) : parsed.file.size;
+    }
+
+    if (!parsed.binary || parsed.size == 0)
+        return;
+
+    const uint64_t key = getShaderCacheKey(parsed.stage, parsed.binary, parsed.size, parsed.glsl, parsed.defines);
+    if (!readShaderCache(key, parsed.cache) || (parsed.glsl && parsed.cache.spirv.empty())) {
+        parsed.cache = ShaderCacheEntry();
+        if (parsed.glsl && !compileGlsl(parsed.filename, (const char*)parsed.binary, parsed.stage, parsed.defines, parsed.cache, parsed.error)) {
+            parsed.binary = nullptr;
+            return;
+        }
+
+        if (parsed.glsl)
+            parsed.cache.reflection = extractReflection(parsed.cache.spirv.data(), parsed.cache.spirv.size() * sizeof(uint32_t));
+        else
+            parsed.cache.reflection = extractReflection(parsed.binary, parsed.size);
+        writeShaderCache(key, parsed.cache);
+    }
+
+    if (parsed.glsl) {
+        parsed.binary = parsed.cache.spirv.data();
+        parsed.size = parsed.cache.spirv.size() * sizeof(uint32_t);
+    }
+    parsed.handle = getDevice()->createShader(nvrhi::ShaderDesc(parsed.stage), parsed.binary, parsed.size);
+}
+
+static nvrhi::BindingLayoutDesc reflectShader(ShaderImpl *shader, const ParsedStage &parsed) {
+    nvrhi::BindingLayoutDesc bindingLayoutDesc = nvrhi::BindingLayoutDesc();
+
+    if (!parsed.handle)
+        return bindingLayoutDesc;
+
+    nvrhi::ShaderHandle handle = parsed.handle;
+    switch (parsed.stage) {
+        case nvrhi::ShaderType::Compute      : shader->computeDesc .setComputeShader      (handle); break;
+        case nvrhi::ShaderType::Amplification: shader->meshletDesc .setAmplificationShader(handle); break;
+        case nvrhi::ShaderType::Mesh         : shader->meshletDesc .setMeshShader         (handle); break;
+        case nvrhi::ShaderType::Vertex       : shader->graphicsDesc.setVertexShader       (handle); break;
+        case nvrhi::ShaderType::Hull         : shader->graphicsDesc.setHullShader         (handle); break;
+        case nvrhi::ShaderType::Domain       : shader->graphicsDesc.setDomainShader       (handle); break;
+        case nvrhi::ShaderType::Geometry     : shader->graphicsDesc.setGeometryShader     (handle); break;
+        case nvrhi::ShaderType::Pixel        :
+            shader->graphicsDesc.setFragmentShader(handle);
+            shader->meshletDesc .setFragmentShader(handle);
+            break;
+        default:;
+    }
+
+    for (const ReflectedResource &resource : parsed.cache.reflection) {
+        const uint binding = resource.binding;
+        Binding bindingInfo = {binding, shader->bindings.empty() ? 0 : shader->bindings.back().size, resource.type};
+        shader->bindings.push_back(bindingInfo);
+
+        switch (resource.type) {
+            case nvrhi::ResourceType::VolatileConstantBuffer:
+                bindingLayoutDesc.addItem(nvrhi::BindingLayoutItem::VolatileConstantBuffer(binding));
+                for (const ReflectedUniform &member : resource.uniforms)
+                    shader->uniforms.insert(std::make_pair(member.name, Uniform{shader->bindings.back().size + member.offset, member.size}));
+                shader->bindings.back().size += padUniformBufferSize(resource.size);
+                break;
+
+            case nvrhi::ResourceType::RawBuffer_UAV:
+                bindingLayoutDesc.addItem(nvrhi::BindingLayoutItem::RawBuffer_UAV(binding));
+                shader->buffers.insert(std::make_pair(resource.name, UniformBuffer{binding}));
+                break;
+
+            case nvrhi::ResourceType::Texture_SRV:
+            case nvrhi::ResourceType::Texture_UAV:
+                for (uint k = 0; k < MAX(resource.arraySize, 1u); k++) {
+                    char name[64];
+                    if (resource.arraySize == 0)
+                        snprintf(name, sizeof(name), "%s", resource.name.c_str());
+                    else
+                        snprintf(name, sizeof(name), "%s[%u]", resource.name.c_str(), k);
+                    bindingLayoutDesc.addItem(resource.type == nvrhi::ResourceType::Texture_UAV ?
+                        nvrhi::BindingLayoutItem::Texture_UAV(binding) :
+                        nvrhi::BindingLayoutItem::Texture_SRV(binding));
+                    shader->textures.insert(std::make_pair(name, UniformTexture{binding, 0, ~0u, 0, ~0u, resource.type}));
+                }
+                break;
+
+            case nvrhi::ResourceType::RayTracingAccelStruct:
+                bindingLayoutDesc.addItem(nvrhi::BindingLayoutItem::RayTracingAccelStruct(binding));
+                shader->accelerationStructure.binding = binding;
+                shader->accelerationStructure.as.impl = nullptr;
+                break;
+
+            default:;
+        }
+    }
+
     return bindingLayoutDesc;
 }
 
+// Stages are parsed in parallel, then reflected in order as the uniforms are laid out stage after stage
+static void reflectStages(ShaderImpl *shader, nvrhi::BindingLayoutDesc &bindingLayoutDesc, ParsedStage *stages, const uint nbStages) {
+    parallelFor(nbStages, 1, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++)
+            parseStage(stages[i]);
+    });
+
+    for (uint i = 0; i < nbStages; i++)
+        merge(bindingLayoutDesc, reflectShader(shader, stages[i]));
+}
+
 static Shader finalizeShader(ShaderImpl *shader, nvrhi::BindingLayoutDesc &bindingLayoutDesc) {
     std::sort(bindingLayoutDesc.bindings.begin(), bindingLayoutDesc.bindings.end(), [](const nvrhi::BindingLayoutItem &a, const nvrhi::BindingLayoutItem &b) {return a.slot < b.slot;});
 
@@ -383,6 +624,214 @@ static Shader finalizeShader(ShaderImpl *shader, nvrhi::BindingLayoutDesc &bindi
     return Shader{shader};
 }
 
+// Stages of a shader from a single listing of its directory, instead of opening every candidate
+static void findStageFiles(const char *shaderName, bool *glslFound, bool *spirvFound) {
+    const char *slash = MAX(strrchr(shaderName, '/'), strrchr(shaderName, '\\'));
+    const std::string dirName = slash ? std::string(shaderName, slash + 1 - shaderName) : std::string("./");
+    const char *baseName = slash ? slash + 1 : shaderName;
+    const size_t baseLength = strlen(baseName);
+
+    memset(glslFound, 0, ARRAY_SIZE(SHADER_STAGES) * sizeof(bool));
+    memset(spirvFound, 0, ARRAY_SIZE(SHADER_STAGES) * sizeof(bool));
+    DIR *dir = opendir(dirName.c_str());
+    if (!dir)
+        return;
+
+    while (const dirent *entry = readdir(dir)) {
+        if (strncmp(entry->d_name, baseName, baseLength))
+            continue;
+
+        const char *extension = entry->d_name + baseLength;
+        for (uint i = 0; i < ARRAY_SIZE(SHADER_STAGES); i++) {
+            if (strncmp(extension, STAGE_EXTENSIONS[i], 5))
+                continue;
+            glslFound[i] |= !strcmp(extension + 5, "");
+            spirvFound[i] |= !strcmp(extension + 5, ".spv");
+        }
+    }
+
+    closedir(dir);
+}
+
+// Stages compiled and reflected but not finalized, so the reload thread doesn't create the GPU resources
+static ShaderImpl* buildShader(const char *shaderName, const char *defines, nvrhi::BindingLayoutDesc &bindingLayoutDesc, std::string &error) {
+    ShaderImpl *shader = new ShaderImpl();
+    strcpy(shader->name, shaderName);
+    shader->pipeType = PipelineType_Invalid;
+    shader->defines = defines ? defines : "";
+
+    bool glslFound[ARRAY_SIZE(SHADER_STAGES)], spirvFound[ARRAY_SIZE(SHADER_STAGES)];
+    findStageFiles(shaderName, glslFound, spirvFound);
+
+    ParsedStage stages[ARRAY_SIZE(SHADER_STAGES)];
+    char filenames[ARRAY_SIZE(SHADER_STAGES)][256];
+    uint nbStages = 0;
+    bool definesIgnored = false;
+    for (uint i = 0; i < ARRAY_SIZE(SHADER_STAGES); i++) {
+        if (!glslFound[i] && !spirvFound[i])
+            continue;
+
+        if (SHADER_STAGES[i] == nvrhi::ShaderType::Compute)
+            shader->pipeType = PipelineType_Compute;
+        else if (SHADER_STAGES[i] == nvrhi::ShaderType::Amplification || SHADER_STAGES[i] == nvrhi::ShaderType::Mesh)
+            shader->pipeType = PipelineType_Meshlet;
+        else if (SHADER_STAGES[i] != nvrhi::ShaderType::Pixel)
+            shader->pipeType = PipelineType_Graphics;
+
+        // The source wins over a SPIR-V binary next to it
+        sprintf(filenames[nbStages], "%s%s%s", shaderName, STAGE_EXTENSIONS[i], glslFound[i] ? "" : ".spv");
+        stages[nbStages] = ParsedStage{SHADER_STAGES[i]};
+        stages[nbStages].filename = filenames[nbStages];
+        stages[nbStages].glsl = glslFound[i];
+        stages[nbStages].defines = defines;
+        definesIgnored |= !glslFound[i] && defines && *defines;
+        nbStages++;
+    }
+
+    if (definesIgnored)
+        logWarning("Defines \"%s\" ignored by the SPIR-V stages of '%s'", defines, shaderName);
+
+    reflectStages(shader, bindingLayoutDesc, stages, nbStages);
+    bool complete = true;
+    for (uint i = 0; i < nbStages; i++) {
+        complete &= stages[i].handle != nullptr;
+        error += stages[i].error;
+        deleteFile(&stages[i].file);
+
+        shader->files.push_back(stages[i].filename);
+        for (const auto &include : stages[i].cache.includes)
+            shader->files.push_back(include.first);
+    }
+
+    if (shader->pipeType == PipelineType_Invalid) {
+        error = std::string("No shader found with name '") + shaderName + "'";
+        logError("%s", error.c_str());
+    }
+
+    if (shader->pipeType == PipelineType_Invalid || !complete) {
+        delete shader;
+        return nullptr;
+    }
+
+    return shader;
+}
+
+static void destroyShaderImpl(ShaderImpl *shader) {
+    waitPipelineCompiles(shader->graphicsPipeCache);
+    waitPipelineCompiles(shader->meshletPipeCache);
+    if (shader->stagingUniforms) {
+        shader->uniformBuffer.Reset();
+        free(shader->stagingUniforms);
+    }
+    delete shader;
+}
+
+// Hot reload: a thread watches the files of the loaded shaders and rebuilds the modified ones, the
+// results replace the contents of the old ones at the next frame boundary so the handles stay valid
+
+typedef struct {
+    ShaderImpl *shader, *fresh;
+    nvrhi::BindingLayoutDesc bindingLayoutDesc;
+} PendingReload;
+
+static struct {
+    std::mutex mutex;
+    std::unordered_set<ShaderImpl*> shaders;
+    std::unordered_map<ShaderImpl*, std::string> errors;
+    std::vector<PendingReload> reloaded;
+    std::vector<std::string> newFiles; // the watcher belongs to the thread
+    std::string shownError;
+    std::thread thread;
+    std::atomic<bool> quit;
+    FileWatcher *watcher;
+} hotReload;
+
+static void registerShader(ShaderImpl *shader) {
+    std::lock_guard<std::mutex> lock(hotReload.mutex);
+    hotReload.shaders.insert(shader);
+    if (hotReload.watcher)
+        hotReload.newFiles.insert(hotReload.newFiles.end(), shader->files.begin(), shader->files.end());
+}
+
+static void unregisterShader(ShaderImpl *shader) {
+    std::lock_guard<std::mutex> lock(hotReload.mutex);
+    hotReload.shaders.erase(shader);
+    hotReload.errors.erase(shader);
+}
+
+static void hotReloadLoop() {
+    while (!hotReload.quit) {
+        {
+            std::lock_guard<std::mutex> lock(hotReload.mutex);
+            for (const std::string &file : hotReload.newFiles)
+                watchFile(hotReload.watcher, file);
+            hotReload.newFiles.clear();
+        }
+
+        std::vector<std::string> changes = waitFileChanges(hotReload.watcher, 100);
+        if (changes.empty())
+            continue;
+
+        // Editors may write a file several times in a row
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (const std::string &file : waitFileChanges(hotReload.watcher, 0))
+            if (std::find(changes.begin(), changes.end(), file) == changes.end())
+                changes.push_back(file);
+
+        std::vector<std::pair<ShaderImpl*, std::pair<std::string, std::string>>> reloads;
+        {
+            std::lock_guard<std::mutex> lock(hotReload.mutex);
+            for (ShaderImpl *shader : hotReload.shaders)
+                for (const std::string &file : shader->files)
+                    if (std::find(changes.begin(), changes.end(), file) != changes.end()) {
+                        reloads.push_back(std::make_pair(shader, std::make_pair(shader->name, shader->defines)));
+                        break;
+                    }
+        }
+
+        for (const auto &reload : reloads) {
+            std::string error;
+            PendingReload pending = {reload.first};
+            pending.bindingLayoutDesc = nvrhi::BindingLayoutDesc().setVisibility(nvrhi::ShaderType::All).setBindingOffsets(bindingOffsets);
+            pending.fresh = buildShader(reload.second.first.c_str(), reload.second.second.c_str(), pending.bindingLayoutDesc, error);
+
+            std::lock_guard<std::mutex> lock(hotReload.mutex);
+            if (pending.fresh) {
+                hotReload.reloaded.push_back(pending);
+                hotReload.newFiles.insert(hotReload.newFiles.end(), pending.fresh->files.begin(), pending.fresh->files.end());
+            }
+            if (error.empty() || !hotReload.shaders.count(reload.first))
+                hotReload.errors.erase(reload.first);
+            else
+                hotReload.errors[reload.first] = error;
+        }
+    }
+}
+
+// The bindings and uniform values set before the reload stay, as long as their names and sizes match
+static void keepUniforms(ShaderImpl *shader, const ShaderImpl *old) {
+    for (auto &uniform : shader->uniforms) {
+        auto it = old->uniforms.find(uniform.first);
+        if (it != old->uniforms.end() && it->second.size == uniform.second.size)
+            memcpy((char*)shader->stagingUniforms + uniform.second.offset, (char*)old->stagingUniforms + it->second.offset, uniform.second.size);
+    }
+
+    for (auto &texture : shader->textures) {
+        auto it = old->textures.find(texture.first);
+        if (it != old->textures.end() && it->second.type == texture.second.type)
+            texture.second = it->second;
+    }
+
+    for (auto &buffer : shader->buffers) {
+        auto it = old->buffers.find(buffer.first);
+        if (it != old->buffers.end())
+            buffer.second = it->second;
+    }
+
+    shader->accelerationStructure.as = old->accelerationStructure.as;
+    shader->uniformsDirty = true;
+}
+
 static nvrhi::Viewport flipViewport(const ViewportState &viewport) {
     return nvrhi::Viewport(viewport.minX, viewport.maxX, viewport.maxY, viewport.minY, viewport.minZ, viewport.maxZ);
 }
@@ -400,11 +849,14 @@ Shader createGraphicsShader(
     shader->pipeType = PipelineType_Graphics;
 
     nvrhi::BindingLayoutDesc bindingLayoutDesc = nvrhi::BindingLayoutDesc().setVisibility(nvrhi::ShaderType::All).setBindingOffsets(bindingOffsets);
-    merge(bindingLayoutDesc, reflectShader(shader, nvrhi::ShaderType::Vertex  , vertBin, vertSize));
-    merge(bindingLayoutDesc, reflectShader(shader, nvrhi::ShaderType::Hull    , tescBin, tescSize));
-    merge(bindingLayoutDesc, reflectShader(shader, nvrhi::ShaderType::Domain  , teseBin, teseSize));
-    merge(bindingLayoutDesc, reflectShader(shader, nvrhi::ShaderType::Geometry, geomBin, geomSize));
-    merge(bindingLayoutDesc, reflectShader(shader, nvrhi::ShaderType::Pixel   , fragBin, fragSize));
+    ParsedStage stages[] = {
+        {nvrhi::ShaderType::Vertex  , vertBin, vertSize},
+        {nvrhi::ShaderType::Hull    , tescBin, tescSize},
+        {nvrhi::ShaderType::Domain  , teseBin, teseSize},
+        {nvrhi::ShaderType::Geometry, geomBin, geomSize},
+        {nvrhi::ShaderType::Pixel   , fragBin, fragSize},
+    };
+    reflectStages(shader, bindingLayoutDesc, stages, ARRAY_SIZE(stages));
     return finalizeShader(shader, bindingLayoutDesc);
 }
 
@@ -412,39 +864,23 @@ Shader createComputeShader(const void *binary, const size_t size) {
     ShaderImpl *shader = new ShaderImpl();
     shader->pipeType = PipelineType_Compute;
     nvrhi::BindingLayoutDesc bindingLayoutDesc = nvrhi::BindingLayoutDesc().setVisibility(nvrhi::ShaderType::Compute).setBindingOffsets(bindingOffsets);
-    merge(bindingLayoutDesc, reflectShader(shader, nvrhi::ShaderType::Compute, binary, size));
+    ParsedStage stage = {nvrhi::ShaderType::Compute, binary, size};
+    reflectStages(shader, bindingLayoutDesc, &stage, 1);
     return finalizeShader(shader, bindingLayoutDesc);
 }
 
 Shader loadShader(const char *shaderName) {
-    ShaderImpl *shader = new ShaderImpl();
-    strcpy(shader->name, shaderName);
-    shader->pipeType = PipelineType_Invalid;
+    return loadShaderVariant(shaderName, nullptr);
+}
 
+Shader loadShaderVariant(const char *shaderName, const char *defines) {
+    std::string error;
     nvrhi::BindingLayoutDesc bindingLayoutDesc = nvrhi::BindingLayoutDesc().setVisibility(nvrhi::ShaderType::All).setBindingOffsets(bindingOffsets);
-    for (uint i = 0; i < ARRAY_SIZE(SHADER_STAGES); i++) {
-        char filename[256];
-        sprintf(filename, "%s%s", shaderName, SPIRV_EXTENSIONS[i]);
-        if (!fileExists(filename))
-            continue;
-
-        if (SHADER_STAGES[i] == nvrhi::ShaderType::Compute)
-            shader->pipeType = PipelineType_Compute;
-        else if (SHADER_STAGES[i] == nvrhi::ShaderType::Amplification || SHADER_STAGES[i] == nvrhi::ShaderType::Mesh)
-            shader->pipeType = PipelineType_Meshlet;
-        else if (SHADER_STAGES[i] != nvrhi::ShaderType::Pixel)
-            shader->pipeType = PipelineType_Graphics;
-
-        SCOPED(File) shaderFile = loadFile(filename);
-        merge(bindingLayoutDesc, reflectShader(shader, SHADER_STAGES[i], shaderFile.data, shaderFile.size));
-    }
-
-    if (shader->pipeType == PipelineType_Invalid) {
-        logError("No shader found with name '%s'", shaderName);
-        delete shader;
+    ShaderImpl *shader = buildShader(shaderName, defines, bindingLayoutDesc, error);
+    if (!shader)
         return Shader();
-    }
 
+    registerShader(shader);
     return finalizeShader(shader, bindingLayoutDesc);
 }
 
@@ -454,15 +890,78 @@ void deleteShader(Shader *shader) {
 
     if (current == shader->impl) current = nullptr;
 
-    ShaderImpl* impl = (ShaderImpl*)shader->impl;
-    if (impl->stagingUniforms) {
-        impl->uniformBuffer.Reset();
-        free(impl->stagingUniforms);
-    }
-    delete impl;
+    unregisterShader((ShaderImpl*)shader->impl);
+    destroyShaderImpl((ShaderImpl*)shader->impl);
     shader->impl = nullptr;
 }
 
+void setShaderHotReload(const bool enable) {
+    if (enable == hotReload.thread.joinable())
+        return;
+
+    if (enable) {
+        if (!(hotReload.watcher = createFileWatcher()))
+            return;
+
+        std::lock_guard<std::mutex> lock(hotReload.mutex);
+        for (ShaderImpl *shader : hotReload.shaders)
+            hotReload.newFiles.insert(hotReload.newFiles.end(), shader->files.begin(), shader->files.end());
+        hotReload.quit = false;
+        hotReload.thread = std::thread(hotReloadLoop);
+        return;
+    }
+
+    hotReload.quit = true;
+    hotReload.thread.join();
+    deleteFileWatcher(hotReload.watcher);
+    hotReload.watcher = nullptr;
+
+    for (PendingReload &reload : hotReload.reloaded)
+        destroyShaderImpl(reload.fresh);
+    hotReload.reloaded.clear();
+    hotReload.newFiles.clear();
+    hotReload.errors.clear();
+    hotReload.shownError.clear();
+}
+
+void applyShaderReloads() {
+    std::lock_guard<std::mutex> lock(hotReload.mutex);
+    for (PendingReload &reload : hotReload.reloaded) {
+        if (!hotReload.shaders.count(reload.shader)) {
+            destroyShaderImpl(reload.fresh);
+            continue;
+        }
+
+        // The old contents go with the fresh impl, nvrhi keeps what the frames in flight still use
+        ShaderImpl *old = (ShaderImpl*)finalizeShader(reload.fresh, reload.bindingLayoutDesc).impl;
+        std::swap(*reload.shader, *old);
+        keepUniforms(reload.shader, old);
+        destroyShaderImpl(old);
+        logInfo("Shader '%s' reloaded", reload.shader->name);
+    }
+    hotReload.reloaded.clear();
+
+    hotReload.shownError.clear();
+    for (const auto &error : hotReload.errors)
+        hotReload.shownError += error.second + "\n";
+}
+
+uint getNbCompilingPipelines() {
+    return nbCompilingPipelines;
+}
+
+uint getNbPipelines() {
+    return nbPipelines;
+}
+
+uint getNbPipelinesSavedByDynamicStates() {
+    return nbPipelinesSavedByDynamicStates;
+}
+
+const char* getShaderReloadError() {
+    return hotReload.shownError.empty() ? nullptr : hotReload.shownError.c_str();
+}
+
 void useShader(Shader shader) {
     current = (ShaderImpl*)shader.impl;
 
@@ -627,46 +1126,73 @@ void setGroupSize3D(const uint nbElemsX, const uint nbElemsY, const uint nbElems
     current->computeGroupSize = uint4(nbElemsX, nbElemsY, nbElemsZ);
 }
 
-static nvrhi::IBindingSet* bindUniforms(nvrhi::IBindingLayout *bindingLayout) {
+static nvrhi::BindingSetHandle createBindingSet(nvrhi::IBindingLayout *bindingLayout, const uint frame) {
+    nvrhi::BindingSetDesc bindingSetDesc = nvrhi::BindingSetDesc();
+
+    for (uint i = 0; i < current->bindings.size(); i++) {
+        const Binding &b = current->bindings[i];
+        if (b.type == nvrhi::ResourceType::VolatileConstantBuffer) {
+            const uint64_t offset = i == 0 ? 0 : current->bindings[i - 1].size;
+            bindingSetDesc.addItem(nvrhi::BindingSetItem::ConstantBuffer(b.binding, current->uniformBuffer, nvrhi::BufferRange(offset, b.size - offset)));
+        }
+    }
+
+    for (auto &it : current->textures) {
+        if (it.second.type == nvrhi::ResourceType::Texture_UAV) {
+            nvrhi::TextureSubresourceSet view = nvrhi::TextureSubresourceSet(it.second.mipmap, 1, it.second.layer, it.second.nbLayers);
+            bindingSetDesc.addItem(nvrhi::BindingSetItem::Texture_UAV(it.second.binding, getNvTexture(it.second.texture), nvrhi::Format::UNKNOWN, view));
+        } else {
+            nvrhi::TextureSubresourceSet view = nvrhi::TextureSubresourceSet(it.second.mipmap, it.second.nbMipmaps, it.second.layer, it.second.nbLayers);
+            bindingSetDesc.addItem(nvrhi::BindingSetItem::Texture_SRV(it.second.binding, getNvTexture(it.second.texture), getNvSampler(it.second.texture), nvrhi::Format::UNKNOWN, view));
+        }
+    }
+
+    for (auto &it : current->buffers)
+        bindingSetDesc.addItem(nvrhi::BindingSetItem::RawBuffer_UAV(it.second.binding, getNvBuffer(it.second.buffer), nvrhi::BufferRange(getBufferOffset(it.second.buffer, frame), getBufferSize(it.second.buffer))));
+
+    if (current->accelerationStructure.as.impl)
+        bindingSetDesc.addItem(nvrhi::BindingSetItem::RayTracingAccelStruct(current->accelerationStructure.binding, getAccelerationStructure(current->accelerationStructure.as)->tlas));
+
+    std::sort(bindingSetDesc.bindings.begin(), bindingSetDesc.bindings.end(), [](const nvrhi::BindingSetItem &a, const nvrhi::BindingSetItem &b) {return a.slot < b.slot;});
+    return getDevice()->createBindingSet(bindingSetDesc, bindingLayout);
+}
+
+static nvrhi::BindingSetHandle bindUniforms(nvrhi::ICommandList *commandList, nvrhi::IBindingLayout *bindingLayout, const uint frame) {
     if (!current) {
         logError("Submit uniforms to an invalid shader");
         return nullptr;
     }
 
+    // Bundles keep their own version of the uniforms and a binding set per frame slice. The camera
+    // matrices set by useShader are rewritten when the bundle executes.
+    if (commandList != getCommandList()) {
+        if (current->stagingSize > 0) {
+            commandList->writeBuffer(current->uniformBuffer, current->stagingUniforms, current->stagingSize);
+            for (const bool view : {false, true}) {
+                const char *name = view ? "ViewMatrix" : "ProjectionMatrix";
+                const Float4 *camera = view ? getCamera()->view.mat : getCamera()->projection.mat;
+                auto range = current->uniforms.equal_range(name);
+                for (auto it = range.first; it != range.second; it++)
+                    if (it->second.size == sizeof(Mat4) && !memcmp((char*)current->stagingUniforms + it->second.offset, camera, sizeof(Mat4)))
+                        addBundleCameraUniform(current->uniformBuffer, it->second.offset, view);
+            }
+        }
+        return createBindingSet(bindingLayout, frame);
+    }
+
     if (current->uniformsDirty && current->stagingSize > 0) {
         current->uniformsDirty = false;
         getCommandList()->writeBuffer(current->uniformBuffer, current->stagingUniforms, current->stagingSize);
     }
 
-    if (!current->bindingSet) {
-        nvrhi::BindingSetDesc bindingSetDesc = nvrhi::BindingSetDesc();
-
-        for (uint i = 0; i < current->bindings.size(); i++) {
-            const Binding &b = current->bindings[i];
-            if (b.type == nvrhi::ResourceType::VolatileConstantBuffer) {
-                const uint64_t offset = i == 0 ? 0 : current->bindings[i - 1].size;
-                bindingSetDesc.addItem(nvrhi::BindingSetItem::ConstantBuffer(b.binding, current->uniformBuffer, nvrhi::BufferRange(offset, b.size - offset)));
-            }
-        }
-
-        for (auto &it : current->textures) {
-            if (it.second.type == nvrhi::ResourceType::Texture_UAV) {
-                nvrhi::TextureSubresourceSet view = nvrhi::TextureSubresourceSet(it.second.mipmap, 1, it.second.layer, it.second.nbLayers);
-                bindingSetDesc.addItem(nvrhi::BindingSetItem::Texture_UAV(it.second.binding, getNvTexture(it.second.texture), nvrhi::Format::UNKNOWN, view));
-            } else {
-                nvrhi::TextureSubresourceSet view = nvrhi::TextureSubresourceSet(it.second.mipmap, it.second.nbMipmaps, it.second.layer, it.second.nbLayers);
-                bindingSetDesc.addItem(nvrhi::BindingSetItem::Texture_SRV(it.second.binding, getNvTexture(it.second.texture), getNvSampler(it.second.texture), nvrhi::Format::UNKNOWN, view));
-            }
-        }
+    for (auto &it : current->buffers)
+        if (it.second.buffer.impl && it.second.offset != getBufferOffset(it.second.buffer, frame))
+            current->bindingSet.Reset();
 
+    if (!current->bindingSet) {
         for (auto &it : current->buffers)
-            bindingSetDesc.addItem(nvrhi::BindingSetItem::RawBuffer_UAV(it.second.binding, getNvBuffer(it.second.buffer)));
-
-        if (current->accelerationStructure.as.impl)
-            bindingSetDesc.addItem(nvrhi::BindingSetItem::RayTracingAccelStruct(current->accelerationStructure.binding, getAccelerationStructure(current->accelerationStructure.as)->tlas));
-
-        std::sort(bindingSetDesc.bindings.begin(), bindingSetDesc.bindings.end(), [](const nvrhi::BindingSetItem &a, const nvrhi::BindingSetItem &b) {return a.slot < b.slot;});
-        current->bindingSet = getDevice()->createBindingSet(bindingSetDesc, bindingLayout);
+            it.second.offset = getBufferOffset(it.second.buffer, frame);
+        current->bindingSet = createBindingSet(bindingLayout, frame);
     }
 
     return current->bindingSet;
@@ -688,13 +1214,34 @@ static void dispatchCompute(const uint nbElemsX, const uint nbElemsY, const uint
 
     getCommandList()->setComputeState(nvrhi::ComputeState()
         .setPipeline  (current->computePipeCache[current->computeGroupSize])
-        .addBindingSet(bindUniforms(current->computeDesc.bindingLayouts[0])));
+        .addBindingSet(bindUniforms(getCommandList(), current->computeDesc.bindingLayouts[0], getFrameIndex())));
     getCommandList()->dispatch(
         (nbElemsX + current->computeGroupSize[0] - 1) / current->computeGroupSize[0],
         (nbElemsY + current->computeGroupSize[1] - 1) / current->computeGroupSize[1],
         (nbElemsZ + current->computeGroupSize[2] - 1) / current->computeGroupSize[2]);
 }
 
+static MeshletPipelineEntry& getMeshletPipeline(const nvrhi::MeshletPipelineDesc &pipelineDesc, nvrhi::MeshletPipelineHandle &pipeline) {
+    MeshletPipeKey key = {current->computeGroupSize, pipelineDesc, getCurrentFramebuffer()->getFramebufferInfo()};
+    if (extendedDynamicState())
+        clearDynamicStates(key.pipeDesc.renderState);
+
+    MeshletPipelineEntry &entry = current->meshletPipeCache[key];
+    const UInt4 groupSize = current->computeGroupSize;
+    nvrhi::FramebufferHandle framebuffer = getCurrentFramebuffer();
+    pipeline = getPipeline<nvrhi::MeshletPipelineHandle>(entry, [=, desc = pipelineDesc]() mutable {
+        nvrhi::ShaderSpecialization meshletGroupSize[3] = {
+            nvrhi::ShaderSpecialization::UInt32(0, groupSize[0]),
+            nvrhi::ShaderSpecialization::UInt32(1, groupSize[1]),
+            nvrhi::ShaderSpecialization::UInt32(2, groupSize[2]),
+        };
+
+        desc.setMeshShader(getDevice()->createShaderSpecialization(desc.MS, meshletGroupSize, 3));
+        return getDevice()->createMeshletPipeline(desc, framebuffer);
+    }, current->name);
+    return entry;
+}
+
 static void dispatchMeshlet(const uint nbElemsX, const uint nbElemsY, const uint nbElemsZ) {
     pushRenderState();
 
@@ -709,30 +1256,34 @@ static void dispatchMeshlet(const uint nbElemsX, const uint nbElemsY, const uint
     if (getRenderState()->rasterState.rasterizerDiscard)
         pipelineDesc.setPixelShader(nullptr);
 
-    const MeshletPipeKey key = {current->computeGroupSize, pipelineDesc, getCurrentFramebuffer()->getFramebufferInfo()};
-    const auto &pipeIt = current->meshletPipeCache.find(key);
-    if (pipeIt == current->meshletPipeCache.end()) {
-        nvrhi::ShaderSpecialization meshletGroupSize[3] = {
-            nvrhi::ShaderSpecialization::UInt32(0, current->computeGroupSize[0]),
-            nvrhi::ShaderSpecialization::UInt32(1, current->computeGroupSize[1]),
-            nvrhi::ShaderSpecialization::UInt32(2, current->computeGroupSize[2]),
-        };
-
-        pipelineDesc.setMeshShader(getDevice()->createShaderSpecialization(pipelineDesc.MS, meshletGroupSize, 3));
-        current->meshletPipeCache[key] = getDevice()->createMeshletPipeline(pipelineDesc, getCurrentFramebuffer());
+    nvrhi::MeshletPipelineHandle pipeline;
+    MeshletPipelineEntry *entry = &getMeshletPipeline(pipelineDesc, pipeline);
+    if (!pipeline && getRenderState()->pipelineMissPolicy == PipelineMiss_Fallback) {
+        getRenderState()->pipelineMissPolicy = PipelineMiss_Block;
+        entry = &getMeshletPipeline(nvrhi::MeshletPipelineDesc(pipelineDesc).setRenderState(getFallbackRenderState()), pipeline);
     }
-
-    nvrhi::MeshletState state = nvrhi::MeshletState()
-        .setPipeline(current->meshletPipeCache[key])
-        .setFramebuffer(getCurrentFramebuffer())
-        .setViewport(nvrhi::ViewportState().addViewport(flipViewport(getRenderState()->viewportState)).addScissorRect(nvrhi::Rect(*(nvrhi::Viewport*)&getRenderState()->scissorState)))
-        .addBindingSet(bindUniforms(current->meshletDesc.bindingLayouts[0]));
-
-    getCommandList()->setMeshletState(state);
-    getCommandList()->dispatchMesh(
-        (nbElemsX + current->computeGroupSize[0] - 1) / current->computeGroupSize[0],
-        (nbElemsY + current->computeGroupSize[1] - 1) / current->computeGroupSize[1],
-        (nbElemsZ + current->computeGroupSize[2] - 1) / current->computeGroupSize[2]);
+    if (!pipeline) {
+        popRenderState();
+        return;
+    }
+    if (extendedDynamicState())
+        countDynamicStates(*entry, nvrhiRenderState);
+
+    recordDraw([&](nvrhi::ICommandList *commandList, const uint frame) {
+        nvrhi::BindingSetHandle bindingSet = bindUniforms(commandList, current->meshletDesc.bindingLayouts[0], frame);
+        nvrhi::MeshletState state = nvrhi::MeshletState()
+            .setPipeline(pipeline)
+            .setFramebuffer(getCurrentFramebuffer())
+            .setViewport(nvrhi::ViewportState().addViewport(flipViewport(getRenderState()->viewportState)).addScissorRect(nvrhi::Rect(*(nvrhi::Viewport*)&getRenderState()->scissorState)))
+            .setDynamicRenderState(nvrhiRenderState)
+            .addBindingSet(bindingSet);
+
+        commandList->setMeshletState(state);
+        commandList->dispatchMesh(
+            (nbElemsX + current->computeGroupSize[0] - 1) / current->computeGroupSize[0],
+            (nbElemsY + current->computeGroupSize[1] - 1) / current->computeGroupSize[1],
+            (nbElemsZ + current->computeGroupSize[2] - 1) / current->computeGroupSize[2]);
+    });
 
     popRenderState();
 }
@@ -751,6 +1302,25 @@ void dispatch3D(const uint nbElemsX, const uint nbElemsY, const uint nbElemsZ) {
         dispatchMeshlet(nbElemsX, nbElemsY, nbElemsZ);
 }
 
+static GraphicsPipelineEntry& getGraphicsPipeline(const nvrhi::GraphicsPipelineDesc &pipelineDesc, nvrhi::GraphicsPipelineHandle &pipeline) {
+    GraphicsPipeKey key = {pipelineDesc, getCurrentFramebuffer()->getFramebufferInfo()};
+    if (extendedDynamicState())
+        clearDynamicStates(key.pipeDesc.renderState);
+
+    GraphicsPipelineEntry &entry = current->graphicsPipeCache[key];
+    nvrhi::FramebufferHandle framebuffer = getCurrentFramebuffer();
+    std::function<nvrhi::GraphicsPipelineHandle()> fastLink;
+    if (graphicsPipelineLibrary()) {
+        fastLink = [=]() {
+            return getDevice()->createGraphicsPipeline(nvrhi::GraphicsPipelineDesc(pipelineDesc).setFastLink(true), framebuffer);
+        };
+    }
+    pipeline = getPipeline<nvrhi::GraphicsPipelineHandle>(entry, [=]() {
+        return getDevice()->createGraphicsPipeline(pipelineDesc, framebuffer);
+    }, current->name, std::move(fastLink));
+    return entry;
+}
+
 static void drawSubMeshOffsetInstancedIndirect(Mesh mesh, const uint first, const uint count, const uint offset, const uint nbInstances, const uint baseInstance, Buffer indirect) {
     if (!current) {
         logError("Draw with an invalid shader");
@@ -782,35 +1352,48 @@ static void drawSubMeshOffsetInstancedIndirect(Mesh mesh, const uint first, cons
     if (getRenderState()->rasterState.rasterizerDiscard)
         pipelineDesc.setPixelShader(nullptr);
 
-    const GraphicsPipeKey key = {pipelineDesc, getCurrentFramebuffer()->getFramebufferInfo()};
-    if (current->graphicsPipeCache.find(key) == current->graphicsPipeCache.end())
-        current->graphicsPipeCache[key] = getDevice()->createGraphicsPipeline(pipelineDesc, getCurrentFramebuffer());
-
-    nvrhi::GraphicsState state = nvrhi::GraphicsState()
-        .setPipeline(current->graphicsPipeCache[key])
-        .setFramebuffer(getCurrentFramebuffer())
-        .setViewport(nvrhi::ViewportState().addViewport(flipViewport(getRenderState()->viewportState)).addScissorRect(nvrhi::Rect(*(nvrhi::Viewport*)&getRenderState()->scissorState)))
-        .setShadingRateState(*(nvrhi::VariableRateShadingState*)&getRenderState()->vrsState)
-        .addBindingSet(bindUniforms(current->graphicsDesc.bindingLayouts[0]));
-
-    if (meshimpl) {
-        state.setIndexBuffer(nvrhi::IndexBufferBinding().setBuffer(getNvBuffer(meshimpl->indices)).setFormat(meshimpl->indicesFormat));
-        for (uint i = 0; i < meshimpl->buffers.size(); i++)
-            state.addVertexBuffer(nvrhi::VertexBufferBinding().setBuffer(getNvBuffer(meshimpl->buffers[i])).setSlot(i));
+    nvrhi::GraphicsPipelineHandle pipeline;
+    GraphicsPipelineEntry *entry = &getGraphicsPipeline(pipelineDesc, pipeline);
+    if (!pipeline && getRenderState()->pipelineMissPolicy == PipelineMiss_Fallback) {
+        getRenderState()->pipelineMissPolicy = PipelineMiss_Block;
+        entry = &getGraphicsPipeline(nvrhi::GraphicsPipelineDesc(pipelineDesc).setRenderState(getFallbackRenderState()), pipeline);
+    }
+    if (!pipeline) {
+        popRenderState();
+        return;
     }
+    if (extendedDynamicState())
+        countDynamicStates(*entry, nvrhiRenderState);
+
+    recordDraw([&](nvrhi::ICommandList *commandList, const uint frame) {
+        nvrhi::BindingSetHandle bindingSet = bindUniforms(commandList, current->graphicsDesc.bindingLayouts[0], frame);
+        nvrhi::GraphicsState state = nvrhi::GraphicsState()
+            .setPipeline(pipeline)
+            .setFramebuffer(getCurrentFramebuffer())
+            .setViewport(nvrhi::ViewportState().addViewport(flipViewport(getRenderState()->viewportState)).addScissorRect(nvrhi::Rect(*(nvrhi::Viewport*)&getRenderState()->scissorState)))
+            .setShadingRateState(*(nvrhi::VariableRateShadingState*)&getRenderState()->vrsState)
+            .setDynamicRenderState(nvrhiRenderState)
+            .addBindingSet(bindingSet);
+
+        if (meshimpl) {
+            state.setIndexBuffer(nvrhi::IndexBufferBinding().setBuffer(getNvBuffer(meshimpl->indices)).setFormat(meshimpl->indicesFormat).setOffset(getBufferOffset(meshimpl->indices, frame)));
+            for (uint i = 0; i < meshimpl->buffers.size(); i++)
+                state.addVertexBuffer(nvrhi::VertexBufferBinding().setBuffer(getNvBuffer(meshimpl->buffers[i])).setSlot(i).setOffset(getBufferOffset(meshimpl->buffers[i], frame)));
+        }
 
-    if (indirect.impl)
-        state.setIndirectParams(getNvBuffer(indirect));
+        if (indirect.impl)
+            state.setIndirectParams(getNvBuffer(indirect));
 
-    getCommandList()->setGraphicsState(state);
+        commandList->setGraphicsState(state);
 
-    indirect.impl ?
-        (meshimpl && meshimpl->nbIndices > 0 ?
-            getCommandList()->drawIndexedIndirect(0, 1) :
-            getCommandList()->drawIndirect       (0, 1)) :
-        (meshimpl && meshimpl->nbIndices > 0 ?
-            getCommandList()->drawIndexed(nvrhi::DrawArguments{count, nbInstances, first, offset, baseInstance}) :
-            getCommandList()->draw       (nvrhi::DrawArguments{count, nbInstances, 0, first, baseInstance}));
+        indirect.impl ?
+            (meshimpl && meshimpl->nbIndices > 0 ?
+                commandList->drawIndexedIndirect(getBufferOffset(indirect, frame), 1) :
+                commandList->drawIndirect       (getBufferOffset(indirect, frame), 1)) :
+            (meshimpl && meshimpl->nbIndices > 0 ?
+                commandList->drawIndexed(nvrhi::DrawArguments{count, nbInstances, first, offset, baseInstance}) :
+                commandList->draw       (nvrhi::DrawArguments{count, nbInstances, 0, first, baseInstance}));
+    });
 
     popRenderState();
 }
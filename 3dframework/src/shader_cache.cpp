@@ -0,0 +1,471 @@
+#include <shader.h>
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "private_log.h"
+#include "private_shader_cache.h"
+#ifdef _WIN32
+    #define NOMINMAX
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <direct.h>
+    #define makeDirectory(dir) _mkdir(dir)
+    #define SHADERC_LIBRARY "shaderc_shared.dll"
+#else
+    #include <dlfcn.h>
+    #define makeDirectory(dir) mkdir(dir, 0755)
+    #define SHADERC_LIBRARY "libshaderc_shared.so"
+#endif
+
+#define CACHE_MAGIC 0x43565053u // "SPVC"
+#define CACHE_VERSION 3u        // bump when the entries or the compile options change
+
+static std::string cacheDir = "../shader_cache/", includeDir = "../../3dframework/shaders/";
+
+static std::string joinPath(const std::string &dir, const char *name) {
+    if (dir.empty() || dir.back() == '/' || dir.back() == '\\')
+        return dir + name;
+    return dir + '/' + name;
+}
+
+static bool readWholeFile(const char *filename, std::string &content) {
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    content.resize(ftell(file));
+    rewind(file);
+    const bool success = fread(&content[0], 1, content.size(), file) == content.size();
+    fclose(file);
+    return success;
+}
+
+// shaderc C API subset, loaded at runtime so the framework doesn't link with it
+
+typedef struct shaderc_compiler *shaderc_compiler_t;
+typedef struct shaderc_compile_options *shaderc_compile_options_t;
+typedef struct shaderc_compilation_result *shaderc_compilation_result_t;
+
+typedef struct {
+    const char *source_name;
+    size_t source_name_length;
+    const char *content;
+    size_t content_length;
+    void *user_data;
+} shaderc_include_result;
+
+enum {
+    shaderc_vertex_shader = 0,
+    shaderc_fragment_shader = 1,
+    shaderc_compute_shader = 2,
+    shaderc_geometry_shader = 3,
+    shaderc_tess_control_shader = 4,
+    shaderc_tess_evaluation_shader = 5,
+    shaderc_task_shader = 26,
+    shaderc_mesh_shader = 27,
+};
+
+enum {
+    shaderc_uniform_kind_image,
+    shaderc_uniform_kind_sampler,
+    shaderc_uniform_kind_texture,
+    shaderc_uniform_kind_buffer,
+    shaderc_uniform_kind_storage_buffer,
+    shaderc_uniform_kind_unordered_access_view,
+};
+
+#define shaderc_include_type_relative 0
+#define shaderc_target_env_vulkan 0
+#define shaderc_env_version_vulkan_1_3 ((1u << 22) | (3u << 12))
+#define shaderc_profile_core 1
+#define shaderc_optimization_level_performance 2
+#define shaderc_compilation_status_success 0
+
+typedef shaderc_include_result* (*shaderc_include_resolve_fn)(void *userData, const char *requestedSource, int type, const char *requestingSource, size_t includeDepth);
+typedef void (*shaderc_include_result_release_fn)(void *userData, shaderc_include_result *result);
+
+static struct {
+    void *library;
+    shaderc_compiler_t compiler;
+    uint64_t version; // identity of the compiler build, part of the cache keys
+    shaderc_compiler_t (*compiler_initialize)();
+    shaderc_compile_options_t (*compile_options_initialize)();
+    void (*compile_options_release)(shaderc_compile_options_t);
+    void (*compile_options_add_macro_definition)(shaderc_compile_options_t, const char*, size_t, const char*, size_t);
+    void (*compile_options_set_optimization_level)(shaderc_compile_options_t, int);
+    void (*compile_options_set_forced_version_profile)(shaderc_compile_options_t, int, int);
+    void (*compile_options_set_target_env)(shaderc_compile_options_t, int, uint32_t);
+    void (*compile_options_set_auto_bind_uniforms)(shaderc_compile_options_t, bool);
+    void (*compile_options_set_auto_map_locations)(shaderc_compile_options_t, bool);
+    void (*compile_options_set_binding_base_for_stage)(shaderc_compile_options_t, int, int, uint32_t);
+    void (*compile_options_set_include_callbacks)(shaderc_compile_options_t, shaderc_include_resolve_fn, shaderc_include_result_release_fn, void*);
+    shaderc_compilation_result_t (*compile_into_spv)(const shaderc_compiler_t, const char*, size_t, int, const char*, const char*, const shaderc_compile_options_t);
+    int (*result_get_compilation_status)(const shaderc_compilation_result_t);
+    size_t (*result_get_length)(const shaderc_compilation_result_t);
+    const char* (*result_get_bytes)(const shaderc_compilation_result_t);
+    const char* (*result_get_error_message)(const shaderc_compilation_result_t);
+    void (*result_release)(shaderc_compilation_result_t);
+    void (*get_spv_version)(unsigned int*, unsigned int*);
+} shaderc;
+
+static std::once_flag shadercLoaded;
+
+static void loadShaderc() {
+    if (!(shaderc.library = SDL_LoadObject(SHADERC_LIBRARY))) {
+        logError("Can't compile GLSL shaders, %s", SDL_GetError());
+        return;
+    }
+
+    bool complete = true;
+    auto load = [&](auto &function, const char *name) {
+        function = (typename std::remove_reference<decltype(function)>::type)SDL_LoadFunction(shaderc.library, name);
+        complete &= function != nullptr;
+    };
+    load(shaderc.compiler_initialize                       , "shaderc_compiler_initialize"                       );
+    load(shaderc.compile_options_initialize                , "shaderc_compile_options_initialize"                );
+    load(shaderc.compile_options_release                   , "shaderc_compile_options_release"                   );
+    load(shaderc.compile_options_add_macro_definition      , "shaderc_compile_options_add_macro_definition"      );
+    load(shaderc.compile_options_set_optimization_level    , "shaderc_compile_options_set_optimization_level"    );
+    load(shaderc.compile_options_set_forced_version_profile, "shaderc_compile_options_set_forced_version_profile");
+    load(shaderc.compile_options_set_target_env            , "shaderc_compile_options_set_target_env"            );
+    load(shaderc.compile_options_set_auto_bind_uniforms    , "shaderc_compile_options_set_auto_bind_uniforms"    );
+    load(shaderc.compile_options_set_auto_map_locations    , "shaderc_compile_options_set_auto_map_locations"    );
+    load(shaderc.compile_options_set_binding_base_for_stage, "shaderc_compile_options_set_binding_base_for_stage");
+    load(shaderc.compile_options_set_include_callbacks     , "shaderc_compile_options_set_include_callbacks"     );
+    load(shaderc.compile_into_spv                          , "shaderc_compile_into_spv"                          );
+    load(shaderc.result_get_compilation_status             , "shaderc_result_get_compilation_status"             );
+    load(shaderc.result_get_length                         , "shaderc_result_get_length"                         );
+    load(shaderc.result_get_bytes                          , "shaderc_result_get_bytes"                          );
+    load(shaderc.result_get_error_message                  , "shaderc_result_get_error_message"                  );
+    load(shaderc.result_release                            , "shaderc_result_release"                            );
+    load(shaderc.get_spv_version                           , "shaderc_get_spv_version"                           );
+
+    if (!complete) {
+        logError("Can't compile GLSL shaders, incomplete %s", SHADERC_LIBRARY);
+        SDL_UnloadObject(shaderc.library);
+        shaderc.library = nullptr;
+        return;
+    }
+
+    // shaderc doesn't report its own version, only the SPIR-V one, so an update that changes the
+    // code generation is detected by the size and date of the library file
+    unsigned int version, revision;
+    shaderc.get_spv_version(&version, &revision);
+    const uint64_t spirvVersion = version ^ ((uint64_t)revision << 32);
+    shaderc.version = hashShaderData(&spirvVersion, sizeof(spirvVersion), 0);
+
+    char path[1024] = "";
+#ifdef _WIN32
+    GetModuleFileNameA(GetModuleHandleA(SHADERC_LIBRARY), path, sizeof(path));
+#else
+    Dl_info info;
+    if (dladdr((void*)shaderc.compile_into_spv, &info) && info.dli_fname)
+        snprintf(path, sizeof(path), "%s", info.dli_fname);
+#endif
+    struct stat status;
+    if (path[0] && stat(path, &status) == 0) {
+        const uint64_t identity[] = {(uint64_t)status.st_size, (uint64_t)status.st_mtime};
+        shaderc.version = hashShaderData(identity, sizeof(identity), shaderc.version);
+    } else
+        logWarning("Can't identify %s, its updates won't invalidate the shader cache", SHADERC_LIBRARY);
+
+    shaderc.compiler = shaderc.compiler_initialize();
+}
+
+// Binding bases per stage matching the GLSLFLAGS of the application makefiles
+struct StageBindings {
+    nvrhi::ShaderType stage;
+    int kind;
+    uint32_t buffer, texture, storageBuffer, image;
+};
+
+static const StageBindings STAGE_BINDINGS[] = {
+    {nvrhi::ShaderType::Amplification, shaderc_task_shader           ,  0, 16,  96, 176},
+    {nvrhi::ShaderType::Mesh         , shaderc_mesh_shader           ,  1, 32, 112, 192},
+    {nvrhi::ShaderType::Vertex       , shaderc_vertex_shader         ,  0, 16,  96, 176},
+    {nvrhi::ShaderType::Hull         , shaderc_tess_control_shader   ,  1, 32, 112, 192},
+    {nvrhi::ShaderType::Domain       , shaderc_tess_evaluation_shader,  2, 48, 128, 208},
+    {nvrhi::ShaderType::Geometry     , shaderc_geometry_shader       ,  3, 64, 144, 224},
+    {nvrhi::ShaderType::Pixel        , shaderc_fragment_shader       ,  4, 80, 160, 240},
+    {nvrhi::ShaderType::Compute      , shaderc_compute_shader        ,  0, 16,  96, 176},
+};
+
+static const StageBindings* getStageBindings(const nvrhi::ShaderType stage) {
+    for (const StageBindings &bindings : STAGE_BINDINGS)
+        if (bindings.stage == stage)
+            return &bindings;
+    return nullptr;
+}
+
+struct IncludeContext {
+    ShaderCacheEntry *entry;
+};
+
+struct IncludeResult {
+    shaderc_include_result result;
+    std::string name, content;
+};
+
+// Relative to the including file first, then in the include directory
+static shaderc_include_result* resolveInclude(void *userData, const char *requestedSource, int type, const char *requestingSource, size_t includeDepth) {
+    UNUSED(includeDepth);
+    IncludeContext *context = (IncludeContext*)userData;
+    IncludeResult *include = new IncludeResult();
+
+    if (type == shaderc_include_type_relative) {
+        const char *slash = MAX(strrchr(requestingSource, '/'), strrchr(requestingSource, '\\'));
+        include->name = std::string(requestingSource, slash ? slash + 1 - requestingSource : 0) + requestedSource;
+    }
+    if (include->name.empty() || !readWholeFile(include->name.c_str(), include->content)) {
+        include->name = joinPath(includeDir, requestedSource);
+        if (!readWholeFile(include->name.c_str(), include->content)) {
+            include->name.clear();
+            include->content = std::string("Can't find include file ") + requestedSource;
+        }
+    }
+
+    if (!include->name.empty())
+        context->entry->includes.push_back(std::make_pair(include->name, hashShaderData(include->content.data(), include->content.size(), 0)));
+
+    include->result = {include->name.c_str(), include->name.size(), include->content.c_str(), include->content.size(), include};
+    return &include->result;
+}
+
+static void releaseInclude(void *userData, shaderc_include_result *result) {
+    UNUSED(userData);
+    delete (IncludeResult*)result->user_data;
+}
+
+// Entries are the SPIR-V and the serialized reflection of a stage
+
+struct CacheWriter {
+    std::vector<char> data;
+
+    void write(const void *src, const size_t size) {data.insert(data.end(), (const char*)src, (const char*)src + size);}
+    void write(const uint x) {write(&x, sizeof(x));}
+    void write(const uint64_t x) {write(&x, sizeof(x));}
+    void write(const std::string &s) {write((uint)s.size()); write(s.data(), s.size());}
+};
+
+struct CacheReader {
+    const char *data, *end;
+
+    bool read(void *dest, const size_t size) {
+        if ((size_t)(end - data) < size) return false;
+        memcpy(dest, data, size);
+        data += size;
+        return true;
+    }
+    bool read(uint &x) {return read(&x, sizeof(x));}
+    bool read(uint64_t &x) {return read(&x, sizeof(x));}
+    // Counts read from a truncated or corrupt file can't ask for more than what's left
+    bool read(uint &count, const size_t minElementSize) {return read(count) && count <= (size_t)(end - data) / minElementSize;}
+    bool read(std::string &s) {
+        uint size;
+        if (!read(size) || (size_t)(end - data) < size) return false;
+        s.assign(data, size);
+        data += size;
+        return true;
+    }
+};
+
+static std::string getCacheFilename(const uint64_t key) {
+    char name[32];
+    sprintf(name, "%016llx.spvc", (unsigned long long)key);
+    return joinPath(cacheDir, name);
+}
+
+uint64_t hashShaderData(const void *data, const size_t size, const uint64_t seed) {
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ull ^ seed;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ ((const unsigned char*)data)[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+uint64_t getShaderCacheKey(const nvrhi::ShaderType stage, const void *data, const size_t size, const bool glsl, const char *defines) {
+    const uint header[] = {CACHE_VERSION, (uint)stage, glsl};
+    uint64_t key = hashShaderData(header, sizeof(header), 0);
+    if (glsl) {
+        std::call_once(shadercLoaded, loadShaderc);
+        key = hashShaderData(&shaderc.version, sizeof(shaderc.version), key);
+    }
+    key = hashShaderData(data, size, key);
+    if (defines)
+        key = hashShaderData(defines, strlen(defines), key);
+    return key;
+}
+
+bool readShaderCache(const uint64_t key, ShaderCacheEntry &entry) {
+    std::string content;
+    if (cacheDir.empty() || !readWholeFile(getCacheFilename(key).c_str(), content))
+        return false;
+
+    CacheReader reader = {content.data(), content.data() + content.size()};
+    uint magic, nbIncludes, spirvSize, nbResources;
+    uint64_t storedKey;
+    if (!reader.read(magic) || magic != CACHE_MAGIC || !reader.read(storedKey) || storedKey != key ||
+        !reader.read(nbIncludes, sizeof(uint) + sizeof(uint64_t)))
+        return false;
+
+    // The source is part of the key, but not the files it includes
+    entry.includes.resize(nbIncludes);
+    for (auto &include : entry.includes) {
+        std::string includeContent;
+        if (!reader.read(include.first) || !reader.read(include.second) || !readWholeFile(include.first.c_str(), includeContent) ||
+            hashShaderData(includeContent.data(), includeContent.size(), 0) != include.second)
+            return false;
+    }
+
+    if (!reader.read(spirvSize, sizeof(uint32_t)))
+        return false;
+    entry.spirv.resize(spirvSize);
+    if (!reader.read(entry.spirv.data(), spirvSize * sizeof(uint32_t)) || !reader.read(nbResources, 6 * sizeof(uint)))
+        return false;
+
+    entry.reflection.resize(nbResources);
+    for (ReflectedResource &resource : entry.reflection) {
+        uint type, nbUniforms;
+        if (!reader.read(type) || !reader.read(resource.binding) || !reader.read(resource.arraySize) || !reader.read(resource.size) ||
+            !reader.read(resource.name) || !reader.read(nbUniforms, 3 * sizeof(uint)))
+            return false;
+
+        resource.type = (nvrhi::ResourceType)type;
+        resource.uniforms.resize(nbUniforms);
+        for (ReflectedUniform &uniform : resource.uniforms)
+            if (!reader.read(uniform.name) || !reader.read(uniform.offset) || !reader.read(uniform.size))
+                return false;
+    }
+
+    return reader.data == reader.end;
+}
+
+void writeShaderCache(const uint64_t key, const ShaderCacheEntry &entry) {
+    if (cacheDir.empty())
+        return;
+
+    CacheWriter writer;
+    writer.write(CACHE_MAGIC);
+    writer.write(key);
+    writer.write((uint)entry.includes.size());
+    for (const auto &include : entry.includes) {
+        writer.write(include.first);
+        writer.write(include.second);
+    }
+
+    writer.write((uint)entry.spirv.size());
+    writer.write(entry.spirv.data(), entry.spirv.size() * sizeof(uint32_t));
+    writer.write((uint)entry.reflection.size());
+    for (const ReflectedResource &resource : entry.reflection) {
+        writer.write((uint)resource.type);
+        writer.write(resource.binding);
+        writer.write(resource.arraySize);
+        writer.write(resource.size);
+        writer.write(resource.name);
+        writer.write((uint)resource.uniforms.size());
+        for (const ReflectedUniform &uniform : resource.uniforms) {
+            writer.write(uniform.name);
+            writer.write(uniform.offset);
+            writer.write(uniform.size);
+        }
+    }
+
+    // Written aside then renamed, so an interrupted write or a concurrent read never sees a partial entry
+    static std::atomic<uint> nbWrites(0);
+    const std::string filename = getCacheFilename(key);
+    const std::string temporary = filename + "." + std::to_string(SDL_GetPerformanceCounter()) + "." + std::to_string(nbWrites++) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        makeDirectory(cacheDir.c_str());
+        file = fopen(temporary.c_str(), "wb");
+    }
+    if (!file) {
+        logWarning("Can't write the shader cache entry \"%s\"", filename.c_str());
+        return;
+    }
+
+    bool success = fwrite(writer.data.data(), 1, writer.data.size(), file) == writer.data.size();
+    success &= fclose(file) == 0;
+#ifdef _WIN32
+    success = success && MoveFileExA(temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    success = success && rename(temporary.c_str(), filename.c_str()) == 0;
+#endif
+    if (!success) {
+        logWarning("Can't write the shader cache entry \"%s\"", filename.c_str());
+        remove(temporary.c_str());
+    }
+}
+
+bool compileGlsl(const char *filename, const char *source, const nvrhi::ShaderType stage, const char *defines, ShaderCacheEntry &entry, std::string &error) {
+    std::call_once(shadercLoaded, loadShaderc);
+    const StageBindings *bindings = getStageBindings(stage);
+    if (!shaderc.compiler || !bindings) {
+        error = std::string("Can't compile \"") + filename + "\", no GLSL compiler";
+        return false;
+    }
+
+    // Same options as the application makefiles, except the optimization of the SPIR-V that they
+    // don't ask for. Options aren't shared between threads.
+    shaderc_compile_options_t options = shaderc.compile_options_initialize();
+    shaderc.compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+    shaderc.compile_options_set_forced_version_profile(options, 460, shaderc_profile_core);
+    shaderc.compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+    shaderc.compile_options_set_auto_bind_uniforms(options, true);
+    shaderc.compile_options_set_auto_map_locations(options, true);
+    shaderc.compile_options_set_binding_base_for_stage(options, bindings->kind, shaderc_uniform_kind_buffer               , bindings->buffer       );
+    shaderc.compile_options_set_binding_base_for_stage(options, bindings->kind, shaderc_uniform_kind_image                , bindings->texture      );
+    shaderc.compile_options_set_binding_base_for_stage(options, bindings->kind, shaderc_uniform_kind_sampler              , bindings->texture      );
+    shaderc.compile_options_set_binding_base_for_stage(options, bindings->kind, shaderc_uniform_kind_texture              , bindings->texture      );
+    shaderc.compile_options_set_binding_base_for_stage(options, bindings->kind, shaderc_uniform_kind_storage_buffer       , bindings->storageBuffer);
+    shaderc.compile_options_set_binding_base_for_stage(options, bindings->kind, shaderc_uniform_kind_unordered_access_view, bindings->image        );
+
+    // Space separated NAME or NAME=VALUE
+    for (const char *define = defines; define && *define;) {
+        const size_t length = strcspn(define, " \t\n");
+        const char *equal = (const char*)memchr(define, '=', length);
+        if (length > 0) {
+            if (equal)
+                shaderc.compile_options_add_macro_definition(options, define, equal - define, equal + 1, define + length - equal - 1);
+            else
+                shaderc.compile_options_add_macro_definition(options, define, length, "", 0);
+        }
+        define += length;
+        define += strspn(define, " \t\n");
+    }
+
+    IncludeContext includeContext = {&entry};
+    entry.includes.clear();
+    shaderc.compile_options_set_include_callbacks(options, resolveInclude, releaseInclude, &includeContext);
+
+    shaderc_compilation_result_t result = shaderc.compile_into_spv(shaderc.compiler, source, strlen(source), bindings->kind, filename, "main", options);
+    const bool success = shaderc.result_get_compilation_status(result) == shaderc_compilation_status_success;
+    if (success) {
+        entry.spirv.resize(shaderc.result_get_length(result) / sizeof(uint32_t));
+        memcpy(entry.spirv.data(), shaderc.result_get_bytes(result), entry.spirv.size() * sizeof(uint32_t));
+    } else {
+        error = std::string("Can't compile \"") + filename + "\":\n" + shaderc.result_get_error_message(result);
+        logError("%s", error.c_str());
+    }
+
+    shaderc.result_release(result);
+    shaderc.compile_options_release(options);
+    return success;
+}
+
+extern "C" {
+
+void setShaderCacheDir(const char *dir) {
+    cacheDir = dir ? dir : "";
+}
+
+void setShaderIncludeDir(const char *dir) {
+    includeDir = dir ? dir : "";
+}
+
+}
@@ -0,0 +1,152 @@
+#include <simulation.h>
+#include <engine.h>
+#include <SDL2/SDL.h>
+#include <string.h>
+#include "private_log.h"
+#include "private_simulation.h"
+
+// The tick being computed never writes the two published snapshots, its input being the latest, nor
+// the two read by the frame, acquireSimulationStates can publish either published one at any time
+#define NB_SNAPSHOTS 5
+// Ticks a late simulation catches up at most, the older ones are dropped
+#define MAX_LATE_TICKS 4
+
+static UserSimulateFunc userSimulate = NULL;
+static uint tickRate, stateSize;
+static char *snapshots[NB_SNAPSHOTS];
+static Uint64 tickTimes[NB_SNAPSHOTS];  // scheduled performance counter of each tick
+static int latest, previous;            // published by the simulation
+static int readLatest, readPrevious;    // used by the current frame
+static float readAlpha = 1.0f;
+static SDL_atomic_t running, nbTicks;
+static SDL_mutex *mutex = NULL;
+static SDL_Thread *thread = NULL;
+
+static int simulationLoop(void *data) {
+    UNUSED(data);
+    const Uint64 frequency = SDL_GetPerformanceFrequency(), period = MAX(frequency / tickRate, 1ull);
+    Uint64 next = SDL_GetPerformanceCounter() + period;
+
+    while (SDL_AtomicGet(&running)) {
+        // Sleeps while the tick is more than 2 ms away, then spins
+        Uint64 now = SDL_GetPerformanceCounter();
+        while (now < next) {
+            if ((next - now) * 500 > frequency)
+                SDL_Delay(1);
+            now = SDL_GetPerformanceCounter();
+        }
+
+        if (now - next > MAX_LATE_TICKS * period)
+            next = now - MAX_LATE_TICKS * period;
+        const Uint64 tickTime = next;
+        next += period;
+
+        if (animationsPaused())
+            continue;
+
+        SDL_LockMutex(mutex);
+        int slot = 0;
+        while (slot == latest || slot == previous || slot == readLatest || slot == readPrevious)
+            slot++;
+        SDL_UnlockMutex(mutex);
+
+        memcpy(snapshots[slot], snapshots[latest], stateSize);
+        userSimulate(snapshots[slot], 1.0f / tickRate);
+
+        SDL_LockMutex(mutex);
+        previous = latest;
+        latest = slot;
+        tickTimes[slot] = tickTime;
+        SDL_UnlockMutex(mutex);
+        SDL_AtomicAdd(&nbTicks, 1);
+    }
+
+    return 0;
+}
+
+static void freeSnapshots() {
+    for (int i = 0; i < NB_SNAPSHOTS; i++) {
+        aligned_free(snapshots[i]);
+        snapshots[i] = NULL;
+    }
+}
+
+void setSimulationFunc(UserSimulateFunc f, const uint rate, const uint size, const void *initialState) {
+    if (thread) {
+        logError("The simulation can't change while the application runs");
+        return;
+    }
+
+    freeSnapshots();
+    userSimulate = NULL;
+    if (!f)
+        return;
+
+    if (rate == 0 || size == 0) {
+        logError("Invalid simulation of %u bytes at %u ticks per second", size, rate);
+        return;
+    }
+
+    if (!mutex)
+        mutex = SDL_CreateMutex();
+
+    for (int i = 0; i < NB_SNAPSHOTS; i++) {
+        snapshots[i] = aligned_malloc(size);
+        if (initialState)
+            memcpy(snapshots[i], initialState, size);
+        else
+            memset(snapshots[i], 0, size);
+        tickTimes[i] = SDL_GetPerformanceCounter();
+    }
+
+    userSimulate = f;
+    tickRate = rate;
+    stateSize = size;
+    latest = previous = readLatest = readPrevious = 0;
+    readAlpha = 1.0f;
+    SDL_AtomicSet(&nbTicks, 0);
+}
+
+void getSimulationStates(const void **previousState, const void **currentState, float *alpha) {
+    if (previousState) *previousState = userSimulate ? snapshots[readPrevious] : NULL;
+    if (currentState) *currentState = userSimulate ? snapshots[readLatest] : NULL;
+    if (alpha) *alpha = readAlpha;
+}
+
+uint getSimulationTicks() {
+    return SDL_AtomicGet(&nbTicks);
+}
+
+void startSimulation() {
+    if (!userSimulate || thread)
+        return;
+
+    SDL_AtomicSet(&running, 1);
+    thread = SDL_CreateThread(simulationLoop, "simulation", NULL);
+    if (!thread)
+        logError("Can't start the simulation thread: %s", SDL_GetError());
+}
+
+void acquireSimulationStates() {
+    if (!thread)
+        return;
+
+    SDL_LockMutex(mutex);
+    readPrevious = previous;
+    readLatest = latest;
+    const Uint64 tickTime = tickTimes[latest];
+    SDL_UnlockMutex(mutex);
+
+    // The frame shows the state one tick late, between the last two ticks
+    const double elapsed = (double)(Sint64)(SDL_GetPerformanceCounter() - tickTime) * tickRate / SDL_GetPerformanceFrequency();
+    readAlpha = CLAMP(elapsed, 0.0, 1.0);
+}
+
+void stopSimulation() {
+    if (!thread)
+        return;
+
+    SDL_AtomicSet(&running, 0);
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+}
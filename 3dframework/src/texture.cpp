@@ -2,6 +2,7 @@
 #include <context.h>
 #include <float.h>
 #include <framebuffer.h>
+#include <graphics_states.h>
 #include <mesh.h>
 #include <nvrhi/nvrhi.h>
 #include <SDL2/SDL_image.h>
@@ -9,6 +10,7 @@
 #include <vector.h>
 #include "private_impl.h"
 #include "private_log.h"
+#include "private_parallel.h"
 
 static_assert(sizeof(SamplerState) == sizeof(nvrhi::SamplerDesc));
 
@@ -72,6 +74,15 @@ Texture createTexture(const TextureType type, const uint width, const uint heigh
         .setInitialState(nvrhi::ResourceStates::ShaderResource).setKeepInitialState(true);
     tex->state.borderColor = 0.0f;
     tex->texture = getDevice()->createTexture(tex->desc);
+    if (!tex->texture) {
+        logError("Can't create a %ux%ux%u texture of %u layers (%llu MB already used, %llu MB budget)", width, height, depth, layers, getTotalMemoryUsage() >> 20, getDeviceLocalBudget() >> 20);
+        delete tex;
+        return NullTexture;
+    }
+
+    tex->memoryCategory = MemoryCategory_Textures;
+    tex->memorySize = getDevice()->getTextureMemoryRequirements(tex->texture).size;
+    trackMemory(tex->memoryCategory, tex->memorySize);
     return Texture{tex};
 }
 
@@ -87,11 +98,13 @@ Texture loadTexture(const char *filename, const ulong flags) {
 Texture loadTextures(const char *filename, const uint nbTextures, const ulong flags) {
     const bool srgb = (flags & SRGB_FLAG) != 0, snorm = (flags & SNORM_FLAG) != 0;
     SDL_Surface *surface[nbTextures];
-    for (uint i = 0; i < nbTextures; i++) {
-        char fullname[256];
-        sprintf(fullname, filename, i);
-        surface[i] = loadSurface(fullname);
-    }
+    parallelFor(nbTextures, 1, [&](const uint begin, const uint end) {
+        for (uint i = begin; i < end; i++) {
+            char fullname[256];
+            sprintf(fullname, filename, i);
+            surface[i] = loadSurface(fullname);
+        }
+    });
 
     Texture tex = createTexture(Texture2DArray, surface[0]->w, surface[0]->h, 1, nbTextures, srgb ? SRGBA8_UNORM : snorm ? RGBA8_SNORM : RGBA8_UNORM, flags);
     for (uint i = 0; i < nbTextures; i++) {
@@ -108,6 +121,7 @@ void deleteTexture(Texture *tex) {
         return;
 
     TextureImpl *impl = (TextureImpl*)tex->impl;
+    trackMemory(impl->memoryCategory, -(long long)impl->memorySize);
     impl->texture.Reset();
     if (impl->staging) impl->staging.Reset();
     delete impl;
@@ -150,22 +164,30 @@ void updateMipmaps(Texture tex) {
     };
 
     const nvrhi::TextureDesc &desc = getNvTexture(tex)->getDesc();
+    // Each mip framebuffer is deleted right after use, the caller's one and its viewport are restored after the chain
+    const Framebuffer previous = getUsedFramebuffer();
+    const ViewportState viewport = getRenderState()->viewportState, scissor = getRenderState()->scissorState;
     SCOPED(Shader) mipmapShader = createGraphicsShader(vertSrc, sizeof(vertSrc), nullptr, 0, nullptr, 0, nullptr, 0, fragSrc, sizeof(fragSrc));
     useShader(mipmapShader);
     uint width = MAX(desc.width >> 1, 1), height = MAX(desc.height >> 1, 1);
     for (uint i = 1; i < desc.mipLevels; i++) {
-        useFramebuffer(createFramebufferMip(&tex, 1, NullTexture, i));
+        SCOPED(Framebuffer) mipFramebuffer = createFramebufferMip(&tex, 1, NullTexture, i);
+        useFramebuffer(mipFramebuffer);
         setUniformTextureMip(tex, i - 1, "Mip0");
         setUniform2F(1.0f / float4((float)width, (float)height), "invSize");
         drawSubMesh(NullMesh, 0, 3);
 
         width = MAX(width >> 1, 1), height = MAX(height >> 1, 1);
     }
+
+    if (previous.impl) useFramebuffer(previous);
+    getRenderState()->viewportState = viewport, getRenderState()->scissorState = scissor;
 }
 
 void *mapTexture(Texture tex) {
     TextureImpl *impl = (TextureImpl*)tex.impl;
-    impl->staging = getDevice()->createStagingTexture(impl->desc, nvrhi::CpuAccessMode::Read);
+    if (!impl->staging)
+        impl->staging = getDevice()->createStagingTexture(impl->desc, nvrhi::CpuAccessMode::Read);
     getCommandList()->copyTexture(impl->staging, nvrhi::TextureSlice(), impl->texture, nvrhi::TextureSlice());
     size_t rowPitch;
     return getDevice()->mapStagingTexture(impl->staging, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch);
@@ -174,7 +196,6 @@ void *mapTexture(Texture tex) {
 void unmapTexture(Texture tex) {
     TextureImpl *impl = (TextureImpl*)tex.impl;
     getDevice()->unmapStagingTexture(impl->staging);
-    impl->staging.Reset();
 }
 
 SamplerState* getSampler(Texture tex) {
@@ -265,6 +286,15 @@ nvrhi::ITexture* getNvTexture(Texture &tex) {
     return impl ? impl->texture : nullptr;
 }
 
+void setTextureMemoryCategory(Texture &tex, const MemoryCategory category) {
+    TextureImpl *impl = (TextureImpl*)tex.impl;
+    if (!impl || impl->memoryCategory == category) return;
+
+    trackMemory(impl->memoryCategory, -(long long)impl->memorySize);
+    trackMemory(category, impl->memorySize);
+    impl->memoryCategory = category;
+}
+
 nvrhi::ISampler* getNvSampler(Texture &tex) {
     TextureImpl *impl = (TextureImpl*)tex.impl;
     if (!impl) return nullptr;
@@ -1,9 +1,22 @@
 #include <transform.h>
 #include <math.h>
-#include <string.h>
+
+// Popped entries are kept for the next pushes of the thread instead of going back to the heap
+static _Thread_local Transform *freeEntries = NULL;
+
+// tr was applied after the current transform, its inverse goes on the other side
+static void appendInverse(Transform *m, Mat4 invtr) {
+    Mat4 invmat;
+    copym4(invmat, m->matinv);
+    multiplytm4(m->matinv, invmat, invtr);
+}
 
 void pushMatrix(Transform *m) {
-    Transform *mat = aligned_malloc(sizeof(Transform));
+    Transform *mat = freeEntries;
+    if (mat)
+        freeEntries = mat->next;
+    else
+        mat = aligned_malloc(sizeof(Transform));
     *mat = *m;
     m->next = mat;
 }
@@ -12,7 +25,8 @@ void popMatrix(Transform *m) {
     if (m->next) {
         Transform *mat = m->next;
         *m = *mat;
-        aligned_free(mat);
+        mat->next = freeEntries;
+        freeEntries = mat;
     } else {
         setIdentity(m);
     }
@@ -34,14 +48,15 @@ void orthographic(Transform *m, const float l, const float r, const float b, con
         {0.0f             , 0.0f             , 1.0f / (f - n), 0.0f},
         {(r + l) / (l - r), (t + b) / (t - b), f / (f - n)   , 1.0f},
     };
+    Mat4 invtr = {
+        {(r - l) * 0.5f   , 0.0f             , 0.0f          , 0.0f},
+        {0.0f             , (b - t) * 0.5f   , 0.0f          , 0.0f},
+        {0.0f             , 0.0f             , f - n         , 0.0f},
+        {(r + l) * 0.5f   , (t + b) * 0.5f   , -f            , 1.0f},
+    };
 
     multiplytm4(m->mat, tr, m->mat);
-
-    Mat4 invtr;
-    inversem4(invtr, tr);
-    Mat4 invmat;
-    memcpy(invmat, m->matinv, sizeof(Mat4));
-    multiplytm4(m->matinv, invmat, invtr);
+    appendInverse(m, invtr);
 }
 
 void perspective(Transform *m, const float fovy, const float ratio, const float n, const float f) {
@@ -52,14 +67,15 @@ void perspective(Transform *m, const float fovy, const float ratio, const float
         {0.0f     ,  0.0f, n / (f - n)    , -1.0f},
         {0.0f     ,  0.0f, f * n / (f - n),  0.0f},
     };
+    Mat4 invtr = {
+        {ratio / t,  0.0f    , 0.0f,  0.0f           },
+        {0.0f     , -1.0f / t, 0.0f,  0.0f           },
+        {0.0f     ,  0.0f    , 0.0f,  (f - n) / (f * n)},
+        {0.0f     ,  0.0f    , -1.0f, 1.0f / f       },
+    };
 
     multiplytm4(m->mat, tr, m->mat);
-
-    Mat4 invtr;
-    inversem4(invtr, tr);
-    Mat4 invmat;
-    memcpy(invmat, m->matinv, sizeof(Mat4));
-    multiplytm4(m->matinv, invmat, invtr);
+    appendInverse(m, invtr);
 }
 
 void perspectiveRTE(Transform *m, const float fovy, const float ratio, const float n, const float f) {
@@ -70,14 +86,15 @@ void perspectiveRTE(Transform *m, const float fovy, const float ratio, const flo
         { 0.0f     , 0.0f, f / (f - n)    , 1.0f},
         { 0.0f     , 0.0f, f * n / (n - f), 0.0f},
     };
+    Mat4 invtr = {
+        {-ratio / t, 0.0f    , 0.0f,  0.0f           },
+        { 0.0f     , 1.0f / t, 0.0f,  0.0f           },
+        { 0.0f     , 0.0f    , 0.0f,  (n - f) / (f * n)},
+        { 0.0f     , 0.0f    , 1.0f,  1.0f / n       },
+    };
 
     multiplytm4(m->mat, tr, m->mat);
-
-    Mat4 invtr;
-    inversem4(invtr, tr);
-    Mat4 invmat;
-    memcpy(invmat, m->matinv, sizeof(Mat4));
-    multiplytm4(m->matinv, invmat, invtr);
+    appendInverse(m, invtr);
 }
 
 void perspective2(Transform *m, const float l, const float r, const float b, const float t, const float n, const float f) {
@@ -87,11 +104,15 @@ void perspective2(Transform *m, const float l, const float r, const float b, con
         {(r + l) / (r - l) , (t + b) / (b - t) , n / (f - n)    , -1.0f},
         {0.0f              , 0.0f              , f * n / (f - n),  0.0f},
     };
+    Mat4 invtr = {
+        {(r - l) / (2.0f * n), 0.0f                , 0.0f,  0.0f             },
+        {0.0f                , (b - t) / (2.0f * n), 0.0f,  0.0f             },
+        {0.0f                , 0.0f                , 0.0f,  (f - n) / (f * n)},
+        {(r + l) / (2.0f * n), (t + b) / (2.0f * n), -1.0f, 1.0f / f         },
+    };
 
     multiplytm4(m->mat, tr, m->mat);
-    Mat4 invtr;
-    inversem4(invtr, tr);
-    multiplytm4(m->matinv, invtr, m->matinv);
+    appendInverse(m, invtr);
 }
 
 void translate(Transform *m, const Float4 t) {
@@ -109,7 +130,7 @@ void translate(Transform *m, const Float4 t) {
     };
 
     multiplytm4(m->mat, tr, m->mat);
-    multiplytm4(m->matinv, invtr, m->matinv);
+    appendInverse(m, invtr);
 }
 
 void rotate(Transform *m, const float angle, const Float4 axis) {
@@ -128,7 +149,7 @@ void rotate2(Transform *m, const float sinAngle, const float cosAngle, const Flo
     transposem4(invtr, tr);
 
     multiplytm4(m->mat, tr, m->mat);
-    multiplytm4(m->matinv, invtr, m->matinv);
+    appendInverse(m, invtr);
 }
 
 void scale(Transform *m, const Float4 s) {
@@ -146,7 +167,7 @@ void scale(Transform *m, const Float4 s) {
     };
 
     multiplytm4(m->mat, tr, m->mat);
-    multiplytm4(m->matinv, invtr, m->matinv);
+    appendInverse(m, invtr);
 }
 
 void lookAt(Transform *m, const Float4 eye, const Float4 center, const Float4 up) {
@@ -161,15 +182,19 @@ void lookAt(Transform *m, const Float4 eye, const Float4 center, const Float4 up
     Mat4 trtr = {normal, conormal, eyeDir, W_AXIS};
     Mat4 tr;
     transposem4(tr, trtr);
-    inversem4(trtr, tr);
+
+    // Orthonormal basis, the inverse is its transpose placed at the eye
+    Mat4 invtr = {normal, conormal, eyeDir, eye};
+    invtr[0][3] = invtr[1][3] = invtr[2][3] = 0.0f;
+    invtr[3][3] = 1.0f;
 
     multiplytm4(m->mat, tr, m->mat);
-    multiplytm4(m->matinv, trtr, m->matinv);
+    appendInverse(m, invtr);
 }
 
 void multMatrix(Transform *m, Mat4 mat) {
     multiplytm4(m->mat, mat, m->mat);
     Mat4 inv;
     inversem4(inv, mat);
-    multiplytm4(m->matinv, inv, m->matinv);
+    appendInverse(m, inv);
 }
@@ -91,6 +91,7 @@ namespace nvrhi::validation
 
         const rt::AccelStructDesc& getDesc() const override { return m_AccelStruct->getDesc(); }
         bool isCompacted() const override { return m_AccelStruct->isCompacted(); }
+        uint64_t getBuildScratchSize() const override { return m_AccelStruct->getBuildScratchSize(); }
         uint64_t getDeviceAddress() const override { return m_AccelStruct->getDeviceAddress(); };
         
     private:
@@ -112,6 +113,7 @@ namespace nvrhi::validation
         CommandQueue m_type;
 
         CommandListState m_State = CommandListState::INITIAL;
+        bool m_IsBundle = false;
         bool m_GraphicsStateSet = false;
         bool m_ComputeStateSet = false;
         bool m_MeshletStateSet = false;
@@ -150,6 +152,10 @@ namespace nvrhi::validation
         void close() override;
         void clearState() override;
 
+        void openBundle(IFramebuffer* framebuffer) override;
+        void executeBundle(ICommandList* bundle, IFramebuffer* framebuffer) override;
+        void writeBundleVolatileBuffer(IBuffer* buffer, const void* data, size_t dataSize, uint64_t destOffsetBytes) override;
+
         void clearTextureFloat(ITexture* t, TextureSubresourceSet subresources, const Color& clearColor) override;
         void clearDepthStencilTexture(ITexture* t, TextureSubresourceSet subresources, bool clearDepth, float depth, bool clearStencil, uint8_t stencil) override;
         void clearTextureUInt(ITexture* t, TextureSubresourceSet subresources, uint32_t clearColor) override;
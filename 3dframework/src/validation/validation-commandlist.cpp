@@ -169,11 +169,112 @@ namespace nvrhi::validation
         m_CommandList->open();
 
         m_State = CommandListState::OPEN;
+        m_IsBundle = false;
         m_GraphicsStateSet = false;
         m_ComputeStateSet = false;
         m_MeshletStateSet = false;
     }
 
+    void CommandListWrapper::openBundle(IFramebuffer* framebuffer)
+    {
+        if (m_State == CommandListState::OPEN)
+        {
+            error("Cannot open a command list that is already open");
+            return;
+        }
+
+        if (m_IsImmediate)
+        {
+            error("An immediate command list cannot record a bundle");
+            return;
+        }
+
+        if (!framebuffer)
+        {
+            error("openBundle: framebuffer is NULL");
+            return;
+        }
+
+        m_CommandList->openBundle(framebuffer);
+
+        m_State = CommandListState::OPEN;
+        m_IsBundle = true;
+        m_GraphicsStateSet = false;
+        m_ComputeStateSet = false;
+        m_MeshletStateSet = false;
+    }
+
+    void CommandListWrapper::executeBundle(ICommandList* bundle, IFramebuffer* framebuffer)
+    {
+        if (!requireOpenState())
+            return;
+
+        if (m_IsBundle)
+        {
+            error("A bundle cannot execute other bundles");
+            return;
+        }
+
+        if (!bundle || !framebuffer)
+        {
+            error("executeBundle: bundle or framebuffer is NULL");
+            return;
+        }
+
+        CommandListWrapper* wrapper = dynamic_cast<CommandListWrapper*>(bundle);
+        if (wrapper)
+        {
+            if (!wrapper->m_IsBundle || wrapper->m_State != CommandListState::CLOSED)
+            {
+                error("executeBundle: the command list must be a closed bundle, recorded with openBundle");
+                return;
+            }
+
+            bundle = wrapper->getUnderlyingCommandList();
+        }
+
+        m_CommandList->executeBundle(bundle, framebuffer);
+
+        m_GraphicsStateSet = false;
+        m_ComputeStateSet = false;
+        m_MeshletStateSet = false;
+    }
+
+    void CommandListWrapper::writeBundleVolatileBuffer(IBuffer* buffer, const void* data, size_t dataSize, uint64_t destOffsetBytes)
+    {
+        if (!m_IsBundle || m_State != CommandListState::CLOSED)
+        {
+            error("writeBundleVolatileBuffer: the command list must be a closed bundle, recorded with openBundle");
+            return;
+        }
+
+        if (!buffer || !data)
+        {
+            error("writeBundleVolatileBuffer: buffer or data is NULL");
+            return;
+        }
+
+        const BufferDesc& desc = buffer->getDesc();
+        if (!desc.isVolatile)
+        {
+            std::stringstream ss;
+            ss << "Buffer " << utils::DebugNameToString(desc.debugName) << " cannot be written with "
+                "writeBundleVolatileBuffer because it's not volatile";
+            error(ss.str());
+            return;
+        }
+
+        if (destOffsetBytes + dataSize > desc.byteSize)
+        {
+            std::stringstream ss;
+            ss << "writeBundleVolatileBuffer: the range is out of the bounds of buffer " << utils::DebugNameToString(desc.debugName);
+            error(ss.str());
+            return;
+        }
+
+        m_CommandList->writeBundleVolatileBuffer(buffer, data, dataSize, destOffsetBytes);
+    }
+
     void CommandListWrapper::close()
     {
         switch (m_State)
@@ -1853,6 +1853,14 @@ namespace nvrhi::validation
             CommandListWrapper* wrapper = dynamic_cast<CommandListWrapper*>(pCommandLists[i]);
             if (wrapper)
             {
+                if (wrapper->m_IsBundle)
+                {
+                    std::stringstream ss;
+                    ss << "executeCommandLists: The command list [" << i << "] is a bundle, it must be executed with executeBundle";
+                    error(ss.str());
+                    return 0;
+                }
+
                 if (!wrapper->requireExecuteState())
                     return 0;
 
@@ -27,6 +27,7 @@
 #include "../common/state-tracking.h"
 #include "../common/versioning.h"
 #include <mutex>
+#include <atomic>
 #include <list>
 
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
@@ -108,6 +109,21 @@ namespace nvrhi::vulkan
     vk::CompareOp convertCompareOp(ComparisonFunc op);
     vk::StencilOp convertStencilOp(StencilOp op);
     vk::StencilOpState convertStencilState(const DepthStencilState& depthStencilState, const DepthStencilState::StencilOpDesc& desc);
+
+    // the pipeline states set by CommandList::setDynamicRenderState with extended dynamic states
+    constexpr vk::DynamicState c_ExtendedDynamicStates[] = {
+        vk::DynamicState::eCullMode,
+        vk::DynamicState::eFrontFace,
+        vk::DynamicState::eDepthBias,
+        vk::DynamicState::eDepthBiasEnable,
+        vk::DynamicState::eDepthTestEnable,
+        vk::DynamicState::eDepthWriteEnable,
+        vk::DynamicState::eDepthCompareOp,
+        vk::DynamicState::eStencilTestEnable,
+        vk::DynamicState::eStencilOp,
+        vk::DynamicState::eStencilCompareMask,
+        vk::DynamicState::eStencilWriteMask
+    };
     vk::BlendFactor convertBlendValue(BlendFactor value);
     vk::BlendOp convertBlendOp(BlendOp op);
     vk::ColorComponentFlags convertColorMask(ColorMask mask);
@@ -164,6 +180,10 @@ namespace nvrhi::vulkan
             bool EXT_debug_marker = false;
             bool KHR_acceleration_structure = false;
             bool buffer_device_address = false; // either KHR_ or Vulkan 1.2 versions
+            bool dynamic_rendering = false; // Vulkan 1.3
+            bool extended_dynamic_state = false; // either EXT_ or Vulkan 1.3 versions
+            bool KHR_pipeline_library = false;
+            bool EXT_graphics_pipeline_library = false; // only set along with KHR_pipeline_library, which it requires
             bool KHR_ray_query = false;
             bool KHR_ray_tracing_pipeline = false;
             bool EXT_mesh_shader = false;
@@ -203,6 +223,18 @@ namespace nvrhi::vulkan
 
         std::vector<RefCountPtr<IResource>> referencedResources; // to keep them alive
         std::vector<RefCountPtr<Buffer>> referencedStagingBuffers; // to allow synchronous mapBuffer
+        std::vector<std::shared_ptr<TrackedCommandBuffer>> referencedBundles; // executed secondary command buffers
+
+        // Volatile buffer versions written by a bundle stay pending until it's destroyed, which happens once
+        // it's recorded again and the command buffers executing it are finished
+        struct BundleVolatileVersions
+        {
+            RefCountPtr<Buffer> buffer;
+            int minVersion = 0;
+            int maxVersion = 0;
+        };
+        std::vector<BundleVolatileVersions> bundleVolatileVersions;
+        uint64_t bundleVersionInfo = 0;
 
         uint64_t recordingID = 0;
         uint64_t submissionID = 0;
@@ -234,9 +266,11 @@ namespace nvrhi::vulkan
         ~Queue();
 
         // creates a command buffer and its synchronization resources
-        TrackedCommandBufferPtr createCommandBuffer();
+        TrackedCommandBufferPtr createCommandBuffer(vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
 
         TrackedCommandBufferPtr getOrCreateCommandBuffer();
+        // secondary command buffer owned by a bundle instead of the pool
+        TrackedCommandBufferPtr createBundleCommandBuffer();
 
         void addWaitSemaphore(vk::Semaphore semaphore, uint64_t value);
         void addSignalSemaphore(vk::Semaphore semaphore, uint64_t value);
@@ -629,6 +663,8 @@ namespace nvrhi::vulkan
         ResourceHandle baseShader; // Could be a Shader or ShaderLibrary
         std::vector<ShaderSpecialization> specializationConstants;
 
+        uint64_t contentHash = 0; // of the module, identifies the graphics pipeline libraries
+
         explicit Shader(const VulkanContext& context)
             : desc(ShaderType::None)
             , m_Context(context)
@@ -647,6 +683,7 @@ namespace nvrhi::vulkan
     {
     public:
         vk::ShaderModule shaderModule;
+        uint64_t contentHash = 0;
 
         explicit ShaderLibrary(const VulkanContext& context)
             : m_Context(context)
@@ -707,6 +744,17 @@ namespace nvrhi::vulkan
         vk::RenderPass renderPass = vk::RenderPass();
         vk::Framebuffer framebuffer = vk::Framebuffer();
 
+        // attachments for vkCmdBeginRendering, used when renderPass is null
+        static_vector<vk::ImageView, c_MaxRenderTargets> colorViews;
+        static_vector<vk::Format, c_MaxRenderTargets> colorFormats;
+        vk::ImageView depthView = vk::ImageView();
+        vk::ImageLayout depthLayout = vk::ImageLayout::eUndefined;
+        vk::Format depthFormat = vk::Format::eUndefined;
+        vk::Format stencilFormat = vk::Format::eUndefined;
+        vk::ImageView shadingRateView = vk::ImageView();
+        vk::Extent2D shadingRateTexelSize;
+        uint32_t layerCount = 1;
+
         std::vector<ResourceHandle> resources;
 
         bool managed = true;
@@ -720,6 +768,9 @@ namespace nvrhi::vulkan
         const FramebufferInfoEx& getFramebufferInfo() const override { return framebufferInfo; }
         Object getNativeObject(ObjectType objectType) override;
 
+        // chained to the pipelines created for a framebuffer without render pass
+        vk::PipelineRenderingCreateInfo getRenderingCreateInfo() const;
+
     private:
         const VulkanContext& m_Context;
     };
@@ -960,6 +1011,8 @@ namespace nvrhi::vulkan
             , m_IsScratchBuffer(isScratchBuffer)
         { }
 
+        ~UploadManager();
+
         std::shared_ptr<BufferChunk> CreateChunk(uint64_t size);
 
         bool suballocateBuffer(uint64_t size, Buffer** pBuffer, uint64_t* pOffset, void** pCpuVA, uint64_t currentVersion, uint32_t alignment = 256);
@@ -986,8 +1039,10 @@ namespace nvrhi::vulkan
         rt::AccelStructDesc desc;
         bool allowUpdate = false;
         bool compacted = false;
+        uint64_t buildScratchSize = 0;
         size_t rtxmuId = ~0ull;
         vk::Buffer rtxmuBuffer;
+        vk::QueryPool compactionQueryPool; // compacted size, written after builds with AllowCompaction
 
 
         explicit AccelStruct(const VulkanContext& context)
@@ -1000,6 +1055,7 @@ namespace nvrhi::vulkan
         const rt::AccelStructDesc& getDesc() const override { return desc; }
         bool isCompacted() const override { return compacted; }
         uint64_t getDeviceAddress() const override;
+        uint64_t getBuildScratchSize() const override { return buildScratchSize; }
 
     private:
         const VulkanContext& m_Context;
@@ -1029,6 +1085,12 @@ namespace nvrhi::vulkan
         const VulkanContext& m_Context;
     };
 
+    struct GraphicsPipelineLibrary
+    {
+        vk::Pipeline pipeline;
+        vk::PipelineLayout pipelineLayout;
+    };
+
     class Device : public RefCounter<nvrhi::vulkan::IDevice>
     {
     public:
@@ -1131,6 +1193,12 @@ namespace nvrhi::vulkan
         uint64_t queueGetCompletedInstance(CommandQueue queue) override;
         FramebufferHandle createHandleForNativeFramebuffer(VkRenderPass renderPass, VkFramebuffer framebuffer,
             const FramebufferDesc& desc, bool transferOwnership) override;
+        uint64_t getUploadChunkMemory() override { return m_UploadChunkMemory; }
+
+        // Internal backend methods
+        void trackUploadChunkMemory(int64_t bytes) { m_UploadChunkMemory += bytes; }
+        void queueAccelStructCompaction(AccelStruct* as);
+        std::vector<RefCountPtr<AccelStruct>> takeAccelStructCompactions();
 
     private:
         VulkanContext m_Context;
@@ -1140,11 +1208,19 @@ namespace nvrhi::vulkan
         utils::BitSetAllocator m_TimerQueryAllocator;
 
         std::mutex m_Mutex;
+        std::atomic<uint64_t> m_UploadChunkMemory = 0;
+        std::vector<RefCountPtr<AccelStruct>> m_PendingCompactions;
+
+        // VK_EXT_graphics_pipeline_library parts of the fast linked pipelines, by the bytes of the state they depend on
+        std::mutex m_GraphicsPipelineLibrariesMutex;
+        std::unordered_map<std::string, GraphicsPipelineLibrary> m_GraphicsPipelineLibraries;
 
         // array of submission queues
         std::array<std::unique_ptr<Queue>, uint32_t(CommandQueue::Count)> m_Queues;
 
         void *mapBuffer(IBuffer* b, CpuAccessMode flags, uint64_t offset, size_t size) const;
+        vk::Pipeline getGraphicsPipelineLibrary(const std::string& key, vk::GraphicsPipelineLibraryFlagBitsEXT part,
+            vk::GraphicsPipelineCreateInfo pipelineInfo, const vk::PipelineLayoutCreateInfo& pipelineLayoutInfo);
     };
 
     class CommandList : public RefCounter<ICommandList>
@@ -1166,6 +1242,10 @@ namespace nvrhi::vulkan
         void close() override;
         void clearState() override;
 
+        void openBundle(IFramebuffer* framebuffer) override;
+        void executeBundle(ICommandList* bundle, IFramebuffer* framebuffer) override;
+        void writeBundleVolatileBuffer(IBuffer* buffer, const void* data, size_t dataSize, uint64_t destOffsetBytes) override;
+
         void clearTextureFloat(ITexture* texture, TextureSubresourceSet subresources, const Color& clearColor) override;
         void clearDepthStencilTexture(ITexture* texture, TextureSubresourceSet subresources, bool clearDepth, float depth, bool clearStencil, uint8_t stencil) override;
         void clearTextureUInt(ITexture* texture, TextureSubresourceSet subresources, uint32_t clearColor) override;
@@ -1257,6 +1337,16 @@ namespace nvrhi::vulkan
         rt::State m_CurrentRayTracingState;
         bool m_AnyVolatileBufferWrites = false;
 
+        // last states set by setDynamicRenderState, undefined after clearState or executing a bundle
+        RasterState m_CurrentDynamicRasterState;
+        DepthStencilState m_CurrentDynamicDepthStencilState;
+        bool m_DynamicRenderStateValid = false;
+
+        // secondary command buffer recording, barriers and render passes are left to the command lists executing it
+        bool m_IsBundle = false;
+        std::vector<GraphicsState> m_BundleGraphicsStates;
+        std::vector<MeshletState> m_BundleMeshletStates;
+
         struct ShaderTableState
         {
             vk::StridedDeviceAddressRegionKHR rayGen;
@@ -1275,10 +1365,14 @@ namespace nvrhi::vulkan
 
         void bindBindingSets(vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout, const BindingSetVector& bindings);
 
+        void beginRenderPass(Framebuffer* fb, bool secondaryContents = false);
         void endRenderPass();
+        void setDynamicRenderState(const RasterState& rasterState, const DepthStencilState& depthStencilState);
 
         void trackResourcesAndBarriers(const GraphicsState& state);
         void trackResourcesAndBarriers(const MeshletState& state);
+        void trackBundleResources(const GraphicsState& state);
+        void trackBundleResources(const MeshletState& state);
 
         void writeVolatileBuffer(Buffer* buffer, const void* data, size_t dataSize);
         void flushVolatileBufferWrites();
@@ -337,6 +337,32 @@ namespace nvrhi::vulkan
         m_AnyVolatileBufferWrites = true;
     }
 
+    void CommandList::writeBundleVolatileBuffer(IBuffer* _buffer, const void* data, size_t dataSize, uint64_t destOffsetBytes)
+    {
+        Buffer* buffer = checked_cast<Buffer*>(_buffer);
+        assert(m_IsBundle && m_CurrentCmdBuf);
+
+        for (const auto& versions : m_CurrentCmdBuf->bundleVolatileVersions)
+        {
+            if (versions.buffer != buffer)
+                continue;
+
+            // the range may hold versions of other command lists in between
+            for (int version = versions.minVersion; version <= versions.maxVersion; version++)
+            {
+                if (buffer->versionTracking[version].load() == m_CurrentCmdBuf->bundleVersionInfo)
+                    memcpy((char*)buffer->mappedMemory + version * buffer->desc.byteSize + destOffsetBytes, data, dataSize);
+            }
+
+            auto range = vk::MappedMemoryRange()
+                .setMemory(buffer->memory)
+                .setOffset(versions.minVersion * buffer->desc.byteSize)
+                .setSize((versions.maxVersion - versions.minVersion + 1) * buffer->desc.byteSize);
+
+            (void)m_Context.device.flushMappedMemoryRanges(1, &range);
+        }
+    }
+
     void CommandList::flushVolatileBufferWrites()
     {
         // The volatile CBs are permanently mapped with the eHostVisible flag, but not eHostCoherent,
@@ -48,6 +48,7 @@ namespace nvrhi::vulkan
 
     void CommandList::open()
     {
+        m_IsBundle = false;
         m_CurrentCmdBuf = m_Device->getQueue(m_CommandListParameters.queueType)->getOrCreateCommandBuffer();
 
         auto beginInfo = vk::CommandBufferBeginInfo()
@@ -59,6 +60,39 @@ namespace nvrhi::vulkan
         clearState();
     }
 
+    void CommandList::openBundle(IFramebuffer* _framebuffer)
+    {
+        Framebuffer* fb = checked_cast<Framebuffer*>(_framebuffer);
+
+        // Not taken from the queue pool, the primary command buffers executing it keep it alive instead
+        m_CurrentCmdBuf = m_Device->getQueue(m_CommandListParameters.queueType)->createBundleCommandBuffer();
+        m_IsBundle = true;
+        m_BundleGraphicsStates.clear();
+        m_BundleMeshletStates.clear();
+
+        const auto renderingInfo = vk::CommandBufferInheritanceRenderingInfo()
+            .setColorAttachmentCount(uint32_t(fb->colorFormats.size()))
+            .setPColorAttachmentFormats(fb->colorFormats.data())
+            .setDepthAttachmentFormat(fb->depthFormat)
+            .setStencilAttachmentFormat(fb->stencilFormat)
+            .setRasterizationSamples(vk::SampleCountFlagBits(fb->framebufferInfo.sampleCount));
+
+        // no framebuffer, so it can be executed into any compatible one
+        auto inheritanceInfo = vk::CommandBufferInheritanceInfo();
+        if (fb->renderPass)
+            inheritanceInfo.setRenderPass(fb->renderPass);
+        else
+            inheritanceInfo.setPNext(&renderingInfo);
+
+        auto beginInfo = vk::CommandBufferBeginInfo()
+            .setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse)
+            .setPInheritanceInfo(&inheritanceInfo);
+
+        (void)m_CurrentCmdBuf->cmdBuf.begin(&beginInfo);
+
+        clearState();
+    }
+
     void CommandList::close()
     {
         endRenderPass();
@@ -79,6 +113,18 @@ namespace nvrhi::vulkan
         clearState();
 
         flushVolatileBufferWrites();
+
+        if (m_IsBundle)
+        {
+            // the uniforms written while recording are read by every execution
+            for (const auto& [buffer, state] : m_VolatileBufferStates)
+            {
+                if (state.initialized && state.minVersion <= state.maxVersion)
+                    m_CurrentCmdBuf->bundleVolatileVersions.push_back({ buffer, state.minVersion, state.maxVersion });
+            }
+            m_CurrentCmdBuf->bundleVersionInfo = (uint64_t(m_CommandListParameters.queueType) << c_VersionQueueShift) | (m_CurrentCmdBuf->recordingID & c_VersionIDMask);
+            m_VolatileBufferStates.clear();
+        }
     }
 
     void CommandList::clearState()
@@ -92,6 +138,7 @@ namespace nvrhi::vulkan
         m_CurrentComputeState = ComputeState();
         m_CurrentMeshletState = MeshletState();
         m_CurrentRayTracingState = rt::State();
+        m_DynamicRenderStateValid = false;
         m_CurrentShaderTablePointers = ShaderTableState();
 
         m_AnyVolatileBufferWrites = false;
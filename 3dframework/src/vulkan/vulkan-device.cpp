@@ -83,6 +83,8 @@ namespace nvrhi::vulkan
             { VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME, &m_Context.extensions.KHR_fragment_shading_rate },
             { VK_EXT_OPACITY_MICROMAP_EXTENSION_NAME, &m_Context.extensions.EXT_opacity_micromap },
             { VK_NV_RAY_TRACING_INVOCATION_REORDER_EXTENSION_NAME, &m_Context.extensions.NV_ray_tracing_invocation_reorder },
+            { VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, &m_Context.extensions.KHR_pipeline_library },
+            { VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME, &m_Context.extensions.EXT_graphics_pipeline_library },
         };
 
         // parse the extension/layer lists and figure out which extensions are enabled
@@ -104,10 +106,19 @@ namespace nvrhi::vulkan
             }
         }
 
+        if (!m_Context.extensions.KHR_pipeline_library)
+            m_Context.extensions.EXT_graphics_pipeline_library = false;
+
         // The Vulkan 1.2 way of enabling bufferDeviceAddress
         if (desc.bufferDeviceAddressSupported)
             m_Context.extensions.buffer_device_address = true;
 
+        if (desc.dynamicRenderingSupported)
+            m_Context.extensions.dynamic_rendering = true;
+
+        if (desc.extendedDynamicStateSupported)
+            m_Context.extensions.extended_dynamic_state = true;
+
         void* pNext = nullptr;
         vk::PhysicalDeviceAccelerationStructurePropertiesKHR accelStructProperties;
         vk::PhysicalDeviceRayTracingPipelinePropertiesKHR rayTracingPipelineProperties;
@@ -210,6 +221,13 @@ namespace nvrhi::vulkan
 
     Device::~Device()
     {
+        for (auto& it : m_GraphicsPipelineLibraries)
+        {
+            m_Context.device.destroyPipeline(it.second.pipeline, m_Context.allocationCallbacks);
+            if (it.second.pipelineLayout)
+                m_Context.device.destroyPipelineLayout(it.second.pipelineLayout, m_Context.allocationCallbacks);
+        }
+
         if (m_TimerQueryPool)
         {
             m_Context.device.destroyQueryPool(m_TimerQueryPool);
@@ -308,6 +326,10 @@ namespace nvrhi::vulkan
             return m_Context.extensions.EXT_conservative_rasterization;
         case Feature::VirtualResources:
             return true;
+        case Feature::ExtendedDynamicState:
+            return m_Context.extensions.extended_dynamic_state;
+        case Feature::GraphicsPipelineLibrary:
+            return m_Context.extensions.EXT_graphics_pipeline_library && m_Context.extensions.dynamic_rendering;
         case Feature::ComputeQueue:
             return (m_Queues[uint32_t(CommandQueue::Compute)] != nullptr);
         case Feature::CopyQueue:
@@ -100,6 +100,8 @@ namespace nvrhi::vulkan
 
             const auto& view = t->getSubresourceView(subresources, dimension, rt.format);
             attachmentViews[i] = view.view;
+            fb->colorViews.push_back(view.view);
+            fb->colorFormats.push_back(attachmentFormat);
 
             fb->resources.push_back(rt.texture);
 
@@ -144,6 +146,12 @@ namespace nvrhi::vulkan
             const auto& view = texture->getSubresourceView(subresources, dimension, att.format);
             attachmentViews.push_back(view.view);
 
+            const FormatInfo& formatInfo = getFormatInfo(att.format == Format::UNKNOWN ? texture->desc.format : att.format);
+            fb->depthView = view.view;
+            fb->depthLayout = depthLayout;
+            fb->depthFormat = formatInfo.hasDepth ? texture->imageInfo.format : vk::Format::eUndefined;
+            fb->stencilFormat = formatInfo.hasStencil ? texture->imageInfo.format : vk::Format::eUndefined;
+
             fb->resources.push_back(att.texture);
 
             if (numArraySlices)
@@ -184,6 +192,7 @@ namespace nvrhi::vulkan
 
             const auto& view = vrsTexture->getSubresourceView(subresources, dimension, vrsAttachment.format);
             attachmentViews.push_back(view.view);
+            fb->shadingRateView = view.view;
 
             fb->resources.push_back(vrsAttachment.texture);
 
@@ -206,8 +215,16 @@ namespace nvrhi::vulkan
                 .setShadingRateAttachmentTexelSize(rateProps.minFragmentShadingRateAttachmentTexelSize);
 
             subpass.setPNext(&shadingRateAttachmentInfo);
+            fb->shadingRateTexelSize = rateProps.minFragmentShadingRateAttachmentTexelSize;
         }
 
+        fb->layerCount = attachmentViews.empty() ? 1 : numArraySlices;
+
+        // with dynamic rendering the views are bound when the pass begins, so resizing or rendering
+        // to another mip level doesn't need new render passes nor new pipelines
+        if (m_Context.extensions.dynamic_rendering)
+            return FramebufferHandle::Create(fb);
+
         auto renderPassInfo = vk::RenderPassCreateInfo2()
                     .setAttachmentCount(uint32_t(attachmentDescs.size()))
                     .setPAttachments(attachmentDescs.data())
@@ -226,7 +243,7 @@ namespace nvrhi::vulkan
                                 .setPAttachments(attachmentViews.data())
                                 .setWidth(fb->framebufferInfo.width)
                                 .setHeight(fb->framebufferInfo.height)
-                                .setLayers(attachmentViews.empty() ? 1 : numArraySlices);
+                                .setLayers(fb->layerCount);
 
         res = m_Context.device.createFramebuffer(&framebufferInfo, m_Context.allocationCallbacks,
                                                &fb->framebuffer);
@@ -274,6 +291,15 @@ namespace nvrhi::vulkan
         }
     }
 
+    vk::PipelineRenderingCreateInfo Framebuffer::getRenderingCreateInfo() const
+    {
+        return vk::PipelineRenderingCreateInfo()
+            .setColorAttachmentCount(uint32_t(colorFormats.size()))
+            .setPColorAttachmentFormats(colorFormats.data())
+            .setDepthAttachmentFormat(depthFormat)
+            .setStencilAttachmentFormat(stencilFormat);
+    }
+
     Object Framebuffer::getNativeObject(ObjectType objectType)
     {
         switch (objectType)
@@ -354,6 +380,103 @@ namespace nvrhi::vulkan
         return shaderStageCreateInfo;
     }
 
+    template<typename T>
+    static void appendKey(std::string& key, const T& value)
+    {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void appendShaderKey(std::string& key, const Shader* shader)
+    {
+        if (!shader)
+        {
+            appendKey(key, uint64_t(0));
+            return;
+        }
+
+        appendKey(key, shader->contentHash);
+        key.append(shader->desc.entryName.c_str(), shader->desc.entryName.size() + 1);
+        appendKey(key, shader->specializationConstants.size());
+        for (const ShaderSpecialization& constant : shader->specializationConstants)
+        {
+            appendKey(key, constant.constantID);
+            appendKey(key, constant.value.u);
+        }
+    }
+
+    // which graphics pipeline library subset each of the dynamic states used here belongs to
+    static bool isLibraryDynamicState(vk::DynamicState state, vk::GraphicsPipelineLibraryFlagBitsEXT part)
+    {
+        switch (state)
+        {
+        case vk::DynamicState::eViewport:
+        case vk::DynamicState::eScissor:
+        case vk::DynamicState::eCullMode:
+        case vk::DynamicState::eFrontFace:
+        case vk::DynamicState::eDepthBias:
+        case vk::DynamicState::eDepthBiasEnable:
+            return part == vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders;
+        case vk::DynamicState::eDepthTestEnable:
+        case vk::DynamicState::eDepthWriteEnable:
+        case vk::DynamicState::eDepthCompareOp:
+        case vk::DynamicState::eStencilTestEnable:
+        case vk::DynamicState::eStencilOp:
+        case vk::DynamicState::eStencilCompareMask:
+        case vk::DynamicState::eStencilWriteMask:
+        case vk::DynamicState::eStencilReference:
+            return part == vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader;
+        case vk::DynamicState::eFragmentShadingRateKHR:
+            return part == vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders || part == vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader;
+        case vk::DynamicState::eBlendConstants:
+            return part == vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface;
+        default:
+            return false;
+        }
+    }
+
+    vk::Pipeline Device::getGraphicsPipelineLibrary(const std::string& key, vk::GraphicsPipelineLibraryFlagBitsEXT part,
+        vk::GraphicsPipelineCreateInfo pipelineInfo, const vk::PipelineLayoutCreateInfo& pipelineLayoutInfo)
+    {
+        std::lock_guard<std::mutex> lock(m_GraphicsPipelineLibrariesMutex);
+
+        auto it = m_GraphicsPipelineLibraries.find(key);
+        if (it != m_GraphicsPipelineLibraries.end())
+            return it->second.pipeline;
+
+        // the library outlives the pipeline it's first created for, so it gets its own layout
+        GraphicsPipelineLibrary library;
+        vk::Result res;
+        if (part == vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders || part == vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader)
+        {
+            res = m_Context.device.createPipelineLayout(&pipelineLayoutInfo, m_Context.allocationCallbacks, &library.pipelineLayout);
+            CHECK_VK_FAIL(res)
+        }
+
+        auto libraryInfo = vk::GraphicsPipelineLibraryCreateInfoEXT()
+            .setFlags(part)
+            .setPNext(pipelineInfo.pNext);
+
+        pipelineInfo
+            .setPNext(&libraryInfo)
+            .setFlags(pipelineInfo.flags | vk::PipelineCreateFlagBits::eLibraryKHR)
+            .setLayout(library.pipelineLayout);
+
+        res = m_Context.device.createGraphicsPipelines(m_Context.pipelineCache,
+                                                     1, &pipelineInfo,
+                                                     m_Context.allocationCallbacks,
+                                                     &library.pipeline);
+        ASSERT_VK_OK(res);
+        if (res != vk::Result::eSuccess)
+        {
+            if (library.pipelineLayout)
+                m_Context.device.destroyPipelineLayout(library.pipelineLayout, m_Context.allocationCallbacks);
+            return nullptr;
+        }
+
+        m_GraphicsPipelineLibraries[key] = library;
+        return library.pipeline;
+    }
+
     GraphicsPipelineHandle Device::createGraphicsPipeline(const GraphicsPipelineDesc& desc, IFramebuffer* _fb)
     {
         if (desc.renderState.singlePassStereo.enabled)
@@ -587,10 +710,13 @@ namespace nvrhi::vulkan
 
         pso->usesBlendConstants = blendState.usesConstantColor(uint32_t(fb->desc.colorAttachments.size()));
 
-        static_vector<vk::DynamicState, 5> dynamicStates = {
+        static_vector<vk::DynamicState, 5 + std::size(c_ExtendedDynamicStates)> dynamicStates = {
             vk::DynamicState::eViewport,
             vk::DynamicState::eScissor
         };
+        if (m_Context.extensions.extended_dynamic_state)
+            for (vk::DynamicState state : c_ExtendedDynamicStates)
+                dynamicStates.push_back(state);
         if (pso->usesBlendConstants)
             dynamicStates.push_back(vk::DynamicState::eBlendConstants);
         if (pso->desc.renderState.depthStencilState.dynamicStencilRef)
@@ -623,6 +749,18 @@ namespace nvrhi::vulkan
         if (pso->desc.shadingRateState.enabled)
             pipelineInfo.setPNext(&shadingRateState);
 
+        auto renderingInfo = fb->getRenderingCreateInfo();
+
+        if (!fb->renderPass)
+        {
+            renderingInfo.setPNext(pipelineInfo.pNext);
+            pipelineInfo.setPNext(&renderingInfo);
+
+            // the same pipeline may be used with or without a shading rate image
+            if (m_Context.extensions.KHR_fragment_shading_rate && m_Context.shadingRateFeatures.attachmentFragmentShadingRate)
+                pipelineInfo.flags |= vk::PipelineCreateFlagBits::eRenderingFragmentShadingRateAttachmentKHR;
+        }
+
         auto tessellationState = vk::PipelineTessellationStateCreateInfo();
 
         if (desc.primType == PrimitiveType::PatchList)
@@ -631,6 +769,173 @@ namespace nvrhi::vulkan
             pipelineInfo.setPTessellationState(&tessellationState);
         }
 
+        if (desc.fastLink && m_Context.extensions.EXT_graphics_pipeline_library && !fb->renderPass)
+        {
+            // Each library is keyed by the state of its own part only, so the shaders are compiled once per
+            // shader and raster state, the blending once per blend state and formats, and this is only a link
+            const bool dynamicRenderState = m_Context.extensions.extended_dynamic_state;
+
+            std::string layoutKey;
+            for (const BindingLayoutHandle& _layout : desc.bindingLayouts)
+            {
+                BindingLayout* layout = checked_cast<BindingLayout*>(_layout.Get());
+                appendKey(layoutKey, layout->isBindless);
+                appendKey(layoutKey, layout->vulkanLayoutBindings.size());
+                for (const vk::DescriptorSetLayoutBinding& binding : layout->vulkanLayoutBindings)
+                {
+                    appendKey(layoutKey, binding.binding);
+                    appendKey(layoutKey, binding.descriptorType);
+                    appendKey(layoutKey, binding.descriptorCount);
+                    appendKey(layoutKey, binding.stageFlags);
+                }
+            }
+            appendKey(layoutKey, pushConstantRange.size);
+            appendKey(layoutKey, pushConstantRange.stageFlags);
+
+            std::string multisampleKey;
+            appendKey(multisampleKey, multisample.rasterizationSamples);
+            appendKey(multisampleKey, multisample.sampleShadingEnable);
+            appendKey(multisampleKey, multisample.alphaToCoverageEnable);
+            appendKey(multisampleKey, rasterState.programmableSamplePositionsEnable);
+            if (rasterState.programmableSamplePositionsEnable)
+            {
+                appendKey(multisampleKey, rasterState.samplePositionsX);
+                appendKey(multisampleKey, rasterState.samplePositionsY);
+            }
+
+            std::string shadingRateKey;
+            appendKey(shadingRateKey, desc.shadingRateState.enabled);
+            if (desc.shadingRateState.enabled)
+            {
+                appendKey(shadingRateKey, shadingRateState.fragmentSize);
+                appendKey(shadingRateKey, shadingRateState.combinerOps);
+            }
+
+            std::string vertexInputKey;
+            appendKey(vertexInputKey, vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface);
+            appendKey(vertexInputKey, inputAssembly.topology);
+            appendKey(vertexInputKey, vertexInput.vertexBindingDescriptionCount);
+            for (uint32_t i = 0; i < vertexInput.vertexBindingDescriptionCount; i++)
+                appendKey(vertexInputKey, vertexInput.pVertexBindingDescriptions[i]);
+            appendKey(vertexInputKey, vertexInput.vertexAttributeDescriptionCount);
+            for (uint32_t i = 0; i < vertexInput.vertexAttributeDescriptionCount; i++)
+                appendKey(vertexInputKey, vertexInput.pVertexAttributeDescriptions[i]);
+
+            std::string preRasterizationKey;
+            appendKey(preRasterizationKey, vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders);
+            preRasterizationKey += layoutKey;
+            appendShaderKey(preRasterizationKey, VS);
+            appendShaderKey(preRasterizationKey, HS);
+            appendShaderKey(preRasterizationKey, DS);
+            appendShaderKey(preRasterizationKey, GS);
+            appendKey(preRasterizationKey, desc.primType);
+            appendKey(preRasterizationKey, tessellationState.patchControlPoints);
+            appendKey(preRasterizationKey, rasterizer.rasterizerDiscardEnable);
+            appendKey(preRasterizationKey, rasterizer.polygonMode);
+            appendKey(preRasterizationKey, lineRasterizationState.lineRasterizationMode);
+            appendKey(preRasterizationKey, rasterState.conservativeRasterEnable);
+            if (!dynamicRenderState)
+            {
+                appendKey(preRasterizationKey, rasterizer.cullMode);
+                appendKey(preRasterizationKey, rasterizer.frontFace);
+                appendKey(preRasterizationKey, rasterizer.depthBiasEnable);
+                appendKey(preRasterizationKey, rasterizer.depthBiasConstantFactor);
+                appendKey(preRasterizationKey, rasterizer.depthBiasClamp);
+                appendKey(preRasterizationKey, rasterizer.depthBiasSlopeFactor);
+            }
+            preRasterizationKey += shadingRateKey;
+
+            std::string fragmentShaderKey;
+            appendKey(fragmentShaderKey, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader);
+            fragmentShaderKey += layoutKey;
+            appendShaderKey(fragmentShaderKey, PS);
+            appendKey(fragmentShaderKey, depthStencilState.dynamicStencilRef);
+            if (!depthStencilState.dynamicStencilRef)
+                appendKey(fragmentShaderKey, depthStencilState.stencilRefValue);
+            if (!dynamicRenderState)
+            {
+                appendKey(fragmentShaderKey, depthStencil.depthTestEnable);
+                appendKey(fragmentShaderKey, depthStencil.depthWriteEnable);
+                appendKey(fragmentShaderKey, depthStencil.depthCompareOp);
+                appendKey(fragmentShaderKey, depthStencil.stencilTestEnable);
+                appendKey(fragmentShaderKey, depthStencil.front);
+                appendKey(fragmentShaderKey, depthStencil.back);
+            }
+            appendKey(fragmentShaderKey, fb->depthFormat);
+            appendKey(fragmentShaderKey, fb->stencilFormat);
+            fragmentShaderKey += multisampleKey;
+            fragmentShaderKey += shadingRateKey;
+
+            std::string fragmentOutputKey;
+            appendKey(fragmentOutputKey, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface);
+            appendKey(fragmentOutputKey, fb->colorFormats.size());
+            for (size_t i = 0; i < fb->colorFormats.size(); i++)
+            {
+                appendKey(fragmentOutputKey, fb->colorFormats[i]);
+                appendKey(fragmentOutputKey, colorBlendAttachments[i]);
+            }
+            appendKey(fragmentOutputKey, fb->depthFormat);
+            appendKey(fragmentOutputKey, fb->stencilFormat);
+            appendKey(fragmentOutputKey, pso->usesBlendConstants);
+            fragmentOutputKey += multisampleKey;
+
+            // the fragment shader is the last stage when there's one
+            const uint32_t numPreRasterizationStages = uint32_t(shaderStages.size()) - (PS ? 1 : 0);
+
+            auto getLibrary = [&](vk::GraphicsPipelineLibraryFlagBitsEXT part, const std::string& key, uint32_t firstStage, uint32_t stageCount)
+            {
+                static_vector<vk::DynamicState, 5 + std::size(c_ExtendedDynamicStates)> partDynamicStates;
+                for (vk::DynamicState state : dynamicStates)
+                    if (isLibraryDynamicState(state, part))
+                        partDynamicStates.push_back(state);
+
+                auto partDynamicStateInfo = vk::PipelineDynamicStateCreateInfo()
+                    .setDynamicStateCount(uint32_t(partDynamicStates.size()))
+                    .setPDynamicStates(partDynamicStates.data());
+
+                auto partInfo = pipelineInfo;
+                partInfo.setStageCount(stageCount)
+                        .setPStages(stageCount ? shaderStages.data() + firstStage : nullptr)
+                        .setPDynamicState(&partDynamicStateInfo);
+
+                return getGraphicsPipelineLibrary(key, part, partInfo, pipelineLayoutInfo);
+            };
+
+            const vk::Pipeline libraries[] = {
+                getLibrary(vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface, vertexInputKey, 0, 0),
+                getLibrary(vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders, preRasterizationKey, 0, numPreRasterizationStages),
+                getLibrary(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader, fragmentShaderKey, numPreRasterizationStages, PS ? 1 : 0),
+                getLibrary(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface, fragmentOutputKey, 0, 0)
+            };
+
+            for (vk::Pipeline library : libraries)
+            {
+                if (!library)
+                {
+                    delete pso;
+                    return nullptr;
+                }
+            }
+
+            auto libraryInfo = vk::PipelineLibraryCreateInfoKHR()
+                .setLibraryCount(uint32_t(std::size(libraries)))
+                .setPLibraries(libraries);
+
+            auto linkInfo = vk::GraphicsPipelineCreateInfo()
+                .setPNext(&libraryInfo)
+                .setFlags(pipelineInfo.flags)
+                .setLayout(pso->pipelineLayout);
+
+            res = m_Context.device.createGraphicsPipelines(m_Context.pipelineCache,
+                                                         1, &linkInfo,
+                                                         m_Context.allocationCallbacks,
+                                                         &pso->pipeline);
+            ASSERT_VK_OK(res);
+            CHECK_VK_FAIL(res);
+
+            return GraphicsPipelineHandle::Create(pso);
+        }
+
         res = m_Context.device.createGraphicsPipelines(m_Context.pipelineCache,
                                                      1, &pipelineInfo,
                                                      m_Context.allocationCallbacks,
@@ -669,16 +974,177 @@ namespace nvrhi::vulkan
         }
     }
 
+    void CommandList::beginRenderPass(Framebuffer* fb, bool secondaryContents)
+    {
+        const auto renderArea = vk::Rect2D()
+            .setOffset(vk::Offset2D(0, 0))
+            .setExtent(vk::Extent2D(fb->framebufferInfo.width, fb->framebufferInfo.height));
+
+        if (fb->renderPass)
+        {
+            m_CurrentCmdBuf->cmdBuf.beginRenderPass(vk::RenderPassBeginInfo()
+                .setRenderPass(fb->renderPass)
+                .setFramebuffer(fb->framebuffer)
+                .setRenderArea(renderArea)
+                .setClearValueCount(0),
+                secondaryContents ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+            return;
+        }
+
+        // same load/store operations and layouts as the render passes of createFramebuffer
+        attachment_vector<vk::RenderingAttachmentInfo> colorAttachments;
+        for (const vk::ImageView& view : fb->colorViews)
+        {
+            colorAttachments.push_back(vk::RenderingAttachmentInfo()
+                .setImageView(view)
+                .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                .setLoadOp(vk::AttachmentLoadOp::eLoad)
+                .setStoreOp(vk::AttachmentStoreOp::eStore));
+        }
+
+        const auto depthAttachment = vk::RenderingAttachmentInfo()
+            .setImageView(fb->depthView)
+            .setImageLayout(fb->depthLayout)
+            .setLoadOp(vk::AttachmentLoadOp::eLoad)
+            .setStoreOp(vk::AttachmentStoreOp::eStore);
+
+        const auto shadingRateAttachment = vk::RenderingFragmentShadingRateAttachmentInfoKHR()
+            .setImageView(fb->shadingRateView)
+            .setImageLayout(vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR)
+            .setShadingRateAttachmentTexelSize(fb->shadingRateTexelSize);
+
+        auto renderingInfo = vk::RenderingInfo()
+            .setFlags(secondaryContents ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags())
+            .setRenderArea(renderArea)
+            .setLayerCount(fb->layerCount)
+            .setColorAttachmentCount(uint32_t(colorAttachments.size()))
+            .setPColorAttachments(colorAttachments.data())
+            .setPDepthAttachment(fb->depthFormat != vk::Format::eUndefined ? &depthAttachment : nullptr)
+            .setPStencilAttachment(fb->stencilFormat != vk::Format::eUndefined ? &depthAttachment : nullptr);
+
+        if (fb->shadingRateView)
+            renderingInfo.setPNext(&shadingRateAttachment);
+
+        m_CurrentCmdBuf->cmdBuf.beginRendering(renderingInfo);
+    }
+
     void CommandList::endRenderPass()
     {
         if (m_CurrentGraphicsState.framebuffer || m_CurrentMeshletState.framebuffer)
         {
-            m_CurrentCmdBuf->cmdBuf.endRenderPass();
+            Framebuffer* fb = checked_cast<Framebuffer*>(m_CurrentGraphicsState.framebuffer ? m_CurrentGraphicsState.framebuffer : m_CurrentMeshletState.framebuffer);
+
+            // the render pass of a bundle belongs to the command list executing it
+            if (!m_IsBundle)
+            {
+                if (fb->renderPass)
+                    m_CurrentCmdBuf->cmdBuf.endRenderPass();
+                else
+                    m_CurrentCmdBuf->cmdBuf.endRendering();
+            }
             m_CurrentGraphicsState.framebuffer = nullptr;
             m_CurrentMeshletState.framebuffer = nullptr;
         }
     }
 
+    void CommandList::executeBundle(ICommandList* _bundle, IFramebuffer* _framebuffer)
+    {
+        assert(m_CurrentCmdBuf);
+
+        CommandList* bundle = checked_cast<CommandList*>(_bundle);
+        Framebuffer* fb = checked_cast<Framebuffer*>(_framebuffer);
+        assert(bundle->m_IsBundle && !m_IsBundle);
+
+        endRenderPass();
+
+        if (m_EnableAutomaticBarriers)
+        {
+            for (const GraphicsState& state : bundle->m_BundleGraphicsStates)
+                trackBundleResources(state);
+            for (const MeshletState& state : bundle->m_BundleMeshletStates)
+                trackBundleResources(state);
+            setResourceStatesForFramebuffer(fb);
+        }
+
+        const FramebufferDesc& desc = fb->getDesc();
+        if (desc.shadingRateAttachment.valid())
+        {
+            setTextureState(desc.shadingRateAttachment.texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), nvrhi::ResourceStates::ShadingRateSurface);
+        }
+
+        commitBarriers();
+
+        // a render pass executing secondary command buffers can't record anything else
+        beginRenderPass(fb, true);
+        m_CurrentCmdBuf->cmdBuf.executeCommands(bundle->m_CurrentCmdBuf->cmdBuf);
+        if (fb->renderPass)
+            m_CurrentCmdBuf->cmdBuf.endRenderPass();
+        else
+            m_CurrentCmdBuf->cmdBuf.endRendering();
+
+        m_CurrentCmdBuf->referencedResources.push_back(fb);
+        m_CurrentCmdBuf->referencedBundles.push_back(bundle->m_CurrentCmdBuf);
+
+        // the state bound by the bundle is undefined in this command buffer
+        m_CurrentPipelineLayout = vk::PipelineLayout();
+        m_CurrentGraphicsState = GraphicsState();
+        m_CurrentComputeState = ComputeState();
+        m_CurrentMeshletState = MeshletState();
+        m_CurrentRayTracingState = rt::State();
+        m_DynamicRenderStateValid = false;
+    }
+
+    static bool sameStencilOps(const DepthStencilState::StencilOpDesc& a, const DepthStencilState::StencilOpDesc& b)
+    {
+        return a.failOp == b.failOp && a.depthFailOp == b.depthFailOp && a.passOp == b.passOp && a.stencilFunc == b.stencilFunc;
+    }
+
+    // only compares the members set by setDynamicRenderState
+    static bool sameDynamicRenderState(const RasterState& rasterA, const DepthStencilState& depthStencilA,
+        const RasterState& rasterB, const DepthStencilState& depthStencilB)
+    {
+        return rasterA.cullMode == rasterB.cullMode && rasterA.frontCounterClockwise == rasterB.frontCounterClockwise &&
+            rasterA.depthBias == rasterB.depthBias && rasterA.depthBiasClamp == rasterB.depthBiasClamp &&
+            rasterA.slopeScaledDepthBias == rasterB.slopeScaledDepthBias &&
+            depthStencilA.depthTestEnable == depthStencilB.depthTestEnable && depthStencilA.depthWriteEnable == depthStencilB.depthWriteEnable &&
+            depthStencilA.depthFunc == depthStencilB.depthFunc && depthStencilA.stencilEnable == depthStencilB.stencilEnable &&
+            depthStencilA.stencilReadMask == depthStencilB.stencilReadMask && depthStencilA.stencilWriteMask == depthStencilB.stencilWriteMask &&
+            sameStencilOps(depthStencilA.frontFaceStencil, depthStencilB.frontFaceStencil) &&
+            sameStencilOps(depthStencilA.backFaceStencil, depthStencilB.backFaceStencil);
+    }
+
+    void CommandList::setDynamicRenderState(const RasterState& rasterState, const DepthStencilState& depthStencilState)
+    {
+        if (m_DynamicRenderStateValid && sameDynamicRenderState(rasterState, depthStencilState, m_CurrentDynamicRasterState, m_CurrentDynamicDepthStencilState))
+            return;
+
+        m_CurrentDynamicRasterState = rasterState;
+        m_CurrentDynamicDepthStencilState = depthStencilState;
+        m_DynamicRenderStateValid = true;
+
+        // same conversions as the pipelines without extended dynamic states
+        vk::CommandBuffer cmdBuf = m_CurrentCmdBuf->cmdBuf;
+
+        cmdBuf.setCullMode(convertCullMode(rasterState.cullMode));
+        cmdBuf.setFrontFace(rasterState.frontCounterClockwise ? vk::FrontFace::eCounterClockwise : vk::FrontFace::eClockwise);
+        cmdBuf.setDepthBiasEnable(rasterState.depthBias ? true : false);
+        cmdBuf.setDepthBias(float(rasterState.depthBias), rasterState.depthBiasClamp, rasterState.slopeScaledDepthBias);
+
+        cmdBuf.setDepthTestEnable(depthStencilState.depthTestEnable);
+        cmdBuf.setDepthWriteEnable(depthStencilState.depthWriteEnable);
+        cmdBuf.setDepthCompareOp(convertCompareOp(depthStencilState.depthFunc));
+        cmdBuf.setStencilTestEnable(depthStencilState.stencilEnable);
+
+        const auto& front = depthStencilState.frontFaceStencil;
+        const auto& back = depthStencilState.backFaceStencil;
+        cmdBuf.setStencilOp(vk::StencilFaceFlagBits::eFront, convertStencilOp(front.failOp), convertStencilOp(front.passOp),
+            convertStencilOp(front.depthFailOp), convertCompareOp(front.stencilFunc));
+        cmdBuf.setStencilOp(vk::StencilFaceFlagBits::eBack, convertStencilOp(back.failOp), convertStencilOp(back.passOp),
+            convertStencilOp(back.depthFailOp), convertCompareOp(back.stencilFunc));
+        cmdBuf.setStencilCompareMask(vk::StencilFaceFlagBits::eFrontAndBack, depthStencilState.stencilReadMask);
+        cmdBuf.setStencilWriteMask(vk::StencilFaceFlagBits::eFrontAndBack, depthStencilState.stencilWriteMask);
+    }
+
     static vk::Viewport VKViewportWithDXCoords(const Viewport& v)
     {
         // requires VK_KHR_maintenance1 which allows negative-height to indicate an inverted coord space to match DX
@@ -692,7 +1158,7 @@ namespace nvrhi::vulkan
         GraphicsPipeline* pso = checked_cast<GraphicsPipeline*>(state.pipeline);
         Framebuffer* fb = checked_cast<Framebuffer*>(state.framebuffer);
 
-        if (m_EnableAutomaticBarriers)
+        if (m_EnableAutomaticBarriers && !m_IsBundle)
         {
             trackResourcesAndBarriers(state);
         }
@@ -708,31 +1174,32 @@ namespace nvrhi::vulkan
             updatePipeline = true;
         }
 
-        if (m_CurrentGraphicsState.framebuffer != state.framebuffer || anyBarriers /* because barriers cannot be set inside a renderpass */)
+        if (m_IsBundle)
         {
-            endRenderPass();
+            // the resource states are set by the command lists executing the bundle
+            m_BundleGraphicsStates.push_back(state);
         }
-
-        auto desc = state.framebuffer->getDesc();
-        if (desc.shadingRateAttachment.valid())
+        else
         {
-            setTextureState(desc.shadingRateAttachment.texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), nvrhi::ResourceStates::ShadingRateSurface);
-        }
+            if (m_CurrentGraphicsState.framebuffer != state.framebuffer || anyBarriers /* because barriers cannot be set inside a renderpass */)
+            {
+                endRenderPass();
+            }
 
-        commitBarriers();
+            auto desc = state.framebuffer->getDesc();
+            if (desc.shadingRateAttachment.valid())
+            {
+                setTextureState(desc.shadingRateAttachment.texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), nvrhi::ResourceStates::ShadingRateSurface);
+            }
 
-        if(!m_CurrentGraphicsState.framebuffer)
-        {
-            m_CurrentCmdBuf->cmdBuf.beginRenderPass(vk::RenderPassBeginInfo()
-                .setRenderPass(fb->renderPass)
-                .setFramebuffer(fb->framebuffer)
-                .setRenderArea(vk::Rect2D()
-                    .setOffset(vk::Offset2D(0, 0))
-                    .setExtent(vk::Extent2D(fb->framebufferInfo.width, fb->framebufferInfo.height)))
-                .setClearValueCount(0),
-                vk::SubpassContents::eInline);
+            commitBarriers();
 
-            m_CurrentCmdBuf->referencedResources.push_back(state.framebuffer);
+            if(!m_CurrentGraphicsState.framebuffer)
+            {
+                beginRenderPass(fb);
+
+                m_CurrentCmdBuf->referencedResources.push_back(state.framebuffer);
+            }
         }
 
         m_CurrentPipelineLayout = pso->pipelineLayout;
@@ -766,6 +1233,14 @@ namespace nvrhi::vulkan
             m_CurrentCmdBuf->cmdBuf.setScissor(0, uint32_t(scissors.size()), scissors.data());
         }
 
+        if (m_Context.extensions.extended_dynamic_state)
+        {
+            if (state.useDynamicRenderState)
+                setDynamicRenderState(state.dynamicRasterState, state.dynamicDepthStencilState);
+            else
+                setDynamicRenderState(pso->desc.renderState.rasterState, pso->desc.renderState.depthStencilState);
+        }
+
         if (pso->desc.renderState.depthStencilState.dynamicStencilRef && (updatePipeline || m_CurrentGraphicsState.dynamicStencilRefValue != state.dynamicStencilRefValue))
         {
             m_CurrentCmdBuf->cmdBuf.setStencilReference(vk::StencilFaceFlagBits::eFrontAndBack, state.dynamicStencilRefValue);
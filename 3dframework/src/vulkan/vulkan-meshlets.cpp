@@ -187,10 +187,13 @@ namespace nvrhi::vulkan
 
         pso->usesBlendConstants = blendState.usesConstantColor(uint32_t(fb->desc.colorAttachments.size()));
 
-        static_vector<vk::DynamicState, 4> dynamicStates = {
+        static_vector<vk::DynamicState, 4 + std::size(c_ExtendedDynamicStates)> dynamicStates = {
             vk::DynamicState::eViewport,
             vk::DynamicState::eScissor
         };
+        if (m_Context.extensions.extended_dynamic_state)
+            for (vk::DynamicState state : c_ExtendedDynamicStates)
+                dynamicStates.push_back(state);
         if (pso->usesBlendConstants)
             dynamicStates.push_back(vk::DynamicState::eBlendConstants);
         if (pso->desc.renderState.depthStencilState.dynamicStencilRef)
@@ -217,6 +220,16 @@ namespace nvrhi::vulkan
             .setBasePipelineHandle(nullptr)
             .setBasePipelineIndex(-1);
 
+        auto renderingInfo = fb->getRenderingCreateInfo();
+
+        if (!fb->renderPass)
+        {
+            pipelineInfo.setPNext(&renderingInfo);
+
+            if (m_Context.extensions.KHR_fragment_shading_rate && m_Context.shadingRateFeatures.attachmentFragmentShadingRate)
+                pipelineInfo.flags |= vk::PipelineCreateFlagBits::eRenderingFragmentShadingRateAttachmentKHR;
+        }
+
         res = m_Context.device.createGraphicsPipelines(m_Context.pipelineCache,
                                                      1, &pipelineInfo,
                                                      m_Context.allocationCallbacks,
@@ -268,7 +281,7 @@ namespace nvrhi::vulkan
         MeshletPipeline* pso = checked_cast<MeshletPipeline*>(state.pipeline);
         Framebuffer* fb = checked_cast<Framebuffer*>(state.framebuffer);
 
-        if (m_EnableAutomaticBarriers)
+        if (m_EnableAutomaticBarriers && !m_IsBundle)
         {
             trackResourcesAndBarriers(state);
         }
@@ -284,25 +297,26 @@ namespace nvrhi::vulkan
             updatePipeline = true;
         }
 
-        if (m_CurrentMeshletState.framebuffer != state.framebuffer || anyBarriers /* because barriers cannot be set inside a renderpass */)
+        if (m_IsBundle)
         {
-            endRenderPass();
+            // the resource states are set by the command lists executing the bundle
+            m_BundleMeshletStates.push_back(state);
         }
+        else
+        {
+            if (m_CurrentMeshletState.framebuffer != state.framebuffer || anyBarriers /* because barriers cannot be set inside a renderpass */)
+            {
+                endRenderPass();
+            }
 
-        commitBarriers();
+            commitBarriers();
 
-        if(!m_CurrentMeshletState.framebuffer)
-        {
-            m_CurrentCmdBuf->cmdBuf.beginRenderPass(vk::RenderPassBeginInfo()
-                .setRenderPass(fb->renderPass)
-                .setFramebuffer(fb->framebuffer)
-                .setRenderArea(vk::Rect2D()
-                    .setOffset(vk::Offset2D(0, 0))
-                    .setExtent(vk::Extent2D(fb->framebufferInfo.width, fb->framebufferInfo.height)))
-                .setClearValueCount(0),
-                vk::SubpassContents::eInline);
-
-            m_CurrentCmdBuf->referencedResources.push_back(state.framebuffer);
+            if(!m_CurrentMeshletState.framebuffer)
+            {
+                beginRenderPass(fb);
+
+                m_CurrentCmdBuf->referencedResources.push_back(state.framebuffer);
+            }
         }
 
         m_CurrentPipelineLayout = pso->pipelineLayout;
@@ -336,6 +350,14 @@ namespace nvrhi::vulkan
             m_CurrentCmdBuf->cmdBuf.setScissor(0, uint32_t(scissors.size()), scissors.data());
         }
 
+        if (m_Context.extensions.extended_dynamic_state)
+        {
+            if (state.useDynamicRenderState)
+                setDynamicRenderState(state.dynamicRasterState, state.dynamicDepthStencilState);
+            else
+                setDynamicRenderState(pso->desc.renderState.rasterState, pso->desc.renderState.depthStencilState);
+        }
+
         if (pso->desc.renderState.depthStencilState.dynamicStencilRef && (updatePipeline || m_CurrentMeshletState.dynamicStencilRefValue != state.dynamicStencilRefValue))
         {
             m_CurrentCmdBuf->cmdBuf.setStencilReference(vk::StencilFaceFlagBits::eFrontAndBack, state.dynamicStencilRefValue);
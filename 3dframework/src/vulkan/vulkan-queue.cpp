@@ -28,6 +28,15 @@ namespace nvrhi::vulkan
 
     TrackedCommandBuffer::~TrackedCommandBuffer()
     {
+        for (const BundleVolatileVersions& versions : bundleVolatileVersions)
+        {
+            for (int version = versions.minVersion; version <= versions.maxVersion; version++)
+            {
+                uint64_t expected = bundleVersionInfo;
+                versions.buffer->versionTracking[version].compare_exchange_strong(expected, 0);
+            }
+        }
+
         m_Context.device.destroyCommandPool(cmdPool, m_Context.allocationCallbacks);
     }
 
@@ -52,7 +61,7 @@ namespace nvrhi::vulkan
         trackingSemaphore = vk::Semaphore();
     }
 
-    TrackedCommandBufferPtr Queue::createCommandBuffer()
+    TrackedCommandBufferPtr Queue::createCommandBuffer(vk::CommandBufferLevel level)
     {
         vk::Result res;
 
@@ -68,7 +77,7 @@ namespace nvrhi::vulkan
         
         // allocate command buffer
         auto allocInfo = vk::CommandBufferAllocateInfo()
-                            .setLevel(vk::CommandBufferLevel::ePrimary)
+                            .setLevel(level)
                             .setCommandPool(ret->cmdPool)
                             .setCommandBufferCount(1);
 
@@ -99,6 +108,17 @@ namespace nvrhi::vulkan
         return cmdBuf;
     }
 
+    TrackedCommandBufferPtr Queue::createBundleCommandBuffer()
+    {
+        std::lock_guard lockGuard(m_Mutex);
+
+        // the recording ID identifies the volatile buffer versions written by the bundle
+        TrackedCommandBufferPtr cmdBuf = createCommandBuffer(vk::CommandBufferLevel::eSecondary);
+        if (cmdBuf)
+            cmdBuf->recordingID = ++m_LastRecordingID;
+        return cmdBuf;
+    }
+
     void Queue::addWaitSemaphore(vk::Semaphore semaphore, uint64_t value)
     {
         if (!semaphore)
@@ -196,6 +216,7 @@ namespace nvrhi::vulkan
             {
                 cmd->referencedResources.clear();
                 cmd->referencedStagingBuffers.clear();
+                cmd->referencedBundles.clear();
                 cmd->submissionID = 0;
                 m_CommandBuffersPool.push_back(cmd);
 
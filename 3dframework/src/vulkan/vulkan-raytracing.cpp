@@ -255,6 +255,8 @@ namespace nvrhi::vulkan
             auto buildSizes = m_Context.device.getAccelerationStructureBuildSizesKHR(
                 vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo, maxPrimitiveCounts);
 
+            as->buildScratchSize = buildSizes.buildScratchSize;
+
             BufferDesc bufferDesc;
             bufferDesc.byteSize = buildSizes.accelerationStructureSize;
             bufferDesc.debugName = desc.debugName;
@@ -541,6 +543,29 @@ namespace nvrhi::vulkan
         std::array<const vk::AccelerationStructureBuildRangeInfoKHR*, 1> buildRangeArrays = { buildRanges.data() };
 
         m_CurrentCmdBuf->cmdBuf.buildAccelerationStructuresKHR(buildInfos, buildRangeArrays);
+
+        if ((buildFlags & rt::AccelStructBuildFlags::AllowCompaction) != 0 && !performUpdate && !as->compacted)
+        {
+            if (!as->compactionQueryPool)
+            {
+                auto poolInfo = vk::QueryPoolCreateInfo()
+                    .setQueryType(vk::QueryType::eAccelerationStructureCompactedSizeKHR)
+                    .setQueryCount(1);
+                as->compactionQueryPool = m_Context.device.createQueryPool(poolInfo, m_Context.allocationCallbacks);
+            }
+
+            // The compacted size is only available once the build has completed
+            auto barrier = vk::MemoryBarrier()
+                .setSrcAccessMask(vk::AccessFlagBits::eAccelerationStructureWriteKHR)
+                .setDstAccessMask(vk::AccessFlagBits::eAccelerationStructureReadKHR);
+            m_CurrentCmdBuf->cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, vk::DependencyFlags(), { barrier }, {}, {});
+            m_CurrentCmdBuf->cmdBuf.resetQueryPool(as->compactionQueryPool, 0, 1);
+            m_CurrentCmdBuf->cmdBuf.writeAccelerationStructuresPropertiesKHR(as->accelStruct,
+                vk::QueryType::eAccelerationStructureCompactedSizeKHR, as->compactionQueryPool, 0);
+
+            m_Device->queueAccelStructCompaction(as);
+        }
 #endif
         if (as->desc.trackLiveness)
             m_CurrentCmdBuf->referencedResources.push_back(as);
@@ -563,9 +588,86 @@ namespace nvrhi::vulkan
                 m_Context.rtxMuResources->asBuildsCompleted.clear();
             }
         }
+#else
+        bool copied = false;
+
+        for (const RefCountPtr<AccelStruct>& as : m_Device->takeAccelStructCompactions())
+        {
+            uint64_t compactedSize = 0;
+            const vk::Result res = m_Context.device.getQueryPoolResults(as->compactionQueryPool, 0, 1,
+                sizeof(compactedSize), &compactedSize, sizeof(compactedSize), vk::QueryResultFlagBits::e64);
+
+            // Builds which haven't completed yet are compacted by a later call
+            if (res == vk::Result::eNotReady)
+            {
+                m_Device->queueAccelStructCompaction(as);
+                continue;
+            }
+
+            if (res != vk::Result::eSuccess || compactedSize == 0 || compactedSize >= as->dataBuffer->getDesc().byteSize)
+                continue;
+
+            BufferDesc bufferDesc;
+            bufferDesc.byteSize = compactedSize;
+            bufferDesc.debugName = as->desc.debugName;
+            bufferDesc.initialState = ResourceStates::AccelStructBuildBlas;
+            bufferDesc.keepInitialState = true;
+            bufferDesc.isAccelStructStorage = true;
+            BufferHandle compactedBuffer = m_Device->createBuffer(bufferDesc);
+
+            auto createInfo = vk::AccelerationStructureCreateInfoKHR()
+                .setType(vk::AccelerationStructureTypeKHR::eBottomLevel)
+                .setBuffer(checked_cast<Buffer*>(compactedBuffer.Get())->buffer)
+                .setSize(compactedSize);
+            vk::AccelerationStructureKHR compactedAccelStruct = m_Context.device.createAccelerationStructureKHR(createInfo, m_Context.allocationCallbacks);
+
+            auto copyInfo = vk::CopyAccelerationStructureInfoKHR()
+                .setSrc(as->accelStruct)
+                .setDst(compactedAccelStruct)
+                .setMode(vk::CopyAccelerationStructureModeKHR::eCompact);
+            m_CurrentCmdBuf->cmdBuf.copyAccelerationStructureKHR(copyInfo);
+
+            // The uncompacted storage is released once this command list has completed
+            AccelStruct* original = new AccelStruct(m_Context);
+            original->accelStruct = as->accelStruct;
+            original->dataBuffer = as->dataBuffer;
+            m_CurrentCmdBuf->referencedResources.push_back(rt::AccelStructHandle::Create(original));
+
+            as->accelStruct = compactedAccelStruct;
+            as->dataBuffer = compactedBuffer;
+            as->accelStructDeviceAddress = m_Context.device.getAccelerationStructureAddressKHR(
+                vk::AccelerationStructureDeviceAddressInfoKHR().setAccelerationStructure(compactedAccelStruct));
+            as->compacted = true;
+            copied = true;
+        }
+
+        if (copied)
+        {
+            auto barrier = vk::MemoryBarrier()
+                .setSrcAccessMask(vk::AccessFlagBits::eAccelerationStructureWriteKHR)
+                .setDstAccessMask(vk::AccessFlagBits::eAccelerationStructureReadKHR | vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+            m_CurrentCmdBuf->cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR | vk::PipelineStageFlagBits::eRayTracingShaderKHR |
+                vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
+                vk::DependencyFlags(), { barrier }, {}, {});
+        }
 #endif
     }
 
+    void Device::queueAccelStructCompaction(AccelStruct* as)
+    {
+        std::lock_guard lockGuard(m_Mutex);
+        m_PendingCompactions.push_back(as);
+    }
+
+    std::vector<RefCountPtr<AccelStruct>> Device::takeAccelStructCompactions()
+    {
+        std::lock_guard lockGuard(m_Mutex);
+        std::vector<RefCountPtr<AccelStruct>> pending;
+        pending.swap(m_PendingCompactions);
+        return pending;
+    }
+
     void CommandList::buildTopLevelAccelStructInternal(AccelStruct* as, VkDeviceAddress instanceData, size_t numInstances, rt::AccelStructBuildFlags buildFlags, uint64_t currentVersion)
     {
         // Remove the internal flag
@@ -757,6 +859,12 @@ namespace nvrhi::vulkan
             m_Context.device.destroyAccelerationStructureKHR(accelStruct, m_Context.allocationCallbacks);
             accelStruct = nullptr;
         }
+
+        if (compactionQueryPool)
+        {
+            m_Context.device.destroyQueryPool(compactionQueryPool, m_Context.allocationCallbacks);
+            compactionQueryPool = nullptr;
+        }
     }
 
     Object AccelStruct::getNativeObject(ObjectType objectType)
@@ -26,12 +26,22 @@
 namespace nvrhi::vulkan
 {
 
+    // FNV-1a
+    static uint64_t hashShaderBinary(const void* binary, const size_t binarySize)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < binarySize; i++)
+            hash = (hash ^ static_cast<const uint8_t*>(binary)[i]) * 0x100000001b3ull;
+        return hash;
+    }
+
     ShaderHandle Device::createShader(const ShaderDesc& desc, const void *binary, const size_t binarySize)
     {
         Shader *shader = new Shader(m_Context);
 
         shader->desc = desc;
         shader->stageFlagBits = convertShaderTypeToShaderStageFlagBits(desc.shaderType);
+        shader->contentHash = hashShaderBinary(binary, binarySize);
 
         auto shaderInfo = vk::ShaderModuleCreateInfo()
             .setCodeSize(binarySize)
@@ -49,7 +59,8 @@ namespace nvrhi::vulkan
     ShaderLibraryHandle Device::createShaderLibrary(const void* binary, const size_t binarySize)
     {
         ShaderLibrary* library = new ShaderLibrary(m_Context);
-        
+        library->contentHash = hashShaderBinary(binary, binarySize);
+
         auto shaderInfo = vk::ShaderModuleCreateInfo()
             .setCodeSize(binarySize)
             .setPCode((const uint32_t*)binary);
@@ -73,6 +84,7 @@ namespace nvrhi::vulkan
         newShader->desc = baseShader->desc;
         newShader->shaderModule = baseShader->shaderModule;
         newShader->stageFlagBits = baseShader->stageFlagBits;
+        newShader->contentHash = baseShader->contentHash;
         newShader->specializationConstants.assign(constants, constants + numConstants);
 
         return ShaderHandle::Create(newShader);
@@ -129,6 +141,7 @@ namespace nvrhi::vulkan
         newShader->shaderModule = shaderModule;
         newShader->baseShader = this;
         newShader->stageFlagBits = convertShaderTypeToShaderStageFlagBits(shaderType);
+        newShader->contentHash = contentHash;
 
         return ShaderHandle::Create(newShader);
     }
@@ -132,6 +132,43 @@ namespace nvrhi::vulkan
         }
     }
 
+    // Same as trackResourcesAndBarriers without the framebuffer, bundles can draw into any compatible one
+    void CommandList::trackBundleResources(const GraphicsState& state)
+    {
+        for (size_t i = 0; i < state.bindings.size(); i++)
+        {
+            setResourceStatesForBindingSet(state.bindings[i]);
+        }
+
+        if (state.indexBuffer.buffer)
+        {
+            requireBufferState(state.indexBuffer.buffer, ResourceStates::IndexBuffer);
+        }
+
+        for (const auto& vb : state.vertexBuffers)
+        {
+            requireBufferState(vb.buffer, ResourceStates::VertexBuffer);
+        }
+
+        if (state.indirectParams)
+        {
+            requireBufferState(state.indirectParams, ResourceStates::IndirectArgument);
+        }
+    }
+
+    void CommandList::trackBundleResources(const MeshletState& state)
+    {
+        for (size_t i = 0; i < state.bindings.size(); i++)
+        {
+            setResourceStatesForBindingSet(state.bindings[i]);
+        }
+
+        if (state.indirectParams)
+        {
+            requireBufferState(state.indirectParams, ResourceStates::IndirectArgument);
+        }
+    }
+
     void CommandList::requireTextureState(ITexture* _texture, TextureSubresourceSet subresources, ResourceStates state)
     {
         Texture* texture = checked_cast<Texture*>(_texture);
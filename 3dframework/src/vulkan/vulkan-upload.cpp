@@ -26,6 +26,11 @@
 namespace nvrhi::vulkan
 {
 
+    UploadManager::~UploadManager()
+    {
+        m_Device->trackUploadChunkMemory(-int64_t(m_AllocatedMemory));
+    }
+
     std::shared_ptr<BufferChunk> UploadManager::CreateChunk(uint64_t size)
     {
         std::shared_ptr<BufferChunk> chunk = std::make_shared<BufferChunk>();
@@ -58,6 +63,9 @@ namespace nvrhi::vulkan
             chunk->bufferSize = size;
         }
 
+        m_AllocatedMemory += size;
+        m_Device->trackUploadChunkMemory(int64_t(size));
+
         return chunk;
     }
 
@@ -1,4 +1,5 @@
 #include <engine.h>
+#include <string.h>
 
 static Mesh WARN_UNUSED_RESULT createHelloTriangleMesh() {
     const float vertices[][2] = {{-0.5f, 0.5f     }, {0.0f, -0.5f     }, {0.5f, 0.5f      }};
@@ -10,15 +11,32 @@ static Mesh WARN_UNUSED_RESULT createHelloTriangleMesh() {
     return mesh;
 }
 
-int main(int, char**) {
-    SCOPED(Application) app = initApplication("Hello Triangle with Buffers", 1024, 768, SRGB_FLAG | VSYNC_FLAG);
-    SCOPED(Shader) shader = loadShader(SHADER_DIR "shader");
-    SCOPED(Mesh) mesh = createHelloTriangleMesh();
+// Meshlets read 3D positions, the triangle faces the eye at z = -1
+static Mesh WARN_UNUSED_RESULT createHelloTriangleMesh3D() {
+    const float vertices[][3] = {{-0.5f, 0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}, {0.0f, -0.5f, 0.5f}};
+
+    Mesh mesh = createMesh(PrimitiveType_Triangles);
+    addMeshAttrib(mesh, RGB32_FLOAT, false, vertices, ARRAY_SIZE(vertices));
+    return mesh;
+}
+
+int main(int argc, char **argv) {
+    // "--meshlets" draws through the task and mesh stages of the framework, on Turing and later
+    const bool meshlets = argc > 1 && !strcmp(argv[1], "--meshlets");
+    SCOPED(Application) app = initApplication("Hello Triangle with Buffers", 1024, 768, SRGB_FLAG | VSYNC_FLAG | (meshlets ? NV_TURING_FLAG : 0));
+    SCOPED(Shader) shader = loadShader(meshlets ? SHADER_DIR "meshlets" : SHADER_DIR "shader");
+    SCOPED(Mesh) mesh = meshlets ? createHelloTriangleMesh3D() : createHelloTriangleMesh();
+    SCOPED(MeshletMesh) meshletMesh = {0};
+    Mat4 identity;
+    mat1(identity, 1.0f);
+
+    if (meshlets)
+        meshletMesh = createMeshletMesh(mesh);
 
     void myDraw() {
         useFramebuffer(getSwapchainFramebuffer());
         useShader(shader);
-        drawMesh(mesh);
+        meshlets ? drawMeshletMesh(meshletMesh, identity, identity, float4(0.0f, 0.0f, -1.0f, 1.0f)) : drawMesh(mesh);
     }
 
     bool myEvents() {return KEY_PRESSED(ESCAPE);}
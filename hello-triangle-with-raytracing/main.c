@@ -1,4 +1,5 @@
 #include <engine.h>
+#include <string.h>
 
 static Mesh WARN_UNUSED_RESULT createHelloTriangleMesh() {
     const float vertices[][2] = {{-0.5f, 0.5f}, {0.0f, -0.5f}, {0.5f, 0.5f}};
@@ -7,15 +8,25 @@ static Mesh WARN_UNUSED_RESULT createHelloTriangleMesh() {
     return mesh;
 }
 
-int main(int, char**) {
-    SCOPED(Application) app = initApplication("Hello Triangle Raytracing", 1024, 768, VSYNC_FLAG | RAYTRACING_FLAG);
-    SCOPED(Shader) shader = loadShader(SHADER_DIR "shader");
+int main(int argc, char **argv) {
+    // "--lbvh" traces a BVH built in compute, for devices without raytracing hardware
+    const bool lbvh = argc > 1 && !strcmp(argv[1], "--lbvh");
+    SCOPED(Application) app = initApplication("Hello Triangle Raytracing", 1024, 768, VSYNC_FLAG | (lbvh ? 0 : RAYTRACING_FLAG));
+    SCOPED(Shader) shader = loadShader(lbvh ? SHADER_DIR "shader_lbvh" : SHADER_DIR "shader");
     SCOPED(Mesh) mesh = createHelloTriangleMesh();
-    SCOPED(AccelerationStructure) as = createAccelerationStructure(mesh, false);
+    SCOPED(AccelerationStructure) as = {0};
+    SCOPED(Shader) builder = {0};
+    SCOPED(GpuBvh) bvh = {0};
+
+    if (lbvh) {
+        builder = loadShader(SHADER_DIR "lbvh");
+        bvh = createGpuBvh(builder, mesh);
+    } else
+        as = createAccelerationStructure(mesh, false);
 
     void myDraw() {
         useShader(shader);
-        setUniformAccelerationStructure(as);
+        lbvh ? setUniformGpuBvh(bvh) : setUniformAccelerationStructure(as);
         setUniformTexture(getSwapchainTexture(), "Framebuffer");
         dispatch2D(getWidth(), getHeight());
     }
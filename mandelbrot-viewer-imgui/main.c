@@ -16,6 +16,7 @@ int main(int, char**) {
     int maxIters = 300, aa = 2;
     double offset[2] = {-0.75, 0.0};
     double zoom = 2.5;
+    bool hotReload = false;
 
     void myDraw() {
         useFramebuffer(getSwapchainFramebuffer());
@@ -41,6 +42,7 @@ int main(int, char**) {
             );
         }
         ON_KEY_ONCE(F12, screenshot());
+        ON_KEY_ONCE(F5, setShaderHotReload(hotReload = !hotReload));
         return KEY_PRESSED(ESCAPE);
     }
 
@@ -76,6 +78,7 @@ int main(int, char**) {
         igSpacing(); igSeparator(); igSpacing();
 
         if (igButton("Take screenshot (F12)", (ImVec2){})) screenshot();
+        if (igCheckbox("Hot reload shaders (F5)", &hotReload)) setShaderHotReload(hotReload);
 
         igEnd();
     }
@@ -11,6 +11,7 @@ int main(int, char**) {
     getCamera()->fovy = 90.0f;
 
     float A = 0.4167f, B = 0.79f, C = 0.2f;
+    bool hotReload = false;
 
     void myDraw() {
         useShader(shader);
@@ -30,6 +31,7 @@ int main(int, char**) {
             ON_CLICK_ONCE(LEFT , grabInput(true ));
             ON_CLICK_ONCE(RIGHT, grabInput(false));
         }
+        ON_KEY_ONCE(F5, setShaderHotReload(hotReload = !hotReload));
         return KEY_PRESSED(ESCAPE);
     }
 
@@ -41,6 +43,7 @@ int main(int, char**) {
         igSliderFloat("B", &B, 0.785f, 0.795f, "%.4g", 1.0f);
         igSliderFloat("C", &C, 0.195f, 0.215f, "%.4g", 1.0f);
         igPopItemWidth();
+        if (igCheckbox("Hot reload shaders (F5)", &hotReload)) setShaderHotReload(hotReload);
 
         igEnd();
     }